@@ -0,0 +1,383 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include "BatchExport.h"
+
+#include <core/AudioEngine/OfflineRenderer.h>
+#include <core/Basics/Instrument.h>
+#include <core/Basics/InstrumentList.h>
+#include <core/Basics/Playlist.h>
+#include <core/Basics/Song.h>
+#include <core/EventQueue.h>
+#include <core/Hydrogen.h>
+#include <core/IO/DiskWriterDriver.h>
+#include <core/Preferences/Preferences.h>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QMap>
+#include <QProcess>
+#include <QSet>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+#include <QXmlStreamReader>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+using namespace H2Core;
+
+BatchExport::BatchExport( const Options& options )
+	: m_options( options )
+{
+}
+
+bool BatchExport::loadList( const QString& sListFile )
+{
+	m_songs.clear();
+	m_outputs.clear();
+
+	if ( sListFile.endsWith( ".h2playlist", Qt::CaseInsensitive ) ) {
+		Playlist* pPlaylist = Playlist::load_file(
+			sListFile, Preferences::get_instance()->isPlaylistUsingRelativeFilenames() );
+		if ( pPlaylist == nullptr ) {
+			___ERRORLOG( QString( "Unable to load playlist [%1]" ).arg( sListFile ) );
+			return false;
+		}
+		for ( int ii = 0; ii < pPlaylist->size(); ++ii ) {
+			m_songs << pPlaylist->get( ii )->filePath;
+			m_outputs << QString();
+		}
+		delete pPlaylist;
+	}
+	else {
+		QFile file( sListFile );
+		if ( ! file.open( QIODevice::ReadOnly | QIODevice::Text ) ) {
+			___ERRORLOG( QString( "Unable to open [%1]" ).arg( sListFile ) );
+			return false;
+		}
+		// Relative paths are resolved with respect to the list.
+		const QDir listDir = QFileInfo( sListFile ).absoluteDir();
+		QTextStream stream( &file );
+		while ( ! stream.atEnd() ) {
+			const QString sLine = stream.readLine().trimmed();
+			if ( sLine.isEmpty() || sLine.startsWith( '#' ) ) {
+				continue;
+			}
+			const QStringList fields = sLine.split( '\t' );
+			m_songs << listDir.absoluteFilePath( fields[ 0 ].trimmed() );
+			m_outputs << ( fields.size() > 1 ?
+						   listDir.absoluteFilePath( fields[ 1 ].trimmed() ) : QString() );
+		}
+	}
+
+	// Songs sharing a base name must not overwrite each other.
+	QSet<QString> usedOutputs;
+	for ( const auto& sOutput : m_outputs ) {
+		if ( ! sOutput.isEmpty() ) {
+			usedOutputs.insert( sOutput );
+		}
+	}
+	const QDir outputDir( m_options.sOutputDir );
+	for ( int ii = 0; ii < m_songs.size(); ++ii ) {
+		if ( ! m_outputs[ ii ].isEmpty() ) {
+			continue;
+		}
+		const QString sBaseName = QFileInfo( m_songs[ ii ] ).completeBaseName();
+		QString sOutput = outputDir.absoluteFilePath(
+			QString( "%1.%2" ).arg( sBaseName ).arg( m_options.sFormat ) );
+		for ( int nSuffix = 2; usedOutputs.contains( sOutput ); ++nSuffix ) {
+			sOutput = outputDir.absoluteFilePath(
+				QString( "%1_%2.%3" ).arg( sBaseName ).arg( nSuffix ).arg( m_options.sFormat ) );
+		}
+		usedOutputs.insert( sOutput );
+		m_outputs[ ii ] = sOutput;
+	}
+
+	if ( m_songs.isEmpty() ) {
+		___ERRORLOG( QString( "No songs found in [%1]" ).arg( sListFile ) );
+		return false;
+	}
+	return true;
+}
+
+QString BatchExport::readDrumkitName( const QString& sSong )
+{
+	QFile file( sSong );
+	if ( ! file.open( QIODevice::ReadOnly ) ) {
+		return QString();
+	}
+
+	QXmlStreamReader reader( &file );
+	while ( ! reader.atEnd() ) {
+		if ( reader.readNext() == QXmlStreamReader::StartElement &&
+			 reader.name() == QLatin1String( "drumkit" ) ) {
+			return reader.readElementText();
+		}
+	}
+	return QString();
+}
+
+QJsonObject BatchExport::errorEntry( const QString& sSong, const QString& sOutput,
+									 const QString& sError )
+{
+	QJsonObject entry;
+	entry[ "song" ] = sSong;
+	entry[ "output" ] = sOutput;
+	entry[ "status" ] = "error";
+	entry[ "error" ] = sError;
+	return entry;
+}
+
+QJsonObject BatchExport::exportSong( const QString& sSong, const QString& sOutput )
+{
+	Hydrogen* pHydrogen = Hydrogen::get_instance();
+	EventQueue* pQueue = EventQueue::get_instance();
+
+	const auto start = std::chrono::steady_clock::now();
+	std::shared_ptr<Song> pSong = Song::load( sSong );
+	if ( pSong == nullptr ) {
+		return errorEntry( sSong, sOutput, "Unable to load song" );
+	}
+	pHydrogen->setSong( pSong );
+	const double fLoadTime = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start ).count();
+
+	InstrumentList* pInstrumentList = pSong->getInstrumentList();
+	for ( int ii = 0; ii < pInstrumentList->size(); ++ii ) {
+		pInstrumentList->get( ii )->set_currently_exported( true );
+	}
+
+	if ( ! QDir().mkpath( QFileInfo( sOutput ).absolutePath() ) ) {
+		return errorEntry( sSong, sOutput, "Unable to create output directory" );
+	}
+	if ( ! pHydrogen->startExportSession( m_options.nSampleRate, m_options.nSampleDepth ) ) {
+		return errorEntry( sSong, sOutput, "Unable to start export session" );
+	}
+	pHydrogen->startExportSong( sOutput, m_options.bExportStems, m_options.bDeterministic );
+
+	bool bDone = false;
+	while ( ! bDone ) {
+		const Event event = pQueue->pop_event();
+		if ( event.type == EVENT_PROGRESS && event.value == 100 ) {
+			bDone = true;
+		} else if ( event.type == EVENT_NONE ) {
+			QThread::msleep( 10 );
+		}
+	}
+
+	auto pDiskWriterDriver = dynamic_cast<DiskWriterDriver*>( pHydrogen->getAudioOutput() );
+	QJsonObject entry;
+	if ( pDiskWriterDriver == nullptr || ! pDiskWriterDriver->getRenderer()->getSucceeded() ) {
+		entry = errorEntry( sSong, sOutput, "Rendering failed" );
+	}
+	else {
+		const OfflineRenderer* pRenderer = pDiskWriterDriver->getRenderer();
+		entry[ "song" ] = sSong;
+		entry[ "output" ] = sOutput;
+		entry[ "status" ] = "ok";
+		entry[ "drumkit" ] = pInstrumentList->size() > 0 ?
+			pInstrumentList->get( 0 )->get_drumkit_name() : QString();
+		entry[ "duration" ] = static_cast<double>( pRenderer->getRenderedFrames() ) /
+			m_options.nSampleRate;
+		entry[ "loadTime" ] = fLoadTime;
+		entry[ "renderTime" ] = pRenderer->getRenderTime();
+		entry[ "realtimeFactor" ] = pRenderer->getRealtimeFactor();
+		entry[ "peak" ] = pRenderer->getPeak();
+		if ( pRenderer->getPeak() > 0 ) {
+			entry[ "peakDb" ] = 20 * std::log10( pRenderer->getPeak() );
+		} else {
+			entry[ "peakDb" ] = QJsonValue();
+		}
+	}
+	pHydrogen->stopExportSession();
+
+	return entry;
+}
+
+QJsonArray BatchExport::exportSongs( volatile bool* pQuit )
+{
+	QJsonArray summary;
+	for ( int ii = 0; ii < m_songs.size(); ++ii ) {
+		if ( pQuit != nullptr && *pQuit ) {
+			summary.append( errorEntry( m_songs[ ii ], m_outputs[ ii ], "Aborted" ) );
+			continue;
+		}
+
+		std::cerr << "[" << ( ii + 1 ) << "/" << m_songs.size() << "] "
+				  << m_songs[ ii ].toLocal8Bit().constData() << " ... " << std::flush;
+		const QJsonObject entry = exportSong( m_songs[ ii ], m_outputs[ ii ] );
+		if ( entry[ "status" ].toString() == "ok" ) {
+			std::cerr << "DONE ("
+					  << QString::number( entry[ "realtimeFactor" ].toDouble(), 'f', 1 )
+				.toLocal8Bit().constData() << "x realtime)" << std::endl;
+		} else {
+			std::cerr << "FAILED: "
+					  << entry[ "error" ].toString().toLocal8Bit().constData() << std::endl;
+		}
+		summary.append( entry );
+	}
+	return summary;
+}
+
+QJsonArray BatchExport::exportSongsParallel( const QString& sExecutable )
+{
+	const int nJobs = std::max( 1, std::min( m_options.nJobs, m_songs.size() ) );
+
+	// Songs of the same drumkit are kept within the same job as long
+	// as this does not leave other jobs idle. Each drumkit is split
+	// into chunks of at most `nMaxChunk` songs and the largest chunks
+	// are assigned first, each to the job with the fewest songs.
+	QMap<QString, QList<int>> kits;
+	for ( int ii = 0; ii < m_songs.size(); ++ii ) {
+		kits[ readDrumkitName( m_songs[ ii ] ) ].append( ii );
+	}
+	const int nMaxChunk = ( m_songs.size() + nJobs - 1 ) / nJobs;
+	std::vector<QList<int>> chunks;
+	for ( const auto& songs : kits ) {
+		for ( int ii = 0; ii < songs.size(); ii += nMaxChunk ) {
+			chunks.push_back( songs.mid( ii, nMaxChunk ) );
+		}
+	}
+	std::stable_sort( chunks.begin(), chunks.end(),
+					  []( const QList<int>& a, const QList<int>& b ) {
+						  return a.size() > b.size(); } );
+	std::vector<QList<int>> jobs( nJobs );
+	for ( const auto& chunk : chunks ) {
+		auto pJob = std::min_element( jobs.begin(), jobs.end(),
+									  []( const QList<int>& a, const QList<int>& b ) {
+										  return a.size() < b.size(); } );
+		pJob->append( chunk );
+	}
+
+	QTemporaryDir tmpDir;
+	if ( ! tmpDir.isValid() ) {
+		___ERRORLOG( "Unable to create temporary directory" );
+		return QJsonArray();
+	}
+
+	std::vector<std::unique_ptr<QProcess>> processes;
+	for ( int nJob = 0; nJob < nJobs; ++nJob ) {
+		if ( jobs[ nJob ].isEmpty() ) {
+			continue;
+		}
+		const QString sList = tmpDir.filePath( QString( "job%1.lst" ).arg( nJob ) );
+		QFile file( sList );
+		if ( ! file.open( QIODevice::WriteOnly | QIODevice::Text ) ) {
+			___ERRORLOG( QString( "Unable to write [%1]" ).arg( sList ) );
+			continue;
+		}
+		QTextStream stream( &file );
+		for ( int nSong : jobs[ nJob ] ) {
+			stream << m_songs[ nSong ] << '\t' << m_outputs[ nSong ] << '\n';
+		}
+		file.close();
+
+		QStringList args;
+		args << "--batch" << sList << "--jobs" << "1"
+			 << "--summary" << tmpDir.filePath( QString( "job%1.json" ).arg( nJob ) )
+			 << "--rate" << QString::number( m_options.nSampleRate )
+			 << "--bits" << QString::number( m_options.nSampleDepth );
+		if ( m_options.bExportStems ) {
+			args << "--stems";
+		}
+		if ( m_options.bDeterministic ) {
+			args << "--deterministic";
+		}
+		if ( ! m_options.sDriver.isEmpty() ) {
+			args << "--driver" << m_options.sDriver;
+		}
+		if ( ! m_options.sLogLevel.isEmpty() ) {
+			args << QString( "--verbose=%1" ).arg( m_options.sLogLevel );
+		}
+
+		auto pProcess = std::make_unique<QProcess>();
+		pProcess->setProcessChannelMode( QProcess::ForwardedChannels );
+		pProcess->start( sExecutable, args );
+		processes.push_back( std::move( pProcess ) );
+	}
+
+	___INFOLOG( QString( "Exporting [%1] songs using [%2] drumkits in [%3] processes" )
+				.arg( m_songs.size() ).arg( kits.size() ).arg( processes.size() ) );
+
+	for ( auto& pProcess : processes ) {
+		pProcess->waitForFinished( -1 );
+	}
+
+	// Merge the summaries of all jobs in the order of the list.
+	QMap<QString, QJsonObject> entries;
+	for ( int nJob = 0; nJob < nJobs; ++nJob ) {
+		QFile file( tmpDir.filePath( QString( "job%1.json" ).arg( nJob ) ) );
+		if ( ! file.open( QIODevice::ReadOnly ) ) {
+			continue;
+		}
+		for ( const auto& entry : QJsonDocument::fromJson( file.readAll() ).array() ) {
+			entries[ entry.toObject()[ "output" ].toString() ] = entry.toObject();
+		}
+	}
+
+	QJsonArray summary;
+	for ( int ii = 0; ii < m_songs.size(); ++ii ) {
+		if ( entries.contains( m_outputs[ ii ] ) ) {
+			summary.append( entries[ m_outputs[ ii ] ] );
+		} else {
+			summary.append( errorEntry( m_songs[ ii ], m_outputs[ ii ],
+										"Export process failed" ) );
+		}
+	}
+	return summary;
+}
+
+bool BatchExport::allSucceeded( const QJsonArray& summary )
+{
+	for ( const auto& entry : summary ) {
+		if ( entry.toObject()[ "status" ].toString() != "ok" ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool BatchExport::writeSummary( const QJsonArray& summary, const QString& sPath )
+{
+	const QByteArray json = QJsonDocument( summary ).toJson( QJsonDocument::Indented );
+	QFile file( sPath );
+	if ( ! file.open( QIODevice::WriteOnly | QIODevice::Truncate ) ) {
+		___ERRORLOG( QString( "Unable to write summary to [%1]" ).arg( sPath ) );
+		return false;
+	}
+	file.write( json );
+	return true;
+}
+
+QString BatchExport::defaultSummaryPath( const QString& sListFile )
+{
+	const QFileInfo info( sListFile );
+	return info.dir().filePath( info.completeBaseName() + ".summary.json" );
+}
@@ -0,0 +1,124 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2CLI_BATCH_EXPORT_H
+#define H2CLI_BATCH_EXPORT_H
+
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+
+/**
+ * Exports a list of songs to audio files.
+ *
+ * The list is either a playlist (*.h2playlist) or a text file with
+ * one song per line. Each line may contain the path of the output
+ * file separated by a tab. Otherwise the output is written into
+ * Options::sOutputDir using the base name of the song. Empty lines
+ * and lines starting with '#' are ignored.
+ *
+ * Since the core of Hydrogen is a singleton, songs are rendered
+ * concurrently by spawning one h2cli process per job. Songs using
+ * the same drumkit are kept together as long as this does not leave
+ * other jobs idle: the songs of each drumkit are split into chunks
+ * of at most ceil(songs / jobs) and each chunk is rendered by a
+ * single job.
+ *
+ * Within a job songs are rendered one after another and share their
+ * decoded samples via H2Core::SampleCache. The previous song is
+ * still loaded while the next one is, so a drumkit is decoded only
+ * once per job regardless of the cache budget. Samples are not
+ * shared across jobs.
+ *
+ * The result is a JSON array containing the render time and peak
+ * level of each song. It is always written to a file, since stdout
+ * is shared with the log messages. Progress is reported on stderr.
+ */
+class BatchExport
+{
+public:
+	struct Options {
+		QString sOutputDir;
+		/** Suffix of the exported files.*/
+		QString sFormat;
+		int nSampleRate;
+		int nSampleDepth;
+		bool bExportStems;
+		/** See Hydrogen::startExportSong().*/
+		bool bDeterministic;
+		/** Number of songs rendered concurrently.*/
+		int nJobs;
+		/** Passed on to the spawned processes.
+		 * @{ */
+		QString sDriver;
+		QString sLogLevel;
+		/** @} */
+	};
+
+	BatchExport( const Options& options );
+
+	/** \return false if @a sListFile could not be read or does not
+	 * contain any songs.*/
+	bool loadList( const QString& sListFile );
+	int size() const;
+
+	/**
+	 * Renders all songs within the current process. Requires
+	 * H2Core::Hydrogen to be up and running.
+	 *
+	 * \param pQuit Stops after the current song once set.
+	 */
+	QJsonArray exportSongs( volatile bool* pQuit );
+	/**
+	 * Distributes all songs across Options::nJobs processes of
+	 * @a sExecutable and waits for them to finish. Does not require
+	 * H2Core::Hydrogen.
+	 */
+	QJsonArray exportSongsParallel( const QString& sExecutable );
+
+	/** \return true in case all songs were exported.*/
+	static bool allSucceeded( const QJsonArray& summary );
+	/** Writes @a summary to @a sPath.*/
+	static bool writeSummary( const QJsonArray& summary, const QString& sPath );
+	/** \return Path of the summary in case none was given: the list
+	 * file @a sListFile with its suffix replaced by "summary.json".*/
+	static QString defaultSummaryPath( const QString& sListFile );
+
+private:
+	QJsonObject exportSong( const QString& sSong, const QString& sOutput );
+	/** \return Name of the drumkit used by the first instrument of
+	 * @a sSong without loading its samples.*/
+	static QString readDrumkitName( const QString& sSong );
+	static QJsonObject errorEntry( const QString& sSong, const QString& sOutput,
+								   const QString& sError );
+
+	Options m_options;
+	QStringList m_songs;
+	QStringList m_outputs;
+};
+
+inline int BatchExport::size() const {
+	return m_songs.size();
+}
+
+#endif // H2CLI_BATCH_EXPORT_H
@@ -20,6 +20,7 @@
  *
  */
 
+#include <QCoreApplication>
 #include <QLibraryInfo>
 #include <QThread>
 #include <core/config.h>
@@ -33,6 +34,7 @@
 #include <core/Basics/Song.h>
 #include <core/MidiMap.h>
 #include <core/AudioEngine/AudioEngine.h>
+#include <core/AudioEngine/OfflineRenderer.h>
 #include <core/Hydrogen.h>
 #include <core/Basics/InstrumentList.h>
 #include <core/Basics/Instrument.h>
@@ -43,6 +45,9 @@
 #include <core/Basics/Playlist.h>
 #include <core/Sampler/Interpolation.h>
 #include <core/Helpers/Filesystem.h>
+#include <core/IO/DiskWriterDriver.h>
+
+#include "BatchExport.h"
 
 #include <iostream>
 #include <signal.h>
@@ -69,6 +74,14 @@ static struct option long_opts[] = {
 	{"help", 0, nullptr, 'h'},
 	{"install", required_argument, nullptr, 'i'},
 	{"drumkit", required_argument, nullptr, 'k'},
+	{"profile", 0, nullptr, 'P'},
+	{"trace", required_argument, nullptr, 'T'},
+	{"stems", 0, nullptr, 't'},
+	{"batch", required_argument, nullptr, 'B'},
+	{"jobs", required_argument, nullptr, 'j'},
+	{"format", required_argument, nullptr, 'F'},
+	{"summary", required_argument, nullptr, 'J'},
+	{"deterministic", 0, nullptr, 'D'},
 	{nullptr, 0, nullptr, 0},
 };
 
@@ -141,6 +154,14 @@ int main(int argc, char *argv[])
 		short bits = 16;
 		int rate = 44100;
 		short interpolation = 0;
+		bool bShowProfile = false;
+		QString sTraceFilename;
+		bool bExportStems = false;
+		QString sBatchFilename;
+		int nJobs = QThread::idealThreadCount();
+		QString sFormat = "wav";
+		QString sSummaryFilename;
+		bool bDeterministic = false;
 #ifdef H2CORE_HAVE_JACKSESSION
 		QString sessionId;
 #endif
@@ -179,6 +200,30 @@ int main(int argc, char *argv[])
 			case 'v':
 				showVersionOpt = true;
 				break;
+			case 'P':
+				bShowProfile = true;
+				break;
+			case 'T':
+				sTraceFilename = QString::fromLocal8Bit(optarg);
+				break;
+			case 't':
+				bExportStems = true;
+				break;
+			case 'B':
+				sBatchFilename = QString::fromLocal8Bit(optarg);
+				break;
+			case 'j':
+				nJobs = strtol(optarg, nullptr, 10);
+				break;
+			case 'F':
+				sFormat = QString::fromLocal8Bit(optarg);
+				break;
+			case 'J':
+				sSummaryFilename = QString::fromLocal8Bit(optarg);
+				break;
+			case 'D':
+				bDeterministic = true;
+				break;
 			case 'V':
 				logLevelOpt = (optarg) ? optarg : "Warning";
 				break;
@@ -288,8 +333,51 @@ int main(int argc, char *argv[])
 //		QString path = pQApp->applicationFilePath();
 //		preferences->setJackSessionApplicationPath ( path );
 #endif
+		// Batch export
+		BatchExport::Options batchOptions;
+		batchOptions.sOutputDir = outFilename;
+		batchOptions.sFormat = sFormat;
+		batchOptions.nSampleRate = rate;
+		batchOptions.nSampleDepth = bits;
+		batchOptions.bExportStems = bExportStems;
+		batchOptions.bDeterministic = bDeterministic;
+		batchOptions.nJobs = nJobs;
+		batchOptions.sDriver = sSelectedDriver;
+		batchOptions.sLogLevel = logLevelOpt;
+		BatchExport batchExport( batchOptions );
+		if ( ! sBatchFilename.isEmpty() ) {
+			if ( ! batchExport.loadList( sBatchFilename ) ) {
+				exit(1);
+			}
+			if ( sSummaryFilename.isEmpty() ) {
+				sSummaryFilename = BatchExport::defaultSummaryPath( sBatchFilename );
+				std::cerr << "Writing summary to "
+						  << sSummaryFilename.toLocal8Bit().constData() << std::endl;
+			}
+		}
+		if ( ! sBatchFilename.isEmpty() && nJobs > 1 ) {
+			// The songs are rendered by child processes.
+			QCoreApplication app( argc, argv );
+			const QJsonArray summary =
+				batchExport.exportSongsParallel( QCoreApplication::applicationFilePath() );
+			BatchExport::writeSummary( summary, sSummaryFilename );
+			delete Logger::get_instance();
+			exit( BatchExport::allSucceeded( summary ) ? 0 : 1 );
+		}
+
 		Hydrogen::create_instance();
 		Hydrogen *pHydrogen = Hydrogen::get_instance();
+
+		if ( ! sBatchFilename.isEmpty() ) {
+			signal(SIGINT, signal_handler);
+			const QJsonArray summary = batchExport.exportSongs( &quit );
+			BatchExport::writeSummary( summary, sSummaryFilename );
+			// Preferences are not saved. Several batch processes might
+			// be running at the same time.
+			delete pHydrogen;
+			delete Logger::get_instance();
+			exit( BatchExport::allSucceeded( summary ) ? 0 : 1 );
+		}
 		std::shared_ptr<Song> pSong = nullptr;
 		Playlist *pPlaylist = nullptr;
 
@@ -383,7 +471,7 @@ int main(int argc, char *argv[])
 				pInstrumentList->get(i)->set_currently_exported( true );
 			}
 			pHydrogen->startExportSession(rate, bits);
-			pHydrogen->startExportSong( outFilename );
+			pHydrogen->startExportSong( outFilename, bExportStems, bDeterministic );
 			std::cout << "Export Progress ... ";
 			ExportMode = true;
 		}
@@ -402,8 +490,17 @@ int main(int argc, char *argv[])
 				if ( event.value < 100 ) {
 					std::cout << "\rExport Progress ... " << event.value << "%";
 				} else {
+					auto pDiskWriterDriver = dynamic_cast<DiskWriterDriver*>( pHydrogen->getAudioOutput() );
+					if ( pDiskWriterDriver != nullptr &&
+						 pDiskWriterDriver->getRenderer()->getSucceeded() ) {
+						std::cout << "\rExport Progress ... DONE ("
+								  << QString::number( pDiskWriterDriver->getRenderer()->getRealtimeFactor(), 'f', 1 )
+							.toLocal8Bit().data()
+								  << "x realtime)" << std::endl;
+					} else {
+						std::cout << "\rExport Progress ... FAILED" << std::endl;
+					}
 					pHydrogen->stopExportSession();
-					std::cout << "\rExport Progress ... DONE" << std::endl;
 					quit = true;
 				}
 				break;
@@ -423,6 +520,10 @@ int main(int argc, char *argv[])
 				break;
 			case EVENT_NONE: /* Sleep if there is no more events */
 				Sleeper::msleep ( 100 );
+				// Collect the timing of the audio engine before it
+				// gets overwritten.
+				pAudioEngine->getProfiler()->update();
+				pHydrogen->releaseRetiredInstruments();
 				break;
 				
 			case EVENT_QUIT: // Shutdown if indicated by a
@@ -439,6 +540,14 @@ int main(int argc, char *argv[])
 			pHydrogen->sequencer_stop();
 		}
 
+		if ( bShowProfile ) {
+			std::cout << std::endl << "DSP profile:" << std::endl
+					  << pAudioEngine->getProfiler()->toTable().toLocal8Bit().constData();
+		}
+		if ( ! sTraceFilename.isEmpty() ) {
+			pAudioEngine->getProfiler()->dumpChromeTrace( sTraceFilename );
+		}
+
 		//delete pSong;
 		pSong = nullptr;
 		delete pPlaylist;
@@ -497,10 +606,21 @@ void showUsage()
 	std::cout << "   -o, --outfile FILE - Output to file (export)" << std::endl;
 	std::cout << "   -r, --rate RATE - Set bitrate while exporting file" << std::endl;
 	std::cout << "   -b, --bits BITS - Set bits depth while exporting file" << std::endl;
+	std::cout << "   -t, --stems - Additionally export each instrument into a separate file" << std::endl;
+	std::cout << "   -D, --deterministic - Use the random seed of the song while exporting. Exporting" << std::endl;
+	std::cout << "       the same song again yields the same file" << std::endl;
+	std::cout << "   -B, --batch FILE - Export all songs of a playlist (*.h2playlist) or a text file" << std::endl;
+	std::cout << "       with one song per line into the directory given by --outfile" << std::endl;
+	std::cout << "   -j, --jobs N - Number of songs exported concurrently in batch mode" << std::endl;
+	std::cout << "   -F, --format SUFFIX - Format of the files exported in batch mode (wav [default], flac, ...)" << std::endl;
+	std::cout << "   -J, --summary FILE - File the JSON summary of a batch export is written to" << std::endl;
+	std::cout << "       (default: the batch FILE with its suffix replaced by summary.json)" << std::endl;
 	std::cout << "   -k, --kit drumkit_name - Load a drumkit at startup" << std::endl;
 	std::cout << "   -i, --install FILE - install a drumkit (*.h2drumkit)" << std::endl;
 	std::cout << "   -I, --interpolate INT - Interpolation" << std::endl;
 	std::cout << "       (0:linear [default],1:cosine,2:third,3:cubic,4:hermite)" << std::endl;
+	std::cout << "   -P, --profile - Print the time spent in the phases of the audio engine on exit" << std::endl;
+	std::cout << "   -T, --trace FILE - Write a Chrome trace (*.json) of the audio engine on exit" << std::endl;
 
 #ifdef H2CORE_HAVE_JACKSESSION
 	std::cout << "   -S, --jacksessionid ID - Start a JackSessionHandler session" << std::endl;
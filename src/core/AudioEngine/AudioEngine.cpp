@@ -21,6 +21,7 @@
  */
 
 #include <core/AudioEngine/AudioEngine.h>
+#include <core/AudioEngine/Mixing.h>
 
 #ifdef WIN32
 #    include "core/Timehelper.h"
@@ -62,43 +63,16 @@
 
 #include <core/Hydrogen.h>	// TODO: remove this line as soon as possible
 #include <core/Preferences/Preferences.h>
+#include <algorithm>
 #include <cassert>
 
 namespace H2Core
 {
 
-
-inline int randomValue( int max )
-{
-	return rand() % max;
-}
-
-inline float getGaussian( float z )
-{
-	// gaussian distribution -- dimss
-	float x1, x2, w;
-	do {
-		x1 = 2.0 * ( ( ( float ) rand() ) / static_cast<float>(RAND_MAX) ) - 1.0;
-		x2 = 2.0 * ( ( ( float ) rand() ) / static_cast<float>(RAND_MAX) ) - 1.0;
-		w = x1 * x1 + x2 * x2;
-	} while ( w >= 1.0 );
-
-	w = sqrtf( ( -2.0 * logf( w ) ) / w );
-	return x1 * w * z + 0.0; // tunable
-}
-
-
-/** Gets the current time.
- * \return Current time obtained by gettimeofday()*/
-inline timeval currentTime2()
-{
-	struct timeval now;
-	gettimeofday( &now, nullptr );
-	return now;
-}
-
 AudioEngine::AudioEngine()
 		: TransportInfo()
+		, m_pNotePool( nullptr )
+		, m_pProfiler( nullptr )
 		, m_pSampler( nullptr )
 		, m_pSynth( nullptr )
 		, m_fElapsedTime( 0 )
@@ -120,15 +94,20 @@ AudioEngine::AudioEngine()
 		, m_nextState( State::Ready )
 		, m_fProcessTime( 0.0f )
 		, m_fMaxProcessTime( 0.0f )
+		, m_nSkippedPeriods( 0 )
+		, m_bOfflineRendering( false )
 		, m_fNextBpm( 120 )
 {
 
-	m_pSampler = new Sampler;
+	m_pNotePool = new NotePool( Preferences::get_instance()->m_nNotePoolSize );
+	m_pProfiler = new DspProfiler();
+	m_pSampler = new Sampler( m_pNotePool );
 	m_pSynth = new Synth;
 	
 	m_pEventQueue = EventQueue::get_instance();
 	
 	srand( time( nullptr ) );
+	seedRandom( static_cast<uint64_t>( time( nullptr ) ) );
 
 	// Create metronome instrument
 	// Get the path to the file of the metronome sound.
@@ -168,6 +147,13 @@ AudioEngine::~AudioEngine()
 
 	clearNoteQueue();
 
+	// Notes of commands which were never applied are still owned by
+	// the AudioEngine.
+	EngineCommand command;
+	while ( m_commandQueue.pop( command ) ) {
+		m_pNotePool->release( command.pNote );
+	}
+
 	// change the current audio engine state
 	setState( State::Uninitialized );
 
@@ -190,6 +176,8 @@ AudioEngine::~AudioEngine()
 //	delete Sequencer::get_instance();
 	delete m_pSampler;
 	delete m_pSynth;
+	delete m_pNotePool;
+	delete m_pProfiler;
 }
 
 Sampler* AudioEngine::getSampler() const
@@ -331,6 +319,13 @@ void AudioEngine::reset() {
 	clearNoteQueue();
 }
 
+void AudioEngine::seedRandom( uint64_t nSeed ) {
+	m_random.seed( nSeed );
+	// Separate streams keep the choice of layers independent of
+	// the number of random numbers drawn by the humanization.
+	m_pSampler->getRandom().seed( nSeed + 1 );
+}
+
 float AudioEngine::computeTickSize( const int nSampleRate, const float fBpm, const int nResolution)
 {
 	float fTickSize = nSampleRate * 60.0 / fBpm / nResolution;
@@ -678,6 +673,9 @@ void AudioEngine::setAudioDriver( AudioOutput* pAudioDriver ) {
 		}
 		
 		setupLadspaFX();
+
+		// The sample rate of the new driver might differ.
+		pHydrogen->resampleSamples();
 	}
 }
 
@@ -817,6 +815,10 @@ void AudioEngine::processCheckBPMChanged() {
 		return;
 	}
 
+	// The start of all queued notes moved.
+	m_songNoteQueue.reschedule( [&]( Note* pNote ) {
+			return computeNoteStartFrame( pNote ); } );
+
 	float fTickNumber = (float)oldFrame / fOldTickSize;
 	DEBUGLOG( QString( "Recomputing ticksize and frame position. Old TS: %1, new TS: %2, old pos: %3, new pos: %4" )
 			  .arg( fOldTickSize ).arg( fNewTickSize )
@@ -881,9 +883,11 @@ void AudioEngine::processPlayNotes( unsigned long nframes )
 	AutomationPath *vp = pSong->getVelocityAutomationPath();
 	
 
-	// reading from m_songNoteQueue
-	while ( !m_songNoteQueue.empty() ) {
-		Note *pNote = m_songNoteQueue.top();
+	// reading from m_songNoteQueue. All notes starting before the end
+	// of the current period will be played.
+	Note *pNote;
+	while ( ( pNote = m_songNoteQueue.popDue( static_cast<long long>( framepos ) +
+											  static_cast<long long>( nframes ) ) ) != nullptr ) {
 
 		float velocity_adjustment = 1.0f;
 		if ( pHydrogen->getMode() == Song::Mode::Song ) {
@@ -891,98 +895,73 @@ void AudioEngine::processPlayNotes( unsigned long nframes )
 			velocity_adjustment = vp->get_value(fPos);
 		}
 
-		// verifico se la nota rientra in questo ciclo
-		unsigned int noteStartInFrames =
-			(int)( pNote->get_position() * getTickSize() );
-
-		// if there is a negative Humanize delay, take into account so
-		// we don't miss the time slice.  ignore positive delay, or we
-		// might end the queue processing prematurely based on NoteQueue
-		// placement.  the sampler handles positive delay.
-		if (pNote->get_humanize_delay() < 0) {
-			noteStartInFrames += pNote->get_humanize_delay();
-		}
-
-		// m_nTotalFrames <= NotePos < m_nTotalFrames + bufferSize
-		bool isNoteStart = ( ( noteStartInFrames >= framepos )
-							 && ( noteStartInFrames < ( framepos + nframes ) ) );
-		bool isOldNote = noteStartInFrames < framepos;
-
-		if ( isNoteStart || isOldNote ) {
-			// Humanize - Velocity parameter
-			pNote->set_velocity( pNote->get_velocity() * velocity_adjustment );
-
-			/* Check if the current note has probability != 1
-			 * If yes remove call random function to dequeue or not the note
-			 */
-			float fNoteProbability = pNote->get_probability();
-			if ( fNoteProbability != 1. ) {
-				if ( fNoteProbability < (float) rand() / (float) RAND_MAX ) {
-					m_songNoteQueue.pop();
-					pNote->get_instrument()->dequeue();
-					continue;
-				}
-			}
-
-			if ( pSong->getHumanizeVelocityValue() != 0 ) {
-				float random = pSong->getHumanizeVelocityValue() * getGaussian( 0.2 );
-				pNote->set_velocity(
-							pNote->get_velocity()
-							+ ( random
-								- ( pSong->getHumanizeVelocityValue() / 2.0 ) )
-							);
-				if ( pNote->get_velocity() > 1.0 ) {
-					pNote->set_velocity( 1.0 );
-				} else if ( pNote->get_velocity() < 0.0 ) {
-					pNote->set_velocity( 0.0 );
-				}
+		// Humanize - Velocity parameter
+		pNote->set_velocity( pNote->get_velocity() * velocity_adjustment );
+
+		/* Check if the current note has probability != 1
+		 * If yes remove call random function to dequeue or not the note
+		 */
+		float fNoteProbability = pNote->get_probability();
+		if ( fNoteProbability != 1. ) {
+			if ( fNoteProbability < m_random.uniform() ) {
+				pNote->get_instrument()->dequeue();
+				m_pNotePool->release( pNote );
+				continue;
 			}
+		}
 
-			// Offset + Random Pitch ;)
-			float fPitch = pNote->get_pitch() + pNote->get_instrument()->get_pitch_offset();
-			/* Check if the current instrument has random picth factor != 0.
-			 * If yes add a gaussian perturbation to the pitch
-			 */
-			float fRandomPitchFactor = pNote->get_instrument()->get_random_pitch_factor();
-			if ( fRandomPitchFactor != 0. ) {
-				fPitch += getGaussian( 0.4 ) * fRandomPitchFactor;
-			}
-			pNote->set_pitch( fPitch );
-
-
-			/*
-			 * Check if the current instrument has the property "Stop-Note" set.
-			 * If yes, a NoteOff note is generated automatically after each note.
-			 */
-			auto  noteInstrument = pNote->get_instrument();
-			if ( noteInstrument->is_stop_notes() ){
-				Note *pOffNote = new Note( noteInstrument,
-										   0.0,
-										   0.0,
-										   0.0,
-										   -1,
-										   0 );
-				pOffNote->set_note_off( true );
-				pHydrogen->getAudioEngine()->getSampler()->noteOn( pOffNote );
-				delete pOffNote;
+		if ( pSong->getHumanizeVelocityValue() != 0 ) {
+			float random = pSong->getHumanizeVelocityValue() * m_random.gaussian( 0.2 );
+			pNote->set_velocity(
+						pNote->get_velocity()
+						+ ( random
+							- ( pSong->getHumanizeVelocityValue() / 2.0 ) )
+						);
+			if ( pNote->get_velocity() > 1.0 ) {
+				pNote->set_velocity( 1.0 );
+			} else if ( pNote->get_velocity() < 0.0 ) {
+				pNote->set_velocity( 0.0 );
 			}
+		}
 
-			m_pSampler->noteOn( pNote );
-			m_songNoteQueue.pop(); // rimuovo la nota dalla lista di note
-			pNote->get_instrument()->dequeue();
-			// raise noteOn event
-			int nInstrument = pSong->getInstrumentList()->index( pNote->get_instrument() );
-			if( pNote->get_note_off() ){
-				delete pNote;
-			}
+		// Offset + Random Pitch ;)
+		float fPitch = pNote->get_pitch() + pNote->get_instrument()->get_pitch_offset();
+		/* Check if the current instrument has random picth factor != 0.
+		 * If yes add a gaussian perturbation to the pitch
+		 */
+		float fRandomPitchFactor = pNote->get_instrument()->get_random_pitch_factor();
+		if ( fRandomPitchFactor != 0. ) {
+			fPitch += m_random.gaussian( 0.4 ) * fRandomPitchFactor;
+		}
+		pNote->set_pitch( fPitch );
+
+
+		/*
+		 * Check if the current instrument has the property "Stop-Note" set.
+		 * If yes, a NoteOff note is generated automatically after each note.
+		 */
+		auto  noteInstrument = pNote->get_instrument();
+		if ( noteInstrument->is_stop_notes() ){
+			Note *pOffNote = m_pNotePool->acquire( noteInstrument,
+												   0.0,
+												   0.0,
+												   0.0,
+												   -1,
+												   0 );
+			pOffNote->set_note_off( true );
+			m_pSampler->noteOn( pOffNote );
+			m_pNotePool->release( pOffNote );
+		}
 
-			m_pEventQueue->push_event( EVENT_NOTEON, nInstrument );
-			
-			continue;
-		} else {
-			// this note will not be played
-			break;
+		m_pSampler->noteOn( pNote );
+		pNote->get_instrument()->dequeue();
+		// raise noteOn event
+		int nInstrument = pSong->getInstrumentList()->index( pNote->get_instrument() );
+		if( pNote->get_note_off() ){
+			m_pNotePool->release( pNote );
 		}
+
+		m_pEventQueue->push_event( EVENT_NOTEON, nInstrument );
 	}
 }
 
@@ -1038,15 +1017,15 @@ void AudioEngine::processTransport( unsigned nFrames )
 void AudioEngine::clearNoteQueue()
 {
 	// delete all copied notes in the song notes queue
-	while (!m_songNoteQueue.empty()) {
-		m_songNoteQueue.top()->get_instrument()->dequeue();
-		delete m_songNoteQueue.top();
-		m_songNoteQueue.pop();
+	Note* pNote;
+	while ( ( pNote = m_songNoteQueue.pop() ) != nullptr ) {
+		pNote->get_instrument()->dequeue();
+		m_pNotePool->release( pNote );
 	}
 
 	// delete all copied notes in the midi notes queue
 	for ( unsigned i = 0; i < m_midiNoteQueue.size(); ++i ) {
-		delete m_midiNoteQueue[i];
+		m_pNotePool->release( m_midiNoteQueue[i] );
 	}
 	m_midiNoteQueue.clear();
 }
@@ -1054,7 +1033,8 @@ void AudioEngine::clearNoteQueue()
 int AudioEngine::audioEngine_process( uint32_t nframes, void* /*arg*/ )
 {
 	AudioEngine* pAudioEngine = Hydrogen::get_instance()->getAudioEngine();
-	timeval startTimeval = currentTime2();
+	DspProfiler* pProfiler = pAudioEngine->m_pProfiler;
+	const int64_t nStartTime = DspProfiler::now();
 
 	// Resetting all audio output buffers with zeros.
 	pAudioEngine->clearAudioBuffers( nframes );
@@ -1081,25 +1061,51 @@ int AudioEngine::audioEngine_process( uint32_t nframes, void* /*arg*/ )
 	 * (like shutting down drivers). In such cases, it seems to be ok to interrupt
 	 * audio processing. Returning the special return value "2" enables the disk 
 	 * writer driver to repeat the processing of the current data.
+	 *
+	 * Everything happening during regular playback (notes triggered
+	 * by the GUI or MIDI, pattern selection) is posted via
+	 * pushCommand() and does not require the lock. Swapping in a
+	 * drumkit and removing instruments is done by this thread itself
+	 * via applyEdit(). Fine-grained edits of patterns and instruments
+	 * in the GUI as well as replacing the Song, which stops playback
+	 * anyway, still hold the lock. Realtime drivers therefore wait
+	 * for the lock for at most the remaining slack time and skip the
+	 * period in case it could not be acquired.
+	 *
+	 * The OfflineRenderer has no deadline to meet. It waits for the
+	 * lock for as long as it takes. The lock is usually uncontended
+	 * during export sessions but keeps mutators, like loading a
+	 * drumkit via OSC or MIDI, from racing with the rendering.
 	 */
-				
-	if ( !pAudioEngine->tryLockFor( std::chrono::microseconds( (int)(1000.0*fSlackTime) ),
-							  RIGHT_HERE ) ) {
-		___ERRORLOG( QString( "Failed to lock audioEngine in allowed %1 ms, missed buffer" ).arg( fSlackTime ) );
-
-		if ( dynamic_cast<DiskWriterDriver*>(pAudioEngine->m_pAudioDriver) != nullptr ) {
+	const bool bIsDiskWriter =
+		dynamic_cast<DiskWriterDriver*>(pAudioEngine->m_pAudioDriver) != nullptr;
+	if ( pAudioEngine->m_bOfflineRendering ) {
+		pAudioEngine->lock( RIGHT_HERE );
+	}
+	else if ( !pAudioEngine->tryLockFor( std::chrono::microseconds( (int)(1000.0*fSlackTime) ),
+										 RIGHT_HERE ) ) {
+		if ( bIsDiskWriter ) {
+			___ERRORLOG( QString( "Failed to lock audioEngine in allowed %1 ms, missed buffer" ).arg( fSlackTime ) );
 			return 2;	// inform the caller that we could not aquire the lock
 		}
-
+		// No logging in here. Composing the message would allocate
+		// memory in the realtime thread.
+		pAudioEngine->m_nSkippedPeriods++;
 		return 0;
 	}
 
+	// Commands must not pile up while the engine is not running.
+	pAudioEngine->processCommands();
+
 	if ( pAudioEngine->getState() != AudioEngine::State::Ready &&
 		 pAudioEngine->getState() != AudioEngine::State::Playing ) {
 		pAudioEngine->unlock();
 		return 0;
 	}
 
+	int64_t nPhaseStart = nStartTime;
+	int64_t nPhaseEnd;
+
 	Hydrogen* pHydrogen = Hydrogen::get_instance();
 	std::shared_ptr<Song> pSong = pHydrogen->getSong();
 
@@ -1116,6 +1122,10 @@ int AudioEngine::audioEngine_process( uint32_t nframes, void* /*arg*/ )
 	// Check whether the tick size has changed.
 	pAudioEngine->processCheckBPMChanged();
 
+	nPhaseEnd = DspProfiler::now();
+	pProfiler->record( DspProfiler::Transport, nPhaseStart, nPhaseEnd );
+	nPhaseStart = nPhaseEnd;
+
 	bool bSendPatternChange = false;
 	// always update note queue.. could come from pattern or realtime input
 	// (midi, keyboard)
@@ -1141,36 +1151,39 @@ int AudioEngine::audioEngine_process( uint32_t nframes, void* /*arg*/ )
 	// play all notes
 	pAudioEngine->processPlayNotes( nframes );
 
+	nPhaseEnd = DspProfiler::now();
+	pProfiler->record( DspProfiler::NoteQueue, nPhaseStart, nPhaseEnd );
+	nPhaseStart = nPhaseEnd;
+
 	float *pBuffer_L = pAudioEngine->m_pAudioDriver->getOut_L(),
 		*pBuffer_R = pAudioEngine->m_pAudioDriver->getOut_R();
 	assert( pBuffer_L != nullptr && pBuffer_R != nullptr );
 
 	// SAMPLER
 	pAudioEngine->getSampler()->process( nframes, pSong );
-	float* out_L = pAudioEngine->getSampler()->m_pMainOut_L;
-	float* out_R = pAudioEngine->getSampler()->m_pMainOut_R;
-	for ( unsigned i = 0; i < nframes; ++i ) {
-		pBuffer_L[ i ] += out_L[ i ];
-		pBuffer_R[ i ] += out_R[ i ];
-	}
+
+	nPhaseEnd = DspProfiler::now();
+	pProfiler->record( DspProfiler::Sampler, nPhaseStart, nPhaseEnd );
+	nPhaseStart = nPhaseEnd;
 
 	// SYNTH
 	pAudioEngine->getSynth()->process( nframes );
-	out_L = pAudioEngine->getSynth()->m_pOut_L;
-	out_R = pAudioEngine->getSynth()->m_pOut_R;
-	for ( unsigned i = 0; i < nframes; ++i ) {
-		pBuffer_L[ i ] += out_L[ i ];
-		pBuffer_R[ i ] += out_R[ i ];
-	}
 
-	timeval renderTime_end = currentTime2();
-	timeval ladspaTime_start = renderTime_end;
+	nPhaseEnd = DspProfiler::now();
+	pProfiler->record( DspProfiler::Synth, nPhaseStart, nPhaseEnd );
+
+	// Both are summed within a single sweep.
+	Mixing::add( pBuffer_L, pAudioEngine->getSampler()->m_pMainOut_L,
+				 pAudioEngine->getSynth()->m_pOut_L, nframes );
+	Mixing::add( pBuffer_R, pAudioEngine->getSampler()->m_pMainOut_R,
+				 pAudioEngine->getSynth()->m_pOut_R, nframes );
 
 #ifdef H2CORE_HAVE_LADSPA
 	// Process LADSPA FX
 	for ( unsigned nFX = 0; nFX < MAX_FX; ++nFX ) {
 		LadspaFX *pFX = Effects::get_instance()->getLadspaFX( nFX );
 		if ( ( pFX ) && ( pFX->isEnabled() ) ) {
+			nPhaseStart = DspProfiler::now();
 			pFX->processFX( nframes );
 
 			float *buf_L, *buf_R;
@@ -1182,50 +1195,28 @@ int AudioEngine::audioEngine_process( uint32_t nframes, void* /*arg*/ )
 				buf_R = buf_L;
 			}
 
-			for ( unsigned i = 0; i < nframes; ++i ) {
-				pBuffer_L[ i ] += buf_L[ i ];
-				pBuffer_R[ i ] += buf_R[ i ];
-				if ( buf_L[ i ] > pAudioEngine->m_fFXPeak_L[nFX] ) {
-					pAudioEngine->m_fFXPeak_L[nFX] = buf_L[ i ];
-				}
+			Mixing::addAndPeak( pBuffer_L, buf_L, nframes, pAudioEngine->m_fFXPeak_L[nFX] );
+			Mixing::addAndPeak( pBuffer_R, buf_R, nframes, pAudioEngine->m_fFXPeak_R[nFX] );
 
-				if ( buf_R[ i ] > pAudioEngine->m_fFXPeak_R[nFX] ) {
-					pAudioEngine->m_fFXPeak_R[nFX] = buf_R[ i ];
-				}
-			}
+			pProfiler->record( DspProfiler::Ladspa + nFX, nPhaseStart, DspProfiler::now() );
 		}
 	}
 #endif
-	timeval ladspaTime_end = currentTime2();
-
+	const int64_t nLadspaEnd = DspProfiler::now();
+	nPhaseStart = nLadspaEnd;
 
 	// update master peaks
-	float val_L, val_R;
-	for ( unsigned i = 0; i < nframes; ++i ) {
-		val_L = pBuffer_L[i];
-		val_R = pBuffer_R[i];
+	pAudioEngine->m_fMasterPeak_L = Mixing::peak( pBuffer_L, nframes,
+												  pAudioEngine->m_fMasterPeak_L );
+	pAudioEngine->m_fMasterPeak_R = Mixing::peak( pBuffer_R, nframes,
+												  pAudioEngine->m_fMasterPeak_R );
 
-		if ( val_L > pAudioEngine->m_fMasterPeak_L ) {
-			pAudioEngine->m_fMasterPeak_L = val_L;
-		}
-
-		if ( val_R > pAudioEngine->m_fMasterPeak_R ) {
-			pAudioEngine->m_fMasterPeak_R = val_R;
-		}
-
-		for (std::vector<DrumkitComponent*>::iterator it = pSong->getComponents()->begin() ; it != pSong->getComponents()->end(); ++it) {
-			DrumkitComponent* drumkit_component = *it;
-
-			float compo_val_L = drumkit_component->get_out_L(i);
-			float compo_val_R = drumkit_component->get_out_R(i);
-
-			if( compo_val_L > drumkit_component->get_peak_l() ) {
-				drumkit_component->set_peak_l( compo_val_L );
-			}
-			if( compo_val_R > drumkit_component->get_peak_r() ) {
-				drumkit_component->set_peak_r( compo_val_R );
-			}
-		}
+	// update component peaks
+	for ( auto pDrumkitComponent : *pSong->getComponents() ) {
+		pDrumkitComponent->set_peak_l( Mixing::peak( pDrumkitComponent->get_out_L(), nframes,
+													 pDrumkitComponent->get_peak_l() ) );
+		pDrumkitComponent->set_peak_r( Mixing::peak( pDrumkitComponent->get_out_R(), nframes,
+													 pDrumkitComponent->get_peak_r() ) );
 	}
 
 	// update total frames number
@@ -1234,19 +1225,20 @@ int AudioEngine::audioEngine_process( uint32_t nframes, void* /*arg*/ )
 		pAudioEngine->updateElapsedTime( nframes, pAudioEngine->m_pAudioDriver->getSampleRate() );
 	}
 
-	timeval finishTimeval = currentTime2();
-	pAudioEngine->m_fProcessTime =
-			( finishTimeval.tv_sec - startTimeval.tv_sec ) * 1000.0
-			+ ( finishTimeval.tv_usec - startTimeval.tv_usec ) / 1000.0;
+	const int64_t nFinishTime = DspProfiler::now();
+	pProfiler->record( DspProfiler::Metering, nPhaseStart, nFinishTime );
+	pProfiler->record( DspProfiler::Total, nStartTime, nFinishTime );
+	pAudioEngine->m_fProcessTime = ( nFinishTime - nStartTime ) / 1000000.0;
 
 #ifdef CONFIG_DEBUG
-	if ( pAudioEngine->m_fProcessTime > m_fMaxProcessTime ) {
+	if ( pAudioEngine->m_fProcessTime > pAudioEngine->m_fMaxProcessTime ) {
 		___WARNINGLOG( "" );
 		___WARNINGLOG( "----XRUN----" );
 		___WARNINGLOG( QString( "XRUN of %1 msec (%2 > %3)" )
-					   .arg( ( m_fProcessTime - pAudioEngine->m_fMaxProcessTime ) )
-					   .arg( m_fProcessTime ).arg( pAudioEngine->m_fMaxProcessTime ) );
-		___WARNINGLOG( QString( "Ladspa process time = %1" ).arg( fLadspaTime ) );
+					   .arg( ( pAudioEngine->m_fProcessTime - pAudioEngine->m_fMaxProcessTime ) )
+					   .arg( pAudioEngine->m_fProcessTime ).arg( pAudioEngine->m_fMaxProcessTime ) );
+		// nPhaseEnd still marks the end of the synth phase.
+		___WARNINGLOG( QString( "Ladspa process time = %1" ).arg( ( nLadspaEnd - nPhaseEnd ) / 1000000.0 ) );
 		___WARNINGLOG( "------------" );
 		___WARNINGLOG( "" );
 		// raise xRun event
@@ -1385,7 +1377,7 @@ int AudioEngine::updateNoteQueue( unsigned nFrames )
 
 			m_midiNoteQueue.pop_front();
 			pNote->get_instrument()->enqueue();
-			m_songNoteQueue.push( pNote );
+			m_songNoteQueue.push( pNote, computeNoteStartFrame( pNote ) );
 		}
 
 		if (  getState() != State::Playing ) {
@@ -1561,15 +1553,16 @@ int AudioEngine::updateNoteQueue( unsigned nFrames )
 				m_pMetronomeInstrument->set_volume(
 							Preferences::get_instance()->m_fMetronomeVolume
 							);
-				Note *pMetronomeNote = new Note( m_pMetronomeInstrument,
-												 tick,
-												 fVelocity,
-												 0.f, // pan
-												 -1,
-												 fPitch
-												 );
+				Note *pMetronomeNote = m_pNotePool->acquire( m_pMetronomeInstrument,
+															 tick,
+															 fVelocity,
+															 0.f, // pan
+															 -1,
+															 fPitch
+															 );
 				m_pMetronomeInstrument->enqueue();
-				m_songNoteQueue.push( pMetronomeNote );
+				m_songNoteQueue.push( pMetronomeNote,
+									  computeNoteStartFrame( pMetronomeNote ) );
 			}
 		}
 
@@ -1624,7 +1617,7 @@ int AudioEngine::updateNoteQueue( unsigned nFrames )
 						*/
 						if ( pSong->getHumanizeTimeValue() != 0 ) {
 							nOffset += ( int )(
-										getGaussian( 0.3 )
+										m_random.gaussian( 0.3 )
 										* pSong->getHumanizeTimeValue()
 										* m_nMaxTimeHumanize
 										);
@@ -1646,11 +1639,12 @@ int AudioEngine::updateNoteQueue( unsigned nFrames )
 						// back.
 						// Why a copy? because it has the new offset (including swing and random timing) in its
 						// humanized delay, and tick position is expressed referring to start time (and not pattern).
-						Note *pCopiedNote = new Note( pNote );
+						Note *pCopiedNote = m_pNotePool->acquire( pNote );
 						pCopiedNote->set_position( tick );
 						pCopiedNote->set_humanize_delay( nOffset );
 						pNote->get_instrument()->enqueue();
-						m_songNoteQueue.push( pCopiedNote );
+						m_songNoteQueue.push( pCopiedNote,
+											  computeNoteStartFrame( pCopiedNote ) );
 					}
 				}
 			}
@@ -1778,21 +1772,286 @@ void AudioEngine::noteOn( Note *note )
 	if ( ( getState() != State::Playing ) && ( getState() != State::Ready ) ) {
 		___ERRORLOG( QString( "Error the audio engine is not in State::Ready or State::Playing but [%1]" )
 					 .arg( static_cast<int>( getState() ) ) );
-		delete note;
+		m_pNotePool->release( note );
 		return;
 	}
 
-	m_midiNoteQueue.push_back( note );
+	EngineCommand command;
+	command.type = EngineCommand::Type::MidiNoteOn;
+	command.pNote = note;
+	command.nValue = 0;
+	command.pPattern = nullptr;
+	if ( !pushCommand( command ) ) {
+		m_pNotePool->release( note );
+	}
+}
+
+bool AudioEngine::pushCommand( const EngineCommand& command )
+{
+	if ( !m_commandQueue.push( command ) ) {
+		___WARNINGLOG( QString( "Command queue full. Dropping command [%1]" )
+					   .arg( static_cast<int>( command.type ) ) );
+		return false;
+	}
+	return true;
+}
+
+void AudioEngine::samplerNoteOn( Note* pNote )
+{
+	EngineCommand command;
+	command.type = EngineCommand::Type::SamplerNoteOn;
+	command.pNote = pNote;
+	command.nValue = 0;
+	command.pPattern = nullptr;
+	if ( !pushCommand( command ) ) {
+		m_pNotePool->release( pNote );
+	}
+}
+
+void AudioEngine::samplerNoteOff( Note* pNote )
+{
+	EngineCommand command;
+	command.type = EngineCommand::Type::SamplerNoteOff;
+	command.pNote = pNote;
+	command.nValue = 0;
+	command.pPattern = nullptr;
+	if ( !pushCommand( command ) ) {
+		m_pNotePool->release( pNote );
+	}
 }
 
-bool AudioEngine::compare_pNotes::operator()(Note* pNote1, Note* pNote2)
+void AudioEngine::midiNoteOff( Note* pNote, int nKey )
 {
-	return (pNote1->get_humanize_delay() +
-			pNote1->get_position() *
-			Hydrogen::get_instance()->getAudioEngine()->getTickSize()) >
-		   (pNote2->get_humanize_delay() +
-			pNote2->get_position() *
-			Hydrogen::get_instance()->getAudioEngine()->getTickSize());
+	EngineCommand command;
+	command.type = EngineCommand::Type::MidiNoteOff;
+	command.pNote = pNote;
+	command.nValue = nKey;
+	command.pPattern = nullptr;
+	if ( !pushCommand( command ) ) {
+		m_pNotePool->release( pNote );
+	}
+}
+
+void AudioEngine::processCommands()
+{
+	// Without a Song or the pattern lists there is nothing to apply
+	// the commands to. They are dropped.
+	if ( getState() != State::Ready && getState() != State::Playing ) {
+		EngineCommand command;
+		while ( m_commandQueue.pop( command ) ) {
+			if ( command.type == EngineCommand::Type::Edit ) {
+				processEdit( command.nValue );
+			} else {
+				m_pNotePool->release( command.pNote );
+			}
+		}
+		return;
+	}
+
+	bool bSendPatternChange = false;
+	EngineCommand command;
+	while ( m_commandQueue.pop( command ) ) {
+		switch ( command.type ) {
+		case EngineCommand::Type::SamplerNoteOn:
+			m_pSampler->noteOn( command.pNote );
+			// The Sampler only keeps notes which are played.
+			if ( command.pNote->get_note_off() ) {
+				m_pNotePool->release( command.pNote );
+			}
+			break;
+
+		case EngineCommand::Type::SamplerNoteOff:
+			// Takes care of deleting the note.
+			m_pSampler->noteOff( command.pNote );
+			break;
+
+		case EngineCommand::Type::MidiNoteOn:
+			m_midiNoteQueue.push_back( command.pNote );
+			break;
+
+		case EngineCommand::Type::MidiNoteOff:
+			if ( m_pSampler->isInstrumentPlaying( command.pNote->get_instrument() ) ) {
+				if ( command.nValue != -1 ) {
+					m_pSampler->midiKeyboardNoteOff( command.nValue );
+				} else {
+					command.pNote->set_note_off( true );
+					m_pSampler->noteOn( command.pNote );
+				}
+			}
+			m_pNotePool->release( command.pNote );
+			break;
+
+		case EngineCommand::Type::ToggleNextPattern:
+			toggleNextPattern( command.pPattern );
+			bSendPatternChange = true;
+			break;
+
+		case EngineCommand::Type::SetOnlyNextPattern:
+			setOnlyNextPattern( command.pPattern );
+			bSendPatternChange = true;
+			break;
+
+		case EngineCommand::Type::Edit:
+			processEdit( command.nValue );
+			break;
+
+		case EngineCommand::Type::None:
+		default:
+			m_pNotePool->release( command.pNote );
+			break;
+		}
+	}
+
+	if ( bSendPatternChange ) {
+		EventQueue::get_instance()->push_event( EVENT_PATTERN_CHANGED, -1 );
+	}
+}
+
+void AudioEngine::processEdit( int nSlot )
+{
+	EditSlot& slot = m_editSlots[ nSlot ];
+	EditSlot::State expected = EditSlot::State::Pending;
+	if ( slot.state.compare_exchange_strong( expected, EditSlot::State::Claimed ) ) {
+		( *slot.pEdit )();
+		slot.state.store( EditSlot::State::Done );
+	} else {
+		// The poster timed out and did apply the edit itself.
+		slot.state.store( EditSlot::State::Free );
+	}
+}
+
+void AudioEngine::applyEdit( const std::function<void()>& edit )
+{
+	auto applyLocked = [&]() {
+		lock( RIGHT_HERE );
+		edit();
+		unlock();
+	};
+
+	if ( m_LockingThread == std::this_thread::get_id() ) {
+		edit();
+		return;
+	}
+	if ( m_pAudioDriver == nullptr ||
+		 ( getState() != State::Ready && getState() != State::Playing ) ) {
+		applyLocked();
+		return;
+	}
+
+	int nSlot = 0;
+	for ( ; nSlot < nEditSlots; ++nSlot ) {
+		EditSlot::State expected = EditSlot::State::Free;
+		if ( m_editSlots[ nSlot ].state.compare_exchange_strong(
+				 expected, EditSlot::State::Pending ) ) {
+			break;
+		}
+	}
+	if ( nSlot == nEditSlots ) {
+		WARNINGLOG( "No free edit slot. Applying edit using the lock" );
+		applyLocked();
+		return;
+	}
+	EditSlot& slot = m_editSlots[ nSlot ];
+	slot.pEdit = &edit;
+
+	EngineCommand command;
+	command.type = EngineCommand::Type::Edit;
+	command.pNote = nullptr;
+	command.nValue = nSlot;
+	command.pPattern = nullptr;
+	if ( !pushCommand( command ) ) {
+		slot.state.store( EditSlot::State::Free );
+		applyLocked();
+		return;
+	}
+
+	// Give the audio thread a couple of periods to pick up the edit.
+	const auto timeout = std::max(
+		std::chrono::milliseconds( 50 ),
+		std::chrono::milliseconds( 4000 * m_pAudioDriver->getBufferSize() /
+								   std::max( 1u, m_pAudioDriver->getSampleRate() ) ) );
+	const auto deadline = std::chrono::steady_clock::now() + timeout;
+	while ( slot.state.load() == EditSlot::State::Pending &&
+			std::chrono::steady_clock::now() < deadline ) {
+		std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+	}
+
+	EditSlot::State expected = EditSlot::State::Pending;
+	if ( slot.state.compare_exchange_strong( expected, EditSlot::State::Cancelled ) ) {
+		// The audio thread frees the slot once it encounters the
+		// cancelled command.
+		WARNINGLOG( "Audio thread did not pick up edit in time. Applying it using the lock" );
+		applyLocked();
+		return;
+	}
+
+	while ( slot.state.load() != EditSlot::State::Done ) {
+		std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+	}
+	slot.state.store( EditSlot::State::Free );
+}
+
+void AudioEngine::toggleNextPattern( Pattern* pPattern )
+{
+	Hydrogen* pHydrogen = Hydrogen::get_instance();
+	std::shared_ptr<Song> pSong = pHydrogen->getSong();
+	if ( pSong == nullptr || pHydrogen->getMode() != Song::Mode::Pattern ) {
+		m_pNextPatterns->clear();
+		return;
+	}
+
+	// The pattern might have been removed since the command was
+	// posted.
+	if ( pSong->getPatternList()->index( pPattern ) == -1 ) {
+		return;
+	}
+
+	// If the pattern is already in the `m_pNextPatterns`, it will be
+	// removed from the latter and its `del()` method will return a
+	// pointer to the very pattern. The if clause is therefore only
+	// entered if the `pPattern` was not already present.
+	if ( m_pNextPatterns->del( pPattern ) == nullptr ) {
+		m_pNextPatterns->add( pPattern );
+	}
+}
+
+void AudioEngine::setOnlyNextPattern( Pattern* pPattern )
+{
+	Hydrogen* pHydrogen = Hydrogen::get_instance();
+	std::shared_ptr<Song> pSong = pHydrogen->getSong();
+	if ( pSong == nullptr || pHydrogen->getMode() != Song::Mode::Pattern ) {
+		m_pNextPatterns->clear();
+		return;
+	}
+
+	// Clear the list of all patterns scheduled to be processed
+	// next and fill them with those currently played.
+	m_pNextPatterns->clear();
+	for ( int ii = 0; ii < m_pPlayingPatterns->size(); ++ii ) {
+		m_pNextPatterns->add( m_pPlayingPatterns->get( ii ) );
+	}
+
+	// Appending the requested pattern unless it was removed since
+	// the command was posted.
+	if ( pSong->getPatternList()->index( pPattern ) != -1 ) {
+		m_pNextPatterns->add( pPattern );
+	}
+}
+
+long long AudioEngine::computeNoteStartFrame( Note* pNote ) const
+{
+	long long nStartFrame =
+		static_cast<long long>( pNote->get_position() * getTickSize() );
+
+	// if there is a negative Humanize delay, take into account so
+	// we don't miss the time slice.  ignore positive delay, or we
+	// might end the queue processing prematurely based on NoteQueue
+	// placement.  the sampler handles positive delay.
+	if ( pNote->get_humanize_delay() < 0 ) {
+		nStartFrame += pNote->get_humanize_delay();
+	}
+
+	return std::max( nStartFrame, 0LL );
 }
 
 void AudioEngine::play() {
@@ -31,12 +31,18 @@
 #include <core/Basics/Note.h>
 #include <core/AudioEngine/TransportInfo.h>
 #include <core/CoreActionController.h>
+#include <core/Helpers/LockFreeQueue.h>
+#include <core/Helpers/Random.h>
+#include <core/AudioEngine/NotePool.h>
+#include <core/AudioEngine/DspProfiler.h>
+#include <core/AudioEngine/NoteScheduler.h>
 
 #include <core/IO/AudioOutput.h>
 #include <core/IO/JackAudioDriver.h>
 #include <core/IO/DiskWriterDriver.h>
 #include <core/IO/FakeDriver.h>
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <cassert>
@@ -44,7 +50,7 @@
 #include <thread>
 #include <chrono>
 #include <deque>
-#include <queue>
+#include <functional>
 
 /** \def RIGHT_HERE
  * Macro intended to be used for the logging of the locking of the
@@ -65,10 +71,58 @@ namespace H2Core
 	class MidiOutput;
 	class MidiInput;
 	class EventQueue;
+	class Pattern;
 	class PatternList;
 	class Drumkit;
 	class Song;
-	
+
+/**
+ * Mutation of the AudioEngine posted by a non-realtime thread (GUI,
+ * MIDI, OSC) using AudioEngine::pushCommand(). It is applied by the
+ * audio thread at the beginning of the next process cycle so neither
+ * side has to wait for the AudioEngine lock.
+ *
+ * \ingroup docCore docAudioEngine
+ */
+struct EngineCommand {
+	enum class Type {
+		None,
+		/** Hand #pNote to Sampler::noteOn(). Note off notes will be
+		 * deleted afterwards.*/
+		SamplerNoteOn,
+		/** Release all notes sharing the instrument of #pNote using
+		 * Sampler::noteOff(), which deletes the note.*/
+		SamplerNoteOff,
+		/** Append #pNote to AudioEngine::m_midiNoteQueue.*/
+		MidiNoteOn,
+		/** MIDI note off for the instrument of #pNote, which is
+		 * deleted afterwards. Ignored in case the instrument is not
+		 * playing. Otherwise the notes of MIDI key #nValue are
+		 * released using Sampler::midiKeyboardNoteOff() or, if
+		 * #nValue is -1, #pNote is passed to Sampler::noteOn() as
+		 * note off note.*/
+		MidiNoteOff,
+		/** Add #pPattern to AudioEngine::m_pNextPatterns or remove
+		 * it in case it is already present. Ignored in case #pPattern
+		 * is not part of the current Song anymore.*/
+		ToggleNextPattern,
+		/** Replace AudioEngine::m_pNextPatterns by the currently
+		 * playing patterns and #pPattern. The latter is only added
+		 * if it is still part of the current Song.*/
+		SetOnlyNextPattern,
+		/** Run the edit posted to slot #nValue using
+		 * AudioEngine::applyEdit().*/
+		Edit
+	};
+
+	Type type;
+	Note* pNote;
+	int nValue;
+	/** Only compared against the patterns of the current Song and
+	 * never dereferenced before it was found in there.*/
+	Pattern* pPattern;
+};
+
 /**
  * Audio Engine main class.
  *
@@ -213,7 +267,57 @@ public:
 	 * AudioEngine lock.
 	 */
 	void			assertLocked( );
+	/**
+	 * Queues @a note to be played at its position in the MIDI note
+	 * queue. Thread-safe and does not require the AudioEngine lock.
+	 */
 	void			noteOn( Note *note );
+
+	/**
+	 * Posts @a command to be applied by the audio thread at the
+	 * beginning of the next process cycle.
+	 *
+	 * Thread-safe and non-blocking. Does not require the AudioEngine
+	 * lock.
+	 *
+	 * \return false if the queue was full. The caller still owns the
+	 * Note associated with @a command in this case.
+	 */
+	bool			pushCommand( const EngineCommand& command );
+	/**
+	 * Convenience function posting a EngineCommand::Type::SamplerNoteOn
+	 * command. The AudioEngine takes ownership of @a pNote.
+	 */
+	void			samplerNoteOn( Note* pNote );
+	/**
+	 * Convenience function posting a EngineCommand::Type::SamplerNoteOff
+	 * command. The AudioEngine takes ownership of @a pNote.
+	 */
+	void			samplerNoteOff( Note* pNote );
+	/**
+	 * Convenience function posting a EngineCommand::Type::MidiNoteOff
+	 * command. The AudioEngine takes ownership of @a pNote.
+	 */
+	void			midiNoteOff( Note* pNote, int nKey );
+	/**
+	 * Runs @a edit on the audio thread at the beginning of the next
+	 * process cycle and returns once it is done.
+	 *
+	 * Used for structural changes of the Song, like swapping in a
+	 * freshly loaded drumkit, the audio thread would otherwise have
+	 * to wait for. @a edit is run within the process cycle and has
+	 * to be short. Everything expensive, like loading samples or
+	 * releasing the previous objects, must happen outside of it.
+	 *
+	 * @a edit is run right away while holding the AudioEngine lock
+	 * in case the calling thread already holds it, the engine is
+	 * neither in State::Ready nor State::Playing, or the audio
+	 * thread did not pick it up within a couple of periods (e.g. the
+	 * driver is not running).
+	 *
+	 * Must not be called by the audio thread.
+	 */
+	void			applyEdit( const std::function<void()>& edit );
 	
 	/**
 	 * Main audio processing function called by the audio drivers whenever
@@ -282,6 +386,10 @@ public:
 	Sampler*		getSampler() const;
 	/** \return #m_pSynth */
 	Synth*			getSynth() const;
+	/** \return #m_pNotePool */
+	NotePool*		getNotePool() const;
+	/** \return #m_pProfiler */
+	DspProfiler*	getProfiler() const;
 
 	/** \return #m_fElapsedTime */
 	float			getElapsedTime() const;	
@@ -354,6 +462,22 @@ public:
 
 	float			getProcessTime() const;
 	float			getMaxProcessTime() const;
+	/** \return #m_nSkippedPeriods */
+	int				getSkippedPeriods() const;
+
+	/** \param bOffline Sets #m_bOfflineRendering. */
+	void			setOfflineRendering( bool bOffline );
+	/** \return #m_bOfflineRendering */
+	bool			getOfflineRendering() const;
+
+	/**
+	 * Seeds #m_random as well as the generator of the Sampler.
+	 *
+	 * Once seeded the same song is rendered the same way, including
+	 * its humanization, note probabilities, and random layers. Must
+	 * not be called while the audio thread is processing.
+	 */
+	void			seedRandom( uint64_t nSeed );
 
 	int				getPatternTickPosition() const;
 
@@ -466,6 +590,39 @@ public:
 private:
 	
 	inline void			processPlayNotes( unsigned long nframes );
+	/**
+	 * Applies all commands posted via pushCommand() since the last
+	 * process cycle. Must only be called by the audio thread while
+	 * holding the AudioEngine lock.
+	 *
+	 * Commands posted while the engine is neither in State::Ready nor
+	 * State::Playing are dropped. Edits posted via applyEdit() are
+	 * run nevertheless since their poster is waiting for them.
+	 */
+	void			processCommands();
+	/**
+	 * Runs the edit posted to slot @a nSlot of #m_editSlots unless
+	 * its poster already gave up on it.
+	 */
+	void			processEdit( int nSlot );
+	/**
+	 * Adds @a pPattern to #m_pNextPatterns or removes it in case it
+	 * is already present. Ignored in case @a pPattern is not part of
+	 * the pattern list of the current Song anymore.
+	 */
+	void			toggleNextPattern( Pattern* pPattern );
+	/**
+	 * Replaces #m_pNextPatterns by #m_pPlayingPatterns and @a
+	 * pPattern, provided the latter is still part of the pattern list
+	 * of the current Song.
+	 */
+	void			setOnlyNextPattern( Pattern* pPattern );
+	/**
+	 * \return Frame @a pNote has to be handed to the Sampler. Positive
+	 * humanization delays are handled by the Sampler itself and not
+	 * taken into account.
+	 */
+	long long		computeNoteStartFrame( Note* pNote ) const;
 	/**
 	 * Updating the TransportInfo of the audio driver.
 	 */
@@ -568,6 +725,13 @@ private:
 	 * directly but using the JACK server.
 	 */
 	void			locate( unsigned long nFrame, bool bWithJackBroadcast = true );
+	/**
+	 * Storage for all notes created during playback. Its size is set
+	 * by Preferences::m_nNotePoolSize.
+	 */
+	NotePool*			m_pNotePool;
+	/** Timing of the individual phases of audioEngine_process(). */
+	DspProfiler*		m_pProfiler;
 	/** Local instance of the Sampler. */
 	Sampler* 			m_pSampler;
 	/** Local instance of the Synth. */
@@ -664,6 +828,46 @@ private:
 	// max ms usable in process with no xrun
 	float				m_fMaxProcessTime;
 
+	/**
+	 * Number of process cycles in which audioEngine_process() could
+	 * not acquire the AudioEngine lock within the slack time of the
+	 * period and had to output silence.
+	 *
+	 * Displayed in the AudioEngineInfoForm.
+	 */
+	std::atomic<int>	m_nSkippedPeriods;
+
+	/**
+	 * Set by the OfflineRenderer while rendering a song to disk.
+	 *
+	 * The renderer is the only thread driving the engine during an
+	 * export session. audioEngine_process() waits for the AudioEngine
+	 * lock without a timeout in each block.
+	 */
+	std::atomic<bool>	m_bOfflineRendering;
+
+	/**
+	 * Commands posted by non-realtime threads via pushCommand(). The
+	 * audio thread is the only consumer.
+	 */
+	LockFreeQueue<EngineCommand, 1024>	m_commandQueue;
+
+	/**
+	 * Hands an edit posted via applyEdit() over to the audio thread.
+	 *
+	 * The poster reserves a #Free slot by setting it #Pending and
+	 * posts its index. The audio thread either claims and runs the
+	 * edit or, in case the poster did time out and #Cancelled it,
+	 * frees the slot. The edit is only ever run by one of both.
+	 */
+	struct EditSlot {
+		enum class State { Free, Pending, Claimed, Done, Cancelled };
+		std::atomic<State> state{ State::Free };
+		const std::function<void()>* pEdit = nullptr;
+	};
+	static constexpr int nEditSlots = 8;
+	EditSlot			m_editSlots[ nEditSlots ];
+
 	// updated in audioEngine_updateNoteQueue()
 	struct timeval		m_currentTickTime;
 
@@ -724,13 +928,8 @@ private:
 	
 	audioProcessCallback m_AudioProcessCallback;
 	
-	/// Song Note FIFO
-	// overload the > operator of Note objects for priority_queue
-	struct compare_pNotes {
-		bool operator() (Note* pNote1, Note* pNote2);
-	};
-
-	std::priority_queue<Note*, std::deque<Note*>, compare_pNotes > m_songNoteQueue;
+	/// Song Note FIFO. Notes are ordered by computeNoteStartFrame().
+	NoteScheduler		m_songNoteQueue;
 	std::deque<Note*>	m_midiNoteQueue;	///< Midi Note FIFO
 	
 	/**
@@ -747,6 +946,10 @@ private:
 	 */
 	int 			m_nMaxTimeHumanize;
 
+	/** Used for humanization and note probability. Only accessed
+	 * by the audio thread. */
+	Random			m_random;
+
 	float 			m_fNextBpm;
 };
 
@@ -827,6 +1030,25 @@ inline float AudioEngine::getMaxProcessTime() const {
 	return m_fMaxProcessTime;
 }
 
+inline NotePool* AudioEngine::getNotePool() const {
+	return m_pNotePool;
+}
+inline DspProfiler* AudioEngine::getProfiler() const {
+	return m_pProfiler;
+}
+
+inline int AudioEngine::getSkippedPeriods() const {
+	return m_nSkippedPeriods.load();
+}
+
+inline void AudioEngine::setOfflineRendering( bool bOffline ) {
+	m_bOfflineRendering = bOffline;
+}
+
+inline bool AudioEngine::getOfflineRendering() const {
+	return m_bOfflineRendering.load();
+}
+
 inline const struct timeval& AudioEngine::getCurrentTickTime() const {
 	return m_currentTickTime;
 }
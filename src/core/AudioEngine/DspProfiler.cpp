@@ -0,0 +1,269 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/AudioEngine/DspProfiler.h>
+
+#include <QFile>
+#include <QTextStream>
+
+#include <algorithm>
+#include <cmath>
+
+namespace H2Core
+{
+
+DspProfiler::DspProfiler()
+	: m_pRing( new Slot[ nRingSize ] )
+	, m_nWritten( 0 )
+	, m_nRead( 0 )
+	, m_nLost( 0 )
+{
+	for ( int ii = 0; ii < nRingSize; ++ii ) {
+		m_pRing[ ii ].nStart.store( 0, std::memory_order_relaxed );
+		m_pRing[ ii ].nPhaseDuration.store( 0, std::memory_order_relaxed );
+	}
+	for ( int ii = 0; ii < PhaseCount; ++ii ) {
+		m_histograms[ ii ].resize( nBuckets, 0 );
+		m_counts[ ii ] = 0;
+		m_max[ ii ] = 0;
+	}
+}
+
+DspProfiler::~DspProfiler()
+{
+}
+
+int DspProfiler::bucketIndex( uint32_t nDuration )
+{
+	if ( nDuration < nSubBuckets ) {
+		return nDuration;
+	}
+	int nExponent = nSubBucketsLog2;
+	while ( ( nDuration >> ( nExponent + 1 ) ) != 0 ) {
+		++nExponent;
+	}
+	const int nSubBucket = ( nDuration >> ( nExponent - nSubBucketsLog2 ) ) &
+		( nSubBuckets - 1 );
+	return ( nExponent - nSubBucketsLog2 + 1 ) * nSubBuckets + nSubBucket;
+}
+
+uint32_t DspProfiler::bucketValue( int nIndex )
+{
+	if ( nIndex < nSubBuckets ) {
+		return nIndex;
+	}
+	const int nExponent = nIndex / nSubBuckets + nSubBucketsLog2 - 1;
+	const uint32_t nSubBucket = nIndex % nSubBuckets;
+	return ( nSubBuckets + nSubBucket ) << ( nExponent - nSubBucketsLog2 );
+}
+
+void DspProfiler::update()
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+
+	const uint64_t nWritten = m_nWritten.load( std::memory_order_acquire );
+	// The slot of the oldest record might be overwritten by the audio
+	// thread at any time.
+	uint64_t nFirst = m_nRead;
+	if ( nWritten - nFirst > nRingSize - 1 ) {
+		nFirst = nWritten - ( nRingSize - 1 );
+	}
+
+	std::vector<Record> records;
+	records.reserve( nWritten - nFirst );
+	for ( uint64_t nn = nFirst; nn < nWritten; ++nn ) {
+		const Slot& slot = m_pRing[ nn & ( nRingSize - 1 ) ];
+		const uint64_t nPhaseDuration = slot.nPhaseDuration.load( std::memory_order_relaxed );
+		Record record;
+		record.nStart = slot.nStart.load( std::memory_order_relaxed );
+		record.nDuration = static_cast<uint32_t>( nPhaseDuration & 0xFFFFFFFF );
+		record.phase = static_cast<int>( nPhaseDuration >> 32 );
+		records.push_back( record );
+	}
+
+	// Records the audio thread started to overwrite while we were
+	// copying them are dropped.
+	std::atomic_thread_fence( std::memory_order_acquire );
+	const uint64_t nWrittenAfter = m_nWritten.load( std::memory_order_relaxed );
+	uint64_t nValid = nFirst;
+	if ( nWrittenAfter + 1 > nFirst + nRingSize ) {
+		nValid = std::min( nWritten, nWrittenAfter + 1 - nRingSize );
+	}
+	m_nLost += nValid - m_nRead;
+	m_nRead = nWritten;
+
+	for ( size_t ii = nValid - nFirst; ii < records.size(); ++ii ) {
+		const Record& record = records[ ii ];
+		if ( record.phase < 0 || record.phase >= PhaseCount ) {
+			continue;
+		}
+		m_histograms[ record.phase ][ bucketIndex( record.nDuration ) ]++;
+		m_counts[ record.phase ]++;
+		m_max[ record.phase ] = std::max( m_max[ record.phase ], record.nDuration );
+		m_trace.push_back( record );
+	}
+
+	while ( m_trace.size() > nTraceSize ) {
+		m_trace.pop_front();
+	}
+}
+
+void DspProfiler::reset()
+{
+	update();
+
+	std::lock_guard<std::mutex> lock( m_mutex );
+	for ( int ii = 0; ii < PhaseCount; ++ii ) {
+		std::fill( m_histograms[ ii ].begin(), m_histograms[ ii ].end(), 0 );
+		m_counts[ ii ] = 0;
+		m_max[ ii ] = 0;
+	}
+	m_trace.clear();
+	m_nLost = 0;
+}
+
+DspProfiler::Stats DspProfiler::getStats( int phase )
+{
+	update();
+
+	Stats stats = { 0, 0, 0, 0 };
+	if ( phase < 0 || phase >= PhaseCount ) {
+		return stats;
+	}
+
+	std::lock_guard<std::mutex> lock( m_mutex );
+	stats.nCount = m_counts[ phase ];
+	if ( stats.nCount == 0 ) {
+		return stats;
+	}
+	stats.fMax = m_max[ phase ] / 1000.0;
+
+	// Upper bound of the bucket holding the requested percentile.
+	auto percentile = [&]( double fFraction ) {
+		const long long nTarget = std::max( 1LL, static_cast<long long>(
+			std::ceil( fFraction * stats.nCount ) ) );
+		long long nSum = 0;
+		for ( int ii = 0; ii < nBuckets; ++ii ) {
+			nSum += m_histograms[ phase ][ ii ];
+			if ( nSum >= nTarget ) {
+				const uint32_t nUpper = ii + 1 < nBuckets ?
+					bucketValue( ii + 1 ) - 1 : UINT32_MAX;
+				return std::min( nUpper, m_max[ phase ] ) / 1000.0;
+			}
+		}
+		return m_max[ phase ] / 1000.0;
+	};
+	stats.fP50 = percentile( 0.5 );
+	stats.fP99 = percentile( 0.99 );
+
+	return stats;
+}
+
+QString DspProfiler::getPhaseName( int phase )
+{
+	if ( phase >= Ladspa && phase < Metering ) {
+		return QString( "ladspa %1" ).arg( phase - Ladspa );
+	}
+	switch ( phase ) {
+	case Transport:
+		return "transport";
+	case NoteQueue:
+		return "note queue";
+	case Sampler:
+		return "sampler";
+	case Synth:
+		return "synth";
+	case Metering:
+		return "metering";
+	case Total:
+		return "total";
+	default:
+		return "unknown";
+	}
+}
+
+QString DspProfiler::toTable()
+{
+	QString sTable = QString( "%1 %2 %3 %4 %5\n" )
+		.arg( QString( "phase" ), -12 ).arg( QString( "periods" ), 10 )
+		.arg( QString( "p50 [ms]" ), 10 ).arg( QString( "p99 [ms]" ), 10 )
+		.arg( QString( "max [ms]" ), 10 );
+	for ( int phase = 0; phase < PhaseCount; ++phase ) {
+		const Stats stats = getStats( phase );
+		if ( stats.nCount == 0 ) {
+			continue;
+		}
+		sTable.append( QString( "%1 %2 %3 %4 %5\n" )
+					   .arg( getPhaseName( phase ), -12 ).arg( stats.nCount, 10 )
+					   .arg( stats.fP50 / 1000.0, 10, 'f', 3 )
+					   .arg( stats.fP99 / 1000.0, 10, 'f', 3 )
+					   .arg( stats.fMax / 1000.0, 10, 'f', 3 ) );
+	}
+	return sTable;
+}
+
+bool DspProfiler::dumpChromeTrace( const QString& sPath )
+{
+	update();
+
+	QFile file( sPath );
+	if ( !file.open( QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate ) ) {
+		ERRORLOG( QString( "Unable to open %1 for writing" ).arg( sPath ) );
+		return false;
+	}
+	QTextStream out( &file );
+
+	std::lock_guard<std::mutex> lock( m_mutex );
+	// Enclosing phases are recorded after the ones within them.
+	int64_t nOrigin = m_trace.empty() ? 0 : m_trace.front().nStart;
+	for ( const auto& record : m_trace ) {
+		nOrigin = std::min( nOrigin, record.nStart );
+	}
+
+	// Complete events ("X") with timestamps in microseconds.
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool bFirst = true;
+	for ( const auto& record : m_trace ) {
+		if ( ! bFirst ) {
+			out << ",";
+		}
+		bFirst = false;
+		out << "\n{\"name\":\"" << getPhaseName( record.phase )
+			<< "\",\"cat\":\"audioEngine\",\"ph\":\"X\",\"pid\":1,\"tid\":1"
+			<< ",\"ts\":" << QString::number( ( record.nStart - nOrigin ) / 1000.0, 'f', 3 )
+			<< ",\"dur\":" << QString::number( record.nDuration / 1000.0, 'f', 3 ) << "}";
+	}
+	out << "\n]}\n";
+	out.flush();
+	file.close();
+
+	INFOLOG( QString( "[%1] records written to %2" ).arg( m_trace.size() ).arg( sPath ) );
+	return true;
+}
+
+long long DspProfiler::getLostRecords()
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	return m_nLost;
+}
+
+};
@@ -0,0 +1,204 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2C_DSP_PROFILER_H
+#define H2C_DSP_PROFILER_H
+
+#include <core/config.h>
+#include <core/Object.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace H2Core
+{
+
+/**
+ * Measures the time spent in the individual phases of
+ * AudioEngine::audioEngine_process().
+ *
+ * The audio thread stores a timestamp and a duration for each phase
+ * in a ring buffer using plain atomic loads and stores. It neither
+ * locks nor allocates memory. Once the ring is full the oldest
+ * records are overwritten so the most recent periods are always
+ * available.
+ *
+ * Other threads - the GUI, the OSC server, or h2cli - collect the
+ * records via update() (also called by all other public
+ * non-realtime methods) and accumulate them in a histogram for each
+ * phase. The last #nTraceSize records are kept to be written as a
+ * Chrome trace (to be opened in chrome://tracing or
+ * https://ui.perfetto.dev) using dumpChromeTrace().
+ *
+ * \ingroup docCore docAudioEngine docDebugging
+ */
+class DspProfiler : public H2Core::Object<DspProfiler>
+{
+	H2_OBJECT(DspProfiler)
+public:
+	/** Phases of audioEngine_process(). The effect slots follow
+	 * #Ladspa.*/
+	enum Phase {
+		/** Processing of commands and transport.*/
+		Transport = 0,
+		NoteQueue,
+		Sampler,
+		Synth,
+		/** First of #MAX_FX slots.*/
+		Ladspa,
+		Metering = Ladspa + MAX_FX,
+		/** Whole process cycle.*/
+		Total,
+		PhaseCount
+	};
+
+	struct Stats {
+		/** Number of periods contributing.*/
+		long long nCount;
+		/** Durations in microseconds.
+		 * @{ */
+		float fP50;
+		float fP99;
+		float fMax;
+		/** @} */
+	};
+
+	/** Number of slots of the ring buffer. One of them is reserved
+	 * for the record currently written.*/
+	static constexpr int nRingSize = 1 << 14;
+	/** Number of records kept for dumpChromeTrace().*/
+	static constexpr int nTraceSize = 1 << 16;
+
+	DspProfiler();
+	~DspProfiler();
+
+	/** \return Monotonic timestamp in nanoseconds. */
+	static int64_t now();
+
+	/**
+	 * Stores the duration of @a phase. Must only be called by the
+	 * audio thread.
+	 *
+	 * \param phase One of #Phase (#Ladspa plus the number of the slot
+	 * for effects).
+	 * \param nStart Timestamp obtained via now() when the phase was
+	 * entered.
+	 * \param nEnd Timestamp obtained via now() when it was left.
+	 */
+	void record( int phase, int64_t nStart, int64_t nEnd );
+
+	/** Moves all new records from the ring buffer into the
+	 * histograms and the trace. */
+	void update();
+	/** Drops all statistics and trace records. */
+	void reset();
+
+	/** \return Percentiles of @a phase since the last reset().*/
+	Stats getStats( int phase );
+	/** \return Human readable name of @a phase. */
+	static QString getPhaseName( int phase );
+	/** \return Table of all phases which were recorded at least once
+	 * with their percentiles in milliseconds.*/
+	QString toTable();
+
+	/**
+	 * Writes the recent records in the Chrome trace event format.
+	 *
+	 * \return true on success.
+	 */
+	bool dumpChromeTrace( const QString& sPath );
+
+	/** \return Number of records overwritten before update() was able
+	 * to collect them.*/
+	long long getLostRecords();
+
+private:
+	/** Sub-buckets per power of two. Results in a relative error of
+	 * at most 1/32.*/
+	static constexpr int nSubBucketsLog2 = 5;
+	static constexpr int nSubBuckets = 1 << nSubBucketsLog2;
+	static constexpr int nBuckets = ( 33 - nSubBucketsLog2 ) * nSubBuckets;
+
+	static int bucketIndex( uint32_t nDuration );
+	/** \return Lower bound of the durations in bucket @a nIndex.*/
+	static uint32_t bucketValue( int nIndex );
+
+	/** Two words of a record. The first one holds the start
+	 * timestamp, the second the phase in its upper and the duration
+	 * in nanoseconds in its lower 32 bits.*/
+	struct Slot {
+		std::atomic<int64_t> nStart;
+		std::atomic<uint64_t> nPhaseDuration;
+	};
+
+	struct Record {
+		int64_t nStart;
+		uint32_t nDuration;
+		int phase;
+	};
+
+	std::unique_ptr<Slot[]> m_pRing;
+	/** Number of records written so far. Only changed by the audio
+	 * thread.*/
+	std::atomic<uint64_t> m_nWritten;
+
+	/** Protects all members below. Never acquired by the audio
+	 * thread.*/
+	std::mutex m_mutex;
+	/** Number of records collected so far.*/
+	uint64_t m_nRead;
+	long long m_nLost;
+	std::vector<uint32_t> m_histograms[ PhaseCount ];
+	long long m_counts[ PhaseCount ];
+	uint32_t m_max[ PhaseCount ];
+	std::deque<Record> m_trace;
+};
+
+inline int64_t DspProfiler::now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+inline void DspProfiler::record( int phase, int64_t nStart, int64_t nEnd ) {
+	int64_t nDuration = nEnd - nStart;
+	if ( nDuration < 0 ) {
+		nDuration = 0;
+	} else if ( nDuration > UINT32_MAX ) {
+		nDuration = UINT32_MAX;
+	}
+	const uint64_t nWritten = m_nWritten.load( std::memory_order_relaxed );
+	Slot& slot = m_pRing[ nWritten & ( nRingSize - 1 ) ];
+	slot.nStart.store( nStart, std::memory_order_relaxed );
+	slot.nPhaseDuration.store( ( static_cast<uint64_t>( phase ) << 32 ) |
+							   static_cast<uint64_t>( nDuration ),
+							   std::memory_order_relaxed );
+	m_nWritten.store( nWritten + 1, std::memory_order_release );
+}
+
+};
+
+#endif // H2C_DSP_PROFILER_H
@@ -0,0 +1,171 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2C_MIXING_H
+#define H2C_MIXING_H
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace H2Core
+{
+
+/**
+ * Block-wise operations on the buffers of the AudioEngine and of
+ * decoded samples.
+ *
+ * All of them produce the same results as their per-frame
+ * counterparts. Additions are done in the same order and a peak
+ * only gets updated by values strictly larger than it, so NaNs are
+ * ignored.
+ *
+ * \ingroup docCore docAudioEngine
+ */
+namespace Mixing
+{
+#ifdef __SSE2__
+	/** Maximum of the four elements of @a peak. */
+	inline float horizontalMax( __m128 peak )
+	{
+		peak = _mm_max_ps( peak, _mm_shuffle_ps( peak, peak, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+		peak = _mm_max_ps( peak, _mm_shuffle_ps( peak, peak, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+		return _mm_cvtss_f32( peak );
+	}
+#endif
+
+	/** \return Maximum of @a fPeak and the first @a nFrames values of
+	 * @a pBuffer. */
+	inline float peak( const float* pBuffer, unsigned nFrames, float fPeak )
+	{
+		unsigned ii = 0;
+#ifdef __SSE2__
+		if ( nFrames >= 4 ) {
+			// _mm_max_ps() returns its second argument in case one
+			// of them is NaN.
+			__m128 peak = _mm_set1_ps( fPeak );
+			for ( ; ii + 4 <= nFrames; ii += 4 ) {
+				peak = _mm_max_ps( _mm_loadu_ps( pBuffer + ii ), peak );
+			}
+			fPeak = horizontalMax( peak );
+		}
+#endif
+		for ( ; ii < nFrames; ++ii ) {
+			if ( pBuffer[ ii ] > fPeak ) {
+				fPeak = pBuffer[ ii ];
+			}
+		}
+		return fPeak;
+	}
+
+	/** Adds @a pSource1 and @a pSource2 (in this order) to @a pDest. */
+	inline void add( float* pDest, const float* pSource1, const float* pSource2,
+					 unsigned nFrames )
+	{
+		unsigned ii = 0;
+#ifdef __SSE2__
+		for ( ; ii + 4 <= nFrames; ii += 4 ) {
+			__m128 sum = _mm_add_ps( _mm_loadu_ps( pDest + ii ),
+									 _mm_loadu_ps( pSource1 + ii ) );
+			_mm_storeu_ps( pDest + ii,
+						   _mm_add_ps( sum, _mm_loadu_ps( pSource2 + ii ) ) );
+		}
+#endif
+		for ( ; ii < nFrames; ++ii ) {
+			pDest[ ii ] = ( pDest[ ii ] + pSource1[ ii ] ) + pSource2[ ii ];
+		}
+	}
+
+	/**
+	 * Adds @a pSource to @a pDest and updates @a fPeak with the
+	 * values of @a pSource within the same sweep.
+	 */
+	inline void addAndPeak( float* pDest, const float* pSource, unsigned nFrames,
+							float& fPeak )
+	{
+		unsigned ii = 0;
+#ifdef __SSE2__
+		if ( nFrames >= 4 ) {
+			__m128 peak = _mm_set1_ps( fPeak );
+			for ( ; ii + 4 <= nFrames; ii += 4 ) {
+				const __m128 source = _mm_loadu_ps( pSource + ii );
+				_mm_storeu_ps( pDest + ii,
+							   _mm_add_ps( _mm_loadu_ps( pDest + ii ), source ) );
+				peak = _mm_max_ps( source, peak );
+			}
+			fPeak = horizontalMax( peak );
+		}
+#endif
+		for ( ; ii < nFrames; ++ii ) {
+			pDest[ ii ] += pSource[ ii ];
+			if ( pSource[ ii ] > fPeak ) {
+				fPeak = pSource[ ii ];
+			}
+		}
+	}
+
+	/** Splits @a nFrames interleaved stereo frames of @a pSource into
+	 * @a pDest_L and @a pDest_R. */
+	inline void deinterleave( const float* pSource, float* pDest_L, float* pDest_R,
+							  unsigned nFrames )
+	{
+		unsigned ii = 0;
+#ifdef __SSE2__
+		for ( ; ii + 4 <= nFrames; ii += 4 ) {
+			const __m128 first = _mm_loadu_ps( pSource + 2 * ii );
+			const __m128 second = _mm_loadu_ps( pSource + 2 * ii + 4 );
+			_mm_storeu_ps( pDest_L + ii,
+						   _mm_shuffle_ps( first, second, _MM_SHUFFLE( 2, 0, 2, 0 ) ) );
+			_mm_storeu_ps( pDest_R + ii,
+						   _mm_shuffle_ps( first, second, _MM_SHUFFLE( 3, 1, 3, 1 ) ) );
+		}
+#endif
+		for ( ; ii < nFrames; ++ii ) {
+			pDest_L[ ii ] = pSource[ 2 * ii ];
+			pDest_R[ ii ] = pSource[ 2 * ii + 1 ];
+		}
+	}
+
+	/** Merges @a nFrames frames of @a pSource_L and @a pSource_R into
+	 * interleaved stereo frames in @a pDest. */
+	inline void interleave( const float* pSource_L, const float* pSource_R, float* pDest,
+							unsigned nFrames )
+	{
+		unsigned ii = 0;
+#ifdef __SSE2__
+		for ( ; ii + 4 <= nFrames; ii += 4 ) {
+			const __m128 left = _mm_loadu_ps( pSource_L + ii );
+			const __m128 right = _mm_loadu_ps( pSource_R + ii );
+			_mm_storeu_ps( pDest + 2 * ii, _mm_unpacklo_ps( left, right ) );
+			_mm_storeu_ps( pDest + 2 * ii + 4, _mm_unpackhi_ps( left, right ) );
+		}
+#endif
+		for ( ; ii < nFrames; ++ii ) {
+			pDest[ 2 * ii ] = pSource_L[ ii ];
+			pDest[ 2 * ii + 1 ] = pSource_R[ ii ];
+		}
+	}
+};
+
+};
+
+#endif // H2C_MIXING_H
@@ -0,0 +1,154 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/AudioEngine/NotePool.h>
+#include <core/Basics/Instrument.h>
+
+#include <new>
+#include <vector>
+
+namespace H2Core
+{
+
+NotePool::NotePool( int nCapacity )
+	: m_nCapacity( nCapacity > 0 ? nCapacity : 1 )
+	, m_nUsed( 0 )
+	, m_nExhausted( 0 )
+{
+	m_pStorage.reset( new Storage[ m_nCapacity ] );
+	m_pNext.reset( new std::atomic<uint32_t>[ m_nCapacity ] );
+
+	for ( int ii = 0; ii < m_nCapacity - 1; ++ii ) {
+		m_pNext[ ii ].store( ii + 1, std::memory_order_relaxed );
+	}
+	m_pNext[ m_nCapacity - 1 ].store( nEndOfList, std::memory_order_relaxed );
+	m_nHead.store( 0, std::memory_order_release );
+}
+
+NotePool::~NotePool()
+{
+	if ( m_nUsed.load() == 0 ) {
+		return;
+	}
+	WARNINGLOG( QString( "[%1] notes are still in use. They will be destroyed anyway." )
+				.arg( m_nUsed.load() ) );
+
+	// All slots not part of the free list are in use.
+	std::vector<bool> free( m_nCapacity, false );
+	for ( uint32_t nSlot = static_cast<uint32_t>( m_nHead.load() & 0xFFFFFFFF );
+		  nSlot != nEndOfList; nSlot = m_pNext[ nSlot ].load() ) {
+		free[ nSlot ] = true;
+	}
+	for ( int ii = 0; ii < m_nCapacity; ++ii ) {
+		if ( ! free[ ii ] ) {
+			slotToNote( ii )->~Note();
+		}
+	}
+}
+
+uint32_t NotePool::popSlot()
+{
+	uint64_t nHead = m_nHead.load( std::memory_order_acquire );
+	for (;;) {
+		const uint32_t nSlot = static_cast<uint32_t>( nHead & 0xFFFFFFFF );
+		if ( nSlot == nEndOfList ) {
+			return nEndOfList;
+		}
+		const uint64_t nNewHead = ( ( ( nHead >> 32 ) + 1 ) << 32 ) |
+			m_pNext[ nSlot ].load( std::memory_order_relaxed );
+		if ( m_nHead.compare_exchange_weak( nHead, nNewHead,
+											std::memory_order_acq_rel,
+											std::memory_order_acquire ) ) {
+			return nSlot;
+		}
+	}
+}
+
+void NotePool::pushSlot( uint32_t nSlot )
+{
+	uint64_t nHead = m_nHead.load( std::memory_order_relaxed );
+	for (;;) {
+		m_pNext[ nSlot ].store( static_cast<uint32_t>( nHead & 0xFFFFFFFF ),
+								std::memory_order_relaxed );
+		const uint64_t nNewHead = ( ( ( nHead >> 32 ) + 1 ) << 32 ) | nSlot;
+		if ( m_nHead.compare_exchange_weak( nHead, nNewHead,
+											std::memory_order_release,
+											std::memory_order_relaxed ) ) {
+			return;
+		}
+	}
+}
+
+Note* NotePool::slotToNote( uint32_t nSlot )
+{
+	return reinterpret_cast<Note*>( &m_pStorage[ nSlot ] );
+}
+
+bool NotePool::contains( const Note* pNote ) const
+{
+	const Storage* pStorage = reinterpret_cast<const Storage*>( pNote );
+	return pStorage >= &m_pStorage[ 0 ] &&
+		pStorage < &m_pStorage[ 0 ] + m_nCapacity;
+}
+
+Note* NotePool::acquire( Note* pOther, std::shared_ptr<Instrument> pInstrument )
+{
+	const uint32_t nSlot = popSlot();
+	if ( nSlot == nEndOfList ) {
+		++m_nExhausted;
+		return new Note( pOther, pInstrument );
+	}
+	++m_nUsed;
+	return new ( slotToNote( nSlot ) ) Note( pOther, pInstrument );
+}
+
+Note* NotePool::acquire( std::shared_ptr<Instrument> pInstrument, int nPosition,
+						 float fVelocity, float fPan, int nLength, float fPitch )
+{
+	const uint32_t nSlot = popSlot();
+	if ( nSlot == nEndOfList ) {
+		++m_nExhausted;
+		return new Note( pInstrument, nPosition, fVelocity, fPan, nLength, fPitch );
+	}
+	++m_nUsed;
+	return new ( slotToNote( nSlot ) ) Note( pInstrument, nPosition, fVelocity,
+											 fPan, nLength, fPitch );
+}
+
+void NotePool::release( Note* pNote )
+{
+	if ( pNote == nullptr ) {
+		return;
+	}
+	if ( ! contains( pNote ) ) {
+		delete pNote;
+		return;
+	}
+
+	pNote->~Note();
+	const uint32_t nSlot = static_cast<uint32_t>(
+		reinterpret_cast<Storage*>( pNote ) - &m_pStorage[ 0 ] );
+	--m_nUsed;
+	pushSlot( nSlot );
+}
+
+};
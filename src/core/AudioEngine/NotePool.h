@@ -0,0 +1,132 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2C_NOTE_POOL_H
+#define H2C_NOTE_POOL_H
+
+#include <core/Object.h>
+#include <core/Basics/Note.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+namespace H2Core
+{
+
+class Instrument;
+
+/**
+ * Preallocated storage for the Note objects created and destroyed by
+ * the AudioEngine and the Sampler during playback.
+ *
+ * All slots are allocated on construction. acquire() constructs a
+ * Note in a free slot using placement new and release() destroys it
+ * and returns the slot to a lock-free free list. This way the
+ * copies of the pattern notes put into the song note queue, the
+ * metronome notes, and the notes triggered via MIDI do not hit the
+ * heap from within the realtime thread. The envelope and the layer
+ * information of the notes are stored within the slots as well (see
+ * Note::nEmbeddedLayers).
+ *
+ * In case the pool is exhausted, acquire() falls back to regular
+ * heap allocation and increments a counter retrievable via
+ * getExhaustedCount(). release() accepts both kinds of notes, so it
+ * can be used in place of `delete` for every Note handed to the
+ * Sampler.
+ *
+ * \ingroup docCore docAudioEngine
+ */
+class NotePool : public H2Core::Object<NotePool>
+{
+	H2_OBJECT(NotePool)
+public:
+	/**
+	 * \param nCapacity Number of notes to preallocate.
+	 */
+	explicit NotePool( int nCapacity );
+	/** Destroys all notes still in use.*/
+	~NotePool();
+
+	NotePool( const NotePool& ) = delete;
+	NotePool& operator=( const NotePool& ) = delete;
+
+	/** Creates a copy of @a pOther. See Note::Note( Note*, std::shared_ptr<Instrument> ).*/
+	Note* acquire( Note* pOther, std::shared_ptr<Instrument> pInstrument = nullptr );
+	/** Creates a new note. See Note::Note( std::shared_ptr<Instrument>, int, float, float, int, float ).*/
+	Note* acquire( std::shared_ptr<Instrument> pInstrument, int nPosition, float fVelocity,
+				   float fPan, int nLength, float fPitch );
+
+	/**
+	 * Destroys @a pNote. Notes not part of the pool are deleted.
+	 *
+	 * Safe to be called from any thread.
+	 */
+	void release( Note* pNote );
+
+	/** \return Whether @a pNote resides within the storage of the pool.*/
+	bool contains( const Note* pNote ) const;
+
+	int getCapacity() const;
+	/** \return Number of slots currently in use.*/
+	int getUsed() const;
+	/** \return Number of notes which had to be allocated on the
+	 * heap since the pool was empty.*/
+	int getExhaustedCount() const;
+
+private:
+	typedef std::aligned_storage<sizeof( Note ), alignof( Note )>::type Storage;
+
+	/** Marks the end of the free list.*/
+	static constexpr uint32_t nEndOfList = 0xFFFFFFFF;
+
+	/** \return Index of a free slot or #nEndOfList.*/
+	uint32_t popSlot();
+	void pushSlot( uint32_t nSlot );
+	Note* slotToNote( uint32_t nSlot );
+
+	int m_nCapacity;
+	std::unique_ptr<Storage[]> m_pStorage;
+	/** Index of the next free slot for each free slot.*/
+	std::unique_ptr<std::atomic<uint32_t>[]> m_pNext;
+	/** Index of the first free slot in the lower 32 bits and a
+	 * counter incremented on each modification in the upper ones to
+	 * avoid the ABA problem.*/
+	std::atomic<uint64_t> m_nHead;
+	std::atomic<int> m_nUsed;
+	std::atomic<int> m_nExhausted;
+};
+
+inline int NotePool::getCapacity() const {
+	return m_nCapacity;
+}
+inline int NotePool::getUsed() const {
+	return m_nUsed.load();
+}
+inline int NotePool::getExhaustedCount() const {
+	return m_nExhausted.load();
+}
+
+};
+
+#endif // H2C_NOTE_POOL_H
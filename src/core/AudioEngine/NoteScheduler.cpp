@@ -0,0 +1,222 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/AudioEngine/NoteScheduler.h>
+
+namespace H2Core
+{
+
+NoteScheduler::NoteScheduler( int nBucketsLog2 )
+	: m_nBucketsLog2( nBucketsLog2 )
+	, m_nBucketMask( ( 1LL << nBucketsLog2 ) - 1 )
+	, m_pOverflow( nullptr )
+	, m_pOverflowTail( nullptr )
+	, m_nCursor( 0 )
+	, m_nPopOffset( 0 )
+	, m_nInWheel( 0 )
+	, m_nInOverflow( 0 )
+{
+	const long long nBuckets = 1LL << m_nBucketsLog2;
+	m_pHeads.reset( new Note*[ nBuckets ] );
+	m_pTails.reset( new Note*[ nBuckets ] );
+	for ( long long ii = 0; ii < nBuckets; ++ii ) {
+		m_pHeads[ ii ] = nullptr;
+		m_pTails[ ii ] = nullptr;
+	}
+}
+
+NoteScheduler::~NoteScheduler()
+{
+	if ( ! empty() ) {
+		WARNINGLOG( QString( "[%1] notes are still scheduled" ).arg( size() ) );
+	}
+}
+
+void NoteScheduler::append( long long nFrame, Note* pNote )
+{
+	const long long nBucket = nFrame & m_nBucketMask;
+	pNote->__scheduler_next = nullptr;
+	if ( m_pTails[ nBucket ] != nullptr ) {
+		m_pTails[ nBucket ]->__scheduler_next = pNote;
+	} else {
+		m_pHeads[ nBucket ] = pNote;
+	}
+	m_pTails[ nBucket ] = pNote;
+	++m_nInWheel;
+}
+
+void NoteScheduler::push( Note* pNote, long long nDueFrame )
+{
+	pNote->__scheduler_frame = nDueFrame;
+	pNote->__scheduler_next = nullptr;
+	m_nPopOffset = 0;
+
+	if ( m_nInWheel == 0 && nDueFrame < m_nCursor ) {
+		// Nothing in between. Since all notes in the overflow list
+		// are due even later, it is safe to move the cursor back.
+		m_nCursor = nDueFrame;
+	}
+	else if ( m_nInWheel == 0 && m_nInOverflow == 0 ) {
+		m_nCursor = nDueFrame;
+	}
+
+	if ( nDueFrame < m_nCursor ) {
+		// Already late, e.g. after a relocation. Put in front of the
+		// notes of the current bucket to be returned by the next call
+		// to popDue(). Other late notes are kept sorted.
+		const long long nBucket = m_nCursor & m_nBucketMask;
+		Note** ppNext = &m_pHeads[ nBucket ];
+		while ( *ppNext != nullptr &&
+				(*ppNext)->__scheduler_frame <= nDueFrame ) {
+			ppNext = &(*ppNext)->__scheduler_next;
+		}
+		pNote->__scheduler_next = *ppNext;
+		*ppNext = pNote;
+		if ( pNote->__scheduler_next == nullptr ) {
+			m_pTails[ nBucket ] = pNote;
+		}
+		++m_nInWheel;
+	}
+	else if ( nDueFrame - m_nCursor > m_nBucketMask ) {
+		// Notes are usually pushed in chronological order. Appending
+		// them at the end spares us the walk through the list.
+		if ( m_pOverflowTail != nullptr &&
+			 m_pOverflowTail->__scheduler_frame <= nDueFrame ) {
+			m_pOverflowTail->__scheduler_next = pNote;
+			m_pOverflowTail = pNote;
+		} else {
+			// Notes sharing the same frame are kept in the order they
+			// were inserted.
+			Note** ppNext = &m_pOverflow;
+			while ( *ppNext != nullptr &&
+					(*ppNext)->__scheduler_frame <= nDueFrame ) {
+				ppNext = &(*ppNext)->__scheduler_next;
+			}
+			pNote->__scheduler_next = *ppNext;
+			*ppNext = pNote;
+			if ( pNote->__scheduler_next == nullptr ) {
+				m_pOverflowTail = pNote;
+			}
+		}
+		++m_nInOverflow;
+	}
+	else {
+		append( nDueFrame, pNote );
+	}
+}
+
+void NoteScheduler::migrateOverflow()
+{
+	while ( m_pOverflow != nullptr &&
+			m_pOverflow->__scheduler_frame - m_nCursor <= m_nBucketMask ) {
+		Note* pNote = m_pOverflow;
+		m_pOverflow = pNote->__scheduler_next;
+		if ( m_pOverflow == nullptr ) {
+			m_pOverflowTail = nullptr;
+		}
+		--m_nInOverflow;
+
+		// The overflow list is sorted and none of its notes is due
+		// before the cursor.
+		append( pNote->__scheduler_frame, pNote );
+	}
+}
+
+Note* NoteScheduler::popDue( long long nLimit )
+{
+	m_nPopOffset = 0;
+	for (;;) {
+		if ( m_nInWheel == 0 ) {
+			if ( m_pOverflow == nullptr ||
+				 m_pOverflow->__scheduler_frame >= nLimit ) {
+				return nullptr;
+			}
+			// Skip all empty buckets in between at once.
+			if ( m_pOverflow->__scheduler_frame > m_nCursor ) {
+				m_nCursor = m_pOverflow->__scheduler_frame;
+			}
+			migrateOverflow();
+			continue;
+		}
+
+		const long long nBucket = m_nCursor & m_nBucketMask;
+		Note* pNote = m_pHeads[ nBucket ];
+		if ( pNote != nullptr ) {
+			if ( pNote->__scheduler_frame >= nLimit ) {
+				// All remaining notes in this and the following
+				// buckets are due even later.
+				return nullptr;
+			}
+			m_pHeads[ nBucket ] = pNote->__scheduler_next;
+			if ( m_pHeads[ nBucket ] == nullptr ) {
+				m_pTails[ nBucket ] = nullptr;
+			}
+			pNote->__scheduler_next = nullptr;
+			--m_nInWheel;
+			return pNote;
+		}
+
+		// Current bucket is empty. Only advance in case the next
+		// one could hold notes due before the limit.
+		if ( m_nCursor + 1 >= nLimit ) {
+			return nullptr;
+		}
+		++m_nCursor;
+		migrateOverflow();
+	}
+}
+
+Note* NoteScheduler::pop()
+{
+	if ( m_nInWheel > 0 ) {
+		// All buckets in front of the offset were emptied by
+		// previous calls.
+		for ( ; m_nPopOffset <= m_nBucketMask; ++m_nPopOffset ) {
+			const long long nBucket = ( m_nCursor + m_nPopOffset ) & m_nBucketMask;
+			Note* pNote = m_pHeads[ nBucket ];
+			if ( pNote != nullptr ) {
+				m_pHeads[ nBucket ] = pNote->__scheduler_next;
+				if ( m_pHeads[ nBucket ] == nullptr ) {
+					m_pTails[ nBucket ] = nullptr;
+				}
+				pNote->__scheduler_next = nullptr;
+				--m_nInWheel;
+				return pNote;
+			}
+		}
+	}
+
+	if ( m_pOverflow != nullptr ) {
+		Note* pNote = m_pOverflow;
+		m_pOverflow = pNote->__scheduler_next;
+		if ( m_pOverflow == nullptr ) {
+			m_pOverflowTail = nullptr;
+		}
+		pNote->__scheduler_next = nullptr;
+		--m_nInOverflow;
+		return pNote;
+	}
+
+	return nullptr;
+}
+
+};
@@ -0,0 +1,165 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2C_NOTE_SCHEDULER_H
+#define H2C_NOTE_SCHEDULER_H
+
+#include <core/Object.h>
+#include <core/Basics/Note.h>
+
+#include <memory>
+
+namespace H2Core
+{
+
+/**
+ * Timing wheel holding all notes which are about to be handed to the
+ * Sampler.
+ *
+ * The wheel is a ring of buckets each corresponding to a single
+ * frame. Notes are linked into their bucket using the
+ * Note::__scheduler_next member, so neither insertion nor removal
+ * allocates memory. Since the AudioEngine only enqueues notes within
+ * its lookahead window, all notes usually fit into the wheel and both
+ * push() and popDue() are O(1). Notes sharing a frame are returned in
+ * the order they were pushed. Notes further away than the wheel can
+ * hold are put into a sorted overflow list and moved into the wheel
+ * once the cursor gets close.
+ *
+ * Notes due before the cursor, e.g. after a relocation, are returned
+ * by the next call to popDue().
+ *
+ * Not thread-safe. It is only accessed by the audio thread or while
+ * holding the AudioEngine lock.
+ *
+ * \ingroup docCore docAudioEngine
+ */
+class NoteScheduler : public H2Core::Object<NoteScheduler>
+{
+	H2_OBJECT(NoteScheduler)
+public:
+	/**
+	 * \param nBucketsLog2 Binary logarithm of the number of buckets
+	 * and thus frames covered by the wheel. The default of 32768
+	 * frames covers the lookahead of the AudioEngine for all common
+	 * sample rates and tempi.
+	 */
+	NoteScheduler( int nBucketsLog2 = 15 );
+	~NoteScheduler();
+
+	NoteScheduler( const NoteScheduler& ) = delete;
+	NoteScheduler& operator=( const NoteScheduler& ) = delete;
+
+	/** Schedules @a pNote to be played at frame @a nDueFrame.*/
+	void push( Note* pNote, long long nDueFrame );
+
+	/**
+	 * Removes the note with the smallest due frame in case it is
+	 * smaller than @a nLimit.
+	 *
+	 * \return nullptr if no note is due before @a nLimit.
+	 */
+	Note* popDue( long long nLimit );
+
+	/** Removes an arbitrary note. Intended to clear the scheduler.
+	 * Consecutive calls resume the scan of the wheel where the
+	 * previous one stopped. Draining the whole scheduler is thus
+	 * linear in the number of notes and buckets.
+	 * \return nullptr in case the scheduler is empty.*/
+	Note* pop();
+
+	/**
+	 * Assigns a new due frame to all notes using @a dueFrame (a
+	 * callable taking a Note* and returning a long long). Used in
+	 * case the tick size changed.
+	 */
+	template <typename F>
+	void reschedule( F dueFrame );
+
+	bool empty() const;
+	int size() const;
+
+	/** \return Number of frames covered by the wheel excluding the
+	 * overflow list. */
+	long long getSpan() const;
+
+private:
+	/** Appends @a pNote to the bucket of @a nFrame.*/
+	void append( long long nFrame, Note* pNote );
+	/** Moves all notes of the overflow list fitting in the wheel.*/
+	void migrateOverflow();
+
+	int m_nBucketsLog2;
+	long long m_nBucketMask;
+	/** First note of each bucket.*/
+	std::unique_ptr<Note*[]> m_pHeads;
+	/** Last note of each bucket.*/
+	std::unique_ptr<Note*[]> m_pTails;
+	/** Notes due after the last bucket of the wheel.*/
+	Note* m_pOverflow;
+	/** Last note of #m_pOverflow.*/
+	Note* m_pOverflowTail;
+	/** Frame corresponding to the front of the wheel. */
+	long long m_nCursor;
+	/** Offset of the first bucket relative to #m_nCursor which
+	 * might still hold notes. Used by pop() and reset whenever
+	 * notes are added or the cursor is moved.*/
+	long long m_nPopOffset;
+	/** Number of notes within the buckets.*/
+	int m_nInWheel;
+	/** Number of notes in #m_pOverflow.*/
+	int m_nInOverflow;
+};
+
+template <typename F>
+void NoteScheduler::reschedule( F dueFrame )
+{
+	// Gather all notes in a single chain first. pop() returns them
+	// in order of their buckets. Appending retains it.
+	Note* pChain = nullptr;
+	Note** ppTail = &pChain;
+	Note* pNote;
+	while ( ( pNote = pop() ) != nullptr ) {
+		*ppTail = pNote;
+		ppTail = &pNote->__scheduler_next;
+	}
+
+	while ( pChain != nullptr ) {
+		pNote = pChain;
+		pChain = pChain->__scheduler_next;
+		push( pNote, dueFrame( pNote ) );
+	}
+}
+
+inline bool NoteScheduler::empty() const {
+	return m_nInWheel == 0 && m_nInOverflow == 0;
+}
+inline int NoteScheduler::size() const {
+	return m_nInWheel + m_nInOverflow;
+}
+inline long long NoteScheduler::getSpan() const {
+	return 1LL << m_nBucketsLog2;
+}
+
+};
+
+#endif // H2C_NOTE_SCHEDULER_H
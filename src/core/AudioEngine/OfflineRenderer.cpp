@@ -0,0 +1,328 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/AudioEngine/OfflineRenderer.h>
+
+#include <core/AudioEngine/AudioEngine.h>
+#include <core/Basics/Instrument.h>
+#include <core/Basics/InstrumentList.h>
+#include <core/Basics/Note.h>
+#include <core/Basics/Pattern.h>
+#include <core/Basics/PatternList.h>
+#include <core/Basics/SampleStretcher.h>
+#include <core/Basics/Song.h>
+#include <core/config.h>
+#include <core/EventQueue.h>
+#include <core/Hydrogen.h>
+#include <core/IO/AudioOutput.h>
+#include <core/Sampler/Sampler.h>
+
+#include <QFileInfo>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <set>
+
+namespace H2Core
+{
+
+OfflineRenderer::OfflineRenderer( unsigned nSampleRate, int nSampleDepth )
+	: m_nSampleRate( nSampleRate )
+	, m_nSampleDepth( nSampleDepth )
+	, m_bExportStems( false )
+	, m_bSucceeded( false )
+	, m_fRealtimeFactor( 0 )
+	, m_fRenderTime( 0 )
+	, m_nRenderedFrames( 0 )
+	, m_fPeak( 0 )
+{
+}
+
+OfflineRenderer::~OfflineRenderer()
+{
+}
+
+int OfflineRenderer::getSoundFileFormat( const QString& sFilename, int nSampleDepth )
+{
+	const QString sSuffix = QFileInfo( sFilename ).suffix().toLower();
+
+	if ( sSuffix == "ogg" ) {
+		return SF_FORMAT_OGG | SF_FORMAT_VORBIS;
+	}
+
+	int nFormat = SF_FORMAT_WAV;
+	if ( sSuffix == "aiff" ) {
+		nFormat = SF_FORMAT_AIFF;	// big endian
+	} else if ( sSuffix == "flac" ) {
+		nFormat = SF_FORMAT_FLAC;
+	}
+
+	int nBits = SF_FORMAT_PCM_16;
+	if ( nSampleDepth == 8 ) {
+		if ( sSuffix == "aiff" ) {
+			nBits = SF_FORMAT_PCM_S8;
+		} else if ( sSuffix == "wav" ) {
+			// Microsoft WAV requires unsigned 8 bit data.
+			nBits = SF_FORMAT_PCM_U8;
+		}
+	} else if ( nSampleDepth == 24 ) {
+		nBits = SF_FORMAT_PCM_24;
+	} else if ( nSampleDepth == 32 ) {
+		nBits = SF_FORMAT_PCM_32;
+	}
+
+	return nFormat | nBits;
+}
+
+QString OfflineRenderer::getStemFilename( const QString& sFilename,
+										  std::shared_ptr<Instrument> pInstrument,
+										  std::shared_ptr<Song> pSong )
+{
+	int nOccurrences = 0;
+	InstrumentList* pInstrumentList = pSong->getInstrumentList();
+	for ( int nInstr = 0; nInstr < pInstrumentList->size(); ++nInstr ) {
+		if ( pInstrumentList->get( nInstr )->get_name() == pInstrument->get_name() ) {
+			++nOccurrences;
+		}
+	}
+
+	QString sName = pInstrument->get_name();
+	if ( nOccurrences >= 2 ) {
+		sName.append( QString( "_%1" ).arg( pInstrument->get_id() ) );
+	}
+
+	const QFileInfo fileInfo( sFilename );
+	const QString sSuffix = fileInfo.suffix();
+	QString sBase = sFilename;
+	if ( ! sSuffix.isEmpty() ) {
+		sBase.chop( sSuffix.size() + 1 );
+	}
+
+	return QString( "%1-%2%3" ).arg( sBase ).arg( sName )
+		.arg( sSuffix.isEmpty() ? QString() : "." + sSuffix );
+}
+
+std::vector<unsigned> OfflineRenderer::computeColumnLengths( std::shared_ptr<Song> pSong ) const
+{
+	std::vector<PatternList*>* pPatternColumns = pSong->getPatternGroupVector();
+	std::vector<unsigned> lengths;
+	lengths.reserve( pPatternColumns->size() );
+
+	// The end of each column is accumulated in double and rounded
+	// once per boundary. Truncating each length on its own would let
+	// the columns drift apart from the transport.
+	double fColumnEnd = 0;
+	long long nColumnEnd = 0;
+	for ( int nColumn = 0; nColumn < pPatternColumns->size(); ++nColumn ) {
+		PatternList* pColumn = ( *pPatternColumns )[ nColumn ];
+		int nPatternSize;
+		if ( pColumn->size() != 0 ) {
+			nPatternSize = pColumn->longest_pattern_length();
+		} else {
+			nPatternSize = MAX_NOTES;
+		}
+
+		const float fTickSize =
+			AudioEngine::computeTickSize( m_nSampleRate,
+										  AudioEngine::getBpmAtColumn( nColumn ),
+										  pSong->getResolution() );
+		fColumnEnd += static_cast<double>( fTickSize ) * nPatternSize;
+		const long long nNextColumnEnd = std::llround( fColumnEnd );
+		lengths.push_back( static_cast<unsigned>( nNextColumnEnd - nColumnEnd ) );
+		nColumnEnd = nNextColumnEnd;
+	}
+
+	return lengths;
+}
+
+bool OfflineRenderer::writeFrames( SNDFILE* pFile, const float* pData_L,
+								   const float* pData_R, unsigned nFrames )
+{
+	float* pData = m_interleaved.data();
+	for ( unsigned ii = 0; ii < nFrames; ++ii ) {
+		pData[ 2 * ii ] = std::min( 1.f, std::max( -1.f, pData_L[ ii ] ) );
+		pData[ 2 * ii + 1 ] = std::min( 1.f, std::max( -1.f, pData_R[ ii ] ) );
+	}
+
+	return sf_writef_float( pFile, pData, nFrames ) == static_cast<sf_count_t>( nFrames );
+}
+
+bool OfflineRenderer::render( const QString& sFilename )
+{
+	m_bSucceeded = renderFiles( sFilename );
+	EventQueue::get_instance()->push_event( EVENT_PROGRESS, 100 );
+
+	return m_bSucceeded;
+}
+
+bool OfflineRenderer::renderFiles( const QString& sFilename )
+{
+	Hydrogen* pHydrogen = Hydrogen::get_instance();
+	AudioEngine* pAudioEngine = pHydrogen->getAudioEngine();
+	AudioOutput* pDriver = pHydrogen->getAudioOutput();
+	std::shared_ptr<Song> pSong = pHydrogen->getSong();
+	Sampler* pSampler = pAudioEngine->getSampler();
+
+	m_fRealtimeFactor = 0;
+	m_fRenderTime = 0;
+	m_nRenderedFrames = 0;
+	m_fPeak = 0;
+
+	SF_INFO soundInfo;
+	soundInfo.samplerate = m_nSampleRate;
+	soundInfo.channels = 2;
+	soundInfo.format = getSoundFileFormat( sFilename, m_nSampleDepth );
+	if ( !sf_format_check( &soundInfo ) ) {
+		ERRORLOG( "Error in soundInfo" );
+		return false;
+	}
+
+	SNDFILE* pFile = sf_open( sFilename.toLocal8Bit(), SFM_WRITE, &soundInfo );
+	if ( pFile == nullptr ) {
+		ERRORLOG( QString( "Unable to open [%1]: %2" )
+				  .arg( sFilename ).arg( sf_strerror( nullptr ) ) );
+		return false;
+	}
+
+	// Only instruments used within the song get a file of their own.
+	std::vector<std::pair<int, SNDFILE*>> stems;
+	if ( m_bExportStems ) {
+		std::set<int> usedInstruments;
+		PatternList* pPatternList = pSong->getPatternList();
+		for ( int nPattern = 0; nPattern < pPatternList->size(); ++nPattern ) {
+			const Pattern::notes_t* pNotes = pPatternList->get( nPattern )->get_notes();
+			FOREACH_NOTE_CST_IT_BEGIN_END( pNotes, it ) {
+				usedInstruments.insert( it->second->get_instrument()->get_id() );
+			}
+		}
+
+		InstrumentList* pInstrumentList = pSong->getInstrumentList();
+		for ( int nInstr = 0; nInstr < pInstrumentList->size(); ++nInstr ) {
+			auto pInstrument = pInstrumentList->get( nInstr );
+			if ( usedInstruments.count( pInstrument->get_id() ) == 0 ) {
+				continue;
+			}
+			const QString sStemFilename = getStemFilename( sFilename, pInstrument, pSong );
+			SNDFILE* pStemFile = sf_open( sStemFilename.toLocal8Bit(), SFM_WRITE, &soundInfo );
+			if ( pStemFile == nullptr ) {
+				ERRORLOG( QString( "Unable to open [%1]: %2" )
+						  .arg( sStemFilename ).arg( sf_strerror( nullptr ) ) );
+				continue;
+			}
+			stems.push_back( std::make_pair( pInstrument->get_id(), pStemFile ) );
+		}
+		pSampler->enableStems( pSong );
+	}
+
+	const unsigned nBlockSize = std::min( nDefaultBlockSize, pDriver->getBufferSize() );
+	m_interleaved.resize( 2 * nBlockSize );
+
+	const std::vector<unsigned> columnLengths = computeColumnLengths( pSong );
+	long long nTotalFrames = 0;
+	for ( const auto nLength : columnLengths ) {
+		nTotalFrames += nLength;
+	}
+
+	INFOLOG( QString( "Rendering [%1] frames to [%2] in blocks of [%3] frames%4" )
+			 .arg( nTotalFrames ).arg( sFilename ).arg( nBlockSize )
+			 .arg( stems.empty() ? "" : QString( " plus [%1] stems" ).arg( stems.size() ) ) );
+
+	pAudioEngine->setOfflineRendering( true );
+
+	const auto start = std::chrono::steady_clock::now();
+	bool bSuccess = true;
+	bool bEndOfSong = false;
+	int nLastPercent = 0;
+	for ( const auto nColumnLength : columnLengths ) {
+		unsigned nFrame = 0;
+		while ( nFrame < nColumnLength ) {
+			const unsigned nFrames = std::min( nBlockSize, nColumnLength - nFrame );
+			nFrame += nFrames;
+
+			if ( AudioEngine::audioEngine_process( nFrames, nullptr ) == 1 ) {
+				bEndOfSong = true;
+				break;
+			}
+			// Tempo changes within the block are applied before the
+			// next one instead of whenever the workers get to them.
+			// Otherwise the output would differ between runs.
+			pHydrogen->getSampleStretcher()->wait();
+
+			const float* pOut_L = pDriver->getOut_L();
+			const float* pOut_R = pDriver->getOut_R();
+			for ( unsigned ii = 0; ii < nFrames; ++ii ) {
+				m_fPeak = std::max( m_fPeak, std::max( std::fabs( pOut_L[ ii ] ),
+													   std::fabs( pOut_R[ ii ] ) ) );
+			}
+			if ( ! writeFrames( pFile, pOut_L, pOut_R, nFrames ) ) {
+				bSuccess = false;
+			}
+			for ( const auto& stem : stems ) {
+				if ( ! writeFrames( stem.second, pSampler->getStemOut_L( stem.first ),
+									pSampler->getStemOut_R( stem.first ), nFrames ) ) {
+					bSuccess = false;
+				}
+			}
+			m_nRenderedFrames += nFrames;
+		}
+
+		// The final value is sent once all files are closed.
+		const int nPercent = nTotalFrames > 0 ?
+			std::min( 99LL, 100 * m_nRenderedFrames / nTotalFrames ) : 99;
+		if ( nPercent != nLastPercent ) {
+			EventQueue::get_instance()->push_event( EVENT_PROGRESS, nPercent );
+			nLastPercent = nPercent;
+		}
+		if ( bEndOfSong ) {
+			break;
+		}
+	}
+	m_fRenderTime = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start ).count();
+
+	pAudioEngine->setOfflineRendering( false );
+
+	if ( ! bSuccess ) {
+		ERRORLOG( "Error during sf_write_float" );
+	}
+
+	sf_close( pFile );
+	for ( const auto& stem : stems ) {
+		sf_close( stem.second );
+	}
+	if ( m_bExportStems ) {
+		pSampler->disableStems();
+	}
+
+	const double fDuration = static_cast<double>( m_nRenderedFrames ) / m_nSampleRate;
+	if ( m_fRenderTime > 0 ) {
+		m_fRealtimeFactor = fDuration / m_fRenderTime;
+	}
+	INFOLOG( QString( "Rendered %1 s of audio in %2 s (%3x realtime)" )
+			 .arg( fDuration, 0, 'f', 2 ).arg( m_fRenderTime, 0, 'f', 2 )
+			 .arg( m_fRealtimeFactor, 0, 'f', 1 ) );
+
+	return bSuccess;
+}
+
+};
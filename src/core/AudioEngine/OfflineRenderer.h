@@ -0,0 +1,168 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2C_OFFLINE_RENDERER_H
+#define H2C_OFFLINE_RENDERER_H
+
+#include <core/Object.h>
+
+#include <sndfile.h>
+
+#include <memory>
+#include <vector>
+
+namespace H2Core
+{
+
+class Instrument;
+class Song;
+
+/**
+ * Renders the current Song to disk as fast as possible.
+ *
+ * Used by the DiskWriterDriver. The song is processed in blocks of
+ * up to #nDefaultBlockSize frames. The boundaries of all pattern
+ * columns are computed once in advance and no block crosses one of
+ * them. Throughout the rendering the AudioEngine is flagged via
+ * AudioEngine::setOfflineRendering(). Each block waits for the lock
+ * of the AudioEngine instead of skipping the block in case it is
+ * held by another thread. After each block the SampleStretcher is
+ * waited for, so samples stretched due to a tempo change are used
+ * from the next block on.
+ *
+ * Optionally all instruments containing notes are written into
+ * separate files alongside the master within the same pass (see
+ * Sampler::enableStems()). These stems hold the post-fader signal
+ * of the instruments without any effect returns.
+ *
+ * Once done the ratio of the rendered duration and the time it took
+ * is logged and available via getRealtimeFactor().
+ *
+ * \ingroup docCore docAudioEngine
+ */
+class OfflineRenderer : public H2Core::Object<OfflineRenderer>
+{
+	H2_OBJECT(OfflineRenderer)
+public:
+	/** Number of frames processed at once unless the output buffers
+	 * of the audio driver are smaller.*/
+	static constexpr unsigned nDefaultBlockSize = 4096;
+
+	OfflineRenderer( unsigned nSampleRate, int nSampleDepth );
+	~OfflineRenderer();
+
+	/** \param bExportStems Sets #m_bExportStems */
+	void setExportStems( bool bExportStems );
+	/** \return #m_bExportStems */
+	bool getExportStems() const;
+
+	/**
+	 * Renders the current song from its beginning to @a sFilename.
+	 *
+	 * The AudioEngine has to be driven by a DiskWriterDriver and
+	 * the caller has to ensure no other thread is processing it.
+	 * Emits #EVENT_PROGRESS while rendering and a final value of 100
+	 * once all files are closed, even in case of an error.
+	 *
+	 * \return true on success. Also available via getSucceeded().
+	 */
+	bool render( const QString& sFilename );
+
+	/** \return Whether the last render() succeeded.*/
+	bool getSucceeded() const;
+	/** \return Duration of the rendered audio divided by the time
+	 * required to render it. 0 prior to the first render().*/
+	double getRealtimeFactor() const;
+	/** \return Wall-clock time of the last render() in seconds.*/
+	double getRenderTime() const;
+	/** \return Number of frames rendered by the last render().*/
+	long long getRenderedFrames() const;
+	/** \return Largest absolute value of the master prior to
+	 * clipping during the last render().*/
+	float getPeak() const;
+
+	/**
+	 * \return Format of the libsndfile file written to @a sFilename
+	 * as derived from its suffix and @a nSampleDepth.
+	 */
+	static int getSoundFileFormat( const QString& sFilename, int nSampleDepth );
+	/**
+	 * \return Name of the file the stem of @a pInstrument is written
+	 * to. The name of the instrument is appended to @a sFilename,
+	 * followed by its id in case it is not unique within @a pSong.
+	 */
+	static QString getStemFilename( const QString& sFilename,
+									std::shared_ptr<Instrument> pInstrument,
+									std::shared_ptr<Song> pSong );
+
+private:
+	/** Does the actual work of render().*/
+	bool renderFiles( const QString& sFilename );
+	/** Length of all pattern columns of @a pSong in frames. Column
+	 * boundaries are rounded to the nearest frame.*/
+	std::vector<unsigned> computeColumnLengths( std::shared_ptr<Song> pSong ) const;
+	/** Clips and interleaves @a nFrames of @a pData_L and @a pData_R
+	 * into #m_interleaved and writes them to @a pFile.*/
+	bool writeFrames( SNDFILE* pFile, const float* pData_L, const float* pData_R,
+					  unsigned nFrames );
+
+	unsigned m_nSampleRate;
+	int m_nSampleDepth;
+	/** Whether each instrument is written to a file of its own in
+	 * addition to the master.*/
+	bool m_bExportStems;
+
+	/** Stereo frames handed over to libsndfile.*/
+	std::vector<float> m_interleaved;
+
+	bool m_bSucceeded;
+	double m_fRealtimeFactor;
+	double m_fRenderTime;
+	long long m_nRenderedFrames;
+	float m_fPeak;
+};
+
+inline void OfflineRenderer::setExportStems( bool bExportStems ) {
+	m_bExportStems = bExportStems;
+}
+inline bool OfflineRenderer::getExportStems() const {
+	return m_bExportStems;
+}
+inline bool OfflineRenderer::getSucceeded() const {
+	return m_bSucceeded;
+}
+inline double OfflineRenderer::getRealtimeFactor() const {
+	return m_fRealtimeFactor;
+}
+inline double OfflineRenderer::getRenderTime() const {
+	return m_fRenderTime;
+}
+inline long long OfflineRenderer::getRenderedFrames() const {
+	return m_nRenderedFrames;
+}
+inline float OfflineRenderer::getPeak() const {
+	return m_fPeak;
+}
+
+};
+
+#endif // H2C_OFFLINE_RENDERER_H
@@ -20,6 +20,7 @@
  *
  */
 #include <core/AudioEngine/TransportInfo.h>
+#include <core/Basics/SampleStretcher.h>
 #include <core/Hydrogen.h>
 #include <core/Preferences/Preferences.h>
 #include <core/config.h>
@@ -50,8 +51,10 @@ void TransportInfo::setBpm( float fNewBpm ) {
 	
 	m_fBpm = fNewBpm;
 
+	// Might be called by the audio thread. The samples are
+	// requested by the threads of the SampleStretcher instead.
 	if ( Preferences::get_instance()->getRubberBandBatchMode() ) {
-		Hydrogen::get_instance()->recalculateRubberband( getBpm() );
+		Hydrogen::get_instance()->getSampleStretcher()->requestTempo( getBpm() );
 	}
 }
  
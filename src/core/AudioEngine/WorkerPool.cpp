@@ -0,0 +1,273 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/AudioEngine/WorkerPool.h>
+
+#include <climits>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace H2Core
+{
+
+/** Number of checks for new work before a worker goes to sleep.*/
+static constexpr int nSpinIterations = 20000;
+
+static inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	_mm_pause();
+#else
+	std::this_thread::yield();
+#endif
+}
+
+WorkerPool::WorkerPool( int nWorkers )
+	: m_nGeneration( 0 )
+	, m_nNextJob( 0 )
+	, m_nJobsDone( 0 )
+	, m_nSleeping( 0 )
+	, m_bQuit( false )
+	, m_callback( nullptr )
+	, m_pContext( nullptr )
+#ifdef __linux__
+	, m_nCallerThreadId( 0 )
+#endif
+{
+	// Spinning workers sharing a CPU with the audio thread would
+	// rather slow it down.
+	const int nMaxWorkers = static_cast<int>( std::thread::hardware_concurrency() ) - 1;
+	if ( nMaxWorkers >= 0 && nWorkers > nMaxWorkers ) {
+		WARNINGLOG( QString( "Only [%1] workers are used since there are no more CPUs available" )
+					.arg( nMaxWorkers ) );
+		nWorkers = nMaxWorkers;
+	}
+
+	for ( int ii = 0; ii < nWorkers; ++ii ) {
+		m_threads.emplace_back( &WorkerPool::workerMain, this, ii );
+	}
+	INFOLOG( QString( "Started [%1] workers" ).arg( nWorkers ) );
+}
+
+WorkerPool::~WorkerPool()
+{
+	m_bQuit.store( true );
+	m_nGeneration.fetch_add( 1 );
+	wakeWorkers();
+	for ( auto& thread : m_threads ) {
+		thread.join();
+	}
+}
+
+void WorkerPool::run( int nJobs, Callback callback, void* pContext )
+{
+	if ( nJobs <= 0 ) {
+		return;
+	}
+	if ( m_threads.empty() || nJobs == 1 || nJobs > nMaxJobs ) {
+		for ( int ii = 0; ii < nJobs; ++ii ) {
+			callback( pContext, ii );
+		}
+		return;
+	}
+
+#ifdef __linux__
+	// Comparing the thread handle does not involve a system call.
+	if ( m_nCallerThreadId.load( std::memory_order_relaxed ) == 0 ||
+		 ! pthread_equal( m_caller, pthread_self() ) ) {
+		m_caller = pthread_self();
+		m_nCallerThreadId.store( static_cast<pid_t>( syscall( SYS_gettid ) ) );
+	}
+#endif
+
+	m_callback = callback;
+	m_pContext = pContext;
+	m_nJobsDone.store( 0, std::memory_order_relaxed );
+
+	const uint32_t nGeneration = m_nGeneration.load( std::memory_order_relaxed ) + 1;
+	// Publishes the job description to all workers claiming a job.
+	m_nNextJob.store( ( static_cast<uint64_t>( nGeneration ) << 32 ) |
+					  static_cast<uint64_t>( nJobs ), std::memory_order_release );
+	m_nGeneration.store( nGeneration );
+	wakeWorkers();
+
+	processJobs( nGeneration );
+
+	// Remaining jobs are already being processed. Waiting for them
+	// is short.
+	while ( m_nJobsDone.load( std::memory_order_acquire ) < nJobs ) {
+		cpuRelax();
+	}
+}
+
+void WorkerPool::processJobs( uint32_t nGeneration )
+{
+	uint64_t nNext = m_nNextJob.load( std::memory_order_acquire );
+	for (;;) {
+		const int nJob = static_cast<int>( ( nNext >> 16 ) & nMaxJobs );
+		const int nJobs = static_cast<int>( nNext & nMaxJobs );
+		if ( static_cast<uint32_t>( nNext >> 32 ) != nGeneration || nJob >= nJobs ) {
+			return;
+		}
+		if ( ! m_nNextJob.compare_exchange_weak( nNext, nNext + ( 1 << 16 ),
+												 std::memory_order_acq_rel,
+												 std::memory_order_acquire ) ) {
+			continue;
+		}
+
+		m_callback( m_pContext, nJob );
+		m_nJobsDone.fetch_add( 1, std::memory_order_release );
+		nNext = m_nNextJob.load( std::memory_order_acquire );
+	}
+}
+
+void WorkerPool::workerMain( int nWorker )
+{
+#ifdef __linux__
+	pid_t nAdopted = 0;
+#endif
+
+	uint32_t nGeneration = 0;
+	for (;;) {
+		waitForWork( nGeneration );
+		if ( m_bQuit.load() ) {
+			return;
+		}
+		nGeneration = m_nGeneration.load();
+#ifdef __linux__
+		const pid_t nCaller = m_nCallerThreadId.load();
+		if ( nCaller != 0 && nCaller != nAdopted ) {
+			adoptScheduling( nCaller, nWorker );
+			nAdopted = nCaller;
+		}
+#endif
+		processJobs( nGeneration );
+	}
+}
+
+#ifdef __linux__
+/** Narrows @a cpuSet down to a single CPU for worker @a nWorker. The
+ * first CPU is left to the audio thread and the workers are
+ * distributed across the remaining ones. @a cpuSet is kept as is in
+ * case it contains a single CPU only.*/
+static cpu_set_t* pinnedCpuSet( cpu_set_t& cpuSet, int nWorker )
+{
+	const int nCpus = CPU_COUNT( &cpuSet );
+	if ( nCpus <= 1 ) {
+		return &cpuSet;
+	}
+
+	const int nTarget = 1 + nWorker % ( nCpus - 1 );
+	int nFound = 0;
+	for ( int nCpu = 0; nCpu < CPU_SETSIZE; ++nCpu ) {
+		if ( ! CPU_ISSET( nCpu, &cpuSet ) ) {
+			continue;
+		}
+		if ( nFound == nTarget ) {
+			CPU_ZERO( &cpuSet );
+			CPU_SET( nCpu, &cpuSet );
+			break;
+		}
+		++nFound;
+	}
+	return &cpuSet;
+}
+
+void WorkerPool::adoptScheduling( pid_t nThreadId, int nWorker )
+{
+	// Both calls fail gracefully in case the thread is already gone.
+	cpu_set_t cpuSet;
+	if ( sched_getaffinity( nThreadId, sizeof( cpuSet ), &cpuSet ) != 0 ||
+		 pthread_setaffinity_np( pthread_self(), sizeof( cpuSet ),
+								 pinnedCpuSet( cpuSet, nWorker ) ) != 0 ) {
+		WARNINGLOG( QString( "Unable to pin worker [%1] to a CPU of the audio thread" )
+					.arg( nWorker ) );
+	}
+
+	int nPolicy = sched_getscheduler( nThreadId );
+	struct sched_param sched;
+	if ( nPolicy == -1 || sched_getparam( nThreadId, &sched ) != 0 ) {
+		WARNINGLOG( QString( "Unable to query the scheduling of the audio thread for worker [%1]" )
+					.arg( nWorker ) );
+		return;
+	}
+#ifdef SCHED_RESET_ON_FORK
+	nPolicy &= ~SCHED_RESET_ON_FORK;
+#endif
+	if ( pthread_setschedparam( pthread_self(), nPolicy, &sched ) != 0 ) {
+		WARNINGLOG( QString( "Can't set scheduling policy [%1] with priority [%2] for worker [%3]" )
+					.arg( nPolicy ).arg( sched.sched_priority ).arg( nWorker ) );
+	}
+}
+#endif
+
+void WorkerPool::waitForWork( uint32_t nGeneration )
+{
+	for ( int ii = 0; ii < nSpinIterations; ++ii ) {
+		if ( m_nGeneration.load( std::memory_order_acquire ) != nGeneration ) {
+			return;
+		}
+		cpuRelax();
+	}
+
+	m_nSleeping.fetch_add( 1 );
+#ifdef __linux__
+	static_assert( sizeof( std::atomic<uint32_t> ) == sizeof( uint32_t ),
+				   "futex requires a plain 32 bit word" );
+	while ( m_nGeneration.load() == nGeneration ) {
+		syscall( SYS_futex, reinterpret_cast<uint32_t*>( &m_nGeneration ),
+				 FUTEX_WAIT_PRIVATE, nGeneration, nullptr, nullptr, 0 );
+	}
+#else
+	{
+		std::unique_lock<std::mutex> lock( m_mutex );
+		m_condition.wait( lock, [&]() { return m_nGeneration.load() != nGeneration; } );
+	}
+#endif
+	m_nSleeping.fetch_sub( 1 );
+}
+
+void WorkerPool::wakeWorkers()
+{
+	if ( m_nSleeping.load() == 0 ) {
+		return;
+	}
+#ifdef __linux__
+	syscall( SYS_futex, reinterpret_cast<uint32_t*>( &m_nGeneration ),
+			 FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0 );
+#else
+	std::lock_guard<std::mutex> lock( m_mutex );
+	m_condition.notify_all();
+#endif
+}
+
+};
@@ -0,0 +1,151 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2C_WORKER_POOL_H
+#define H2C_WORKER_POOL_H
+
+#include <core/Object.h>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sys/types.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+namespace H2Core
+{
+
+/**
+ * Set of threads sharing the work of the audio thread during a
+ * single period.
+ *
+ * run() hands a number of independent jobs to the workers and
+ * processes jobs itself until all of them are claimed. It returns
+ * once the last job is done. Jobs are claimed one by one. Which
+ * thread processes which job is not deterministic, so the callback
+ * must write its results to memory private to the job.
+ *
+ * In between two periods the workers spin for a short while before
+ * going to sleep. They are woken using a futex on Linux. run() does
+ * neither allocate memory nor lock a mutex there. On other platforms
+ * waking the workers requires a short lock of a mutex.
+ *
+ * On Linux the workers adopt the scheduling policy and priority of
+ * the thread calling run(), usually the audio thread of the driver.
+ * Each worker is pinned to a single CPU out of the affinity of that
+ * thread, leaving its first CPU to the audio thread. The audio
+ * thread itself is owned by the driver and not pinned. The workers
+ * follow in case it is replaced.
+ *
+ * \ingroup docCore docAudioEngine
+ */
+class WorkerPool : public H2Core::Object<WorkerPool>
+{
+	H2_OBJECT(WorkerPool)
+public:
+	/** Function called for each job. @a pContext is the pointer
+	 * passed to run().*/
+	typedef void (*Callback)( void* pContext, int nJob );
+
+	/**
+	 * \param nWorkers Number of threads to start. The thread calling
+	 * run() is not included. It is limited to the number of CPUs
+	 * minus one.
+	 */
+	explicit WorkerPool( int nWorkers );
+	~WorkerPool();
+
+	WorkerPool( const WorkerPool& ) = delete;
+	WorkerPool& operator=( const WorkerPool& ) = delete;
+
+	/**
+	 * Calls @a callback for all jobs in [0, @a nJobs) and blocks
+	 * until all of them are done.
+	 *
+	 * Must not be called concurrently. More than #nMaxJobs jobs are
+	 * processed by the calling thread alone.
+	 */
+	void run( int nJobs, Callback callback, void* pContext );
+
+	int getWorkerCount() const;
+
+	static constexpr int nMaxJobs = 0xFFFF;
+
+private:
+	void workerMain( int nWorker );
+	/** Claims and processes jobs of generation @a nGeneration till
+	 * none is left.*/
+	void processJobs( uint32_t nGeneration );
+	/** Blocks till the generation differs from @a nGeneration.*/
+	void waitForWork( uint32_t nGeneration );
+	void wakeWorkers();
+#ifdef __linux__
+	/** Applies the scheduling of the thread with kernel id @a
+	 * nThreadId to the calling worker and pins it to one of the CPUs
+	 * of that thread.*/
+	void adoptScheduling( pid_t nThreadId, int nWorker );
+#endif
+
+	std::vector<std::thread> m_threads;
+
+	/** Incremented for each call to run(). Workers wait on it.*/
+	std::atomic<uint32_t> m_nGeneration;
+	/** Generation in the upper 32 bits followed by the index of the
+	 * next unclaimed job and the number of jobs in 16 bits each.
+	 * Bundling them prevents a late worker from claiming a job of a
+	 * later generation.*/
+	std::atomic<uint64_t> m_nNextJob;
+	/** Number of jobs of the current generation already done.*/
+	std::atomic<int> m_nJobsDone;
+	/** Number of workers about to sleep.*/
+	std::atomic<int> m_nSleeping;
+	std::atomic<bool> m_bQuit;
+
+	Callback m_callback;
+	void* m_pContext;
+
+#ifdef __linux__
+	/** Thread which called run() most recently. Only accessed by
+	 * run().*/
+	pthread_t m_caller;
+	/** Kernel id of #m_caller. 0 before the first call to run().*/
+	std::atomic<pid_t> m_nCallerThreadId;
+#else
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+#endif
+};
+
+inline int WorkerPool::getWorkerCount() const {
+	return m_threads.size();
+}
+
+};
+
+#endif // H2C_WORKER_POOL_H
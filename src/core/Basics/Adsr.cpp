@@ -24,6 +24,8 @@
 
 #include "ExponentialTables.h"
 
+#include <cmath>
+
 namespace H2Core
 {
 
@@ -35,6 +37,23 @@ inline static float linear_interpolation( float fVal_A, float fVal_B, double fVa
 	//return fVal_A + ((fVal_B - fVal_A) * fVal);
 }
 
+/**
+ * Number of frames rendered within a segment of @a fLength ticks,
+ * currently at @a fTicks, before the envelope enters the next one.
+ * Mirrors the check in ADSR::get_value(): the segment is left as
+ * soon as the tick count exceeds its length.
+ */
+inline static double segment_frames( float fTicks, float fLength, float fStep )
+{
+	if ( fStep <= 0 ) {
+		return HUGE_VAL;
+	}
+	if ( fTicks > fLength ) {
+		return 1;
+	}
+	return std::floor( ( fLength - fTicks ) / fStep ) + 1;
+}
+
 void ADSR::normalise()
 {
 	if (__attack < 0.0) {
@@ -147,6 +166,81 @@ float ADSR::get_value( float step )
 	return __value;
 }
 
+void ADSR::get_values( float step, float* pValues, int nFrames )
+{
+	int nFrame = 0;
+	while ( nFrame < nFrames ) {
+		const int nRemaining = nFrames - nFrame;
+		float* pSegment = &pValues[ nFrame ];
+
+		if ( __state == SUSTAIN || __state == IDLE ) {
+			// Constant till the note gets released.
+			__value = __state == SUSTAIN ? __sustain : 0;
+			for ( int ii = 0; ii < nRemaining; ++ii ) {
+				pSegment[ ii ] = __value;
+			}
+			return;
+		}
+
+		float fLength;
+		if ( __state == ATTACK ) {
+			fLength = __attack;
+		} else if ( __state == DECAY ) {
+			fLength = __decay;
+		} else {
+			if ( __release < 256 ) {
+				__release = 256;
+			}
+			fLength = __release;
+		}
+
+		const double fSegmentFrames = segment_frames( __ticks, fLength, step );
+		const bool bSegmentDone = fSegmentFrames <= nRemaining;
+		const int nSegment = bSegmentDone ? static_cast<int>( fSegmentFrames ) : nRemaining;
+
+		// The curves only depend on the frame index which allows the
+		// compiler to unroll and vectorize the loops.
+		if ( __state == ATTACK ) {
+			if ( __attack == 0 ) {
+				for ( int ii = 0; ii < nSegment; ++ii ) {
+					pSegment[ ii ] = 1.0;
+				}
+			} else {
+				for ( int ii = 0; ii < nSegment; ++ii ) {
+					pSegment[ ii ] = convex_exponant( linear_interpolation(
+						0.0, 1.0, ( ( __ticks + ii * step ) * 1.0 / __attack ) ) );
+				}
+			}
+		} else if ( __state == DECAY ) {
+			if ( __decay == 0 ) {
+				for ( int ii = 0; ii < nSegment; ++ii ) {
+					pSegment[ ii ] = __sustain;
+				}
+			} else {
+				for ( int ii = 0; ii < nSegment; ++ii ) {
+					pSegment[ ii ] = concave_exponant( linear_interpolation(
+						1.0, 0.0, ( ( __ticks + ii * step ) * 1.0 / __decay ) ) ) *
+						( 1 - __sustain ) + __sustain;
+				}
+			}
+		} else {
+			for ( int ii = 0; ii < nSegment; ++ii ) {
+				pSegment[ ii ] = concave_exponant( linear_interpolation(
+					1.0, 0.0, ( ( __ticks + ii * step ) * 1.0 / __release ) ) ) * __release_value;
+			}
+		}
+
+		__value = pSegment[ nSegment - 1 ];
+		if ( bSegmentDone ) {
+			__state = static_cast<ADSRState>( __state + 1 );
+			__ticks = 0;
+		} else {
+			__ticks += nSegment * step;
+		}
+		nFrame += nSegment;
+	}
+}
+
 void ADSR::attack()
 {
 	__state = ATTACK;
@@ -163,6 +257,19 @@ float ADSR::release()
 	return __release_value;
 }
 
+void ADSR::fade_out( unsigned int frames )
+{
+	if ( __state == IDLE ) return;
+	if ( frames < 256 ) {
+		frames = 256;
+	}
+	if ( __state == RELEASE && __ticks + frames >= __release ) return;
+	__release_value = __value;
+	__release = frames;
+	__state = RELEASE;
+	__ticks = 0;
+}
+
 QString ADSR::toQString( const QString& sPrefix, bool bShort ) const {
 	QString s = Base::sPrintIndention;
 	QString sOutput;
@@ -92,6 +92,16 @@ class ADSR : public Object<ADSR>
 		 * \param step the increment to be added to __ticks
 		 */
 		float get_value( float step );
+		/**
+		 * compute the values of @a nFrames consecutive frames at
+		 * once. Equivalent to calling get_value() @a nFrames times
+		 * but the boundaries of the segments are computed up
+		 * front, leaving tight loops for the curves.
+		 * \param step the increment to be added to __ticks per frame
+		 * \param pValues buffer of at least @a nFrames elements
+		 * \param nFrames number of frames to compute
+		 */
+		void get_values( float step, float* pValues, int nFrames );
 		/**
 		 * sets state to RELEASE,
 		 * returns 0 if the state is IDLE,
@@ -99,6 +109,15 @@ class ADSR : public Object<ADSR>
 		 * set state to RELEASE, save __release_value and return it.
 		 * */
 		float release();
+		/**
+		 * sets state to RELEASE and fades from the current value
+		 * to 0 within @a frames ticks. A release already ending
+		 * earlier is kept. Used when the note is stolen.
+		 * \param frames fade duration, at least 256
+		 */
+		void fade_out( unsigned int frames );
+		/** value of the last tick computed */
+		float get_current_value() const;
 
 		/** Formatted string version for debugging purposes.
 		 * \param sPrefix String prefix which will be added in front of
@@ -171,6 +190,11 @@ inline unsigned int ADSR::get_release()
 	return __release;
 }
 
+inline float ADSR::get_current_value() const
+{
+	return __state == IDLE ? 0 : __value;
+}
+
 };
 
 #endif // H2C_ADRS_H
@@ -73,6 +73,9 @@ class DrumkitComponent : public H2Core::Object<DrumkitComponent>
 		void						set_outs( int nBufferPos, float valL, float valR );
 		float						get_out_L( int nBufferPos );
 		float						get_out_R( int nBufferPos );
+		/** Buffers filled by set_outs() within the current period.*/
+		const float*				get_out_L() const;
+		const float*				get_out_R() const;
 		/** Formatted string version for debugging purposes.
 		 * \param sPrefix String prefix which will be added in front of
 		 * every new line
@@ -172,6 +175,16 @@ inline float DrumkitComponent::get_peak_r() const
 	return __peak_r;
 }
 
+inline const float* DrumkitComponent::get_out_L() const
+{
+	return __out_L;
+}
+
+inline const float* DrumkitComponent::get_out_R() const
+{
+	return __out_R;
+}
+
 inline void DrumkitComponent::set_outs( int nBufferPos, float valL, float valR )
 {
 	__out_L[nBufferPos] += valL;
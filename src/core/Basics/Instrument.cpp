@@ -31,12 +31,14 @@
 
 #include <core/Basics/Adsr.h>
 #include <core/Basics/Sample.h>
+#include <core/Basics/SampleLoader.h>
 #include <core/Basics/Drumkit.h>
 #include <core/Basics/DrumkitComponent.h>
 #include <core/Basics/InstrumentList.h>
 #include <core/Basics/InstrumentComponent.h>
 #include <core/Basics/InstrumentLayer.h>
 #include <core/Sampler/Sampler.h>
+#include <core/Preferences/Preferences.h>
 
 namespace H2Core
 {
@@ -63,6 +65,7 @@ Instrument::Instrument( const int id, const QString& name, std::shared_ptr<ADSR>
 	, __soloed( false )
 	, __muted( false )
 	, __mute_group( -1 )
+	, __max_voices( 0 )
 	, __queued( 0 )
 	, __hihat_grp( -1 )
 	, __lower_cc( 0 )
@@ -89,7 +92,7 @@ Instrument::Instrument( const int id, const QString& name, std::shared_ptr<ADSR>
 	for ( int i=0; i<MAX_FX; i++ ) {
 		__fx_level[i] = 0.0;
 	}
-	__components = new std::vector<std::shared_ptr<InstrumentComponent>>();
+	__components = std::make_shared<std::vector<std::shared_ptr<InstrumentComponent>>>();
 }
 
 Instrument::Instrument( std::shared_ptr<Instrument> other )
@@ -114,6 +117,7 @@ Instrument::Instrument( std::shared_ptr<Instrument> other )
 	, __soloed( other->is_soloed() )
 	, __muted( other->is_muted() )
 	, __mute_group( other->get_mute_group() )
+	, __max_voices( other->get_max_voices() )
 	, __queued( other->is_queued() )
 	, __hihat_grp( other->get_hihat_grp() )
 	, __lower_cc( other->get_lower_cc() )
@@ -128,7 +132,7 @@ Instrument::Instrument( std::shared_ptr<Instrument> other )
 		__fx_level[i] = other->get_fx_level( i );
 	}
 
-	__components = new std::vector<std::shared_ptr<InstrumentComponent>>();
+	__components = std::make_shared<std::vector<std::shared_ptr<InstrumentComponent>>>();
 	for ( auto& pComponent : *other->get_components() ) {
 		__components->push_back( std::make_shared<InstrumentComponent>( pComponent ) );
 	}
@@ -136,7 +140,6 @@ Instrument::Instrument( std::shared_ptr<Instrument> other )
 
 Instrument::~Instrument()
 {
-	delete __components;
 }
 
 std::shared_ptr<Instrument> Instrument::load_instrument( const QString& drumkit_name, const QString& instrument_name, Filesystem::Lookup lookup )
@@ -146,7 +149,8 @@ std::shared_ptr<Instrument> Instrument::load_instrument( const QString& drumkit_
 	return pInstrument;
 }
 
-void Instrument::load_from( Drumkit* pDrumkit, std::shared_ptr<Instrument> pInstrument, bool is_live )
+void Instrument::load_from( Drumkit* pDrumkit, std::shared_ptr<Instrument> pInstrument, bool is_live,
+						   SampleLoader* pLoader )
 {
 	AudioEngine* pAudioEngine = Hydrogen::get_instance()->getAudioEngine();
 
@@ -162,6 +166,11 @@ void Instrument::load_from( Drumkit* pDrumkit, std::shared_ptr<Instrument> pInst
 
 	set_missing_samples( false );
 
+	// Samples of layers loaded lazily are decoded on first use.
+	const bool bLazy = Preferences::get_instance()->m_bLazyLayerLoading;
+
+	SampleLoader sampleLoader;
+	SampleLoader* pSampleLoader = pLoader != nullptr ? pLoader : &sampleLoader;
 	for ( const auto& pSrcComponent : *pInstrument->get_components() ) {
 		auto pMyComponent = std::make_shared<InstrumentComponent>( pSrcComponent->get_drumkit_componentID() );
 		pMyComponent->set_gain( pSrcComponent->get_gain() );
@@ -182,38 +191,58 @@ void Instrument::load_from( Drumkit* pDrumkit, std::shared_ptr<Instrument> pInst
 				}
 			} else {
 				QString sample_path =  pDrumkit->get_path() + "/" + src_layer->get_sample()->get_filename();
-				auto pSample = Sample::load( sample_path );
-				if ( pSample == nullptr ) {
-					_ERRORLOG( QString( "Error loading sample %1. Creating a new empty layer." ).arg( sample_path ) );
-					set_missing_samples( true );
-					if ( is_live ) {
-						pAudioEngine->lock( RIGHT_HERE );
-					}
-					pMyComponent->set_layer( nullptr, i );
-					
-					if ( is_live ) {
-						pAudioEngine->unlock();
-					}
-				} else {
-					if ( is_live ) {
-						pAudioEngine->lock( RIGHT_HERE );
+				pSampleLoader->add( [sample_path, bLazy]() {
+					return bLazy ? Sample::create_deferred( sample_path ) : Sample::load( sample_path );
+				},
+									[=]( std::shared_ptr<Sample> pSample ) {
+					if ( pSample == nullptr ) {
+						_ERRORLOG( QString( "Error loading sample %1. Creating a new empty layer." ).arg( sample_path ) );
+						set_missing_samples( true );
+						if ( is_live ) {
+							pAudioEngine->lock( RIGHT_HERE );
+						}
+						pMyComponent->set_layer( nullptr, i );
+
+						if ( is_live ) {
+							pAudioEngine->unlock();
+						}
+					} else {
+						if ( is_live ) {
+							pAudioEngine->lock( RIGHT_HERE );
+						}
+						auto pLayer = std::make_shared<InstrumentLayer>( src_layer, pSample );
+						if ( bLazy ) {
+							pLayer->defer_sample();
+						}
+						pMyComponent->set_layer( pLayer, i );
+						if ( is_live ) {
+							pAudioEngine->unlock();
+						}
 					}
-					pMyComponent->set_layer( std::make_shared<InstrumentLayer>( src_layer, pSample ), i );
-					if ( is_live ) {
-						pAudioEngine->unlock();
-					}
-				}
+				} );
 			}
 			my_layer = nullptr;
 		}
 	}
+	// The layers are assigned as soon as all samples are decoded.
+	sampleLoader.run();
+
 	if ( is_live ) {
 		pAudioEngine->lock( RIGHT_HERE );
 	}
 
+	copy_properties( pInstrument );
+	this->set_drumkit_name( pDrumkit->get_name() );
+	
+	if ( is_live ) {
+		pAudioEngine->unlock();
+	}
+}
+
+void Instrument::copy_properties( std::shared_ptr<Instrument> pInstrument )
+{
 	this->set_id( pInstrument->get_id() );
 	this->set_name( pInstrument->get_name() );
-	this->set_drumkit_name( pDrumkit->get_name() );
 	this->set_gain( pInstrument->get_gain() );
 	this->set_volume( pInstrument->get_volume() );
 	this->setPan( pInstrument->getPan() );
@@ -225,6 +254,7 @@ void Instrument::load_from( Drumkit* pDrumkit, std::shared_ptr<Instrument> pInst
 	this->set_random_pitch_factor( pInstrument->get_random_pitch_factor() );
 	this->set_muted( pInstrument->is_muted() );
 	this->set_mute_group( pInstrument->get_mute_group() );
+	this->set_max_voices( pInstrument->get_max_voices() );
 	this->set_midi_out_channel( pInstrument->get_midi_out_channel() );
 	this->set_midi_out_note( pInstrument->get_midi_out_note() );
 	this->set_stop_notes( pInstrument->is_stop_notes() );
@@ -233,10 +263,14 @@ void Instrument::load_from( Drumkit* pDrumkit, std::shared_ptr<Instrument> pInst
 	this->set_lower_cc( pInstrument->get_lower_cc() );
 	this->set_higher_cc( pInstrument->get_higher_cc() );
 	this->set_apply_velocity ( pInstrument->get_apply_velocity() );
-	
-	if ( is_live ) {
-		pAudioEngine->unlock();
-	}
+}
+
+void Instrument::take_over( std::shared_ptr<Instrument> pInstrument )
+{
+	copy_properties( pInstrument );
+	set_drumkit_name( pInstrument->get_drumkit_name() );
+	set_missing_samples( pInstrument->has_missing_samples() );
+	__components.swap( pInstrument->__components );
 }
 
 void Instrument::load_from( const QString& dk_name, const QString& instrument_name, bool is_live, Filesystem::Lookup lookup )
@@ -293,6 +327,7 @@ std::shared_ptr<Instrument> Instrument::load_from( XMLNode* node, const QString&
 	pInstrument->set_adsr( std::make_shared<ADSR>( attack, decay, sustain, release ) );
 	pInstrument->set_gain( node->read_float( "gain", 1.0f, true, false ) );
 	pInstrument->set_mute_group( node->read_int( "muteGroup", -1, true, false ) );
+	pInstrument->set_max_voices( node->read_int( "maxVoices", 0, true, false ) );
 	pInstrument->set_midi_out_channel( node->read_int( "midiOutChannel", -1, true, false ) );
 	pInstrument->set_midi_out_note( node->read_int( "midiOutNote", pInstrument->__midi_out_note, true, false ) );
 	pInstrument->set_stop_notes( node->read_bool( "isStopNote", true,false ) );
@@ -324,16 +359,24 @@ std::shared_ptr<Instrument> Instrument::load_from( XMLNode* node, const QString&
 	return pInstrument;
 }
 
-void Instrument::load_samples()
+void Instrument::load_samples( SampleLoader* pLoader )
 {
+	SampleLoader sampleLoader;
+	SampleLoader* pSampleLoader = pLoader != nullptr ? pLoader : &sampleLoader;
 	for ( auto& pComponent : *get_components() ) {
 		for ( int i = 0; i < InstrumentComponent::getMaxLayers(); i++ ) {
 			auto pLayer = pComponent->get_layer( i );
-			if( pLayer ) {
-				pLayer->load_sample();
+			if ( pLayer && Preferences::get_instance()->m_bLazyLayerLoading ) {
+				pLayer->defer_sample();
+			} else if( pLayer ) {
+				pSampleLoader->add( [pLayer]() {
+					pLayer->load_sample();
+					return pLayer->get_sample();
+				} );
 			}
 		}
 	}
+	sampleLoader.run();
 }
 
 void Instrument::unload_samples()
@@ -348,6 +391,42 @@ void Instrument::unload_samples()
 	}
 }
 
+void Instrument::resample_samples( int nSampleRate, SampleLoader* pLoader )
+{
+	AudioEngine* pAudioEngine = Hydrogen::get_instance()->getAudioEngine();
+	SampleLoader sampleLoader;
+	SampleLoader* pSampleLoader = pLoader != nullptr ? pLoader : &sampleLoader;
+	for ( auto& pComponent : *get_components() ) {
+		for ( int i = 0; i < InstrumentComponent::getMaxLayers(); i++ ) {
+			auto pLayer = pComponent->get_layer( i );
+			if ( pLayer == nullptr ) {
+				continue;
+			}
+			auto pSample = pLayer->get_sample();
+			if ( pSample == nullptr || pSample->get_sample_rate() == nSampleRate ||
+				 pSample->is_streamed() || pLayer->is_deferred() ) {
+				continue;
+			}
+			// Voices still playing keep the previous sample.
+			pSampleLoader->add( [pSample, nSampleRate]() {
+				auto pResampled = std::make_shared<Sample>( pSample );
+				if ( ! pResampled->resample( nSampleRate ) ) {
+					return std::shared_ptr<Sample>();
+				}
+				return pResampled;
+			}, [=]( std::shared_ptr<Sample> pResampled ) {
+				if ( pResampled == nullptr || pLayer->get_sample() != pSample ) {
+					return;
+				}
+				pAudioEngine->lock( RIGHT_HERE );
+				pLayer->set_sample( pResampled );
+				pAudioEngine->unlock();
+			} );
+		}
+	}
+	sampleLoader.run();
+}
+
 void Instrument::save_to( XMLNode* node, int component_id )
 {
 	XMLNode InstrumentNode = node->createNode( "instrument" );
@@ -369,6 +448,7 @@ void Instrument::save_to( XMLNode* node, int component_id )
 	InstrumentNode.write_float( "Sustain", __adsr->get_sustain() );
 	InstrumentNode.write_float( "Release", __adsr->get_release() );
 	InstrumentNode.write_int( "muteGroup", __mute_group );
+	InstrumentNode.write_int( "maxVoices", __max_voices );
 	InstrumentNode.write_int( "midiOutChannel", __midi_out_channel );
 	InstrumentNode.write_int( "midiOutNote", __midi_out_note );
 	InstrumentNode.write_bool( "isStopNote", __stop_notes );
@@ -442,6 +522,7 @@ QString Instrument::toQString( const QString& sPrefix, bool bShort ) const {
 			.append( QString( "%1%2soloed: %3\n" ).arg( sPrefix ).arg( s ).arg( __soloed ) )
 			.append( QString( "%1%2muted: %3\n" ).arg( sPrefix ).arg( s ).arg( __muted ) )
 			.append( QString( "%1%2mute_group: %3\n" ).arg( sPrefix ).arg( s ).arg( __mute_group ) )
+			.append( QString( "%1%2max_voices: %3\n" ).arg( sPrefix ).arg( s ).arg( __max_voices ) )
 			.append( QString( "%1%2queued: %3\n" ).arg( sPrefix ).arg( s ).arg( __queued ) ) ;
 		sOutput.append( QString( "%1%2fx_level: [ " ).arg( sPrefix ).arg( s ) );
 		for ( auto ff : __fx_level ) {
@@ -487,6 +568,7 @@ QString Instrument::toQString( const QString& sPrefix, bool bShort ) const {
 			.append( QString( ", soloed: %1" ).arg( __soloed ) )
 			.append( QString( ", muted: %1" ).arg( __muted ) )
 			.append( QString( ", mute_group: %1" ).arg( __mute_group ) )
+			.append( QString( ", max_voices: %1" ).arg( __max_voices ) )
 			.append( QString( ", queued: %1" ).arg( __queued ) ) ;
 		sOutput.append( QString( ", fx_level: [ " ) );
 		for ( auto ff : __fx_level ) {
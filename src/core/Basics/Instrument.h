@@ -44,6 +44,7 @@ class Drumkit;
 class DrumkitComponent;
 class InstrumentLayer;
 class InstrumentComponent;
+class SampleLoader;
 
 
 /**
@@ -97,21 +98,40 @@ class Instrument : public H2Core::Object<Instrument>
 		 * \param drumkit the drumkit the instrument belongs to
 		 * \param instrument to load samples and members from
 		 * \param is_live is it performed while playing
+		 * \param pLoader If not nullptr, the samples are added to
+		 * @a pLoader and assigned to the layers once SampleLoader::run()
+		 * is called. Otherwise they are loaded concurrently before
+		 * returning.
 		 */
-		void load_from( Drumkit* drumkit, std::shared_ptr<Instrument> instrument, bool is_live = true );
+		void load_from( Drumkit* drumkit, std::shared_ptr<Instrument> instrument, bool is_live = true,
+						SampleLoader* pLoader = nullptr );
 
 		/**
 		 * Calls the InstrumentLayer::load_sample() member
 		 * function of all layers of each component of the
 		 * Instrument.
+		 *
+		 * \param pLoader If not nullptr, the layers are added to
+		 * @a pLoader and loaded once SampleLoader::run() is
+		 * called. Otherwise they are loaded concurrently before
+		 * returning.
 		 */
-		void load_samples();
+		void load_samples( SampleLoader* pLoader = nullptr );
 		/**
 		 * Calls the InstrumentLayer::unload_sample() member
 		 * function of all layers of each component of the
 		 * Instrument.
 		 */
 		void unload_samples();
+		/**
+		 * Converts the samples of all layers to @a nSampleRate
+		 * (see Sample::resample()). Layers are handed a
+		 * resampled copy of their sample while holding the lock
+		 * of the AudioEngine.
+		 *
+		 * \param pLoader See load_samples().
+		 */
+		void resample_samples( int nSampleRate, SampleLoader* pLoader = nullptr );
 
 		/**
 		 * save the instrument within the given XMLNode
@@ -151,6 +171,11 @@ class Instrument : public H2Core::Object<Instrument>
 		/** get the mute group of the instrument */
 		int get_mute_group() const;
 
+		/** set the maximum number of voices of the instrument, 0 for no limit */
+		void set_max_voices( int voices );
+		/** get the maximum number of voices of the instrument */
+		int get_max_voices() const;
+
 		/** set the midi out channel of the instrument */
 		void set_midi_out_channel( int channel );
 		/** get the midi out channel of the instrument */
@@ -277,6 +302,25 @@ class Instrument : public H2Core::Object<Instrument>
 
 		std::vector<std::shared_ptr<InstrumentComponent>>* get_components();
 		std::shared_ptr<InstrumentComponent> get_component( int DrumkitComponentID );
+		/**
+		 * Shares the ownership of the current components.
+		 *
+		 * Notes keep the components they started with alive this
+		 * way, even if take_over() replaced them in the meantime.
+		 */
+		std::shared_ptr<std::vector<std::shared_ptr<InstrumentComponent>>> share_components() const;
+
+		/**
+		 * Takes over the properties and components of @a
+		 * pInstrument, which receives the previous components in
+		 * return.
+		 *
+		 * The components are exchanged in constant time. This
+		 * allows to replace a fully loaded instrument while the
+		 * audio engine is running (see Hydrogen::loadDrumkit()).
+		 * The AudioEngine has to be locked by the caller.
+		 */
+		void take_over( std::shared_ptr<Instrument> pInstrument );
 
 		void set_apply_velocity( bool apply_velocity );
 		bool get_apply_velocity() const;
@@ -324,6 +368,7 @@ class Instrument : public H2Core::Object<Instrument>
 		bool					__soloed;				///< is the instrument in solo mode?
 		bool					__muted;				///< is the instrument muted?
 		int						__mute_group;			///< mute group of the instrument
+		int						__max_voices;			///< maximum number of notes played at the same time, 0 for no limit (see VoiceAllocator)
 		int						__queued;				///< count the number of notes queued within Sampler::__playing_notes_queue or std::priority_queue m_songNoteQueue
 		float					__fx_level[MAX_FX];		///< Ladspa FX level array
 		int						__hihat_grp;			///< the instrument is part of a hihat
@@ -331,10 +376,14 @@ class Instrument : public H2Core::Object<Instrument>
 		int						__higher_cc;			///< higher cc level
 		bool					__is_preview_instrument;		///< is the instrument an hydrogen preview instrument?
 		bool					__is_metronome_instrument;		///< is the instrument an metronome instrument?
-		std::vector<std::shared_ptr<InstrumentComponent>>* __components;		///< InstrumentLayer array
+		std::shared_ptr<std::vector<std::shared_ptr<InstrumentComponent>>> __components;		///< InstrumentLayer array
 		bool					__apply_velocity;				///< change the sample gain based on velocity
 		bool					__current_instr_for_export;		///< is the instrument currently being exported?
 		bool 					m_bHasMissingSamples;	///< does the instrument have missing sample files?
+
+		/** Copies all properties of @a pInstrument except for its
+		 * components and the name of its drumkit.*/
+		void copy_properties( std::shared_ptr<Instrument> pInstrument );
 };
 
 // DEFINITIONS
@@ -383,6 +432,16 @@ inline int Instrument::get_mute_group() const
 	return __mute_group;
 }
 
+inline void Instrument::set_max_voices( int voices )
+{
+	__max_voices = ( voices < 0 ? 0 : voices );
+}
+
+inline int Instrument::get_max_voices() const
+{
+	return __max_voices;
+}
+
 inline int Instrument::get_midi_out_channel() const
 {
 	return __midi_out_channel;
@@ -654,6 +713,11 @@ inline void Instrument::set_is_metronome_instrument(bool isMetronome)
 }
 
 inline std::vector<std::shared_ptr<InstrumentComponent>>* Instrument::get_components()
+{
+	return __components.get();
+}
+
+inline std::shared_ptr<std::vector<std::shared_ptr<InstrumentComponent>>> Instrument::share_components() const
 {
 	return __components;
 }
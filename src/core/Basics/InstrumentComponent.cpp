@@ -37,6 +37,8 @@
 #include <core/Basics/InstrumentList.h>
 #include <core/Basics/InstrumentLayer.h>
 
+#include <QtAlgorithms>
+
 namespace H2Core
 {
 
@@ -45,16 +47,22 @@ int InstrumentComponent::m_nMaxLayers;
 InstrumentComponent::InstrumentComponent( int related_drumkit_componentID )
 	: __related_drumkit_componentID( related_drumkit_componentID )
 	, __gain( 1.0 )
+	, m_nVelocityWords( ( m_nMaxLayers + 63 ) / 64 )
+	, m_nVelocityRevision( -1 )
 {
 	__layers.resize( m_nMaxLayers );
 	for ( int i = 0; i < m_nMaxLayers; i++ ) {
 		__layers[i] = nullptr;
 	}
+	m_velocityTable.resize( nVelocityBuckets * m_nVelocityWords );
+	m_nearestLayers.fill( -1 );
 }
 
 InstrumentComponent::InstrumentComponent( std::shared_ptr<InstrumentComponent> other )
 	: __related_drumkit_componentID( other->__related_drumkit_componentID )
 	, __gain( other->__gain )
+	, m_nVelocityWords( ( m_nMaxLayers + 63 ) / 64 )
+	, m_nVelocityRevision( -1 )
 {
 	__layers.resize( m_nMaxLayers );
 	for ( int i = 0; i < m_nMaxLayers; i++ ) {
@@ -65,6 +73,8 @@ InstrumentComponent::InstrumentComponent( std::shared_ptr<InstrumentComponent> o
 			__layers[i] = nullptr;
 		}
 	}
+	m_velocityTable.resize( nVelocityBuckets * m_nVelocityWords );
+	m_nearestLayers.fill( -1 );
 }
 
 InstrumentComponent::~InstrumentComponent()
@@ -78,6 +88,104 @@ void InstrumentComponent::set_layer( std::shared_ptr<InstrumentLayer> layer, int
 {
 	assert( idx >= 0 && idx < m_nMaxLayers );
 	__layers[ idx ] = layer;
+	m_nVelocityRevision.store( -1, std::memory_order_release );
+}
+
+int InstrumentComponent::find_layers( float velocity, int* indices )
+{
+	return lookup_layers( velocity, indices, static_cast<int>( __layers.size() ) );
+}
+
+int InstrumentComponent::find_layer( float velocity )
+{
+	int nLayer = -1;
+	lookup_layers( velocity, &nLayer, 1 );
+	return nLayer;
+}
+
+int InstrumentComponent::find_nearest_layer( float velocity )
+{
+	check_velocity_table();
+	return m_nearestLayers[ velocity_bucket( velocity ) ];
+}
+
+void InstrumentComponent::check_velocity_table()
+{
+	if ( m_nVelocityRevision.load( std::memory_order_acquire ) !=
+		 InstrumentLayer::get_velocity_revision() ) {
+		update_velocity_table();
+	}
+}
+
+int InstrumentComponent::lookup_layers( float velocity, int* indices, int max_found )
+{
+	check_velocity_table();
+
+	int nFound = 0;
+	const uint64_t* pWords = &m_velocityTable[ velocity_bucket( velocity ) * m_nVelocityWords ];
+	for ( int nWord = 0; nWord < m_nVelocityWords; ++nWord ) {
+		for ( uint64_t nBits = pWords[ nWord ]; nBits != 0; nBits &= nBits - 1 ) {
+			const int nLayer = nWord * 64 + qCountTrailingZeroBits( static_cast<quint64>( nBits ) );
+			const auto& pLayer = __layers[ nLayer ];
+			// The bucket may cover velocities outside of the range
+			// of the layer.
+			if ( pLayer != nullptr &&
+				 velocity >= pLayer->get_start_velocity() &&
+				 velocity <= pLayer->get_end_velocity() ) {
+				indices[ nFound++ ] = nLayer;
+				if ( nFound == max_found ) {
+					return nFound;
+				}
+			}
+		}
+	}
+	return nFound;
+}
+
+void InstrumentComponent::update_velocity_table()
+{
+	// Read first so changes during the update trigger another one.
+	const int nRevision = InstrumentLayer::get_velocity_revision();
+
+	std::fill( m_velocityTable.begin(), m_velocityTable.end(), 0 );
+	const int nLayers = std::min( static_cast<int>( __layers.size() ), m_nVelocityWords * 64 );
+	for ( int nLayer = 0; nLayer < nLayers; ++nLayer ) {
+		const auto& pLayer = __layers[ nLayer ];
+		if ( pLayer == nullptr ) {
+			continue;
+		}
+		const uint64_t nBit = static_cast<uint64_t>( 1 ) << ( nLayer % 64 );
+		const int nLastBucket = velocity_bucket( pLayer->get_end_velocity() );
+		for ( int nBucket = velocity_bucket( pLayer->get_start_velocity() );
+			  nBucket <= nLastBucket; ++nBucket ) {
+			m_velocityTable[ nBucket * m_nVelocityWords + nLayer / 64 ] |= nBit;
+		}
+	}
+
+	// Distance between the velocity range of each bucket and the
+	// ones of the layers. The first layer wins in case of a tie.
+	for ( int nBucket = 0; nBucket < nVelocityBuckets; ++nBucket ) {
+		const float fBucketStart = static_cast<float>( nBucket ) / nVelocityBuckets;
+		const float fBucketEnd = static_cast<float>( nBucket + 1 ) / nVelocityBuckets;
+		float fShortestDistance = 0;
+		int nNearestLayer = -1;
+		for ( int nLayer = 0; nLayer < static_cast<int>( __layers.size() ); ++nLayer ) {
+			const auto& pLayer = __layers[ nLayer ];
+			if ( pLayer == nullptr ) {
+				continue;
+			}
+			const float fDistance = std::max( { 0.f,
+					pLayer->get_start_velocity() - fBucketEnd,
+					fBucketStart - pLayer->get_end_velocity() } );
+			if ( nNearestLayer == -1 || fDistance < fShortestDistance ) {
+				fShortestDistance = fDistance;
+				nNearestLayer = nLayer;
+			}
+		}
+		m_nearestLayers[ nBucket ] = nNearestLayer;
+	}
+
+	m_nVelocityRevision.store( nRevision, std::memory_order_release );
 }
 
 void InstrumentComponent::setMaxLayers( int layers )
@@ -23,7 +23,11 @@
 #ifndef H2C_INSTRUMENTCOMPONENT_H
 #define H2C_INSTRUMENTCOMPONENT_H
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
+#include <cstdint>
 #include <vector>
 #include <core/Object.h>
 #include <memory>
@@ -54,6 +58,46 @@ class InstrumentComponent : public H2Core::Object<InstrumentComponent>
 		std::shared_ptr<InstrumentLayer>	get_layer( int idx );
 		void				set_layer( std::shared_ptr<InstrumentLayer> layer, int idx );
 
+		/**
+		 * Finds all layers whose velocity range contains @a
+		 * velocity.
+		 *
+		 * Only the layers overlapping the bucket of @a velocity
+		 * are checked (see #nVelocityBuckets). The table of
+		 * candidates is rebuilt without any allocation on first use
+		 * after a layer was set or the velocity range of any layer
+		 * changed. Real-time safe but not to be called by several
+		 * threads at once.
+		 *
+		 * \param velocity Velocity of the note.
+		 * \param indices Receives the indices of the layers in
+		 * ascending order. Has to hold getMaxLayers() elements.
+		 * \return Number of layers found.
+		 */
+		int					find_layers( float velocity, int* indices );
+		/** \return Index of the first layer whose velocity range
+		 * contains @a velocity or -1. See find_layers(). */
+		int					find_layer( float velocity );
+		/**
+		 * Fallback in case @a velocity falls into a hole between
+		 * the velocity ranges of the layers (find_layer() returns
+		 * -1). Drumkits not written with enough care contain such
+		 * holes.
+		 *
+		 * The nearest layer is stored for each bucket of the
+		 * velocity table. The lookup is thus O(1) and real-time
+		 * safe just like find_layers().
+		 *
+		 * \return Index of the layer whose velocity range is
+		 * closest to the bucket of @a velocity or -1 if there are
+		 * no layers at all.
+		 */
+		int					find_nearest_layer( float velocity );
+
+		/** Number of ranges the velocity is divided into by the table
+		 * used in find_layers().*/
+		static constexpr int nVelocityBuckets = 128;
+
 		void				set_drumkit_componentID( int related_drumkit_componentID );
 		int					get_drumkit_componentID();
 
@@ -90,6 +134,28 @@ class InstrumentComponent : public H2Core::Object<InstrumentComponent>
 		 * Preferences::Preferences(): 16. */
 		static int			m_nMaxLayers;
 		std::vector<std::shared_ptr<InstrumentLayer>>	__layers;
+
+		/** \return Bucket of the velocity table @a velocity falls into. */
+		static int			velocity_bucket( float velocity );
+		/** Implements find_layers() stopping after @a max_found
+		 * layers.*/
+		int					lookup_layers( float velocity, int* indices, int max_found );
+		/** Rebuilds #m_velocityTable and #m_nearestLayers in case
+		 * a layer or a velocity range changed.*/
+		void				check_velocity_table();
+		void				update_velocity_table();
+		/** For each of the #nVelocityBuckets buckets a bit set of
+		 * the layers whose velocity range overlaps it, stored in
+		 * #m_nVelocityWords words.*/
+		std::vector<uint64_t>	m_velocityTable;
+		int					m_nVelocityWords;
+		/** For each of the #nVelocityBuckets buckets the layer whose
+		 * velocity range is closest to it. Used by
+		 * find_nearest_layer().*/
+		std::array<int, nVelocityBuckets>	m_nearestLayers;
+		/** InstrumentLayer::get_velocity_revision() #m_velocityTable
+		 * was built for. -1 after a layer was set.*/
+		std::atomic<int>	m_nVelocityRevision;
 };
 
 // DEFINITIONS
@@ -128,6 +194,19 @@ inline std::shared_ptr<InstrumentLayer> InstrumentComponent::get_layer( int idx
 	return __layers[ idx ];
 }
 
+inline int InstrumentComponent::velocity_bucket( float velocity )
+{
+	// Scaling by a power of two is exact. The bucket does therefore
+	// never decrease with the velocity.
+	if ( ! ( velocity > 0 ) ) {
+		return 0;
+	}
+	if ( velocity >= 1 ) {
+		return nVelocityBuckets - 1;
+	}
+	return std::min( static_cast<int>( velocity * nVelocityBuckets ), nVelocityBuckets - 1 );
+}
+
 };
 
 
@@ -28,12 +28,15 @@
 namespace H2Core
 {
 
+std::atomic<int> InstrumentLayer::__velocity_revision( 0 );
+
 InstrumentLayer::InstrumentLayer( std::shared_ptr<Sample> sample ) :
 	__start_velocity( 0.0 ),
 	__end_velocity( 1.0 ),
 	__pitch( 0.0 ),
 	__gain( 1.0 ),
-	__sample( sample )
+	__sample( sample ),
+	m_loadState( LoadState::Loaded )
 {
 }
 
@@ -42,7 +45,8 @@ InstrumentLayer::InstrumentLayer( std::shared_ptr<InstrumentLayer> other ) : Obj
 	__end_velocity( other->get_end_velocity() ),
 	__pitch( other->get_pitch() ),
 	__gain( other->get_gain() ),
-	__sample( other->get_sample() )
+	__sample( other->get_sample() ),
+	m_loadState( other->is_deferred() ? LoadState::Deferred : LoadState::Loaded )
 {
 }
 
@@ -51,7 +55,8 @@ InstrumentLayer::InstrumentLayer( std::shared_ptr<InstrumentLayer> other, std::s
 	__end_velocity( other->get_end_velocity() ),
 	__pitch( other->get_pitch() ),
 	__gain( other->get_gain() ),
-	__sample( sample )
+	__sample( sample ),
+	m_loadState( LoadState::Loaded )
 {
 }
 
@@ -62,13 +67,16 @@ InstrumentLayer::~InstrumentLayer()
 void InstrumentLayer::set_sample( std::shared_ptr<Sample> sample )
 {
 	__sample = sample;
+	m_loadState.store( LoadState::Loaded, std::memory_order_release );
 }
 
 void InstrumentLayer::load_sample()
 {
 	if( __sample ) {
-		__sample->load();
+		// Layers of drumkits may be streamed from disk.
+		__sample->load( true );
 	}
+	m_loadState.store( LoadState::Loaded, std::memory_order_release );
 }
 
 void InstrumentLayer::unload_sample()
@@ -108,6 +116,7 @@ QString InstrumentLayer::toQString( const QString& sPrefix, bool bShort ) const
 			.append( QString( "%1%2pitch: %3\n" ).arg( sPrefix ).arg( s ).arg( __pitch ) )
 			.append( QString( "%1%2start_velocity: %3\n" ).arg( sPrefix ).arg( s ).arg( __start_velocity ) )
 			.append( QString( "%1%2end_velocity: %3\n" ).arg( sPrefix ).arg( s ).arg( __end_velocity ) )
+			.append( QString( "%1%2deferred: %3\n" ).arg( sPrefix ).arg( s ).arg( is_deferred() ) )
 			.append( QString( "%1" ).arg( __sample->toQString( sPrefix + s, bShort ) ) );
 	} else {
 		sOutput = QString( "[InstrumentLayer]" )
@@ -115,6 +124,7 @@ QString InstrumentLayer::toQString( const QString& sPrefix, bool bShort ) const
 			.append( QString( ", pitch: %1" ).arg( __pitch ) )
 			.append( QString( ", start_velocity: %1" ).arg( __start_velocity ) )
 			.append( QString( ", end_velocity: %1" ).arg( __end_velocity ) )
+			.append( QString( ", deferred: %1" ).arg( is_deferred() ) )
 			.append( QString( ", sample: %1\n" ).arg( __sample->get_filepath() ) );
 	}
 	
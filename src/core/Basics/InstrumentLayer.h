@@ -23,6 +23,7 @@
 #ifndef H2C_INSTRUMENT_LAYER_H
 #define H2C_INSTRUMENT_LAYER_H
 
+#include <atomic>
 #include <memory>
 #include <core/Object.h>
 
@@ -78,7 +79,14 @@ namespace H2Core
 		void set_end_velocity( float end );
 		/** get the end velocity of the layer */
 		float get_end_velocity() const;
-		/** set the sample of the layer */
+		/**
+		 * Incremented whenever the velocity range of any layer
+		 * changes. Allows InstrumentComponent to keep its lookup
+		 * table of layers up to date.
+		 */
+		static int get_velocity_revision();
+		/** set the sample of the layer. The layer is no longer
+		 * deferred afterwards. */
 		void set_sample( std::shared_ptr<Sample> sample );
 		/** get the sample of the layer */
 		std::shared_ptr<Sample> get_sample() const;
@@ -93,6 +101,22 @@ namespace H2Core
 		 */
 		void unload_sample();
 
+		/**
+		 * Marks #__sample, which holds no data yet, to be loaded on
+		 * first use (see Preferences::m_bLazyLayerLoading).
+		 */
+		void defer_sample();
+		/** \return Whether #__sample was not loaded yet. */
+		bool is_deferred() const;
+		/**
+		 * Called by the Sampler once it selected a deferred layer.
+		 * Real-time safe.
+		 *
+		 * \return true for the first call only. Further calls
+		 * return false till the layer is deferred again.
+		 */
+		bool request_sample();
+
 		/**
 		 * save the instrument layer within the given XMLNode
 		 * \param node the XMLNode to feed
@@ -121,6 +145,15 @@ namespace H2Core
 		float __start_velocity;     ///< the start velocity of the sample, 0.0 by default
 		float __end_velocity;       ///< the end velocity of the sample, 1.0 by default
 		std::shared_ptr<Sample> __sample;           ///< the underlaying sample
+		static std::atomic<int> __velocity_revision; ///< see get_velocity_revision()
+
+		enum class LoadState {
+			Loaded,
+			Deferred,
+			/** Deferred and queued for loading by the Sampler.*/
+			Requested
+		};
+		std::atomic<LoadState> m_loadState;
 	};
 
 	// DEFINITIONS
@@ -148,6 +181,7 @@ namespace H2Core
 	inline void InstrumentLayer::set_start_velocity( float start )
 	{
 		__start_velocity = start;
+		__velocity_revision.fetch_add( 1, std::memory_order_release );
 	}
 
 	inline float InstrumentLayer::get_start_velocity() const
@@ -158,6 +192,7 @@ namespace H2Core
 	inline void InstrumentLayer::set_end_velocity( float end )
 	{
 		__end_velocity = end;
+		__velocity_revision.fetch_add( 1, std::memory_order_release );
 	}
 
 	inline float InstrumentLayer::get_end_velocity() const
@@ -165,11 +200,33 @@ namespace H2Core
 		return __end_velocity;
 	}
 
+	inline int InstrumentLayer::get_velocity_revision()
+	{
+		return __velocity_revision.load( std::memory_order_acquire );
+	}
+
 	inline std::shared_ptr<Sample> InstrumentLayer::get_sample() const
 	{
 		return __sample;
 	}
 
+	inline void InstrumentLayer::defer_sample()
+	{
+		m_loadState.store( LoadState::Deferred, std::memory_order_release );
+	}
+
+	inline bool InstrumentLayer::is_deferred() const
+	{
+		return m_loadState.load( std::memory_order_acquire ) != LoadState::Loaded;
+	}
+
+	inline bool InstrumentLayer::request_sample()
+	{
+		LoadState expected = LoadState::Deferred;
+		return m_loadState.compare_exchange_strong( expected, LoadState::Requested,
+													 std::memory_order_acq_rel );
+	}
+
 };
 
 #endif // H2C_INSTRUMENT_LAYER_H
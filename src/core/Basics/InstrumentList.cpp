@@ -24,6 +24,7 @@
 
 #include <core/Helpers/Xml.h>
 #include <core/Basics/Instrument.h>
+#include <core/Basics/SampleLoader.h>
 
 #include <set>
 
@@ -49,9 +50,12 @@ InstrumentList::~InstrumentList()
 
 void InstrumentList::load_samples()
 {
+	// The samples of all instruments are decoded concurrently.
+	SampleLoader sampleLoader;
 	for( int i=0; i<__instruments.size(); i++ ) {
-		__instruments[i]->load_samples();
+		__instruments[i]->load_samples( &sampleLoader );
 	}
+	sampleLoader.run();
 }
 
 void InstrumentList::unload_samples()
@@ -61,6 +65,15 @@ void InstrumentList::unload_samples()
 	}
 }
 
+void InstrumentList::resample_samples( int nSampleRate )
+{
+	SampleLoader sampleLoader;
+	for( int i=0; i<__instruments.size(); i++ ) {
+		__instruments[i]->resample_samples( nSampleRate, &sampleLoader );
+	}
+	sampleLoader.run();
+}
+
 InstrumentList* InstrumentList::load_from( XMLNode* node, const QString& dk_path, const QString& dk_name )
 {
 	InstrumentList* instruments = new InstrumentList();
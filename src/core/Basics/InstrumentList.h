@@ -142,6 +142,10 @@ class InstrumentList : public H2Core::Object<InstrumentList>
 		 * function of all Instruments in #__instruments.
 		 */
 		void unload_samples();
+		/** Calls the Instrument::resample_samples() member
+		 * function of all Instruments in #__instruments.
+		 */
+		void resample_samples( int nSampleRate );
 		/**
 		 * save the instrument list within the given XMLNode
 		 * \param node the XMLNode to feed
@@ -30,6 +30,8 @@
 #include <core/Basics/Instrument.h>
 #include <core/Basics/InstrumentComponent.h>
 #include <core/Basics/InstrumentList.h>
+#include <core/Sampler/DiskStreamer.h>
+#include <core/Sampler/Filter.h>
 #include <core/Sampler/Sampler.h>
 
 namespace H2Core
@@ -47,11 +49,13 @@ Note::Note( std::shared_ptr<Instrument> instrument, int position, float velocity
 	  __pitch( pitch ),
 	  __key( C ),
 	  __octave( P8 ),
-	  __adsr( nullptr ),
 	  __lead_lag( 0.0 ),
 	  __cut_off( 1.0 ),
 	  __resonance( 0.0 ),
+	  __filter_started( false ),
 	  __humanize_delay( 0 ),
+	  __layers_selected( __layers_embedded ),
+	  __layers_selected_count( 0 ),
 	  __bpfb_l( 0.0 ),
 	  __bpfb_r( 0.0 ),
 	  __lpfb_l( 0.0 ),
@@ -60,20 +64,13 @@ Note::Note( std::shared_ptr<Instrument> instrument, int position, float velocity
 	  __midi_msg( -1 ),
 	  __note_off( false ),
 	  __just_recorded( false ),
-	  __probability( 1.0f )
+	  __probability( 1.0f ),
+	  __scheduler_next( nullptr ),
+	  __scheduler_frame( 0 )
 {
 	if ( __instrument != nullptr ) {
-		__adsr = __instrument->copy_adsr();
 		__instrument_id = __instrument->get_id();
-
-		for ( const auto& pCompo : *__instrument->get_components() ) {
-
-			SelectedLayerInfo *sampleInfo = new SelectedLayerInfo;
-			sampleInfo->SelectedLayer = -1;
-			sampleInfo->SamplePosition = 0;
-
-			__layers_selected[ pCompo->get_drumkit_componentID() ] = sampleInfo;
-		}
+		init_layers_selected();
 	}
 
 	setPan( pan ); // this checks the boundaries
@@ -91,11 +88,13 @@ Note::Note( Note* other, std::shared_ptr<Instrument> instrument )
 	  __pitch( other->get_pitch() ),
 	  __key( other->get_key() ),
 	  __octave( other->get_octave() ),
-	  __adsr( nullptr ),
 	  __lead_lag( other->get_lead_lag() ),
 	  __cut_off( other->get_cut_off() ),
 	  __resonance( other->get_resonance() ),
+	  __filter_started( false ),
 	  __humanize_delay( other->get_humanize_delay() ),
+	  __layers_selected( __layers_embedded ),
+	  __layers_selected_count( 0 ),
 	  __bpfb_l( other->get_bpfb_l() ),
 	  __bpfb_r( other->get_bpfb_r() ),
 	  __lpfb_l( other->get_lpfb_l() ),
@@ -104,25 +103,46 @@ Note::Note( Note* other, std::shared_ptr<Instrument> instrument )
 	  __midi_msg( other->get_midi_msg() ),
 	  __note_off( other->get_note_off() ),
 	  __just_recorded( other->get_just_recorded() ),
-	  __probability( other->get_probability() )
+	  __probability( other->get_probability() ),
+	  __scheduler_next( nullptr ),
+	  __scheduler_frame( 0 )
 {
 	if ( instrument != nullptr ) __instrument = instrument;
 	if ( __instrument != nullptr ) {
-		__adsr = __instrument->copy_adsr();
 		__instrument_id = __instrument->get_id();
+		init_layers_selected();
+	}
+}
 
-		for ( const auto& pCompo : *__instrument->get_components() ) {
-			SelectedLayerInfo *sampleInfo = new SelectedLayerInfo;
-			sampleInfo->SelectedLayer = -1;
-			sampleInfo->SamplePosition = 0;
-
-			__layers_selected[ pCompo->get_drumkit_componentID() ] = sampleInfo;
+Note::~Note()
+{
+	for ( int ii = 0; ii < __layers_selected_count; ++ii ) {
+		if ( __layers_selected[ ii ].info.pStream != nullptr ) {
+			__layers_selected[ ii ].info.pStream->close();
 		}
 	}
 }
 
-Note::~Note()
+void Note::init_layers_selected()
 {
+	// The envelope is copied into the note. Together with the
+	// embedded layer infos this keeps notes acquired from the
+	// NotePool free of allocations.
+	__adsr = ADSR( __instrument->get_adsr() );
+
+	auto pComponents = __instrument->get_components();
+	const int nComponents = pComponents->size();
+	if ( nComponents > nEmbeddedLayers ) {
+		__layers_overflow.reset( new ComponentLayer[ nComponents ] );
+		__layers_selected = __layers_overflow.get();
+	}
+	for ( const auto& pCompo : *pComponents ) {
+		ComponentLayer& layer = __layers_selected[ __layers_selected_count++ ];
+		layer.nComponentID = pCompo->get_drumkit_componentID();
+		layer.info.SelectedLayer = -1;
+		layer.info.SamplePosition = 0;
+		layer.info.pStream = nullptr;
+	}
 }
 
 static inline float check_boundary( float v, float min, float max )
@@ -158,6 +178,30 @@ void Note::map_instrument( InstrumentList* instruments )
 	}
 }
 
+void Note::apply_filter( float* buffer_l, float* buffer_r, int frames )
+{
+	const float cut_off = __instrument->get_filter_cutoff();
+	const float resonance = __instrument->get_filter_resonance();
+	if ( !__filter_started ) {
+		// Nothing to ramp from.
+		__cut_off = cut_off;
+		__resonance = resonance;
+		__filter_started = true;
+	}
+
+	Filter::State state = { { __bpfb_l, __bpfb_r }, { __lpfb_l, __lpfb_r } };
+	Filter::lowPass( buffer_l, buffer_r, frames, state,
+					 __cut_off, cut_off, __resonance, resonance );
+	__bpfb_l = state.fBandPass[ 0 ];
+	__bpfb_r = state.fBandPass[ 1 ];
+	__lpfb_l = state.fLowPass[ 0 ];
+	__lpfb_r = state.fLowPass[ 1 ];
+	if ( frames > 0 ) {
+		__cut_off = cut_off;
+		__resonance = resonance;
+	}
+}
+
 QString Note::key_to_string()
 {
 	return QString( "%1%2" ).arg( __key_str[__key] ).arg( __octave );
@@ -253,7 +297,7 @@ QString Note::toQString( const QString& sPrefix, bool bShort ) const {
 			.append( QString( "%1%2pitch: %3\n" ).arg( sPrefix ).arg( s ).arg( __pitch ) )
 			.append( QString( "%1%2key: %3\n" ).arg( sPrefix ).arg( s ).arg( __key ) )
 			.append( QString( "%1%2octave: %3\n" ).arg( sPrefix ).arg( s ).arg( __octave ) )
-			.append( QString( "%1" ).arg( __adsr->toQString( sPrefix + s, bShort ) ) )
+			.append( QString( "%1" ).arg( __adsr.toQString( sPrefix + s, bShort ) ) )
 			.append( QString( "%1%2lead_lag: %3\n" ).arg( sPrefix ).arg( s ).arg( __lead_lag ) )
 			.append( QString( "%1%2cut_off: %3\n" ).arg( sPrefix ).arg( s ).arg( __cut_off ) )
 			.append( QString( "%1%2resonance: %3\n" ).arg( sPrefix ).arg( s ).arg( __resonance ) )
@@ -271,12 +315,13 @@ QString Note::toQString( const QString& sPrefix, bool bShort ) const {
 			.append( QString( "%1" ).arg( __instrument->toQString( sPrefix + s, bShort ) ) );
 		sOutput.append( QString( "%1%2layers_selected:\n" )
 						.arg( sPrefix ).arg( s ) );
-		for ( auto ll : __layers_selected ) {
+		for ( int ii = 0; ii < __layers_selected_count; ++ii ) {
+			const auto& layer = __layers_selected[ ii ];
 			sOutput.append( QString( "%1%2%3 : selected layer: %4, sample position: %5\n" )
 							.arg( sPrefix ).arg( s + s )
-							.arg( ll.first )
-							.arg( ll.second->SelectedLayer )
-							.arg( ll.second->SamplePosition ) );
+							.arg( layer.nComponentID )
+							.arg( layer.info.SelectedLayer )
+							.arg( layer.info.SamplePosition ) );
 		}
 	} else {
 
@@ -290,7 +335,7 @@ QString Note::toQString( const QString& sPrefix, bool bShort ) const {
 			.append( QString( ", pitch: %1" ).arg( __pitch ) )
 			.append( QString( ", key: %1" ).arg( __key ) )
 			.append( QString( ", octave: %1" ).arg( __octave ) )
-			.append( QString( ", [%1" ).arg( __adsr->toQString( sPrefix + s, bShort ).replace( "\n", "]" ) ) )
+			.append( QString( ", [%1" ).arg( __adsr.toQString( sPrefix + s, bShort ).replace( "\n", "]" ) ) )
 			.append( QString( ", lead_lag: %1" ).arg( __lead_lag ) )
 			.append( QString( ", cut_off: %1" ).arg( __cut_off ) )
 			.append( QString( ", resonance: %1" ).arg( __resonance ) )
@@ -307,11 +352,12 @@ QString Note::toQString( const QString& sPrefix, bool bShort ) const {
 			.append( QString( ", probability: %1" ).arg( __probability ) )
 			.append( QString( ", instrument: %1" ).arg( __instrument->get_name() ) )
 			.append( QString( ", layers_selected:" ) );
-		for ( auto ll : __layers_selected ) {
+		for ( int ii = 0; ii < __layers_selected_count; ++ii ) {
+			const auto& layer = __layers_selected[ ii ];
 			sOutput.append( QString( "%1 : selected layer: %2, sample position: %3" )
-							.arg( ll.first )
-							.arg( ll.second->SelectedLayer )
-							.arg( ll.second->SamplePosition ) );
+							.arg( layer.nComponentID )
+							.arg( layer.info.SelectedLayer )
+							.arg( layer.info.SamplePosition ) );
 		}
 	}
 	return sOutput;
@@ -26,6 +26,7 @@
 #include <memory>
 
 #include <core/Object.h>
+#include <core/Basics/Adsr.h>
 #include <core/Basics/Instrument.h>
 
 #define KEY_MIN                 0
@@ -56,10 +57,13 @@ class XMLNode;
 class ADSR;
 class Instrument;
 class InstrumentList;
+class NoteScheduler;
+class DiskStream;
 
 struct SelectedLayerInfo {
 	int SelectedLayer;		///< selected layer during layer selection
 	float SamplePosition;	///< place marker for overlapping process() cycles
+	DiskStream* pStream;	///< remainder of a streamed sample, owned by the Sampler
 };
 
 /**
@@ -69,6 +73,8 @@ struct SelectedLayerInfo {
 class Note : public H2Core::Object<Note>
 {
 		H2_OBJECT(Note)
+		/** Uses the note itself as node of its buckets.*/
+		friend class NoteScheduler;
 	public:
 		/** possible keys */
 		enum Key { C=KEY_MIN, Cs, D, Ef, E, F, Fs, G, Af, A, Bf, B };
@@ -92,6 +98,9 @@ class Note : public H2Core::Object<Note>
 		 * \param instrument if set will be used as note instrument
 		 */
 		Note( Note* other, std::shared_ptr<Instrument> instrument=nullptr );
+		/** The envelope and layer infos refer to the note itself.*/
+		Note( const Note& other ) = delete;
+		Note& operator=( const Note& other ) = delete;
 		/** destructor */
 		~Note();
 
@@ -120,6 +129,16 @@ class Note : public H2Core::Object<Note>
 		std::shared_ptr<Instrument> get_instrument();
 		/** return true if #__instrument is set */
 		bool has_instrument() const;
+		/**
+		 * Keeps the current components of #__instrument alive
+		 * while the note is playing. Called by Sampler::noteOn()
+		 * so the note finishes with the samples it started with
+		 * even if the drumkit is exchanged in the meantime.
+		 */
+		void capture_components();
+		/** \return Components captured by capture_components() or
+		 * those of #__instrument if there are none.*/
+		std::vector<std::shared_ptr<InstrumentComponent>>* get_components() const;
 		/**
 		 * #__instrument_id setter
 		 * \param value the new value
@@ -209,9 +228,16 @@ class Note : public H2Core::Object<Note>
 
 		/*
 		 * selected sample
+		 * \return nullptr if the instrument had no component of
+		 * id @a CompoID when the note was created
 		 * */
 		SelectedLayerInfo* get_layer_selected( int CompoID );
 
+		/** Number of components whose SelectedLayerInfo is stored
+		 * within the note itself. Notes of instruments with more
+		 * components allocate them on the heap.*/
+		static constexpr int nEmbeddedLayers = 8;
+
 
 		void set_probability( float value );
 		float get_probability() const;
@@ -280,8 +306,10 @@ class Note : public H2Core::Object<Note>
 		 */
 		void set_midi_info( Key key, Octave octave, int msg );
 
-		/** get the ADSR of the note */
-		std::shared_ptr<ADSR> get_adsr() const;
+		/** \return Envelope of the note. Owned by the note and only
+		 * valid as long as the note is not released to the
+		 * NotePool or deleted.*/
+		ADSR* get_adsr();
 		/** call release on adsr */
 		//float release_adsr() const              { return __adsr->release(); }
 		/** call get value on adsr */
@@ -298,11 +326,19 @@ class Note : public H2Core::Object<Note>
 		bool match( const Note *pNote ) const;
 
 		/**
-		 * compute left and right output based on filters
-		 * \param val_l the left channel value
-		 * \param val_r the right channel value
+		 * apply the resonant low pass filter of the instrument to a
+		 * block of frames in place
+		 *
+		 * The cutoff and resonance of the instrument are read once.
+		 * The coefficients are ramped from the ones used for the
+		 * previous block (#__cut_off and #__resonance) over the whole
+		 * block, which keeps sweeps of the parameters, e.g. via MIDI
+		 * CC, free of zipper noise.
+		 * \param buffer_l the left channel
+		 * \param buffer_r the right channel
+		 * \param frames number of frames to filter
 		 */
-		void compute_lr_values( float* val_l, float* val_r );
+		void apply_filter( float* buffer_l, float* buffer_r, int frames );
 		/** Formatted string version for debugging purposes.
 		 * \param sPrefix String prefix which will be added in front of
 		 * every new line
@@ -330,12 +366,23 @@ class Note : public H2Core::Object<Note>
 		float			__pitch;              ///< the frequency of the note
 		Key				__key;                  ///< the key, [0;11]==[C;B]
 		Octave			 __octave;            ///< the octave [-3;3]
-		std::shared_ptr<ADSR>			__adsr;               ///< attack decay sustain release
+		ADSR			__adsr;               ///< copy of the envelope of the instrument, kept within the note to not allocate it separately
 		float			__lead_lag;           ///< lead or lag offset of the note
-		float			__cut_off;            ///< filter cutoff [0;1]
-		float			__resonance;          ///< filter resonant frequency [0;1]
+		float			__cut_off;            ///< filter cutoff [0;1] reached by the last block filtered
+		float			__resonance;          ///< filter resonant frequency [0;1] reached by the last block filtered
+		bool			__filter_started;      ///< whether #__cut_off and #__resonance were set by apply_filter()
 		int				__humanize_delay;       ///< used in "humanize" function
-		std::map< int, SelectedLayerInfo* > __layers_selected;
+		struct ComponentLayer {
+			int nComponentID;
+			SelectedLayerInfo info;
+		};
+		/** creates the layer infos of all components of #__instrument */
+		void init_layers_selected();
+		ComponentLayer	__layers_embedded[ nEmbeddedLayers ];
+		std::unique_ptr<ComponentLayer[]> __layers_overflow; ///< used in case there are more than #nEmbeddedLayers components
+		ComponentLayer*	__layers_selected;    ///< either #__layers_embedded or #__layers_overflow
+		int				__layers_selected_count;
+		std::shared_ptr<std::vector<std::shared_ptr<InstrumentComponent>>> __components; ///< components captured while playing
 		float			__bpfb_l;             ///< left band pass filter buffer
 		float			__bpfb_r;             ///< right band pass filter buffer
 		float			__lpfb_l;             ///< left low pass filter buffer
@@ -345,14 +392,16 @@ class Note : public H2Core::Object<Note>
 		bool			__note_off;            ///< note type on|off
 		bool			__just_recorded;       ///< used in record+delete
 		float			__probability;        ///< note probability
+		Note*			__scheduler_next;      ///< next note in the same bucket of the NoteScheduler
+		long long		__scheduler_frame;     ///< frame the note is due according to the NoteScheduler
 		static const char* __key_str[]; ///< used to build QString from #__key an #__octave
 };
 
 // DEFINITIONS
 
-inline std::shared_ptr<ADSR> Note::get_adsr() const
+inline ADSR* Note::get_adsr()
 {
-	return __adsr;
+	return &__adsr;
 }
 
 inline std::shared_ptr<Instrument> Note::get_instrument()
@@ -475,9 +524,29 @@ inline void Note::set_probability( float value )
 	__probability = value;
 }
 
+inline void Note::capture_components()
+{
+	if ( __instrument != nullptr ) {
+		__components = __instrument->share_components();
+	}
+}
+
+inline std::vector<std::shared_ptr<InstrumentComponent>>* Note::get_components() const
+{
+	if ( __components != nullptr ) {
+		return __components.get();
+	}
+	return __instrument->get_components();
+}
+
 inline SelectedLayerInfo* Note::get_layer_selected( int CompoID )
 {
-	return __layers_selected[ CompoID ];
+	for ( int ii = 0; ii < __layers_selected_count; ++ii ) {
+		if ( __layers_selected[ ii ].nComponentID == CompoID ) {
+			return &__layers_selected[ ii ].info;
+		}
+	}
+	return nullptr;
 }
 
 inline void Note::set_humanize_delay( int value )
@@ -583,25 +652,6 @@ inline bool Note::match( const Note *pNote ) const
 	return match( pNote->__instrument, pNote->__key, pNote->__octave );
 }
 
-inline void Note::compute_lr_values( float* val_l, float* val_r )
-{
-	/* TODO ???
-	if( !has_instrument() ) {
-		*val_l = 0.0f;
-		*val_r = 0.0f;
-		return;
-	}
-	*/
-	float cut_off = __instrument->get_filter_cutoff();
-	float resonance = __instrument->get_filter_resonance();
-	__bpfb_l  =  resonance * __bpfb_l  + cut_off * ( *val_l - __lpfb_l );
-	__lpfb_l +=  cut_off   * __bpfb_l;
-	__bpfb_r  =  resonance * __bpfb_r  + cut_off * ( *val_r - __lpfb_r );
-	__lpfb_r +=  cut_off   * __bpfb_r;
-	*val_l = __lpfb_l;
-	*val_r = __lpfb_r;
-}
-
 };
 
 #endif // H2C_NOTE_H
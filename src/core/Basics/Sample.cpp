@@ -22,14 +22,20 @@
 
 
 
+#include <algorithm>
 #include <limits>
 #include <memory>
 
 #include <core/Hydrogen.h>
+#include <core/AudioEngine/Mixing.h>
 #include <core/Preferences/Preferences.h>
 #include <core/Helpers/Filesystem.h>
 #include <core/Basics/Sample.h>
+#include <core/Basics/SampleCache.h>
 #include <core/Basics/Note.h>
+#include <core/Sampler/SincResampler.h>
+
+#include <QtCore/QTemporaryDir>
 
 #if defined(H2CORE_HAVE_RUBBERBAND) || _DOXYGEN_
 #include <rubberband/RubberBandStretcher.h>
@@ -82,18 +88,24 @@ Sample::Sample( std::shared_ptr<Sample> pOther ): Object( *pOther ),
 	__data_r( nullptr ),
 	__is_modified( pOther->get_is_modified() ),
 	__loops( pOther->__loops ),
-	__rubberband( pOther->__rubberband )
+	__rubberband( pOther->__rubberband ),
+	__unstretched( pOther->__unstretched )
 {
 
-	__data_l = new float[__frames];
-	__data_r = new float[__frames];
-	
-	// Since the third argument of memcpy takes the number of bytes,
-	// which are about to be copied, and the data is given in float,
-	// which are  four bytes each, the number of copied frames
-	// `__frames` has to be multiplied by four.
-	memcpy( __data_l, pOther->get_data_l(), __frames * 4 );
-	memcpy( __data_r, pOther->get_data_r(), __frames * 4 );
+	if ( pOther->__buffer != nullptr ) {
+		// Immutable content can be shared.
+		assign_buffer( pOther->__buffer );
+	} else {
+		__data_l = new float[__frames];
+		__data_r = new float[__frames];
+
+		// Since the third argument of memcpy takes the number of bytes,
+		// which are about to be copied, and the data is given in float,
+		// which are  four bytes each, the number of copied frames
+		// `__frames` has to be multiplied by four.
+		memcpy( __data_l, pOther->get_data_l(), __frames * 4 );
+		memcpy( __data_r, pOther->get_data_r(), __frames * 4 );
+	}
 	
 	PanEnvelope* pPan = pOther->get_pan_envelope();
 	for( int i=0; i<pPan->size(); i++ ) {
@@ -108,12 +120,94 @@ Sample::Sample( std::shared_ptr<Sample> pOther ): Object( *pOther ),
 
 Sample::~Sample()
 {
-	if ( __data_l != nullptr ) {
-		delete[] __data_l;
+	release_data();
+}
+
+void Sample::release_data()
+{
+	if ( __buffer != nullptr ) {
+		__buffer.reset();
+		__expanded_data[ 0 ].reset();
+		__expanded_data[ 1 ].reset();
+	} else {
+		if ( __data_l != nullptr ) {
+			delete[] __data_l;
+		}
+		if ( __data_r != nullptr && __data_r != __data_l ) {
+			delete[] __data_r;
+		}
+	}
+	__data_l = __data_r = nullptr;
+}
+
+void Sample::assign_buffer( std::shared_ptr<SampleBuffer> pBuffer )
+{
+	release_data();
+
+	__buffer = pBuffer;
+	__frames = pBuffer->getFileFrames();
+	__sample_rate = pBuffer->getSampleRate();
+
+	// Compact formats and streamed samples are only converted on
+	// demand.
+	if ( pBuffer->getFormat() == SampleBuffer::Format::Float &&
+		 pBuffer->isComplete() ) {
+		__data_l = pBuffer->getFloatData( 0 );
+		__data_r = pBuffer->getFloatData( 1 );
+	}
+}
+
+std::shared_ptr<SampleBuffer> Sample::get_complete_buffer() const
+{
+	assert( __buffer != nullptr );
+
+	if ( __buffer->isComplete() ) {
+		return __buffer;
+	}
+
+	auto pBuffer = SampleBuffer::decode( __filepath );
+	if ( pBuffer == nullptr || pBuffer->getFrames() != __frames ) {
+		ERRORLOG( QString( "Unable to decode streamed sample [%1]" ).arg( __filepath ) );
+		// Silence beyond the resident frames.
+		pBuffer = std::make_shared<SampleBuffer>( __frames, __sample_rate,
+												  __buffer->getChannels(),
+												  SampleBuffer::Format::Float );
+		std::vector<float> resident( __buffer->getFrames() );
+		for ( int nChannel = 0; nChannel < __buffer->getChannels(); ++nChannel ) {
+			__buffer->toFloat( nChannel, resident.data() );
+			memcpy( pBuffer->getFloatData( nChannel ), resident.data(),
+					resident.size() * sizeof( float ) );
+		}
+	}
+	return pBuffer;
+}
+
+void Sample::expand_data() const
+{
+	const auto pBuffer = get_complete_buffer();
+
+	for ( int nChannel = 0; nChannel < pBuffer->getChannels(); ++nChannel ) {
+		__expanded_data[ nChannel ] = std::make_unique<float[]>( __frames );
+		pBuffer->toFloat( nChannel, __expanded_data[ nChannel ].get() );
 	}
-	if ( __data_r != nullptr ) {
-		delete[] __data_r;
+	__data_l = __expanded_data[ 0 ].get();
+	__data_r = pBuffer->getChannels() > 1 ? __expanded_data[ 1 ].get() : __data_l;
+}
+
+void Sample::detach()
+{
+	if ( __buffer == nullptr ) {
+		return;
 	}
+
+	const auto pBuffer = get_complete_buffer();
+	float* pData_L = new float[ __frames ];
+	float* pData_R = new float[ __frames ];
+	pBuffer->toFloat( 0, pData_L );
+	pBuffer->toFloat( 1, pData_R );
+	release_data();
+	__data_l = pData_L;
+	__data_r = pData_R;
 }
 
 void Sample::set_filename( const QString& filename )
@@ -143,12 +237,32 @@ std::shared_ptr<Sample> Sample::load( const QString& sFilepath )
 	return pSample;
 }
 
+std::shared_ptr<Sample> Sample::create_deferred( const QString& sFilepath )
+{
+	if( !Filesystem::file_readable( sFilepath ) ) {
+		ERRORLOG( QString( "Unable to read %1" ).arg( sFilepath ) );
+		return nullptr;
+	}
+
+	return std::make_shared<Sample>( sFilepath );
+}
+
 std::shared_ptr<Sample> Sample::load( const QString& filepath, const Loops& loops, const Rubberband& rubber, const VelocityEnvelope& velocity, const PanEnvelope& pan, float fBpm )
 {
 	auto pSample = Sample::load( filepath );
 	
 	if( pSample ){
-		pSample->apply( loops, rubber, velocity, pan, fBpm );
+		pSample->apply_loops( loops );
+		pSample->apply_velocity( velocity );
+		pSample->apply_pan( pan );
+		pSample->set_rubberband( rubber );
+
+		// The unstretched sample is kept by the stretched one in
+		// order to stretch it again on tempo changes.
+		auto pStretched = Sample::stretch( pSample, fBpm );
+		if ( pStretched != nullptr ) {
+			return pStretched;
+		}
 	}
 
 	return pSample;
@@ -166,73 +280,62 @@ void Sample::apply( const Loops& loops, const Rubberband& rubber, const Velocity
 #endif
 }
 
-bool Sample::load()
+bool Sample::load( bool bAllowStreaming )
 {
-	// Will contain a bunch of metadata about the loaded sample.
-	SF_INFO sound_info = {0};
+	int nMaxFrames = 0;
+	const auto pPref = Preferences::get_instance();
+	if ( bAllowStreaming && pPref->m_bDiskStreaming ) {
+		nMaxFrames = std::max( 1, pPref->m_nStreamingHeadFrames );
+	}
 
-	// Opens file in read-only mode.
-	SNDFILE* file = sf_open( __filepath.toLocal8Bit(), SFM_READ, &sound_info );
-	if ( !file ) {
-		ERRORLOG( QString( "[Sample::load] Error loading file %1" ).arg( __filepath ) );
+	auto pBuffer = SampleCache::get_instance()->get( __filepath, nMaxFrames );
+	if ( pBuffer == nullptr ) {
 		return false;
 	}
-	
-	// Sanity check. SAMPLE_CHANNELS is defined in
-	// core/include/hydrogen/globals.h and set to 2.
-	if ( sound_info.channels > SAMPLE_CHANNELS ) {
-		WARNINGLOG( QString( "can't handle %1 channels, only 2 will be used" ).arg( sound_info.channels ) );
-		sound_info.channels = SAMPLE_CHANNELS;
-	}
-	if ( sound_info.frames > ( std::numeric_limits<int>::max()/sound_info.channels ) ) {
-		WARNINGLOG( QString( "sample frames count (%1) and channels (%2) are too much, truncate it." ).arg( sound_info.frames ).arg( sound_info.channels ) );
-		sound_info.frames = ( std::numeric_limits<int>::max()/sound_info.channels );
-	}
 
-	// Create an array, which will hold the block of samples read
-	// from file.
-	float* buffer = new float[ sound_info.frames * sound_info.channels ];
-	
-	//memset( buffer, 0, sound_info.frames *sound_info.channels );
-	
-	// Read all frames into `buffer'. Libsndfile does seamlessly
-	// convert the format of the underlying data on the fly. The
-	// output will be an array of floats regardless of file's
-	// encoding (e.g. 16 bit PCM).
-	sf_count_t count = sf_read_float( file, buffer, sound_info.frames * sound_info.channels );
-	if( count==0 ){
-		WARNINGLOG( QString( "%1 is an empty sample" ).arg( __filepath ) );
+	// Flush the current content of the left and right channel and
+	// replace it along with the metadata.
+	assign_buffer( pBuffer );
+
+	return true;
+}
+
+bool Sample::resample( int nSampleRate )
+{
+	if ( __sample_rate == nSampleRate ) {
+		return true;
 	}
-	
-	// Deallocate the handler.
-	if ( sf_close( file ) != 0 ){
-		WARNINGLOG( QString( "Unable to close sample file %1" ).arg( __filepath ) );
+	if ( is_streamed() || is_empty() ) {
+		return false;
 	}
-	
-	// Flush the current content of the left and right channel and
-	// the current metadata.
-	unload();
-	
-	// Save the metadata of the loaded file into private members
-	// of the Sample class.
-	__frames = sound_info.frames;
-	__sample_rate = sound_info.samplerate;
-
-	// Split the loaded frames into left and right channel. 
-	// If only one channels was present in the underlying data,
-	// duplicate its content.
-	__data_l = new float[ sound_info.frames ];
-	__data_r = new float[ sound_info.frames ];
-	if ( sound_info.channels == 1 ) {
-		memcpy( __data_l, buffer, __frames * sizeof( float ) );
-		memcpy( __data_r, buffer, __frames * sizeof( float ) );
-	} else if ( sound_info.channels == SAMPLE_CHANNELS ) {
-		for ( int i = 0; i < __frames; i++ ) {
-			__data_l[i] = buffer[i * SAMPLE_CHANNELS ];
-			__data_r[i] = buffer[i * SAMPLE_CHANNELS + 1 ];
+
+	if ( __buffer != nullptr ) {
+		// The content of modified samples, e.g. the result of
+		// exec_rubberband_cli(), differs from the file.
+		std::shared_ptr<SampleBuffer> pBuffer;
+		if ( __is_modified ) {
+			pBuffer = __buffer->resample( nSampleRate );
+		} else {
+			pBuffer = SampleCache::get_instance()->get( __filepath, 0, nSampleRate );
 		}
+		if ( pBuffer == nullptr ) {
+			return false;
+		}
+		assign_buffer( pBuffer );
+		return true;
 	}
-	delete[] buffer;
+
+	const SincResampler resampler( __sample_rate, nSampleRate );
+	const int nFrames = resampler.getOutputFrames( __frames );
+	float* pData_L = new float[ nFrames ];
+	float* pData_R = new float[ nFrames ];
+	resampler.process( __data_l, __frames, pData_L, nFrames );
+	resampler.process( __data_r, __frames, pData_R, nFrames );
+	release_data();
+	__data_l = pData_L;
+	__data_r = pData_R;
+	__frames = nFrames;
+	__sample_rate = nSampleRate;
 
 	return true;
 }
@@ -264,6 +367,8 @@ bool Sample::apply_loops( const Loops& lo )
 	}
 	//if( lo == __loops ) return true;
 
+	detach();
+
 	bool full_loop = lo.start_frame==lo.loop_frame;
 	int full_length =  lo.end_frame - lo.start_frame;
 	int loop_length =  lo.end_frame - lo.loop_frame;
@@ -327,8 +432,7 @@ bool Sample::apply_loops( const Loops& lo )
 		assert( x==new_length );
 	}
 	__loops = lo;
-	delete[] __data_l;
-	delete[] __data_r;
+	release_data();
 	__data_l = new_data_l;
 	__data_r = new_data_r;
 	__frames = new_length;
@@ -349,6 +453,7 @@ void Sample::apply_velocity( const VelocityEnvelope& v )
 	
 	__velocity_envelope.clear();
 	if ( v.size() > 0 ) {
+		detach();
 		float inv_resolution = __frames / 841.0F;
 		for ( int i = 1; i < v.size(); i++ ) {
 			float y = ( 91 - v[i - 1].value ) / 91.0F;
@@ -384,6 +489,7 @@ void Sample::apply_pan( const PanEnvelope& p )
 	
 	__pan_envelope.clear();
 	if ( p.size() > 0 ) {
+		detach();
 		float inv_resolution = __frames / 841.0F;
 		for ( int i = 1; i < p.size(); i++ ) {
 			float y = ( 45 - p[i - 1].value ) / 45.0F;
@@ -426,36 +532,29 @@ void Sample::apply_rubberband( const Rubberband& rb, float fBpm ) {
 	if( !rb.use ){
 		return;
 	}
+	detach();
 	// compute rubberband options
 	double output_duration = 60.0 / fBpm * rb.divider;
 	double time_ratio = output_duration / get_sample_duration();
 	RubberBand::RubberBandStretcher::Options options = compute_rubberband_options( rb );
 	double pitch_scale = compute_pitch_scale( rb );
-	// output buffer
-	//
 	// Sometimes the Rubber Band result is _way_ larger than expected,
-	// e.g. `out_buffer_size` = 1837 and retrieved frames = 11444. No
-	// idea what is going on there but it would make Hydrogen crash if
-	// not accounting for resizing the output buffer. The +10 is in
-	// place to cover the more frequent situations of a difference of
-	// just one frame.
-	int out_buffer_size = static_cast<int>( __frames * time_ratio + 0.1 + 10 );
+	// e.g. an expected size of 1837 and retrieved frames = 11444. The
+	// output buffers therefore grow on demand. The +10 covers the
+	// more frequent situations of a difference of just one frame.
+	std::vector<float> out_data_l;
+	std::vector<float> out_data_r;
+	out_data_l.reserve( static_cast<int>( __frames * time_ratio + 0.1 + 10 ) );
+	out_data_r.reserve( out_data_l.capacity() );
 	// instantiate rubberband
 	RubberBand::RubberBandStretcher rubber = RubberBand::RubberBandStretcher( __sample_rate, 2, options, time_ratio, pitch_scale );
 	rubber.setDebugLevel( RUBBERBAND_DEBUG );
 	// This option will be ignored in real-time processing.
 	rubber.setExpectedInputDuration( __frames );
 
-	int retrieved = 0;
-	//int buffer_free = out_buffer_size;
-	float* out_data_l = new float[ out_buffer_size ];
-	float* out_data_r = new float[ out_buffer_size ];
-	float* out_data_l_tmp;
-	float* out_data_r_tmp;
-
 	DEBUGLOG( QString( "on %1\n\toptions\t\t: %2\n\ttime ratio\t: %3\n\tpitch\t\t: %4" ).arg( get_filename() ).arg( options ).arg( time_ratio ).arg( pitch_scale ) );
 
-	float* ibuf[2];
+	const float* ibuf[2];
 	int block_size = MAX_BUFFER_SIZE;
 
 	// If the RUB button in the player control is activated and
@@ -470,8 +569,18 @@ void Sample::apply_rubberband( const Rubberband& rb, float fBpm ) {
 		rubber.setMaxProcessSize( block_size );
 	}
 
+	// Appends all frames available to the output buffers.
+	auto retrieve = [&]( int available ) {
+		const int retrieved = out_data_l.size();
+		out_data_l.resize( retrieved + available );
+		out_data_r.resize( retrieved + available );
+		float* obuf[2] = { &out_data_l[ retrieved ], &out_data_r[ retrieved ] };
+		const int n = rubber.retrieve( obuf, available );
+		out_data_l.resize( retrieved + n );
+		out_data_r.resize( retrieved + n );
+	};
+
 	// retrieve data
-	float* obuf[2];
 	int processed = 0;
 	int available = 0;
 	int nRequired = 0;
@@ -487,14 +596,9 @@ void Sample::apply_rubberband( const Rubberband& rb, float fBpm ) {
 		}
 		bool final = (processed + nRequired >= __frames);
 		int ibs = (final ? (__frames-processed) : nRequired );
-		float tempIbufL[ibs];
-		float tempIbufR[ibs];
-		for(int i = 0 ; i < ibs; i++) {
-			tempIbufL[i] = __data_l[i + processed];
-			tempIbufR[i] = __data_r[i + processed];
-		}
-		ibuf[0] = tempIbufL;
-		ibuf[1] = tempIbufR;
+		// The input is read in place.
+		ibuf[0] = __data_l + processed;
+		ibuf[1] = __data_r + processed;
 		rubber.process( ibuf, ibs, final );
 		processed += ibs;
 
@@ -503,32 +607,7 @@ void Sample::apply_rubberband( const Rubberband& rb, float fBpm ) {
 		// the stretching is complete will be checked after the parent
 		// while loop.
 		while( (available=rubber.available()) > 0 ) {
-				
-			if ( retrieved + available > out_buffer_size ) {
-				// The buffers defined above are too small.
-				int nNewBufferSize = static_cast<int>( ( retrieved + available ) * 1.2 );
-				WARNINGLOG( QString( "Unexpected output size of stretched Rubber Band sample. Increasing output buffer from [%1] to [%2]" )
-							.arg( out_buffer_size )
-							.arg( nNewBufferSize ) );
-				out_data_l_tmp = new float[ out_buffer_size ];
-				out_data_r_tmp = new float[ out_buffer_size ];
-				memcpy( out_data_l_tmp, out_data_l, out_buffer_size * sizeof( float ) );
-				memcpy( out_data_r_tmp, out_data_r, out_buffer_size * sizeof( float ) );
-				delete [] out_data_l;
-				delete [] out_data_r;
-				out_data_l = new float[ nNewBufferSize ];
-				out_data_r = new float[ nNewBufferSize ];
-				memcpy( out_data_l, out_data_l_tmp, out_buffer_size * sizeof( float ) );
-				memcpy( out_data_r, out_data_r_tmp, out_buffer_size * sizeof( float ) );
-				delete [] out_data_l_tmp;
-				delete [] out_data_r_tmp;
-			}
-				
-			obuf[0] = &out_data_l[retrieved];
-			obuf[1] = &out_data_r[retrieved];
-			int n = rubber.retrieve( obuf, available);
-
-			retrieved += n;
+			retrieve( available );
 		}
 		
 		if( final ){
@@ -540,44 +619,15 @@ void Sample::apply_rubberband( const Rubberband& rb, float fBpm ) {
 	// second run of stretcher to retrieve all last
 	// frames until stretcher returns -1.
 	while( (available=rubber.available())!= -1) {
-			
-		if ( retrieved + available > out_buffer_size ) {
-			// The buffers defined above are too small.
-			int nNewBufferSize = static_cast<int>( ( retrieved + available ) * 1.5 );
-			WARNINGLOG( QString( "Unexpected output size of stretched Rubber Band sample. Increasing output buffer from [%1] to [%2[" )
-						.arg( out_buffer_size )
-						.arg( nNewBufferSize ) );
-			out_data_l_tmp = new float[ out_buffer_size ];
-			out_data_r_tmp = new float[ out_buffer_size ];
-			memcpy( out_data_l_tmp, out_data_l, out_buffer_size * sizeof( float ) );
-			memcpy( out_data_r_tmp, out_data_r, out_buffer_size * sizeof( float ) ); 
-			delete [] out_data_l;
-			delete [] out_data_r;
-			out_data_l = new float[ nNewBufferSize ];
-			out_data_r = new float[ nNewBufferSize ];
-			memcpy( out_data_l, out_data_l_tmp, out_buffer_size * sizeof( float ) );
-			memcpy( out_data_r, out_data_r_tmp, out_buffer_size * sizeof( float ) );
-			delete [] out_data_l_tmp;
-			delete [] out_data_r_tmp;
-
-			out_buffer_size = nNewBufferSize;
-		}
-	
-		obuf[0] = &out_data_l[retrieved];
-		obuf[1] = &out_data_r[retrieved];
-		int n = rubber.retrieve( obuf, available);
-
-		retrieved += n;
+		retrieve( available );
 	}
 	
-	delete [] __data_l;
-	delete [] __data_r;
+	const int retrieved = out_data_l.size();
+	release_data();
 	__data_l = new float[ retrieved ];
 	__data_r = new float[ retrieved ];
-	memcpy( __data_l, out_data_l, retrieved*sizeof( float ) );
-	memcpy( __data_r, out_data_r, retrieved*sizeof( float ) );
-	delete [] out_data_l;
-	delete [] out_data_r;
+	memcpy( __data_l, out_data_l.data(), retrieved*sizeof( float ) );
+	memcpy( __data_r, out_data_r.data(), retrieved*sizeof( float ) );
 
 	// update sample
 	__rubberband = rb;
@@ -597,7 +647,14 @@ bool Sample::exec_rubberband_cli( const Rubberband& rb, float fBpm )
 	}
 
 	if( rb.use ) {
-		QString outfilePath =  QDir::tempPath() + "/tmp_rb_outfile.wav";
+		// Samples are stretched concurrently (see SampleStretcher).
+		// Each call therefore uses files of its own.
+		QTemporaryDir tmpDir;
+		if ( ! tmpDir.isValid() ) {
+			ERRORLOG( "unable to create temporary directory" );
+			return false;
+		}
+		QString outfilePath = tmpDir.filePath( "tmp_rb_outfile.wav" );
 		if( !write( outfilePath ) ) {
 			ERRORLOG( "unable to write sample" );
 			return false;
@@ -614,14 +671,13 @@ bool Sample::exec_rubberband_cli( const Rubberband& rb, float fBpm )
 		rubberoutframes = int( __frames * ratio + 0.1 );
 		_INFOLOG( QString( "ratio: %1, rubberoutframes: %2, rubberinframes: %3" ).arg( ratio ).arg ( rubberoutframes ).arg ( __frames ) );
 
-		QObject*	pParent = nullptr;
-		QProcess*	pRubberbandProc = new QProcess( pParent );
+		QProcess rubberbandProc;
 
 		QStringList arguments;
 		QString rCs = QString( " %1" ).arg( rb.c_settings );
 		float fFrequency = Note::pitchToFrequency( ( double )rb.pitch );
 		QString rFs = QString( " %1" ).arg( fFrequency );
-		QString rubberResultPath = QDir::tempPath() + "/tmp_rb_result_file.wav";
+		QString rubberResultPath = tmpDir.filePath( "tmp_rb_result_file.wav" );
 
 		arguments << "-D" << QString( " %1" ).arg( durationtime ) 	//stretch or squash to make output file X seconds long
 		          << "--threads"					//assume multi-CPU even if only one CPU is identified
@@ -631,34 +687,22 @@ bool Sample::exec_rubberband_cli( const Rubberband& rb, float fBpm )
 		          << outfilePath 					//infile
 		          << rubberResultPath;					//outfile
 
-		pRubberbandProc->start( program, arguments );
-
-		while( pRubberbandProc->state() != QProcess::NotRunning 
-			   && !pRubberbandProc->waitForFinished() ) {
-			//_ERRORLOG( QString( "processing" ));
-		}
+		rubberbandProc.start( program, arguments );
+		rubberbandProc.waitForFinished( -1 );
 
-		delete pRubberbandProc;
 		if ( QFile( rubberResultPath ).exists() == false ) {
 			_ERRORLOG( QString( "Rubberband reimporter File %1 not found" ).arg( rubberResultPath ) );
 			return false;
 		}
 
-		auto p_Rubberbanded = Sample::load( rubberResultPath.toLocal8Bit() );
-		if( p_Rubberbanded == nullptr ) {
+		// Temporary file. Not worth caching.
+		auto pRubberbanded = SampleBuffer::decode( rubberResultPath );
+		if( pRubberbanded == nullptr ) {
 			return false;
 		}
 
-		QFile( outfilePath ).remove();
-
-		QFile( rubberResultPath ).remove();
-
-		__frames = p_Rubberbanded->get_frames();
-
-		__data_l = p_Rubberbanded->get_data_l();
-		__data_r = p_Rubberbanded->get_data_r();
-		p_Rubberbanded->__data_l = nullptr;
-		p_Rubberbanded->__data_r = nullptr;
+		// The temporary files are removed along with tmpDir.
+		assign_buffer( pRubberbanded );
 
 		__is_modified = true;
 		__rubberband = rb;
@@ -666,6 +710,28 @@ bool Sample::exec_rubberband_cli( const Rubberband& rb, float fBpm )
 	return true;
 }
 
+std::shared_ptr<Sample> Sample::stretch( std::shared_ptr<Sample> pSource, float fBpm )
+{
+	if ( pSource->__unstretched != nullptr ) {
+		pSource = pSource->__unstretched;
+	}
+	const Rubberband rb = pSource->__rubberband;
+	if ( ! rb.use || pSource->is_empty() ) {
+		return nullptr;
+	}
+
+	auto pStretched = std::make_shared<Sample>( pSource );
+#ifdef H2CORE_HAVE_RUBBERBAND
+	pStretched->apply_rubberband( rb, fBpm );
+#else
+	if ( ! pStretched->exec_rubberband_cli( rb, fBpm ) ) {
+		return nullptr;
+	}
+#endif
+	pStretched->__unstretched = pSource;
+	return pStretched;
+}
+
 Sample::Loops::LoopMode Sample::parse_loop_mode( const QString& sMode )
 {
 	if ( sMode == "forward" ) {
@@ -681,24 +747,6 @@ Sample::Loops::LoopMode Sample::parse_loop_mode( const QString& sMode )
 
 bool Sample::write( const QString& path, int format )
 {
-	float* obuf = new float[ SAMPLE_CHANNELS * __frames ];
-	for ( int i = 0; i < __frames; ++i ) {
-		float value_l = __data_l[i];
-		float value_r = __data_r[i];
-		
-		if ( value_l > 1.f ) {
-			value_l = 1.f;
-		} else if ( value_l < -1.f ) {
-			value_l = -1.f;
-		} else if ( value_r > 1.f ) {
-			value_r = 1.f;
-		} else if ( value_r < -1.f ) {
-			value_r = -1.f;
-		}
-		
-		obuf[ i* SAMPLE_CHANNELS + 0 ] = value_l;
-		obuf[ i* SAMPLE_CHANNELS + 1 ] = value_r;
-	}
 	SF_INFO sf_info;
 	sf_info.channels = SAMPLE_CHANNELS;
 	sf_info.frames = __frames;
@@ -706,7 +754,6 @@ bool Sample::write( const QString& path, int format )
 	sf_info.format = format;
 	if ( !sf_format_check( &sf_info ) ) {
 		___ERRORLOG( "SF_INFO error" );
-		delete[] obuf;
 		return false;
 	}
 
@@ -714,22 +761,35 @@ bool Sample::write( const QString& path, int format )
 
 	if ( sf_file==nullptr ) {
 		___ERRORLOG( QString( "sf_open error : %1" ).arg( sf_strerror( sf_file ) ) );
-		sf_close( sf_file );
-		delete[] obuf;
 		return false;
 	}
 
-	sf_count_t res = sf_writef_float( sf_file, obuf, __frames );
+	// The sample is clipped and interleaved one chunk at a time
+	// instead of copying it as a whole.
+	const int nChunkFrames = SampleBuffer::nChunkFrames;
+	std::vector<float> clipped( 2 * nChunkFrames );
+	std::vector<float> obuf( SAMPLE_CHANNELS * nChunkFrames );
+	const float* pData_L = get_data_l();
+	const float* pData_R = get_data_r();
+	for ( int nFrame = 0; nFrame < __frames; nFrame += nChunkFrames ) {
+		const int nFrames = std::min( nChunkFrames, __frames - nFrame );
+		float* pClipped_L = clipped.data();
+		float* pClipped_R = clipped.data() + nChunkFrames;
+		for ( int i = 0; i < nFrames; ++i ) {
+			pClipped_L[ i ] = std::clamp( pData_L[ nFrame + i ], -1.f, 1.f );
+			pClipped_R[ i ] = std::clamp( pData_R[ nFrame + i ], -1.f, 1.f );
+		}
+		Mixing::interleave( pClipped_L, pClipped_R, obuf.data(), nFrames );
 
-	if ( res<=0 ) {
-		___ERRORLOG( QString( "sf_writef_float error : %1" ).arg( sf_strerror( sf_file ) ) );
-		sf_close( sf_file );
-		delete[] obuf;
-		return false;
+		sf_count_t res = sf_writef_float( sf_file, obuf.data(), nFrames );
+		if ( res<=0 ) {
+			___ERRORLOG( QString( "sf_writef_float error : %1" ).arg( sf_strerror( sf_file ) ) );
+			sf_close( sf_file );
+			return false;
+		}
 	}
 
 	sf_close( sf_file );
-	delete[] obuf;
 	return true;
 }
 
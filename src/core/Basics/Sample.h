@@ -28,6 +28,7 @@
 #include <sndfile.h>
 
 #include <core/Object.h>
+#include <core/Basics/SampleBuffer.h>
 
 namespace H2Core
 {
@@ -166,6 +167,17 @@ class Sample : public H2Core::Object<Sample>
 		 * \fn load(const QString& filepath)
 		 */
 		static std::shared_ptr<Sample> load( const QString& filepath);
+
+		/**
+		 * Initializes a new Sample without loading its data, which
+		 * is done on first use instead (see
+		 * InstrumentLayer::defer_sample()).
+		 *
+		 * \param filepath the file to load audio data from later on
+		 *
+		 * \return nullptr if @a filepath is not readable.
+		 */
+		static std::shared_ptr<Sample> create_deferred( const QString& filepath );
 	
 		/**
 		 * Load a sample from a file and apply the
@@ -180,7 +192,8 @@ class Sample : public H2Core::Object<Sample>
 		 *
 		 * \return Pointer to the newly initialized Sample. If
 		 * the provided @a filepath is not readable, a nullptr
-		 * is returned instead.
+		 * is returned instead. If Rubber Band was applied, the
+		 * result keeps the unstretched sample (see stretch()).
 		 *
 		 * \overload load(const QString& filepath, const Loops& loops, const Rubberband& rubber, const VelocityEnvelope& velocity, const PanEnvelope& pan)
 		 */
@@ -188,7 +201,7 @@ class Sample : public H2Core::Object<Sample>
 
 		/**
 		 * Load the sample stored in #__filepath into
-		 * #__data_l and #__data_r.
+		 * #__buffer.
 		 *
 		 * It uses libsndfile for reading both the content and
 		 * the metadata of the sample file. The latter is
@@ -198,18 +211,29 @@ class Sample : public H2Core::Object<Sample>
 		 * (two per default) channels in the audio file. If
 		 * there are more, Hydrogen will _NOT_ downmix its
 		 * content but simply extract the first two channels
-		 * and display a warning message. For mono file the
-		 * same content will be assigned to both the left
-		 * (#__data_l) and right channel (#__data_r).
+		 * and display a warning message. Mono files are
+		 * stored as a single channel, which is returned for
+		 * both the left (get_data_l()) and right channel
+		 * (get_data_r()).
 		 *
 		 * If the total number of frames in the file is larger
 		 * than the maximum value of an `int', the content is
 		 * truncated and a warning log message will be
 		 * displayed.
 		 *
+		 * The decoded content is retrieved via the SampleCache
+		 * and shared with all other Samples loaded from the
+		 * same file until it gets modified.
+		 *
+		 * \param bAllowStreaming Whether the sample may be
+		 * streamed from disk in case
+		 * Preferences::m_bDiskStreaming is enabled. Only the
+		 * first Preferences::m_nStreamingHeadFrames frames are
+		 * kept in memory then (see is_streamed()).
+		 *
 		 * \fn load()
 		 */
-		bool load();
+		bool load( bool bAllowStreaming = false );
 		/**
 		 * Flush the current content of the left and right
 		 * channel and the current metadata.
@@ -264,9 +288,47 @@ class Sample : public H2Core::Object<Sample>
 		 * \param fBpm tempo the Rubberband transformation will target
 		 */
 		bool exec_rubberband_cli( const Rubberband& rb, float fBpm );
+		/**
+		 * Time-stretches @a pSource to @a fBpm according to its
+		 * Rubberband parameters using apply_rubberband() or
+		 * exec_rubberband_cli().
+		 *
+		 * Safe to be called concurrently for different samples.
+		 * Not real-time safe.
+		 *
+		 * \return Stretched copy of @a pSource, or of the sample
+		 * it was stretched from itself, or nullptr if Rubber Band
+		 * is not used or failed.
+		 */
+		static std::shared_ptr<Sample> stretch( std::shared_ptr<Sample> pSource, float fBpm );
+		/**
+		 * Converts the sample to @a nSampleRate using a
+		 * band-limited SincResampler (see
+		 * Preferences::m_bResampleOnLoad).
+		 *
+		 * Unmodified samples are resampled from the original
+		 * file and the result is shared via the SampleCache.
+		 * Modified ones convert their current content. To be
+		 * called after all other transformations since their
+		 * parameters, like the loop frames, refer to the
+		 * original rate. Not real-time safe.
+		 *
+		 * \return false if the sample is empty, streamed from
+		 * disk, which is always read at its original rate, or
+		 * the file could not be read.
+		 */
+		bool resample( int nSampleRate );
 
-		/** \return true if both data channels are null pointers */
+		/** \return true if the sample does not hold any data */
 		bool is_empty() const;
+		/** \return true if only the first
+		 * get_resident_frames() frames are kept in memory and
+		 * the remainder has to be read from disk (see
+		 * DiskStreamer).*/
+		bool is_streamed() const;
+		/** \return Number of frames kept in memory. Equals
+		 * #__frames unless the sample is streamed.*/
+		int get_resident_frames() const;
 		/** \return #__filepath */
 		const QString get_filepath() const;
 		/** \return Filename part of #__filepath */
@@ -289,14 +351,39 @@ class Sample : public H2Core::Object<Sample>
 		/** \return sample duration in seconds */
 		double get_sample_duration( ) const;
 	
-		/** \return data size, which is calculated by
-		 * #__frames time sizeof( float ) * 2 
+		/** \return data size in bytes. #__frames time sizeof(
+		 * float ) * 2 unless the sample is stored in a compact
+		 * format (see SampleBuffer). Only the resident part of
+		 * streamed samples is taken into account.
 		 */
 		int get_size() const;
-		/** \return #__data_l*/
+		/** \return 1 for mono and 2 for stereo samples. Modified
+		 * samples are always stereo.*/
+		int get_channels() const;
+		/**
+		 * \return #__data_l
+		 *
+		 * Samples stored in a compact format are converted into
+		 * float on first access. Streamed samples are decoded
+		 * from disk in their entirety. This is neither real-time
+		 * safe nor thread-safe. The audio thread has to use
+		 * visit_data() instead.
+		 */
 		float* get_data_l() const;
-		/** \return #__data_r*/
+		/** \return #__data_r. See get_data_l().*/
 		float* get_data_r() const;
+		/**
+		 * Calls @a function with two readers providing float access
+		 * to the left and right channel via operator[] regardless of
+		 * the format the data is stored in (see
+		 * SampleBuffer::Reader). @a function has to be a generic
+		 * lambda and is instantiated for each format.
+		 *
+		 * For streamed samples only the first
+		 * get_resident_frames() frames can be read.
+		 */
+		template <typename Function>
+		void visit_data( Function&& function ) const;
 		/**
 		 * #__is_modified setter
 		 * \param value the new value for #__is_modified
@@ -312,6 +399,11 @@ class Sample : public H2Core::Object<Sample>
 		Loops get_loops() const;
 		/** \return #__rubberband parameters */
 		Rubberband get_rubberband() const;
+		/** Sets the #__rubberband parameters without applying
+		 * them (see stretch()).*/
+		void set_rubberband( const Rubberband& rb );
+		/** \return #__unstretched */
+		std::shared_ptr<Sample> get_unstretched() const;
 		/**
 		 * parse the given string and rturn the corresponding loop_mode
 		 * \param string the loop mode text to be parsed
@@ -332,13 +424,43 @@ class Sample : public H2Core::Object<Sample>
 		QString				__filepath;          ///< filepath of the sample
 		int					__frames;            ///< number of frames in this sample
 		int					__sample_rate;       ///< samplerate for this sample
-		float*				__data_l;            ///< left channel data
-		float*				__data_r;            ///< right channel data
+		mutable float*		__data_l;            ///< left channel data
+		mutable float*		__data_r;            ///< right channel data
 		bool				__is_modified;       ///< true if sample is modified
 		PanEnvelope			__pan_envelope;      ///< pan envelope vector
 		VelocityEnvelope	__velocity_envelope; ///< velocity envelope vector
 		Loops				__loops;             ///< set of loop parameters
 		Rubberband			__rubberband;        ///< set of rubberband parameters
+		/** Sample the content was created from by stretch(). Kept
+		 * to stretch it again on tempo changes. nullptr if the
+		 * sample was not stretched.*/
+		std::shared_ptr<Sample> __unstretched;
+		/**
+		 * Decoded content shared with all other Samples loaded from
+		 * the same file (see SampleCache). As long as it is set
+		 * #__data_l and #__data_r are not owned by this Sample and
+		 * must not be written to. They either point into the buffer
+		 * or, for compact formats, into #__expanded_data once
+		 * requested.
+		 */
+		std::shared_ptr<SampleBuffer> __buffer;
+		/** Float version of a #__buffer in a compact format created
+		 * by get_data_l() or get_data_r().*/
+		mutable std::unique_ptr<float[]> __expanded_data[ 2 ];
+		/** Sets #__buffer and the data and metadata derived from
+		 * it.*/
+		void assign_buffer( std::shared_ptr<SampleBuffer> pBuffer );
+		/** \return #__buffer if it is complete. The whole file
+		 * decoded again otherwise.*/
+		std::shared_ptr<SampleBuffer> get_complete_buffer() const;
+		/** Creates #__expanded_data.*/
+		void expand_data() const;
+		/** Replaces a shared #__buffer by a float stereo copy of its
+		 * content owned by this Sample. To be called before
+		 * altering the data.*/
+		void detach();
+		/** Frees or releases #__data_l and #__data_r.*/
+		void release_data();
 		/** loop modes string */
 		static const std::vector<QString> __loop_modes;
 };
@@ -347,23 +469,28 @@ class Sample : public H2Core::Object<Sample>
 
 inline void Sample::unload()
 {
-	if ( __data_l != nullptr ) {
-		delete [] __data_l;
-	}
-	
-	if ( __data_r != nullptr ) {
-		delete [] __data_r;
-	}
+	release_data();
 	__frames = __sample_rate = 0;
 	/** #__is_modified = false; leave this unchanged as pan,
 	    velocity, loop and rubberband are kept unchanged */
-
-	__data_l = __data_r = nullptr;
 }
 
 inline bool Sample::is_empty() const
 {
-	return ( __data_l == 0 && __data_r == 0 );
+	return ( __buffer == nullptr && __data_l == 0 && __data_r == 0 );
+}
+
+inline bool Sample::is_streamed() const
+{
+	return __buffer != nullptr && __buffer->getFrames() < __frames;
+}
+
+inline int Sample::get_resident_frames() const
+{
+	if ( __buffer != nullptr ) {
+		return __buffer->getFrames();
+	}
+	return __frames;
 }
 
 inline const QString Sample::get_filepath() const
@@ -403,19 +530,65 @@ inline double Sample::get_sample_duration() const
 
 inline int Sample::get_size() const
 {
+	if ( __buffer != nullptr ) {
+		return __buffer->getSize();
+	}
 	return __frames * sizeof( float ) * 2;
 }
 
+inline int Sample::get_channels() const
+{
+	if ( __buffer != nullptr ) {
+		return __buffer->getChannels();
+	}
+	return 2;
+}
+
 inline float* Sample::get_data_l() const
 {
+	if ( __data_l == nullptr && __buffer != nullptr ) {
+		expand_data();
+	}
 	return __data_l;
 }
 
 inline float* Sample::get_data_r() const
 {
+	if ( __data_r == nullptr && __buffer != nullptr ) {
+		expand_data();
+	}
 	return __data_r;
 }
 
+template <typename Function>
+inline void Sample::visit_data( Function&& function ) const
+{
+	using Format = SampleBuffer::Format;
+	if ( __buffer == nullptr ) {
+		function( SampleBuffer::Reader<Format::Float>{ __data_l },
+				  SampleBuffer::Reader<Format::Float>{ __data_r } );
+		return;
+	}
+
+	switch ( __buffer->getFormat() ) {
+	case Format::Int16:
+		function( __buffer->getReader<Format::Int16>( 0 ),
+				  __buffer->getReader<Format::Int16>( 1 ) );
+		break;
+	case Format::Int24:
+		function( __buffer->getReader<Format::Int24>( 0 ),
+				  __buffer->getReader<Format::Int24>( 1 ) );
+		break;
+	case Format::Half:
+		function( __buffer->getReader<Format::Half>( 0 ),
+				  __buffer->getReader<Format::Half>( 1 ) );
+		break;
+	default:
+		function( __buffer->getReader<Format::Float>( 0 ),
+				  __buffer->getReader<Format::Float>( 1 ) );
+	}
+}
+
 inline void Sample::set_is_modified( bool is_modified )
 {
 	__is_modified = is_modified;
@@ -451,6 +624,16 @@ inline Sample::Rubberband Sample::get_rubberband() const
 	return __rubberband;
 }
 
+inline void Sample::set_rubberband( const Rubberband& rb )
+{
+	__rubberband = rb;
+}
+
+inline std::shared_ptr<Sample> Sample::get_unstretched() const
+{
+	return __unstretched;
+}
+
 };
 
 #endif // H2C_SAMPLE_H
@@ -0,0 +1,376 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/Basics/SampleBuffer.h>
+#include <core/AudioEngine/Mixing.h>
+#include <core/Globals.h>
+#include <core/Sampler/SincResampler.h>
+
+#include <sndfile.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace H2Core
+{
+
+SampleBuffer::SampleBuffer( int nFrames, int nSampleRate, int nChannels, Format format )
+	: m_nFrames( nFrames )
+	, m_nFileFrames( nFrames )
+	, m_nSampleRate( nSampleRate )
+	, m_nChannels( nChannels )
+	, m_format( format )
+	, m_pChannels{ nullptr, nullptr }
+{
+	assert( nChannels == 1 || nChannels == 2 );
+	assert( format != Format::Auto );
+
+	// Always allocate at least one byte. Empty samples are still
+	// represented by a valid pointer.
+	const size_t nBytes = std::max<size_t>(
+		1, static_cast<size_t>( nFrames ) * getBytesPerSample( format ) );
+	for ( int nChannel = 0; nChannel < nChannels; ++nChannel ) {
+		m_data[ nChannel ].resize( nBytes, 0 );
+		m_pChannels[ nChannel ] = m_data[ nChannel ].data();
+	}
+}
+
+std::shared_ptr<SampleBuffer> SampleBuffer::decode( const QString& sFilepath, Format format,
+													int nMaxFrames )
+{
+	// Will contain a bunch of metadata about the loaded sample.
+	SF_INFO sound_info = {0};
+
+	// Opens file in read-only mode.
+	SNDFILE* file = sf_open( sFilepath.toLocal8Bit(), SFM_READ, &sound_info );
+	if ( !file ) {
+		ERRORLOG( QString( "Error loading file %1" ).arg( sFilepath ) );
+		return nullptr;
+	}
+
+	// Sanity check. SAMPLE_CHANNELS is defined in core/Globals.h
+	// and set to 2.
+	const int nFileChannels = sound_info.channels;
+	if ( nFileChannels > SAMPLE_CHANNELS ) {
+		WARNINGLOG( QString( "can't handle %1 channels, only 2 will be used" ).arg( nFileChannels ) );
+	}
+	if ( sound_info.frames > ( std::numeric_limits<int>::max()/nFileChannels ) ) {
+		WARNINGLOG( QString( "sample frames count (%1) and channels (%2) are too much, truncate it." ).arg( sound_info.frames ).arg( nFileChannels ) );
+		sound_info.frames = ( std::numeric_limits<int>::max()/nFileChannels );
+	}
+
+	if ( format == Format::Auto ) {
+		switch ( sound_info.format & SF_FORMAT_SUBMASK ) {
+		case SF_FORMAT_PCM_S8:
+		case SF_FORMAT_PCM_U8:
+		case SF_FORMAT_PCM_16:
+			format = Format::Int16;
+			break;
+		case SF_FORMAT_PCM_24:
+			format = Format::Int24;
+			break;
+		default:
+			format = Format::Float;
+		}
+	}
+
+	int nFrames = sound_info.frames;
+	if ( nMaxFrames > 0 && nFrames > nMaxFrames ) {
+		nFrames = nMaxFrames;
+	}
+	auto pBuffer = std::make_shared<SampleBuffer>(
+		nFrames, sound_info.samplerate,
+		std::min( nFileChannels, SAMPLE_CHANNELS ), format );
+	pBuffer->m_nFileFrames = sound_info.frames;
+
+	// Read the file in chunks and convert each one straight into the
+	// planar storage of the buffer. Libsndfile does seamlessly
+	// convert the format of the underlying data on the fly. Integer
+	// formats are read as integers to not lose any precision.
+	sf_count_t count = 0;
+	auto readChunks = [&]( auto* pChunk, auto readFrames ) {
+		while ( count < nFrames ) {
+			const sf_count_t nChunk = readFrames(
+				file, pChunk, std::min<sf_count_t>( nChunkFrames, nFrames - count ) );
+			if ( nChunk <= 0 ) {
+				break;
+			}
+			pBuffer->store( pChunk, nFileChannels, nChunk, count );
+			count += nChunk;
+		}
+	};
+	const size_t nChunkValues = static_cast<size_t>( nChunkFrames ) * nFileChannels;
+	if ( format == Format::Int16 ) {
+		std::vector<short> chunk( nChunkValues );
+		readChunks( chunk.data(), sf_readf_short );
+	} else if ( format == Format::Int24 ) {
+		std::vector<int> chunk( nChunkValues );
+		readChunks( chunk.data(), sf_readf_int );
+	} else {
+		std::vector<float> chunk( nChunkValues );
+		readChunks( chunk.data(), sf_readf_float );
+	}
+	if( count==0 ){
+		WARNINGLOG( QString( "%1 is an empty sample" ).arg( sFilepath ) );
+	}
+
+	// Deallocate the handler.
+	if ( sf_close( file ) != 0 ){
+		WARNINGLOG( QString( "Unable to close sample file %1" ).arg( sFilepath ) );
+	}
+
+	return pBuffer;
+}
+
+std::shared_ptr<SampleBuffer> SampleBuffer::resample( int nSampleRate ) const
+{
+	assert( isComplete() );
+
+	const SincResampler resampler( m_nSampleRate, nSampleRate );
+	const int nFrames = resampler.getOutputFrames( m_nFrames );
+	auto pBuffer = std::make_shared<SampleBuffer>( nFrames, nSampleRate, m_nChannels, m_format );
+
+	std::vector<float> source( m_nFrames );
+	std::vector<float> resampled( nFrames );
+	std::vector<float> interleaved( static_cast<size_t>( nFrames ) * m_nChannels );
+	for ( int nChannel = 0; nChannel < m_nChannels; ++nChannel ) {
+		toFloat( nChannel, source.data() );
+		resampler.process( source.data(), m_nFrames, resampled.data(), nFrames );
+		for ( int ii = 0; ii < nFrames; ++ii ) {
+			interleaved[ ii * m_nChannels + nChannel ] = resampled[ ii ];
+		}
+	}
+	pBuffer->store( interleaved.data(), m_nChannels, nFrames );
+
+	return pBuffer;
+}
+
+template <typename T>
+void SampleBuffer::store( const T* pSource, int nSourceChannels, int nFrames, int nOffset )
+{
+	if constexpr ( std::is_same_v<T, float> ) {
+		if ( m_format == Format::Float ) {
+			float* pDest_L = reinterpret_cast<float*>( m_pChannels[ 0 ] ) + nOffset;
+			if ( m_nChannels == 1 && nSourceChannels == 1 ) {
+				memcpy( pDest_L, pSource, nFrames * sizeof( float ) );
+				return;
+			}
+			if ( m_nChannels == 2 && nSourceChannels == 2 ) {
+				float* pDest_R = reinterpret_cast<float*>( m_pChannels[ 1 ] ) + nOffset;
+				Mixing::deinterleave( pSource, pDest_L, pDest_R, nFrames );
+				return;
+			}
+		}
+	}
+
+	// The format is checked once per channel to keep the loops free
+	// of branches.
+	for ( int nChannel = 0; nChannel < m_nChannels; ++nChannel ) {
+		uint8_t* pDest = m_pChannels[ nChannel ];
+		const T* pIn = pSource + nChannel;
+
+		if constexpr ( std::is_same_v<T, short> ) {
+			// Only read for Format::Int16.
+			int16_t* pOut = reinterpret_cast<int16_t*>( pDest ) + nOffset;
+			for ( int ii = 0; ii < nFrames; ++ii ) {
+				pOut[ ii ] = pIn[ ii * nSourceChannels ];
+			}
+		}
+		else if constexpr ( std::is_same_v<T, int> ) {
+			// Libsndfile left-aligns all integers. Only the upper
+			// three bytes are kept.
+			uint8_t* pOut = pDest + 3 * static_cast<size_t>( nOffset );
+			for ( int ii = 0; ii < nFrames; ++ii ) {
+				const uint32_t nValue = static_cast<uint32_t>( pIn[ ii * nSourceChannels ] );
+				pOut[ 3 * ii ] = ( nValue >> 8 ) & 0xff;
+				pOut[ 3 * ii + 1 ] = ( nValue >> 16 ) & 0xff;
+				pOut[ 3 * ii + 2 ] = ( nValue >> 24 ) & 0xff;
+			}
+		}
+		else if ( m_format == Format::Half ) {
+			uint16_t* pOut = reinterpret_cast<uint16_t*>( pDest ) + nOffset;
+			for ( int ii = 0; ii < nFrames; ++ii ) {
+				pOut[ ii ] = floatToHalf( pIn[ ii * nSourceChannels ] );
+			}
+		}
+		else if ( m_format == Format::Int16 ) {
+			// Only reached for resampled content.
+			int16_t* pOut = reinterpret_cast<int16_t*>( pDest ) + nOffset;
+			for ( int ii = 0; ii < nFrames; ++ii ) {
+				const float fValue = std::clamp( pIn[ ii * nSourceChannels ] * 0x8000,
+												 -32768.0f, 32767.0f );
+				pOut[ ii ] = static_cast<int16_t>( std::lrint( fValue ) );
+			}
+		}
+		else if ( m_format == Format::Int24 ) {
+			uint8_t* pOut = pDest + 3 * static_cast<size_t>( nOffset );
+			for ( int ii = 0; ii < nFrames; ++ii ) {
+				const float fValue = std::clamp( pIn[ ii * nSourceChannels ] * 0x800000,
+												 -8388608.0f, 8388607.0f );
+				const uint32_t nValue = static_cast<uint32_t>( std::lrint( fValue ) );
+				pOut[ 3 * ii ] = nValue & 0xff;
+				pOut[ 3 * ii + 1 ] = ( nValue >> 8 ) & 0xff;
+				pOut[ 3 * ii + 2 ] = ( nValue >> 16 ) & 0xff;
+			}
+		}
+		else {
+			float* pOut = reinterpret_cast<float*>( pDest ) + nOffset;
+			for ( int ii = 0; ii < nFrames; ++ii ) {
+				pOut[ ii ] = pIn[ ii * nSourceChannels ];
+			}
+		}
+	}
+}
+
+void SampleBuffer::toFloat( int nChannel, float* pDest ) const
+{
+	switch ( m_format ) {
+	case Format::Int16: {
+		const auto reader = getReader<Format::Int16>( nChannel );
+		for ( int ii = 0; ii < m_nFrames; ++ii ) {
+			pDest[ ii ] = reader[ ii ];
+		}
+		break;
+	}
+	case Format::Int24: {
+		const auto reader = getReader<Format::Int24>( nChannel );
+		for ( int ii = 0; ii < m_nFrames; ++ii ) {
+			pDest[ ii ] = reader[ ii ];
+		}
+		break;
+	}
+	case Format::Half: {
+		const auto reader = getReader<Format::Half>( nChannel );
+		for ( int ii = 0; ii < m_nFrames; ++ii ) {
+			pDest[ ii ] = reader[ ii ];
+		}
+		break;
+	}
+	default:
+		memcpy( pDest, getData( nChannel ), m_nFrames * sizeof( float ) );
+	}
+}
+
+size_t SampleBuffer::getBytesPerSample( Format format )
+{
+	switch ( format ) {
+	case Format::Int16:
+	case Format::Half:
+		return 2;
+	case Format::Int24:
+		return 3;
+	default:
+		return sizeof( float );
+	}
+}
+
+QString SampleBuffer::formatToQString( Format format )
+{
+	switch ( format ) {
+	case Format::Float:
+		return "float";
+	case Format::Int16:
+		return "int16";
+	case Format::Int24:
+		return "int24";
+	case Format::Half:
+		return "half";
+	default:
+		return "auto";
+	}
+}
+
+SampleBuffer::Format SampleBuffer::parseFormat( const QString& sFormat )
+{
+	if ( sFormat == "float" ) {
+		return Format::Float;
+	} else if ( sFormat == "int16" ) {
+		return Format::Int16;
+	} else if ( sFormat == "int24" ) {
+		return Format::Int24;
+	} else if ( sFormat == "half" ) {
+		return Format::Half;
+	}
+
+	return Format::Auto;
+}
+
+uint16_t SampleBuffer::floatToHalf( float fValue )
+{
+	uint32_t nBits;
+	memcpy( &nBits, &fValue, sizeof( float ) );
+
+	const uint16_t nSign = ( nBits >> 16 ) & 0x8000;
+	const uint32_t nAbs = nBits & 0x7fffffff;
+
+	if ( nAbs >= 0x7f800000 ) {
+		// Infinity and NaN
+		return nSign | 0x7c00 | ( nAbs > 0x7f800000 ? 0x200 : 0 );
+	}
+	if ( nAbs >= 0x477ff000 ) {
+		// Too large to be represented. Rounds to infinity.
+		return nSign | 0x7c00;
+	}
+	if ( nAbs < 0x38800000 ) {
+		// Subnormal numbers in half precision. The mantissa is the
+		// value in multiples of 2^-24. A result of 0x400 is the
+		// smallest normal number.
+		float fAbs;
+		memcpy( &fAbs, &nAbs, sizeof( float ) );
+		return nSign | static_cast<uint16_t>( std::nearbyint( fAbs * ( 1 << 24 ) ) );
+	}
+
+	// Rebias the exponent and round the mantissa to nearest even. A
+	// carry propagates into the exponent as intended.
+	uint32_t nHalf = ( ( ( nAbs >> 23 ) - 112 ) << 10 ) | ( ( nAbs >> 13 ) & 0x3ff );
+	const uint32_t nRemainder = nAbs & 0x1fff;
+	if ( nRemainder > 0x1000 || ( nRemainder == 0x1000 && ( nHalf & 1 ) ) ) {
+		++nHalf;
+	}
+	return nSign | static_cast<uint16_t>( nHalf );
+}
+
+QString SampleBuffer::toQString( const QString& sPrefix, bool bShort ) const {
+	QString s = Base::sPrintIndention;
+	QString sOutput;
+	if ( ! bShort ) {
+		sOutput = QString( "%1[SampleBuffer]\n" ).arg( sPrefix )
+			.append( QString( "%1%2frames: %3\n" ).arg( sPrefix ).arg( s ).arg( m_nFrames ) )
+			.append( QString( "%1%2file_frames: %3\n" ).arg( sPrefix ).arg( s ).arg( m_nFileFrames ) )
+			.append( QString( "%1%2sample_rate: %3\n" ).arg( sPrefix ).arg( s ).arg( m_nSampleRate ) )
+			.append( QString( "%1%2channels: %3\n" ).arg( sPrefix ).arg( s ).arg( m_nChannels ) )
+			.append( QString( "%1%2format: %3\n" ).arg( sPrefix ).arg( s ).arg( formatToQString( m_format ) ) )
+			.append( QString( "%1%2mapped: %3\n" ).arg( sPrefix ).arg( s ).arg( isMapped() ) );
+	} else {
+		sOutput = QString( "[SampleBuffer]" )
+			.append( QString( " frames: %1" ).arg( m_nFrames ) )
+			.append( QString( ", file_frames: %1" ).arg( m_nFileFrames ) )
+			.append( QString( ", sample_rate: %1" ).arg( m_nSampleRate ) )
+			.append( QString( ", channels: %1" ).arg( m_nChannels ) )
+			.append( QString( ", format: %1" ).arg( formatToQString( m_format ) ) )
+			.append( QString( ", mapped: %1" ).arg( isMapped() ) );
+	}
+	return sOutput;
+}
+
+};
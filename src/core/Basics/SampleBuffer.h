@@ -0,0 +1,287 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2C_SAMPLE_BUFFER_H
+#define H2C_SAMPLE_BUFFER_H
+
+#include <core/Object.h>
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace H2Core
+{
+
+class SampleDiskCache;
+
+/**
+ * Decoded content of a sample file.
+ *
+ * Mono files are stored as a single channel which is returned for
+ * both the left and the right one. The content is kept either as
+ * 32 bit float or in one of the compact formats below and converted
+ * to float while reading (see Reader).
+ *
+ * Once handed out by the SampleCache the buffer is shared by all
+ * Samples loaded from the same file and must not be altered
+ * anymore. Samples convert it into a float copy of their own prior
+ * to applying any modification (see Sample::detach()).
+ *
+ * \ingroup docCore
+ */
+class SampleBuffer : public H2Core::Object<SampleBuffer>
+{
+	H2_OBJECT(SampleBuffer)
+public:
+	enum class Format {
+		/** 32 bit float.*/
+		Float,
+		/** 16 bit signed integer.*/
+		Int16,
+		/** 24 bit signed integer packed into three bytes (little
+		 * endian).*/
+		Int24,
+		/** IEEE 754 half-precision float.*/
+		Half,
+		/** Only valid as argument of decode(). Picks the most
+		 * compact format representing the content of the file
+		 * without any loss.*/
+		Auto
+	};
+
+	/**
+	 * Provides float access to a single channel stored in @a
+	 * format via operator[]. Used by the render loops of the
+	 * Sampler, which are instantiated for each format.
+	 */
+	template <Format format>
+	struct Reader;
+
+	/** Allocates zero-initialized storage.*/
+	SampleBuffer( int nFrames, int nSampleRate, int nChannels, Format format );
+
+	SampleBuffer( const SampleBuffer& ) = delete;
+	SampleBuffer& operator=( const SampleBuffer& ) = delete;
+
+	/**
+	 * Decodes @a sFilepath using libsndfile and stores its content
+	 * in @a format.
+	 *
+	 * Only the first #SAMPLE_CHANNELS channels are used. The file is
+	 * read in chunks of #nChunkFrames frames, each of which is
+	 * converted into the planar storage right away. Apart from the
+	 * buffer itself only a single chunk is allocated.
+	 *
+	 * \param nMaxFrames If larger than 0, only the first @a
+	 * nMaxFrames frames of the file are decoded (see
+	 * Preferences::m_bDiskStreaming).
+	 *
+	 * \return nullptr in case the file could not be read.
+	 */
+	static std::shared_ptr<SampleBuffer> decode( const QString& sFilepath,
+												 Format format = Format::Float,
+												 int nMaxFrames = 0 );
+	/** Number of frames read from a file at once by decode().*/
+	static constexpr int nChunkFrames = 4096;
+	/**
+	 * Converts the content to @a nSampleRate using a SincResampler.
+	 * The result is stored in the same format. Values exceeding the
+	 * range of integer formats are clipped.
+	 *
+	 * Only valid for complete buffers. Not real-time safe.
+	 */
+	std::shared_ptr<SampleBuffer> resample( int nSampleRate ) const;
+
+	/** \return Number of frames held by the buffer.*/
+	int getFrames() const;
+	/** \return Number of frames of the file the buffer was decoded
+	 * from.*/
+	int getFileFrames() const;
+	/** \return Whether the buffer holds all frames of the file.*/
+	bool isComplete() const;
+	int getSampleRate() const;
+	/** \return 1 for mono and 2 for stereo samples.*/
+	int getChannels() const;
+	Format getFormat() const;
+	/** \return Number of bytes occupied by the content.*/
+	size_t getSize() const;
+	/** \return Whether the content is mapped from a file of the
+	 * SampleDiskCache.*/
+	bool isMapped() const;
+
+	/** \return Raw content of channel @a nChannel (0 = left, 1 =
+	 * right).*/
+	const void* getData( int nChannel ) const;
+	/** \return Content of @a nChannel. Only valid for
+	 * Format::Float.*/
+	float* getFloatData( int nChannel ) const;
+	/** \return Reader for channel @a nChannel.*/
+	template <Format format>
+	Reader<format> getReader( int nChannel ) const;
+
+	/** Writes the content of @a nChannel converted to float into
+	 * @a pDest, which has to hold getFrames() values.*/
+	void toFloat( int nChannel, float* pDest ) const;
+
+	static size_t getBytesPerSample( Format format );
+	static QString formatToQString( Format format );
+	/** \return Format named @a sFormat ("float", "int16", "int24",
+	 * "half", or "auto"). Format::Auto for unknown names.*/
+	static Format parseFormat( const QString& sFormat );
+
+	static float halfToFloat( uint16_t nHalf );
+	static uint16_t floatToHalf( float fValue );
+
+	QString toQString( const QString& sPrefix, bool bShort = true ) const override;
+
+private:
+	friend class SampleDiskCache;
+
+	/** Converts @a nFrames interleaved values of @a nSourceChannels
+	 * channels from @a pSource into the storage of all channels
+	 * starting at frame @a nOffset.*/
+	template <typename T>
+	void store( const T* pSource, int nSourceChannels, int nFrames, int nOffset = 0 );
+
+	int m_nFrames;
+	int m_nFileFrames;
+	int m_nSampleRate;
+	int m_nChannels;
+	Format m_format;
+	/** Storage of the channels. Only the first one is used for mono
+	 * samples. Empty in case the buffer is mapped.*/
+	std::vector<uint8_t> m_data[ 2 ];
+	/** Content of the channels, either pointing into #m_data or
+	 * into #m_pMapping.*/
+	uint8_t* m_pChannels[ 2 ];
+	/** Keeps the cache file mapped as long as the buffer exists.*/
+	std::shared_ptr<uint8_t> m_pMapping;
+};
+
+template <>
+struct SampleBuffer::Reader<SampleBuffer::Format::Float> {
+	const float* pData;
+	float operator[]( int nFrame ) const {
+		return pData[ nFrame ];
+	}
+};
+
+template <>
+struct SampleBuffer::Reader<SampleBuffer::Format::Int16> {
+	const int16_t* pData;
+	float operator[]( int nFrame ) const {
+		// Same normalization as used by libsndfile.
+		return pData[ nFrame ] * ( 1.0f / 0x8000 );
+	}
+};
+
+template <>
+struct SampleBuffer::Reader<SampleBuffer::Format::Int24> {
+	const uint8_t* pData;
+	float operator[]( int nFrame ) const {
+		const uint8_t* p = &pData[ 3 * nFrame ];
+		// Shift the value into the upper bytes first to get the
+		// sign extension for free.
+		const int32_t nValue = static_cast<int32_t>(
+			( static_cast<uint32_t>( p[ 0 ] ) << 8 ) |
+			( static_cast<uint32_t>( p[ 1 ] ) << 16 ) |
+			( static_cast<uint32_t>( p[ 2 ] ) << 24 ) ) >> 8;
+		return nValue * ( 1.0f / 0x800000 );
+	}
+};
+
+template <>
+struct SampleBuffer::Reader<SampleBuffer::Format::Half> {
+	const uint16_t* pData;
+	float operator[]( int nFrame ) const {
+		return SampleBuffer::halfToFloat( pData[ nFrame ] );
+	}
+};
+
+inline int SampleBuffer::getFrames() const {
+	return m_nFrames;
+}
+inline int SampleBuffer::getFileFrames() const {
+	return m_nFileFrames;
+}
+inline bool SampleBuffer::isComplete() const {
+	return m_nFrames == m_nFileFrames;
+}
+inline int SampleBuffer::getSampleRate() const {
+	return m_nSampleRate;
+}
+inline int SampleBuffer::getChannels() const {
+	return m_nChannels;
+}
+inline SampleBuffer::Format SampleBuffer::getFormat() const {
+	return m_format;
+}
+inline size_t SampleBuffer::getSize() const {
+	return static_cast<size_t>( m_nFrames ) * m_nChannels *
+		getBytesPerSample( m_format );
+}
+inline bool SampleBuffer::isMapped() const {
+	return m_pMapping != nullptr;
+}
+inline const void* SampleBuffer::getData( int nChannel ) const {
+	return m_pChannels[ nChannel < m_nChannels ? nChannel : 0 ];
+}
+inline float* SampleBuffer::getFloatData( int nChannel ) const {
+	assert( m_format == Format::Float );
+	return static_cast<float*>( const_cast<void*>( getData( nChannel ) ) );
+}
+template <SampleBuffer::Format format>
+inline SampleBuffer::Reader<format> SampleBuffer::getReader( int nChannel ) const {
+	assert( m_format == format );
+	using T = std::remove_const_t<std::remove_pointer_t<decltype( Reader<format>::pData )>>;
+	return Reader<format>{ static_cast<const T*>( getData( nChannel ) ) };
+}
+
+inline float SampleBuffer::halfToFloat( uint16_t nHalf ) {
+	const uint32_t nSign = static_cast<uint32_t>( nHalf & 0x8000 ) << 16;
+	const uint32_t nExponent = ( nHalf >> 10 ) & 0x1f;
+	const uint32_t nMantissa = nHalf & 0x3ff;
+
+	uint32_t nBits;
+	if ( nExponent == 0 ) {
+		// Zero and subnormal numbers
+		const float fValue = nMantissa * ( 1.0f / ( 1 << 24 ) );
+		return nSign != 0 ? -fValue : fValue;
+	} else if ( nExponent == 0x1f ) {
+		// Infinity and NaN
+		nBits = nSign | 0x7f800000 | ( nMantissa << 13 );
+	} else {
+		nBits = nSign | ( ( nExponent + 112 ) << 23 ) | ( nMantissa << 13 );
+	}
+
+	float fValue;
+	memcpy( &fValue, &nBits, sizeof( float ) );
+	return fValue;
+}
+
+};
+
+#endif // H2C_SAMPLE_BUFFER_H
@@ -0,0 +1,298 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/Basics/SampleCache.h>
+#include <core/Basics/SampleDiskCache.h>
+#include <core/Helpers/Filesystem.h>
+#include <core/Preferences/Preferences.h>
+
+#include <QDateTime>
+#include <QFileInfo>
+
+#include <algorithm>
+
+namespace H2Core
+{
+
+SampleCache* SampleCache::__instance = nullptr;
+
+void SampleCache::create_instance()
+{
+	if ( __instance == nullptr ) {
+		const auto pPref = Preferences::get_instance();
+		const size_t nBudget = static_cast<size_t>(
+			std::max( 0, pPref->m_nSampleCacheSize ) ) * 1024 * 1024;
+		__instance = new SampleCache( nBudget,
+									  SampleBuffer::parseFormat( pPref->m_sSampleFormat ) );
+		if ( pPref->m_bPersistentSampleCache ) {
+			__instance->setDiskCache(
+				std::make_shared<SampleDiskCache>( Filesystem::sample_cache_dir() ) );
+		}
+	}
+}
+
+SampleCache::SampleCache( size_t nBudget, SampleBuffer::Format format )
+	: m_nBudget( nBudget )
+	, m_format( format )
+	, m_nBytes( 0 )
+	, m_nHits( 0 )
+	, m_nMisses( 0 )
+	, m_nDiskHits( 0 )
+	, m_nEvictions( 0 )
+{
+	__instance = this;
+}
+
+SampleCache::~SampleCache()
+{
+	clear();
+	__instance = nullptr;
+}
+
+/** Whether the cached @a pBuffer can be used for a request of @a
+ * nMaxFrames frames.*/
+static bool isSufficient( const std::shared_ptr<SampleBuffer>& pBuffer, int nMaxFrames )
+{
+	return pBuffer->isComplete() || pBuffer->getFrames() == nMaxFrames;
+}
+
+std::shared_ptr<SampleBuffer> SampleCache::get( const QString& sFilepath, int nMaxFrames, int nSampleRate )
+{
+	const SampleBuffer::Format format = m_format;
+	const QFileInfo fileInfo( sFilepath );
+	const QString sKey = fileInfo.canonicalFilePath();
+	if ( sKey.isEmpty() ) {
+		// File does not exist. Let the decoder report the error.
+		return SampleBuffer::decode( sFilepath, format, nMaxFrames );
+	}
+	const qint64 nFileSize = fileInfo.size();
+	const qint64 nLastModified = fileInfo.lastModified().toMSecsSinceEpoch();
+	if ( nSampleRate > 0 ) {
+		nMaxFrames = 0;
+	}
+	// Resampled content is cached alongside the original one.
+	const QString sEntryKey = nSampleRate > 0 ?
+		QString( "%1@%2" ).arg( sKey ).arg( nSampleRate ) : sKey;
+
+	std::shared_ptr<SampleDiskCache> pDiskCache;
+	{
+		std::lock_guard<std::mutex> lock( m_mutex );
+		auto it = m_entries.find( sEntryKey );
+		if ( it != m_entries.end() ) {
+			if ( it->second.nFileSize == nFileSize &&
+				 it->second.nLastModified == nLastModified &&
+				 isSufficient( it->second.pBuffer, nMaxFrames ) ) {
+				m_lru.splice( m_lru.begin(), m_lru, it->second.it );
+				++m_nHits;
+				return it->second.pBuffer;
+			}
+
+			// The file was altered on disk or just a part of it is
+			// cached. Samples already using the old content keep it.
+			remove( it );
+		}
+		++m_nMisses;
+		pDiskCache = m_pDiskCache;
+	}
+
+	std::shared_ptr<SampleBuffer> pBuffer;
+	if ( pDiskCache != nullptr ) {
+		pBuffer = pDiskCache->load( sEntryKey, nFileSize, nLastModified, format, nMaxFrames );
+	}
+	const bool bDiskHit = pBuffer != nullptr;
+	if ( ! bDiskHit ) {
+		if ( nSampleRate > 0 ) {
+			const auto pSource = get( sFilepath );
+			if ( pSource == nullptr ) {
+				return nullptr;
+			}
+			if ( pSource->getSampleRate() == nSampleRate ) {
+				return pSource;
+			}
+			pBuffer = pSource->resample( nSampleRate );
+		} else {
+			pBuffer = SampleBuffer::decode( sFilepath, format, nMaxFrames );
+			if ( pBuffer == nullptr ) {
+				return nullptr;
+			}
+		}
+		if ( pDiskCache != nullptr ) {
+			pDiskCache->store( sEntryKey, nFileSize, nLastModified, format, pBuffer );
+		}
+	}
+
+	std::lock_guard<std::mutex> lock( m_mutex );
+	if ( bDiskHit ) {
+		++m_nDiskHits;
+	}
+	auto it = m_entries.find( sEntryKey );
+	if ( it != m_entries.end() ) {
+		if ( it->second.nFileSize == nFileSize &&
+			 it->second.nLastModified == nLastModified &&
+			 isSufficient( it->second.pBuffer, nMaxFrames ) ) {
+			// Another thread decoded the same file in the meantime.
+			m_lru.splice( m_lru.begin(), m_lru, it->second.it );
+			return it->second.pBuffer;
+		}
+		remove( it );
+	}
+
+	m_lru.push_front( sEntryKey );
+	m_entries[ sEntryKey ] = { pBuffer, nFileSize, nLastModified, m_lru.begin() };
+	m_nBytes += pBuffer->getSize();
+
+	trimLocked();
+
+	return pBuffer;
+}
+
+void SampleCache::remove( std::map<QString, Entry>::iterator it )
+{
+	m_nBytes -= it->second.pBuffer->getSize();
+	m_lru.erase( it->second.it );
+	m_entries.erase( it );
+}
+
+void SampleCache::trim()
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	trimLocked();
+}
+
+void SampleCache::trimLocked()
+{
+	size_t nUnusedBytes = 0;
+	for ( const auto& [ _, entry ] : m_entries ) {
+		if ( entry.pBuffer.use_count() == 1 ) {
+			nUnusedBytes += entry.pBuffer->getSize();
+		}
+	}
+
+	auto it = m_lru.end();
+	while ( nUnusedBytes > m_nBudget && it != m_lru.begin() ) {
+		--it;
+		auto entryIt = m_entries.find( *it );
+		assert( entryIt != m_entries.end() );
+		if ( entryIt->second.pBuffer.use_count() > 1 ) {
+			continue;
+		}
+		nUnusedBytes -= entryIt->second.pBuffer->getSize();
+		// Erasing the current element would invalidate the iterator.
+		++it;
+		remove( entryIt );
+		++m_nEvictions;
+	}
+}
+
+void SampleCache::clear()
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	m_entries.clear();
+	m_lru.clear();
+	m_nBytes = 0;
+	m_nHits = 0;
+	m_nMisses = 0;
+	m_nDiskHits = 0;
+	m_nEvictions = 0;
+}
+
+void SampleCache::setBudget( size_t nBytes )
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	m_nBudget = nBytes;
+	trimLocked();
+}
+
+size_t SampleCache::getBudget() const
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	return m_nBudget;
+}
+
+void SampleCache::setFormat( SampleBuffer::Format format )
+{
+	m_format = format;
+}
+
+void SampleCache::setDiskCache( std::shared_ptr<SampleDiskCache> pDiskCache )
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	m_pDiskCache = pDiskCache;
+}
+
+std::shared_ptr<SampleDiskCache> SampleCache::getDiskCache() const
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	return m_pDiskCache;
+}
+
+SampleCache::Stats SampleCache::getStats() const
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	Stats stats;
+	stats.nHits = m_nHits;
+	stats.nMisses = m_nMisses;
+	stats.nDiskHits = m_nDiskHits;
+	stats.nEvictions = m_nEvictions;
+	stats.nEntries = m_entries.size();
+	stats.nBytes = m_nBytes;
+	stats.nUnusedBytes = 0;
+	for ( const auto& [ _, entry ] : m_entries ) {
+		if ( entry.pBuffer.use_count() == 1 ) {
+			stats.nUnusedBytes += entry.pBuffer->getSize();
+		}
+	}
+	stats.nBudget = m_nBudget;
+	return stats;
+}
+
+QString SampleCache::toQString( const QString& sPrefix, bool bShort ) const {
+	const auto stats = getStats();
+	QString s = Base::sPrintIndention;
+	QString sOutput;
+	if ( ! bShort ) {
+		sOutput = QString( "%1[SampleCache]\n" ).arg( sPrefix )
+			.append( QString( "%1%2entries: %3\n" ).arg( sPrefix ).arg( s ).arg( stats.nEntries ) )
+			.append( QString( "%1%2bytes: %3\n" ).arg( sPrefix ).arg( s ).arg( stats.nBytes ) )
+			.append( QString( "%1%2unused bytes: %3\n" ).arg( sPrefix ).arg( s ).arg( stats.nUnusedBytes ) )
+			.append( QString( "%1%2budget: %3\n" ).arg( sPrefix ).arg( s ).arg( stats.nBudget ) )
+			.append( QString( "%1%2format: %3\n" ).arg( sPrefix ).arg( s ).arg( SampleBuffer::formatToQString( m_format ) ) )
+			.append( QString( "%1%2hits: %3\n" ).arg( sPrefix ).arg( s ).arg( stats.nHits ) )
+			.append( QString( "%1%2misses: %3\n" ).arg( sPrefix ).arg( s ).arg( stats.nMisses ) )
+			.append( QString( "%1%2disk hits: %3\n" ).arg( sPrefix ).arg( s ).arg( stats.nDiskHits ) )
+			.append( QString( "%1%2evictions: %3\n" ).arg( sPrefix ).arg( s ).arg( stats.nEvictions ) );
+	} else {
+		sOutput = QString( "[SampleCache]" )
+			.append( QString( " entries: %1" ).arg( stats.nEntries ) )
+			.append( QString( ", bytes: %1" ).arg( stats.nBytes ) )
+			.append( QString( ", unused bytes: %1" ).arg( stats.nUnusedBytes ) )
+			.append( QString( ", budget: %1" ).arg( stats.nBudget ) )
+			.append( QString( ", format: %1" ).arg( SampleBuffer::formatToQString( m_format ) ) )
+			.append( QString( ", hits: %1" ).arg( stats.nHits ) )
+			.append( QString( ", misses: %1" ).arg( stats.nMisses ) )
+			.append( QString( ", disk hits: %1" ).arg( stats.nDiskHits ) )
+			.append( QString( ", evictions: %1" ).arg( stats.nEvictions ) );
+	}
+	return sOutput;
+}
+
+};
@@ -0,0 +1,179 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2C_SAMPLE_CACHE_H
+#define H2C_SAMPLE_CACHE_H
+
+#include <core/Object.h>
+#include <core/Basics/SampleBuffer.h>
+
+#include <atomic>
+#include <cassert>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace H2Core
+{
+
+class SampleDiskCache;
+
+/**
+ * Process-wide cache of decoded samples.
+ *
+ * Files are decoded into the format set in
+ * Preferences::m_sSampleFormat. Changing it only affects files not
+ * cached yet.
+ *
+ * Samples are keyed by their canonical path. Size and modification
+ * time of the file are stored along with the decoded content and a
+ * file changed on disk is decoded again. All Samples loaded from the
+ * same file share a single SampleBuffer, regardless of whether they
+ * belong to different drumkits, songs, or the preview.
+ *
+ * Buffers which are no longer used by any Sample are kept in order
+ * to make switching back and forth between drumkits cheap. Their
+ * total size is bound by a budget (Preferences::m_nSampleCacheSize)
+ * and the least recently used ones are evicted first. Buffers still
+ * in use are never evicted since this would not free any memory but
+ * just break the sharing.
+ *
+ * If a SampleDiskCache is set, files not held in memory are restored
+ * from it before being decoded and freshly decoded ones are written
+ * to it.
+ *
+ * \ingroup docCore
+ */
+class SampleCache : public H2Core::Object<SampleCache>
+{
+	H2_OBJECT(SampleCache)
+public:
+	struct Stats {
+		/** Number of requests served from the cache.*/
+		long long nHits;
+		/** Number of requests which required the file to be
+		 * decoded.*/
+		long long nMisses;
+		/** Number of misses served by the SampleDiskCache.*/
+		long long nDiskHits;
+		/** Number of buffers dropped due to the budget.*/
+		long long nEvictions;
+		/** Number of cached buffers.*/
+		int nEntries;
+		/** Bytes occupied by all cached buffers.*/
+		size_t nBytes;
+		/** Bytes occupied by cached buffers no longer used by any
+		 * Sample.*/
+		size_t nUnusedBytes;
+		size_t nBudget;
+	};
+
+	/**
+	 * If #__instance equals nullptr, a new SampleCache singleton
+	 * will be created using the budget set in the Preferences.
+	 *
+	 * It is called in Hydrogen::create_instance().
+	 */
+	static void create_instance();
+	/** \return #__instance */
+	static SampleCache* get_instance() { assert(__instance); return __instance; }
+	~SampleCache();
+
+	/**
+	 * \return Decoded content of @a sFilepath. Either retrieved from
+	 * the cache or freshly decoded and inserted. nullptr in case the
+	 * file could not be read.
+	 *
+	 * Thread-safe. Files are decoded without holding the lock of the
+	 * cache.
+	 *
+	 * \param nMaxFrames If larger than 0, only the first @a
+	 * nMaxFrames frames are required (see SampleBuffer::decode()).
+	 * A complete buffer already cached is returned nevertheless.
+	 * \param nSampleRate If larger than 0, the content is converted
+	 * to @a nSampleRate (see SampleBuffer::resample()). Both the
+	 * original and the converted buffer are cached. Resampled
+	 * buffers are always complete and @a nMaxFrames is ignored.
+	 */
+	std::shared_ptr<SampleBuffer> get( const QString& sFilepath, int nMaxFrames = 0,
+									   int nSampleRate = 0 );
+
+	/** Evicts unused buffers until the budget is met.*/
+	void trim();
+	/** Drops all buffers and resets the statistics.*/
+	void clear();
+
+	/** \param nBytes Budget for the buffers no longer used by any
+	 * Sample. Takes effect immediately.*/
+	void setBudget( size_t nBytes );
+	size_t getBudget() const;
+	/** \param format Format newly decoded samples are stored in.*/
+	void setFormat( SampleBuffer::Format format );
+	SampleBuffer::Format getFormat() const;
+	/** \param pDiskCache Persistent cache consulted prior to
+	 * decoding a file. nullptr disables it.*/
+	void setDiskCache( std::shared_ptr<SampleDiskCache> pDiskCache );
+	std::shared_ptr<SampleDiskCache> getDiskCache() const;
+	Stats getStats() const;
+
+	QString toQString( const QString& sPrefix, bool bShort = true ) const override;
+
+private:
+	/** Sets #__instance to this. Called by create_instance().*/
+	SampleCache( size_t nBudget, SampleBuffer::Format format );
+	static SampleCache* __instance;
+
+	struct Entry {
+		std::shared_ptr<SampleBuffer> pBuffer;
+		qint64 nFileSize;
+		qint64 nLastModified;
+		/** Position of the key within #m_lru.*/
+		std::list<QString>::iterator it;
+	};
+
+	/** Caller has to hold #m_mutex.*/
+	void trimLocked();
+	/** Caller has to hold #m_mutex.*/
+	void remove( std::map<QString, Entry>::iterator it );
+
+	mutable std::mutex m_mutex;
+	std::map<QString, Entry> m_entries;
+	/** Keys of #m_entries. The most recently used one comes first.*/
+	std::list<QString> m_lru;
+	size_t m_nBudget;
+	std::atomic<SampleBuffer::Format> m_format;
+	std::shared_ptr<SampleDiskCache> m_pDiskCache;
+	size_t m_nBytes;
+	long long m_nHits;
+	long long m_nMisses;
+	long long m_nDiskHits;
+	long long m_nEvictions;
+};
+
+inline SampleBuffer::Format SampleCache::getFormat() const {
+	return m_format;
+}
+
+};
+
+#endif // H2C_SAMPLE_CACHE_H
@@ -0,0 +1,270 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/Basics/SampleDiskCache.h>
+#include <core/Helpers/Filesystem.h>
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+
+#include <cstring>
+
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
+
+namespace H2Core
+{
+
+/** Identifies cache files. Changed whenever the layout changes.*/
+static const char sMagic[ 8 ] = { 'H', '2', 'S', 'M', 'P', 'L', 0, 1 };
+/** Written in native byte order to detect foreign files.*/
+static const uint32_t nByteOrderMark = 0x01020304;
+static const QString sSuffix = ".h2sc";
+
+/** Leading part of each cache file.*/
+struct CacheHeader {
+	char magic[ 8 ];
+	uint32_t nByteOrder;
+	int32_t nFormat;
+	int64_t nFileSize;
+	int64_t nLastModified;
+	int32_t nSampleRate;
+	int32_t nChannels;
+	int32_t nFrames;
+	/** Length of the UTF-8 encoded canonical path following the
+	 * header.*/
+	int32_t nPathBytes;
+	/** Offset of the content of the first channel.*/
+	int64_t nDataOffset;
+	/** Distance between the content of successive channels.*/
+	int64_t nChannelStride;
+};
+
+static int64_t align( int64_t nBytes )
+{
+	return ( nBytes + SampleDiskCache::nAlignment - 1 ) /
+		SampleDiskCache::nAlignment * SampleDiskCache::nAlignment;
+}
+
+/**
+ * Maps the content of @a pFile into memory. The mapping is private.
+ * In case the content is ever written to, only the affected pages are
+ * copied and the cache file stays untouched.
+ *
+ * \return nullptr on failure. The mapping is released along with the
+ * last copy of the pointer.
+ */
+static std::shared_ptr<uint8_t> mapFile( std::unique_ptr<QFile> pFile )
+{
+#ifndef WIN32
+	// Mapped directly to not keep a file descriptor open for each
+	// sample. The mapping outlives the descriptor.
+	const size_t nSize = pFile->size();
+	void* pMapped = mmap( nullptr, nSize, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+						  pFile->handle(), 0 );
+	if ( pMapped == MAP_FAILED ) {
+		return nullptr;
+	}
+	return std::shared_ptr<uint8_t>( static_cast<uint8_t*>( pMapped ),
+									 [nSize]( uint8_t* p ) { munmap( p, nSize ); } );
+#else
+	// The mapping is released once the file gets closed.
+	std::shared_ptr<QFile> pSharedFile( std::move( pFile ) );
+	uchar* pMapped = pSharedFile->map( 0, pSharedFile->size(), QFileDevice::MapPrivateOption );
+	if ( pMapped == nullptr ) {
+		return nullptr;
+	}
+	return std::shared_ptr<uint8_t>( pMapped, [pSharedFile]( uint8_t* ) {} );
+#endif
+}
+
+SampleDiskCache::SampleDiskCache( const QString& sDirectory )
+	: m_sDirectory( sDirectory )
+{
+	if ( ! QDir( m_sDirectory ).exists() ) {
+		Filesystem::mkdir( m_sDirectory );
+	}
+}
+
+QString SampleDiskCache::getCacheFile( const QString& sKey, SampleBuffer::Format format ) const
+{
+	const QByteArray hash = QCryptographicHash::hash(
+		QString( "%1:%2" ).arg( SampleBuffer::formatToQString( format ) ).arg( sKey ).toUtf8(),
+		QCryptographicHash::Sha1 );
+	return QDir( m_sDirectory ).filePath( QString::fromLatin1( hash.toHex() ) + sSuffix );
+}
+
+std::shared_ptr<SampleBuffer> SampleDiskCache::load( const QString& sKey, qint64 nFileSize,
+													 qint64 nLastModified,
+													 SampleBuffer::Format format,
+													 int nMaxFrames ) const
+{
+	auto pFile = std::make_unique<QFile>( getCacheFile( sKey, format ) );
+	if ( ! pFile->open( QIODevice::ReadOnly ) ) {
+		return nullptr;
+	}
+
+	CacheHeader header;
+	if ( pFile->read( reinterpret_cast<char*>( &header ), sizeof( header ) ) != sizeof( header ) ||
+		 memcmp( header.magic, sMagic, sizeof( sMagic ) ) != 0 ||
+		 header.nByteOrder != nByteOrderMark ) {
+		WARNINGLOG( QString( "Ignoring invalid cache file [%1]" ).arg( pFile->fileName() ) );
+		return nullptr;
+	}
+	if ( header.nFileSize != nFileSize || header.nLastModified != nLastModified ) {
+		// Source file changed on disk.
+		return nullptr;
+	}
+	if ( nMaxFrames > 0 && header.nFrames > nMaxFrames ) {
+		return nullptr;
+	}
+
+	const auto storedFormat = static_cast<SampleBuffer::Format>( header.nFormat );
+	if ( header.nFormat < 0 || storedFormat >= SampleBuffer::Format::Auto ||
+		 header.nChannels < 1 || header.nChannels > 2 || header.nFrames <= 0 ||
+		 header.nPathBytes < 0 ||
+		 header.nChannelStride < static_cast<int64_t>( header.nFrames ) *
+		 static_cast<int64_t>( SampleBuffer::getBytesPerSample( storedFormat ) ) ||
+		 header.nDataOffset < static_cast<int64_t>( sizeof( header ) ) + header.nPathBytes ||
+		 header.nDataOffset % nAlignment != 0 ||
+		 header.nDataOffset + header.nChannels * header.nChannelStride > pFile->size() ) {
+		WARNINGLOG( QString( "Ignoring invalid cache file [%1]" ).arg( pFile->fileName() ) );
+		return nullptr;
+	}
+	if ( QString::fromUtf8( pFile->read( header.nPathBytes ) ) != sKey ) {
+		// Hash collision.
+		return nullptr;
+	}
+
+	const QString sCacheFile = pFile->fileName();
+	auto pMapping = mapFile( std::move( pFile ) );
+	if ( pMapping == nullptr ) {
+		WARNINGLOG( QString( "Unable to map cache file [%1]" ).arg( sCacheFile ) );
+		return nullptr;
+	}
+	uint8_t* pMapped = pMapping.get();
+
+	// Touch all pages once so the audio thread does not have to
+	// fault them in the first time the sample is played.
+	volatile uint8_t nSum = 0;
+	for ( int64_t nByte = header.nDataOffset;
+		  nByte < header.nDataOffset + header.nChannels * header.nChannelStride;
+		  nByte += 4096 ) {
+		nSum += pMapped[ nByte ];
+	}
+
+	auto pBuffer = std::make_shared<SampleBuffer>( 0, header.nSampleRate, header.nChannels,
+												   storedFormat );
+	pBuffer->m_nFrames = header.nFrames;
+	pBuffer->m_nFileFrames = header.nFrames;
+	for ( int nChannel = 0; nChannel < header.nChannels; ++nChannel ) {
+		pBuffer->m_data[ nChannel ] = std::vector<uint8_t>();
+		pBuffer->m_pChannels[ nChannel ] =
+			pMapped + header.nDataOffset + nChannel * header.nChannelStride;
+	}
+	pBuffer->m_pMapping = pMapping;
+
+	return pBuffer;
+}
+
+bool SampleDiskCache::store( const QString& sKey, qint64 nFileSize, qint64 nLastModified,
+							 SampleBuffer::Format format,
+							 const std::shared_ptr<SampleBuffer>& pBuffer ) const
+{
+	if ( pBuffer == nullptr || ! pBuffer->isComplete() || pBuffer->getFrames() == 0 ||
+		 pBuffer->isMapped() ) {
+		return false;
+	}
+
+	const QByteArray path = sKey.toUtf8();
+	const int64_t nChannelBytes = static_cast<int64_t>( pBuffer->getFrames() ) *
+		SampleBuffer::getBytesPerSample( pBuffer->getFormat() );
+
+	CacheHeader header;
+	memset( &header, 0, sizeof( header ) );
+	memcpy( header.magic, sMagic, sizeof( sMagic ) );
+	header.nByteOrder = nByteOrderMark;
+	header.nFormat = static_cast<int32_t>( pBuffer->getFormat() );
+	header.nFileSize = nFileSize;
+	header.nLastModified = nLastModified;
+	header.nSampleRate = pBuffer->getSampleRate();
+	header.nChannels = pBuffer->getChannels();
+	header.nFrames = pBuffer->getFrames();
+	header.nPathBytes = path.size();
+	header.nDataOffset = align( sizeof( header ) + path.size() );
+	header.nChannelStride = align( nChannelBytes );
+
+	// Written to a temporary file first and renamed on commit().
+	// Concurrent writers and readers therefore never see a partial
+	// file.
+	QSaveFile file( getCacheFile( sKey, format ) );
+	if ( ! file.open( QIODevice::WriteOnly ) ) {
+		WARNINGLOG( QString( "Unable to write cache file [%1]: %2" )
+					.arg( file.fileName() ).arg( file.errorString() ) );
+		return false;
+	}
+
+	const QByteArray padding( nAlignment, 0 );
+	file.write( reinterpret_cast<const char*>( &header ), sizeof( header ) );
+	file.write( path );
+	file.write( padding.constData(), header.nDataOffset - sizeof( header ) - path.size() );
+	for ( int nChannel = 0; nChannel < header.nChannels; ++nChannel ) {
+		file.write( static_cast<const char*>( pBuffer->getData( nChannel ) ), nChannelBytes );
+		file.write( padding.constData(), header.nChannelStride - nChannelBytes );
+	}
+
+	if ( ! file.commit() ) {
+		WARNINGLOG( QString( "Unable to write cache file [%1]: %2" )
+					.arg( file.fileName() ).arg( file.errorString() ) );
+		return false;
+	}
+
+	return true;
+}
+
+void SampleDiskCache::clear() const
+{
+	QDir dir( m_sDirectory );
+	for ( const auto& sFile : dir.entryList( QStringList( "*" + sSuffix ), QDir::Files ) ) {
+		if ( ! dir.remove( sFile ) ) {
+			WARNINGLOG( QString( "Unable to remove cache file [%1]" ).arg( dir.filePath( sFile ) ) );
+		}
+	}
+}
+
+QString SampleDiskCache::toQString( const QString& sPrefix, bool bShort ) const {
+	QString s = Base::sPrintIndention;
+	QString sOutput;
+	if ( ! bShort ) {
+		sOutput = QString( "%1[SampleDiskCache]\n" ).arg( sPrefix )
+			.append( QString( "%1%2directory: %3\n" ).arg( sPrefix ).arg( s ).arg( m_sDirectory ) );
+	} else {
+		sOutput = QString( "[SampleDiskCache]" )
+			.append( QString( " directory: %1" ).arg( m_sDirectory ) );
+	}
+	return sOutput;
+}
+
+};
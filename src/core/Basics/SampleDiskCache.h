@@ -0,0 +1,119 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2C_SAMPLE_DISK_CACHE_H
+#define H2C_SAMPLE_DISK_CACHE_H
+
+#include <core/Object.h>
+#include <core/Basics/SampleBuffer.h>
+
+#include <memory>
+
+namespace H2Core
+{
+
+/**
+ * Persistent cache of decoded samples (see
+ * Preferences::m_bPersistentSampleCache).
+ *
+ * The SampleCache stores each file it decoded in a cache file of its
+ * own within Filesystem::sample_cache_dir(). On the next start those
+ * files are mapped into memory instead of being decoded again, which
+ * makes loading large drumkits a matter of reading them from disk.
+ *
+ * A cache file consists of a header identifying the source file by
+ * its canonical path, size, and modification time, followed by the
+ * content of each channel in the format it is stored in. All
+ * sections are aligned to #nAlignment bytes so the mapped content can
+ * be used as is. Cache files not matching the source file anymore
+ * are ignored and overwritten once the file was decoded again.
+ *
+ * Only complete buffers are cached. The content is used without any
+ * conversion and cache files are therefore not portable between
+ * machines of different byte order.
+ *
+ * \ingroup docCore
+ */
+class SampleDiskCache : public H2Core::Object<SampleDiskCache>
+{
+	H2_OBJECT(SampleDiskCache)
+public:
+	/** \param sDirectory Folder holding the cache files. Created if
+	 * it does not exist yet.*/
+	SampleDiskCache( const QString& sDirectory );
+
+	/**
+	 * Maps the cached content of a file into memory.
+	 *
+	 * Thread-safe.
+	 *
+	 * \param sKey Canonical path of the file.
+	 * \param nFileSize Current size of the file.
+	 * \param nLastModified Current modification time of the file.
+	 * \param format Format requested from SampleBuffer::decode().
+	 * \param nMaxFrames If larger than 0, files longer than @a
+	 * nMaxFrames frames are not restored (see
+	 * Preferences::m_bDiskStreaming).
+	 *
+	 * \return nullptr in case there is no valid cache file.
+	 */
+	std::shared_ptr<SampleBuffer> load( const QString& sKey, qint64 nFileSize,
+										qint64 nLastModified, SampleBuffer::Format format,
+										int nMaxFrames = 0 ) const;
+	/**
+	 * Writes @a pBuffer decoded from the file @a sKey in @a format
+	 * into the cache. Incomplete, empty, and mapped buffers are
+	 * skipped.
+	 *
+	 * Thread-safe. The cache file is replaced atomically.
+	 *
+	 * \return Whether a cache file was written.
+	 */
+	bool store( const QString& sKey, qint64 nFileSize, qint64 nLastModified,
+				SampleBuffer::Format format,
+				const std::shared_ptr<SampleBuffer>& pBuffer ) const;
+
+	/** Removes all cache files.*/
+	void clear() const;
+
+	const QString& getDirectory() const;
+	/** \return Path of the cache file of @a sKey decoded in @a
+	 * format.*/
+	QString getCacheFile( const QString& sKey, SampleBuffer::Format format ) const;
+
+	/** Alignment of the content of each channel within a cache
+	 * file.*/
+	static constexpr int nAlignment = 64;
+
+	QString toQString( const QString& sPrefix, bool bShort = true ) const override;
+
+private:
+	QString m_sDirectory;
+};
+
+inline const QString& SampleDiskCache::getDirectory() const {
+	return m_sDirectory;
+}
+
+};
+
+#endif // H2C_SAMPLE_DISK_CACHE_H
@@ -0,0 +1,214 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/Basics/SampleLoader.h>
+#include <core/Basics/Sample.h>
+#include <core/EventQueue.h>
+#include <core/Preferences/Preferences.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace H2Core
+{
+
+/**
+ * Threads shared by all SampleLoaders.
+ *
+ * They are started on first use, kept till the application quits,
+ * and only added when a call to run() requires more of them than
+ * before.
+ */
+class SampleLoaderThreads
+{
+public:
+	static SampleLoaderThreads& get_instance() {
+		static SampleLoaderThreads instance;
+		return instance;
+	}
+
+	~SampleLoaderThreads() {
+		{
+			std::lock_guard<std::mutex> lock( m_mutex );
+			m_bQuit = true;
+		}
+		m_workCondition.notify_all();
+		for ( auto& thread : m_threads ) {
+			thread.join();
+		}
+	}
+
+	/** Calls @a task on @a nThreads pooled threads while @a task is
+	 * called on the calling thread as well. Returns once all of
+	 * them are done.*/
+	void run( int nThreads, const std::function<void()>& task ) {
+		Batch batch{ &task, nThreads };
+		{
+			std::lock_guard<std::mutex> lock( m_mutex );
+			while ( static_cast<int>( m_threads.size() ) < nThreads ) {
+				m_threads.emplace_back( &SampleLoaderThreads::threadMain, this );
+			}
+			for ( int ii = 0; ii < nThreads; ++ii ) {
+				m_queue.push_back( &batch );
+			}
+		}
+		m_workCondition.notify_all();
+
+		task();
+
+		std::unique_lock<std::mutex> lock( m_mutex );
+		m_doneCondition.wait( lock, [&]() { return batch.nRemaining == 0; } );
+	}
+
+	int size() {
+		std::lock_guard<std::mutex> lock( m_mutex );
+		return m_threads.size();
+	}
+
+private:
+	struct Batch {
+		const std::function<void()>* pTask;
+		/** Number of pooled threads not done with #pTask yet.*/
+		int nRemaining;
+	};
+
+	SampleLoaderThreads() = default;
+
+	void threadMain() {
+		std::unique_lock<std::mutex> lock( m_mutex );
+		for (;;) {
+			m_workCondition.wait( lock, [&]() { return m_bQuit || ! m_queue.empty(); } );
+			if ( m_bQuit ) {
+				return;
+			}
+			Batch* pBatch = m_queue.front();
+			m_queue.pop_front();
+
+			lock.unlock();
+			( *pBatch->pTask )();
+			lock.lock();
+
+			if ( --pBatch->nRemaining == 0 ) {
+				m_doneCondition.notify_all();
+			}
+		}
+	}
+
+	std::mutex m_mutex;
+	std::condition_variable m_workCondition;
+	std::condition_variable m_doneCondition;
+	std::deque<Batch*> m_queue;
+	std::vector<std::thread> m_threads;
+	bool m_bQuit = false;
+};
+
+SampleLoader::SampleLoader()
+{
+}
+
+void SampleLoader::add( Load load, Done done )
+{
+	m_jobs.push_back( { std::move( load ), std::move( done ), nullptr } );
+}
+
+int SampleLoader::getPooledThreadCount()
+{
+	return SampleLoaderThreads::get_instance().size();
+}
+
+int SampleLoader::getThreadCount()
+{
+	const int nCores = std::max( 1u, std::thread::hardware_concurrency() );
+	return std::max( 1, std::min( nCores, Preferences::get_instance()->m_nSampleLoadingThreads ) );
+}
+
+void SampleLoader::run()
+{
+	const int nJobs = m_jobs.size();
+	if ( nJobs == 0 ) {
+		return;
+	}
+
+	std::atomic<int> nNextJob( 0 );
+	std::atomic<int> nDoneJobs( 0 );
+	auto work = [&]( bool bReportProgress ) {
+		int nLastPercent = -1;
+		int nJob;
+		while ( ( nJob = nNextJob.fetch_add( 1 ) ) < nJobs ) {
+			auto& job = m_jobs[ nJob ];
+			job.pSample = job.load();
+			const int nDone = nDoneJobs.fetch_add( 1 ) + 1;
+
+			// The EventQueue only supports a single writer. Progress
+			// is therefore reported by the calling thread alone.
+			const int nPercent = std::min( 99, nDone * 100 / nJobs );
+			if ( bReportProgress && nPercent != nLastPercent ) {
+				EventQueue::get_instance()->push_event( EVENT_PROGRESS, nPercent );
+				nLastPercent = nPercent;
+			}
+		}
+	};
+
+	// Only the calling thread reports progress.
+	const int nThreads = std::min( getThreadCount(), nJobs );
+	const std::thread::id caller = std::this_thread::get_id();
+	const std::function<void()> task = [&]() {
+		work( std::this_thread::get_id() == caller );
+	};
+	if ( nThreads > 1 ) {
+		SampleLoaderThreads::get_instance().run( nThreads - 1, task );
+	} else {
+		task();
+	}
+
+	INFOLOG( QString( "Loaded [%1] samples using [%2] threads" ).arg( nJobs ).arg( nThreads ) );
+
+	// Jobs added within the callbacks are run by the next call.
+	std::vector<Job> jobs;
+	jobs.swap( m_jobs );
+	for ( auto& job : jobs ) {
+		if ( job.done ) {
+			job.done( job.pSample );
+		}
+	}
+}
+
+QString SampleLoader::toQString( const QString& sPrefix, bool bShort ) const {
+	QString s = Base::sPrintIndention;
+	QString sOutput;
+	if ( ! bShort ) {
+		sOutput = QString( "%1[SampleLoader]\n" ).arg( sPrefix )
+			.append( QString( "%1%2jobs: %3\n" ).arg( sPrefix ).arg( s ).arg( m_jobs.size() ) )
+			.append( QString( "%1%2threads: %3\n" ).arg( sPrefix ).arg( s ).arg( getThreadCount() ) );
+	} else {
+		sOutput = QString( "[SampleLoader]" )
+			.append( QString( " jobs: %1" ).arg( m_jobs.size() ) )
+			.append( QString( ", threads: %1" ).arg( getThreadCount() ) );
+	}
+	return sOutput;
+}
+
+};
@@ -0,0 +1,105 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2C_SAMPLE_LOADER_H
+#define H2C_SAMPLE_LOADER_H
+
+#include <core/Object.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace H2Core
+{
+
+class Sample;
+
+/**
+ * Loads the samples of drumkits and songs concurrently.
+ *
+ * Loading jobs are collected using add() and executed by run(). The
+ * number of threads is bound by both the number of cores and
+ * Preferences::m_nSampleLoadingThreads, which limits the number of
+ * files read from disk at the same time. Apart from the calling one
+ * the threads are taken from a pool shared by all SampleLoaders,
+ * which is started on first use and kept till the application
+ * quits.
+ *
+ * Jobs must not depend on each other. All state shared with the rest
+ * of the application, like the instruments the samples are assigned
+ * to, should be altered in the @a done callback instead. Those are
+ * called in the order the jobs were added on the thread calling
+ * run().
+ *
+ * \ingroup docCore
+ */
+class SampleLoader : public H2Core::Object<SampleLoader>
+{
+	H2_OBJECT(SampleLoader)
+public:
+	/** Loads a sample on an arbitrary thread.*/
+	using Load = std::function<std::shared_ptr<Sample>()>;
+	/** Receives the result of Load on the thread calling run().*/
+	using Done = std::function<void( std::shared_ptr<Sample> )>;
+
+	SampleLoader();
+
+	void add( Load load, Done done = nullptr );
+	/** \return Number of jobs added since the last call to run().*/
+	int size() const;
+
+	/**
+	 * Executes all added jobs and blocks until they are done.
+	 *
+	 * Progress is reported in percent using #EVENT_PROGRESS. The
+	 * final value of 100 is reserved for the end of an export (see
+	 * OfflineRenderer) and therefore never emitted.
+	 */
+	void run();
+
+	/** \return Number of threads used by run(), including the
+	 * calling one.*/
+	static int getThreadCount();
+	/** \return Number of threads started for the pool shared by
+	 * all SampleLoaders so far.*/
+	static int getPooledThreadCount();
+
+	QString toQString( const QString& sPrefix, bool bShort = true ) const override;
+
+private:
+	struct Job {
+		Load load;
+		Done done;
+		std::shared_ptr<Sample> pSample;
+	};
+
+	std::vector<Job> m_jobs;
+};
+
+inline int SampleLoader::size() const {
+	return m_jobs.size();
+}
+
+};
+
+#endif // H2C_SAMPLE_LOADER_H
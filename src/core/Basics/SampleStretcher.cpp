@@ -0,0 +1,301 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+
+#include <core/Basics/SampleStretcher.h>
+#include <core/AudioEngine/AudioEngine.h>
+#include <core/Basics/InstrumentLayer.h>
+#include <core/Basics/Sample.h>
+#include <core/EventQueue.h>
+#include <core/Hydrogen.h>
+#include <core/Preferences/Preferences.h>
+
+#include <algorithm>
+#include <tuple>
+
+namespace H2Core
+{
+
+bool SampleStretcher::Key::operator<( const Key& other ) const
+{
+	return std::tie( sFilepath, pModifiedSource, fRatio, fPitch, nCrispness ) <
+		std::tie( other.sFilepath, other.pModifiedSource, other.fRatio, other.fPitch,
+				  other.nCrispness );
+}
+
+SampleStretcher::SampleStretcher( int nThreads, size_t nBudget )
+	: m_bQuit( false )
+	, m_nActiveJobs( 0 )
+	, m_fPendingBpm( 0 )
+	, m_nBudget( nBudget )
+	, m_nHits( 0 )
+	, m_nMisses( 0 )
+	, m_nSuperseded( 0 )
+{
+	for ( int ii = 0; ii < std::max( 1, nThreads ); ++ii ) {
+		m_threads.emplace_back( &SampleStretcher::threadMain, this );
+	}
+}
+
+SampleStretcher::~SampleStretcher()
+{
+	{
+		std::lock_guard<std::mutex> lock( m_mutex );
+		m_bQuit = true;
+		m_jobs.clear();
+	}
+	m_condition.notify_all();
+	for ( auto& thread : m_threads ) {
+		thread.join();
+	}
+}
+
+SampleStretcher::Key SampleStretcher::makeKey( const std::shared_ptr<Sample>& pSource, float fBpm )
+{
+	const auto rb = pSource->get_rubberband();
+	const double fRatio = 60.0 / fBpm * rb.divider / pSource->get_sample_duration();
+	// Unmodified samples of the same file share their results,
+	// e.g. after the drumkit was reloaded.
+	return Key{ pSource->get_filepath(),
+				pSource->get_is_modified() ? pSource.get() : nullptr,
+				fRatio, rb.pitch, rb.c_settings };
+}
+
+void SampleStretcher::request( std::shared_ptr<InstrumentLayer> pLayer,
+							   std::shared_ptr<Sample> pSource, float fBpm )
+{
+	if ( pLayer == nullptr || pSource == nullptr ) {
+		return;
+	}
+	if ( pSource->get_unstretched() != nullptr ) {
+		pSource = pSource->get_unstretched();
+	}
+
+	std::lock_guard<std::mutex> lock( m_mutex );
+	for ( auto& job : m_jobs ) {
+		if ( job.pLayerKey == pLayer.get() ) {
+			job.pSource = pSource;
+			job.fBpm = fBpm;
+			++m_nSuperseded;
+			return;
+		}
+	}
+	m_jobs.push_back( { pLayer, pLayer.get(), pSource, fBpm } );
+	m_condition.notify_one();
+}
+
+void SampleStretcher::requestTempo( float fBpm )
+{
+	// Neither locking nor notifying the workers since this is
+	// called by the audio thread.
+	m_fPendingBpm.store( fBpm );
+}
+
+void SampleStretcher::wait()
+{
+	std::unique_lock<std::mutex> lock( m_mutex );
+	// Do not wait for the workers to poll a posted tempo.
+	m_condition.notify_all();
+	m_doneCondition.wait( lock, [&]() {
+		return m_jobs.empty() && m_nActiveJobs == 0 && m_fPendingBpm.load() == 0;
+	} );
+}
+
+void SampleStretcher::clear()
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	m_jobs.clear();
+	m_fPendingBpm.store( 0 );
+	m_entries.clear();
+	m_lru.clear();
+	m_nHits = m_nMisses = m_nSuperseded = 0;
+	m_doneCondition.notify_all();
+}
+
+void SampleStretcher::threadMain()
+{
+	while ( true ) {
+		Job job;
+		float fBpm = 0;
+		{
+			std::unique_lock<std::mutex> lock( m_mutex );
+			m_condition.wait_for( lock, nPollInterval, [&]() {
+				return m_bQuit || ! m_jobs.empty() || m_fPendingBpm.load() != 0;
+			} );
+			if ( m_bQuit ) {
+				return;
+			}
+			fBpm = m_fPendingBpm.exchange( 0 );
+			if ( fBpm == 0 ) {
+				if ( m_jobs.empty() ) {
+					continue;
+				}
+				job = std::move( m_jobs.front() );
+				m_jobs.pop_front();
+			}
+			++m_nActiveJobs;
+		}
+
+		if ( fBpm != 0 ) {
+			processTempo( fBpm );
+		} else {
+			process( job );
+		}
+
+		{
+			std::lock_guard<std::mutex> lock( m_mutex );
+			--m_nActiveJobs;
+		}
+		m_doneCondition.notify_all();
+	}
+}
+
+void SampleStretcher::process( const Job& job )
+{
+	auto pLayer = job.pLayer.lock();
+	if ( pLayer == nullptr ) {
+		return;
+	}
+
+	const Key key = makeKey( job.pSource, job.fBpm );
+	auto pStretched = lookup( key );
+	if ( pStretched == nullptr ) {
+		pStretched = Sample::stretch( job.pSource, job.fBpm );
+		if ( pStretched == nullptr ) {
+			ERRORLOG( QString( "Unable to stretch [%1]" ).arg( job.pSource->get_filepath() ) );
+			return;
+		}
+		insert( key, pStretched );
+	}
+
+	// The layer might have been assigned a different sample in the
+	// meantime, e.g. by the SampleEditor.
+	AudioEngine* pAudioEngine = Hydrogen::get_instance()->getAudioEngine();
+	pAudioEngine->lock( RIGHT_HERE );
+	const auto pCurrent = pLayer->get_sample();
+	if ( pCurrent != nullptr && pCurrent != pStretched &&
+		 ( pCurrent == job.pSource || pCurrent->get_unstretched() == job.pSource ) ) {
+		pLayer->set_sample( pStretched );
+	}
+	pAudioEngine->unlock();
+}
+
+void SampleStretcher::processTempo( float fBpm )
+{
+	if ( ! Preferences::get_instance()->getRubberBandBatchMode() ) {
+		return;
+	}
+
+	Hydrogen* pHydrogen = Hydrogen::get_instance();
+	AudioEngine* pAudioEngine = pHydrogen->getAudioEngine();
+	pAudioEngine->lock( RIGHT_HERE );
+	const bool bSong = pHydrogen->getSong() != nullptr;
+	pHydrogen->stretchSamples( fBpm );
+	pAudioEngine->unlock();
+
+	if ( bSong ) {
+		EventQueue::get_instance()->push_event( EVENT_UPDATE_SONG, 3 );
+	}
+}
+
+std::shared_ptr<Sample> SampleStretcher::lookup( const Key& key )
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	auto it = m_entries.find( key );
+	if ( it == m_entries.end() ) {
+		++m_nMisses;
+		return nullptr;
+	}
+	++m_nHits;
+	m_lru.splice( m_lru.begin(), m_lru, it->second.it );
+	return it->second.pStretched;
+}
+
+void SampleStretcher::insert( const Key& key, std::shared_ptr<Sample> pStretched )
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	if ( m_entries.find( key ) != m_entries.end() ) {
+		// Stretched by another worker in the meantime.
+		return;
+	}
+	m_lru.push_front( key );
+	m_entries[ key ] = { pStretched, static_cast<size_t>( pStretched->get_size() ), m_lru.begin() };
+	trimLocked();
+}
+
+void SampleStretcher::trimLocked()
+{
+	size_t nUnusedBytes = 0;
+	for ( const auto& [ key, entry ] : m_entries ) {
+		if ( entry.pStretched.use_count() == 1 ) {
+			nUnusedBytes += entry.nBytes;
+		}
+	}
+
+	auto it = m_lru.end();
+	while ( nUnusedBytes > m_nBudget && it != m_lru.begin() ) {
+		--it;
+		auto entryIt = m_entries.find( *it );
+		if ( entryIt->second.pStretched.use_count() > 1 ) {
+			continue;
+		}
+		nUnusedBytes -= entryIt->second.nBytes;
+		m_entries.erase( entryIt );
+		it = m_lru.erase( it );
+	}
+}
+
+SampleStretcher::Stats SampleStretcher::getStats() const
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	return Stats{ m_nHits, m_nMisses, m_nSuperseded,
+				  static_cast<int>( m_entries.size() ),
+				  static_cast<int>( m_jobs.size() ) + m_nActiveJobs };
+}
+
+QString SampleStretcher::toQString( const QString& sPrefix, bool bShort ) const {
+	const auto stats = getStats();
+	QString s = Base::sPrintIndention;
+	QString sOutput;
+	if ( ! bShort ) {
+		sOutput = QString( "%1[SampleStretcher]\n" ).arg( sPrefix )
+			.append( QString( "%1%2threads: %3\n" ).arg( sPrefix ).arg( s ).arg( m_threads.size() ) )
+			.append( QString( "%1%2entries: %3\n" ).arg( sPrefix ).arg( s ).arg( stats.nEntries ) )
+			.append( QString( "%1%2pending: %3\n" ).arg( sPrefix ).arg( s ).arg( stats.nPending ) )
+			.append( QString( "%1%2budget: %3\n" ).arg( sPrefix ).arg( s ).arg( m_nBudget ) )
+			.append( QString( "%1%2hits: %3\n" ).arg( sPrefix ).arg( s ).arg( stats.nHits ) )
+			.append( QString( "%1%2misses: %3\n" ).arg( sPrefix ).arg( s ).arg( stats.nMisses ) )
+			.append( QString( "%1%2superseded: %3\n" ).arg( sPrefix ).arg( s ).arg( stats.nSuperseded ) );
+	} else {
+		sOutput = QString( "[SampleStretcher]" )
+			.append( QString( " threads: %1" ).arg( m_threads.size() ) )
+			.append( QString( ", entries: %1" ).arg( stats.nEntries ) )
+			.append( QString( ", pending: %1" ).arg( stats.nPending ) )
+			.append( QString( ", budget: %1" ).arg( m_nBudget ) )
+			.append( QString( ", hits: %1" ).arg( stats.nHits ) )
+			.append( QString( ", misses: %1" ).arg( stats.nMisses ) )
+			.append( QString( ", superseded: %1" ).arg( stats.nSuperseded ) );
+	}
+	return sOutput;
+}
+
+};
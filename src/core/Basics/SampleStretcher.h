@@ -0,0 +1,210 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+
+#ifndef H2C_SAMPLE_STRETCHER_H
+#define H2C_SAMPLE_STRETCHER_H
+
+#include <core/Object.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace H2Core
+{
+
+class InstrumentLayer;
+class Sample;
+
+/**
+ * Time-stretches samples using Rubber Band in the background (see
+ * Sample::stretch()).
+ *
+ * Layers keep playing their current sample till the stretched one
+ * is ready. It is assigned by the worker threads while holding the
+ * lock of the AudioEngine, provided the layer still plays the same
+ * source sample. Requests for a layer not processed yet are
+ * superseded by newer ones. Tempo changes while dragging the BPM
+ * therefore do not pile up.
+ *
+ * Tempo changes of the AudioEngine are posted using requestTempo().
+ * Since they might happen within the audio thread, walking the
+ * instruments and requesting their layers is left to the worker
+ * threads.
+ *
+ * Results are cached per source file, time ratio, pitch, and
+ * crispness. Switching back to a tempo used before or reloading a
+ * sample does not require it to be stretched again. Results still in use are never
+ * evicted. The total size of all others is bound by a budget and
+ * the least recently used ones are dropped first.
+ *
+ * Owned by Hydrogen (see Hydrogen::getSampleStretcher()).
+ *
+ * \ingroup docCore
+ */
+class SampleStretcher : public H2Core::Object<SampleStretcher>
+{
+	H2_OBJECT(SampleStretcher)
+public:
+	struct Stats {
+		/** Number of requests served from the cache.*/
+		long long nHits;
+		/** Number of requests which required stretching.*/
+		long long nMisses;
+		/** Number of requests replaced by a newer one for the same
+		 * layer before being processed.*/
+		long long nSuperseded;
+		/** Number of cached results.*/
+		int nEntries;
+		/** Number of requests not processed yet.*/
+		int nPending;
+	};
+
+	/**
+	 * \param nThreads Number of worker threads.
+	 * \param nBudget Bytes occupied by cached results no longer
+	 * used by any layer.
+	 */
+	SampleStretcher( int nThreads, size_t nBudget );
+	~SampleStretcher();
+
+	SampleStretcher( const SampleStretcher& ) = delete;
+	SampleStretcher& operator=( const SampleStretcher& ) = delete;
+
+	/**
+	 * Stretches @a pSource, or the sample it was stretched from, to
+	 * @a fBpm and assigns the result to @a pLayer once ready.
+	 *
+	 * Does neither block on stretching nor lock the AudioEngine
+	 * and may therefore be called while holding it.
+	 */
+	void request( std::shared_ptr<InstrumentLayer> pLayer, std::shared_ptr<Sample> pSource,
+				  float fBpm );
+	/**
+	 * Requests all samples of the current song to be stretched to
+	 * @a fBpm (see Hydrogen::recalculateRubberband()).
+	 *
+	 * Only stores the tempo, which is picked up by a worker thread
+	 * within #nPollInterval. Real-time safe. Subsequent calls before
+	 * that supersede each other.
+	 */
+	void requestTempo( float fBpm );
+	/** Blocks till all requests, including the tempo posted by
+	 * requestTempo(), are processed.
+	 *
+	 * Called by the OfflineRenderer after each block, so tempo
+	 * changes within the song are applied at the same position in
+	 * every export.*/
+	void wait();
+	/** Drops all pending requests and cached results.*/
+	void clear();
+
+	Stats getStats() const;
+
+	QString toQString( const QString& sPrefix, bool bShort = true ) const override;
+
+private:
+	struct Job {
+		std::weak_ptr<InstrumentLayer> pLayer;
+		/** Used to identify requests for the same layer.*/
+		const InstrumentLayer* pLayerKey;
+		std::shared_ptr<Sample> pSource;
+		float fBpm;
+	};
+
+	/** Identifies a result.*/
+	struct Key {
+		/** File the source was loaded from.*/
+		QString sFilepath;
+		/** The source itself in case its content differs from the
+		 * file (see Sample::get_is_modified()) and nullptr
+		 * otherwise. It is kept alive by the result (see
+		 * Sample::get_unstretched()).*/
+		const Sample* pModifiedSource;
+		double fRatio;
+		float fPitch;
+		int nCrispness;
+
+		bool operator<( const Key& other ) const;
+	};
+
+	struct Entry {
+		std::shared_ptr<Sample> pStretched;
+		size_t nBytes;
+		/** Position of the key within #m_lru.*/
+		std::list<Key>::iterator it;
+	};
+
+	static Key makeKey( const std::shared_ptr<Sample>& pSource, float fBpm );
+
+	/** Interval in which the worker threads check for a tempo
+	 * posted by requestTempo().*/
+	static constexpr std::chrono::milliseconds nPollInterval{ 20 };
+
+	void threadMain();
+	/** Requests the samples of the current song for @a fBpm while
+	 * holding the lock of the AudioEngine. Marking the song
+	 * modified is left to the event loop (see
+	 * #EVENT_UPDATE_SONG).*/
+	void processTempo( float fBpm );
+	/** Stretches the sample of @a job and assigns it.*/
+	void process( const Job& job );
+	/** \return Cached result for @a key or nullptr.*/
+	std::shared_ptr<Sample> lookup( const Key& key );
+	void insert( const Key& key, std::shared_ptr<Sample> pStretched );
+	/** Evicts unused results until the budget is met. Caller has to
+	 * hold #m_mutex.*/
+	void trimLocked();
+
+	std::vector<std::thread> m_threads;
+	bool m_bQuit;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_condition;
+	/** Signaled whenever a job is done.*/
+	std::condition_variable m_doneCondition;
+	std::deque<Job> m_jobs;
+	/** Number of jobs taken by the workers but not done yet.*/
+	int m_nActiveJobs;
+	/** Tempo posted by requestTempo() or 0 if there is none.*/
+	std::atomic<float> m_fPendingBpm;
+
+	std::map<Key, Entry> m_entries;
+	/** Keys of #m_entries. The most recently used one comes first.*/
+	std::list<Key> m_lru;
+	size_t m_nBudget;
+
+	long long m_nHits;
+	long long m_nMisses;
+	long long m_nSuperseded;
+};
+
+};
+
+#endif // H2C_SAMPLE_STRETCHER_H
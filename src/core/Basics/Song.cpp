@@ -34,6 +34,7 @@
 #include <core/Basics/Song.h>
 #include <core/Basics/DrumkitComponent.h>
 #include <core/Basics/Sample.h>
+#include <core/Basics/SampleLoader.h>
 #include <core/Basics/Instrument.h>
 #include <core/Basics/InstrumentComponent.h>
 #include <core/Basics/InstrumentList.h>
@@ -81,6 +82,7 @@ Song::Song( const QString& sName, const QString& sAuthor, float fBpm, float fVol
 	, m_fHumanizeTimeValue( 0.0 )
 	, m_fHumanizeVelocityValue( 0.0 )
 	, m_fSwingFactor( 0.0 )
+	, m_nRandomSeed( 0 )
 	, m_bIsModified( false )
 	, m_mode( Mode::Pattern )
 	, m_sPlaybackTrackFilename( "" )
@@ -689,6 +691,7 @@ QString Song::toQString( const QString& sPrefix, bool bShort ) const {
 			.append( QString( "%1%2m_fHumanizeTimeValue: %3\n" ).arg( sPrefix ).arg( s ).arg( m_fHumanizeTimeValue ) )
 			.append( QString( "%1%2m_fHumanizeVelocityValue: %3\n" ).arg( sPrefix ).arg( s ).arg( m_fHumanizeVelocityValue ) )
 			.append( QString( "%1%2m_fSwingFactor: %3\n" ).arg( sPrefix ).arg( s ).arg( m_fSwingFactor ) )
+			.append( QString( "%1%2m_nRandomSeed: %3\n" ).arg( sPrefix ).arg( s ).arg( m_nRandomSeed ) )
 			.append( QString( "%1%2m_bIsModified: %3\n" ).arg( sPrefix ).arg( s ).arg( m_bIsModified ) )
 			.append( QString( "%1%2m_latestRoundRobins\n" ).arg( sPrefix ).arg( s ) );
 		for ( auto mm : m_latestRoundRobins ) {
@@ -742,6 +745,7 @@ QString Song::toQString( const QString& sPrefix, bool bShort ) const {
 			.append( QString( ", m_fHumanizeTimeValue: %1" ).arg( m_fHumanizeTimeValue ) )
 			.append( QString( ", m_fHumanizeVelocityValue: %1" ).arg( m_fHumanizeVelocityValue ) )
 			.append( QString( ", m_fSwingFactor: %1" ).arg( m_fSwingFactor ) )
+			.append( QString( ", m_nRandomSeed: %1" ).arg( m_nRandomSeed ) )
 			.append( QString( ", m_bIsModified: %1" ).arg( m_bIsModified ) )
 			.append( QString( ", m_latestRoundRobins" ) );
 		for ( auto mm : m_latestRoundRobins ) {
@@ -863,6 +867,8 @@ std::shared_ptr<Song> SongReader::readSong( const QString& sFileName )
 	float fHumanizeTimeValue = LocalFileMng::readXmlFloat( songNode, "humanize_time", 0.0 );
 	float fHumanizeVelocityValue = LocalFileMng::readXmlFloat( songNode, "humanize_velocity", 0.0 );
 	float fSwingFactor = LocalFileMng::readXmlFloat( songNode, "swing_factor", 0.0 );
+	uint64_t nRandomSeed = LocalFileMng::readXmlString( songNode, "random_seed", "0", false, false )
+		.toULongLong();
 	bool bContainsIsTimelineActivated;
 	bool bIsTimelineActivated =
 		LocalFileMng::readXmlBool( songNode, "isTimelineActivated", false,
@@ -885,6 +891,7 @@ std::shared_ptr<Song> SongReader::readSong( const QString& sFileName )
 	pSong->setHumanizeTimeValue( fHumanizeTimeValue );
 	pSong->setHumanizeVelocityValue( fHumanizeVelocityValue );
 	pSong->setSwingFactor( fSwingFactor );
+	pSong->setRandomSeed( nRandomSeed );
 	pSong->setPlaybackTrackFilename( sPlaybackTrack );
 	pSong->setPlaybackTrackEnabled( bPlaybackTrackEnabled );
 	pSong->setPlaybackTrackVolume( fPlaybackTrackVolume );
@@ -959,6 +966,8 @@ std::shared_ptr<Song> SongReader::readSong( const QString& sFileName )
 
 	//  Instrument List
 	InstrumentList* pInstrList = new InstrumentList();
+	SampleLoader sampleLoader;
+	const bool bLazyLayerLoading = Preferences::get_instance()->m_bLazyLayerLoading;
 
 	QDomNode instrumentListNode = songNode.firstChildElement( "instrumentList" );
 	if ( ( ! instrumentListNode.isNull()  ) ) {
@@ -1029,6 +1038,7 @@ std::shared_ptr<Song> SongReader::readSong( const QString& sFileName )
 			QString sMidiOutChannel = LocalFileMng::readXmlString( instrumentNode, "midiOutChannel", "-1", false, false );
 			QString sMidiOutNote = LocalFileMng::readXmlString( instrumentNode, "midiOutNote", "60", false, false );
 			int nMuteGroup = sMuteGroup.toInt();
+			int nMaxVoices = LocalFileMng::readXmlInt( instrumentNode, "maxVoices", 0, false, false );
 			bool isStopNote = LocalFileMng::readXmlBool( instrumentNode, "isStopNote", false );
 			QString sRead_sample_select_algo = LocalFileMng::readXmlString( instrumentNode, "sampleSelectionAlgo", "VELOCITY" );
 
@@ -1064,6 +1074,7 @@ std::shared_ptr<Song> SongReader::readSong( const QString& sFileName )
 			pInstrument->set_filter_resonance( fFilterResonance );
 			pInstrument->set_gain( fGain );
 			pInstrument->set_mute_group( nMuteGroup );
+			pInstrument->set_max_voices( nMaxVoices );
 			pInstrument->set_stop_notes( isStopNote );
 			pInstrument->set_hihat_grp( iIsHiHat );
 			pInstrument->set_lower_cc( iLowerCC );
@@ -1095,24 +1106,29 @@ std::shared_ptr<Song> SongReader::readSong( const QString& sFileName )
 				if ( !QFile( sFilename ).exists() && !drumkitPath.isEmpty() ) {
 					sFilename = drumkitPath + "/" + sFilename;
 				}
-				auto pSample = Sample::load( sFilename );
-				if ( pSample == nullptr ) {
-					// nel passaggio tra 0.8.2 e 0.9.0 il drumkit di default e' cambiato.
-					// Se fallisce provo a caricare il corrispettivo file in formato flac
-//					warningLog( "[readSong] Error loading sample: " + sFilename + " not found. Trying to load a flac..." );
-					sFilename = sFilename.left( sFilename.length() - 4 );
-					sFilename += ".flac";
-					pSample = Sample::load( sFilename );
-				}
-				if ( pSample == nullptr ) {
-					ERRORLOG( "Error loading sample: " + sFilename + " not found" );
-					pInstrument->set_muted( true );
-					pInstrument->set_missing_samples( true );
-				}
 				auto pCompo = std::make_shared<InstrumentComponent>( 0 );
-				auto pLayer = std::make_shared<InstrumentLayer>( pSample );
+				auto pLayer = std::make_shared<InstrumentLayer>( nullptr );
 				pCompo->set_layer( pLayer, 0 );
 				pInstrument->get_components()->push_back( pCompo );
+				sampleLoader.add( [sFilename]() mutable {
+					auto pSample = Sample::load( sFilename );
+					if ( pSample == nullptr ) {
+						// nel passaggio tra 0.8.2 e 0.9.0 il drumkit di default e' cambiato.
+						// Se fallisce provo a caricare il corrispettivo file in formato flac
+//						warningLog( "[readSong] Error loading sample: " + sFilename + " not found. Trying to load a flac..." );
+						sFilename = sFilename.left( sFilename.length() - 4 );
+						sFilename += ".flac";
+						pSample = Sample::load( sFilename );
+					}
+					return pSample;
+				}, [pInstrument, pLayer, sFilename]( std::shared_ptr<Sample> pSample ) {
+					if ( pSample == nullptr ) {
+						ERRORLOG( "Error loading sample: " + sFilename + " not found" );
+						pInstrument->set_muted( true );
+						pInstrument->set_missing_samples( true );
+					}
+					pLayer->set_sample( pSample );
+				} );
 			}
 			//~ back compatibility code
 			else {
@@ -1162,14 +1178,12 @@ std::shared_ptr<Song> SongReader::readSong( const QString& sFileName )
 							ro.use = false;
 						}
 
-						std::shared_ptr<Sample> pSample;
-						if ( !sIsModified ) {
-							pSample = Sample::load( sFilename );
-						} else {
+						Sample::VelocityEnvelope velocity;
+						Sample::VelocityEnvelope pan;
+						if ( sIsModified ) {
 							// FIXME, kill EnvelopePoint, create Envelope class
 							EnvelopePoint pt;
 
-							Sample::VelocityEnvelope velocity;
 							QDomNode volumeNode = layerNode.firstChildElement( "volume" );
 							while (  ! volumeNode.isNull()  ) {
 								pt.frame = LocalFileMng::readXmlInt( volumeNode, "volume-position", 0 );
@@ -1179,7 +1193,6 @@ std::shared_ptr<Song> SongReader::readSong( const QString& sFileName )
 								//ERRORLOG( QString("volume-posi %1").arg(LocalFileMng::readXmlInt( volumeNode, "volume-position", 0)) );
 							}
 
-							Sample::VelocityEnvelope pan;
 							QDomNode  panNode = layerNode.firstChildElement( "pan" );
 							while (  ! panNode.isNull()  ) {
 								pt.frame = LocalFileMng::readXmlInt( panNode, "pan-position", 0 );
@@ -1187,20 +1200,37 @@ std::shared_ptr<Song> SongReader::readSong( const QString& sFileName )
 								pan.push_back( pt );
 								panNode = panNode.nextSiblingElement( "pan" );
 							}
-
-							pSample = Sample::load( sFilename, lo, ro, velocity, pan, fBpm );
 						}
-						if ( pSample == nullptr ) {
-							ERRORLOG( "Error loading sample: " + sFilename + " not found" );
-							pInstrument->set_muted( true );
-							pInstrument->set_missing_samples( true );
-						}
-						auto pLayer = std::make_shared<InstrumentLayer>( pSample );
+
+						auto pLayer = std::make_shared<InstrumentLayer>( nullptr );
 						pLayer->set_start_velocity( fMin );
 						pLayer->set_end_velocity( fMax );
 						pLayer->set_gain( fGain );
 						pLayer->set_pitch( fPitch );
 						pCompo->set_layer( pLayer, nLayer );
+						// Modified samples are always decoded right away.
+						const bool bDeferred = bLazyLayerLoading && ! sIsModified;
+						sampleLoader.add( [sFilename, bDeferred]() {
+							return bDeferred ? Sample::create_deferred( sFilename ) : Sample::load( sFilename );
+						}, [=]( std::shared_ptr<Sample> pSample ) {
+							if ( pSample == nullptr ) {
+								ERRORLOG( "Error loading sample: " + sFilename + " not found" );
+								pInstrument->set_muted( true );
+								pInstrument->set_missing_samples( true );
+							}
+							else if ( sIsModified ) {
+								// Rubber Band is applied in the background once
+								// the song is set (see Hydrogen::stretchSamples()).
+								pSample->apply_loops( lo );
+								pSample->apply_velocity( velocity );
+								pSample->apply_pan( pan );
+								pSample->set_rubberband( ro );
+							}
+							pLayer->set_sample( pSample );
+							if ( pSample != nullptr && bDeferred ) {
+								pLayer->defer_sample();
+							}
+						} );
 						nLayer++;
 
 						layerNode = ( QDomNode ) layerNode.nextSiblingElement( "layer" );
@@ -1250,13 +1280,11 @@ std::shared_ptr<Song> SongReader::readSong( const QString& sFileName )
 							ro.use = false;
 						}
 
-						std::shared_ptr<Sample> pSample = nullptr;
-						if ( !sIsModified ) {
-							pSample = Sample::load( sFilename );
-						} else {
+						Sample::VelocityEnvelope velocity;
+						Sample::VelocityEnvelope pan;
+						if ( sIsModified ) {
 							EnvelopePoint pt;
 
-							Sample::VelocityEnvelope velocity;
 							QDomNode volumeNode = layerNode.firstChildElement( "volume" );
 							while (  ! volumeNode.isNull()  ) {
 								pt.frame = LocalFileMng::readXmlInt( volumeNode, "volume-position", 0 );
@@ -1266,7 +1294,6 @@ std::shared_ptr<Song> SongReader::readSong( const QString& sFileName )
 								//ERRORLOG( QString("volume-posi %1").arg(LocalFileMng::readXmlInt( volumeNode, "volume-position", 0)) );
 							}
 
-							Sample::VelocityEnvelope pan;
 							QDomNode  panNode = layerNode.firstChildElement( "pan" );
 							while (  ! panNode.isNull()  ) {
 								pt.frame = LocalFileMng::readXmlInt( panNode, "pan-position", 0 );
@@ -1274,20 +1301,37 @@ std::shared_ptr<Song> SongReader::readSong( const QString& sFileName )
 								pan.push_back( pt );
 								panNode = panNode.nextSiblingElement( "pan" );
 							}
-
-							pSample = Sample::load( sFilename, lo, ro, velocity, pan, fBpm );
 						}
-						if ( pSample == nullptr ) {
-							ERRORLOG( "Error loading sample: " + sFilename + " not found" );
-							pInstrument->set_muted( true );
-							pInstrument->set_missing_samples( true );
-						}
-						auto pLayer = std::make_shared<InstrumentLayer>( pSample );
+
+						auto pLayer = std::make_shared<InstrumentLayer>( nullptr );
 						pLayer->set_start_velocity( fMin );
 						pLayer->set_end_velocity( fMax );
 						pLayer->set_gain( fGain );
 						pLayer->set_pitch( fPitch );
 						pCompo->set_layer( pLayer, nLayer );
+						// Modified samples are always decoded right away.
+						const bool bDeferred = bLazyLayerLoading && ! sIsModified;
+						sampleLoader.add( [sFilename, bDeferred]() {
+							return bDeferred ? Sample::create_deferred( sFilename ) : Sample::load( sFilename );
+						}, [=]( std::shared_ptr<Sample> pSample ) {
+							if ( pSample == nullptr ) {
+								ERRORLOG( "Error loading sample: " + sFilename + " not found" );
+								pInstrument->set_muted( true );
+								pInstrument->set_missing_samples( true );
+							}
+							else if ( sIsModified ) {
+								// Rubber Band is applied in the background once
+								// the song is set (see Hydrogen::stretchSamples()).
+								pSample->apply_loops( lo );
+								pSample->apply_velocity( velocity );
+								pSample->apply_pan( pan );
+								pSample->set_rubberband( ro );
+							}
+							pLayer->set_sample( pSample );
+							if ( pSample != nullptr && bDeferred ) {
+								pLayer->defer_sample();
+							}
+						} );
 						nLayer++;
 
 						layerNode = ( QDomNode ) layerNode.nextSiblingElement( "layer" );
@@ -1299,6 +1343,9 @@ std::shared_ptr<Song> SongReader::readSong( const QString& sFileName )
 			instrumentNode = ( QDomNode ) instrumentNode.nextSiblingElement( "instrument" );
 		}
 
+		// The samples of all instruments are decoded concurrently.
+		sampleLoader.run();
+
 		if ( instrumentList_count == 0 ) {
 			WARNINGLOG( "0 instruments?" );
 		}
@@ -29,6 +29,7 @@
 #include <vector>
 #include <map>
 #include <memory>
+#include <cstdint>
 
 #include <core/Object.h>
 
@@ -169,6 +170,11 @@ class Song : public H2Core::Object<Song>, public std::enable_shared_from_this<So
 		float			getSwingFactor() const;
 		void			setSwingFactor( float fFactor );
 
+		/** \return #m_nRandomSeed */
+		uint64_t		getRandomSeed() const;
+		/** \param nSeed Sets #m_nRandomSeed */
+		void			setRandomSeed( uint64_t nSeed );
+
 		Mode			getMode() const;
 		void			setMode( Mode mode );
 							
@@ -189,6 +195,9 @@ class Song : public H2Core::Object<Song>, public std::enable_shared_from_this<So
 							
 		int			getLatestRoundRobin( float fStartVelocity );
 		void			setLatestRoundRobin( float fStartVelocity, int nLatestRoundRobin );
+		/** Starts all instruments using Instrument::ROUND_ROBIN
+		 * with their first layer again.*/
+		void			clearLatestRoundRobins();
 		/** \return #m_sPlaybackTrackFilename */
 		const QString&		getPlaybackTrackFilename() const;
 		/** \param sFilename Sets #m_sPlaybackTrackFilename. */
@@ -289,6 +298,13 @@ class Song : public H2Core::Object<Song>, public std::enable_shared_from_this<So
 		float			m_fHumanizeTimeValue;
 		float			m_fHumanizeVelocityValue;
 		float			m_fSwingFactor;
+		/**
+		 * Seed of the random numbers used for humanization, note
+		 * probability, and random layer selection in case the song
+		 * is exported deterministically (see
+		 * Hydrogen::startExportSong()). 0 by default.
+		 */
+		uint64_t		m_nRandomSeed;
 		bool			m_bIsModified;
 		std::map< float, int> 	m_latestRoundRobins;
 		Mode			m_mode;
@@ -530,6 +546,17 @@ inline float Song::getSwingFactor() const
 	return m_fSwingFactor;
 }
 
+inline uint64_t Song::getRandomSeed() const
+{
+	return m_nRandomSeed;
+}
+
+inline void Song::setRandomSeed( uint64_t nSeed )
+{
+	m_nRandomSeed = nSeed;
+	setIsModified( true );
+}
+
 inline Song::Mode Song::getMode() const
 {
 	return m_mode;
@@ -566,6 +593,11 @@ inline void Song::setLatestRoundRobin( float fStartVelocity, int nLatestRoundRob
 	setIsModified( true );
 }
 
+inline void Song::clearLatestRoundRobins()
+{
+	m_latestRoundRobins.clear();
+}
+
 inline const QString& Song::getPlaybackTrackFilename() const
 {
 	return m_sPlaybackTrackFilename;
@@ -128,6 +128,8 @@ enum EventType {
 	 * - 1 - triggered whenever the Song was saved via the core part
 	 *       (updated the title and status bar).
 	 * - 2 - Song is not writable (inform the user via a QMessageBox)
+	 * - 3 - the SampleStretcher requested the samples of the Song
+	 *       to be stretched to a new tempo (marks the Song modified).
 	 */
 	EVENT_UPDATE_SONG,
 	/**
@@ -47,6 +47,7 @@
 #define PLAYLISTS       "playlists/"
 #define PLUGINS         "plugins/"
 #define REPOSITORIES    "repositories/"
+#define SAMPLES         "samples/"
 #define SCRIPTS         "scripts/"
 #define SONGS           "songs/"
 #define THEMES          "themes/"
@@ -391,6 +392,7 @@ bool Filesystem::check_usr_paths()
 	if( !path_usable( __usr_data_path ) ) ret = false;
 	if( !path_usable( cache_dir() ) ) ret = false;
 	if( !path_usable( repositories_cache_dir() ) ) ret = false;
+	if( !path_usable( sample_cache_dir() ) ) ret = false;
 	if( !path_usable( usr_drumkits_dir() ) ) ret = false;
 	if( !path_usable( patterns_dir() ) ) ret = false;
 	if( !path_usable( playlists_dir() ) ) ret = false;
@@ -546,6 +548,10 @@ QString Filesystem::repositories_cache_dir()
 {
 	return __usr_data_path + CACHE + REPOSITORIES;
 }
+QString Filesystem::sample_cache_dir()
+{
+	return __usr_data_path + CACHE + SAMPLES;
+}
 QString Filesystem::demos_dir()
 {
 	return __sys_data_path + DEMOS;
@@ -823,6 +829,7 @@ void Filesystem::info()
 	INFOLOG( QString( "User Click file            : %1" ).arg( usr_click_file_path() ) );
 	INFOLOG( QString( "Cache dir                  : %1" ).arg( cache_dir() ) );
 	INFOLOG( QString( "Reporitories Cache dir     : %1" ).arg( repositories_cache_dir() ) );
+	INFOLOG( QString( "Sample Cache dir           : %1" ).arg( sample_cache_dir() ) );
 	INFOLOG( QString( "User drumkit dir           : %1" ).arg( usr_drumkits_dir() ) );
 	INFOLOG( QString( "Patterns dir               : %1" ).arg( patterns_dir() ) );
 	INFOLOG( QString( "Playlist dir               : %1" ).arg( playlists_dir() ) );
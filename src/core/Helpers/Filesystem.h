@@ -154,6 +154,8 @@ namespace H2Core
 		static QString cache_dir();
 		/** returns user repository cache path */
 		static QString repositories_cache_dir();
+		/** returns user decoded sample cache path */
+		static QString sample_cache_dir();
 		/** returns system demos path */
 		static QString demos_dir();
 		/** returns system xsd path */
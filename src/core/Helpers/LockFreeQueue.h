@@ -0,0 +1,144 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2C_LOCK_FREE_QUEUE_H
+#define H2C_LOCK_FREE_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+namespace H2Core
+{
+
+/**
+ * Bounded multi-producer/single-consumer FIFO which never blocks.
+ *
+ * All storage is allocated on construction. Each slot carries a
+ * sequence number telling producers and the consumer whether it is
+ * free or filled (the array based queue by D. Vyukov). Producers
+ * claim a slot using a compare-and-swap on the write index, the
+ * single consumer - the audio thread - does not need any atomic
+ * read-modify-write operation at all and is therefore wait-free.
+ *
+ * \tparam T Copyable element type.
+ * \tparam nCapacity Maximum number of elements. Must be a power of two.
+ */
+/** \ingroup docCore docAudioEngine*/
+template <typename T, size_t nCapacity>
+class LockFreeQueue
+{
+	static_assert( nCapacity >= 2 && ( nCapacity & ( nCapacity - 1 ) ) == 0,
+				   "LockFreeQueue capacity must be a power of two" );
+public:
+	LockFreeQueue() : m_nWriteIndex( 0 ), m_nReadIndex( 0 ) {
+		for ( size_t ii = 0; ii < nCapacity; ++ii ) {
+			m_slots[ ii ].nSequence.store( ii, std::memory_order_relaxed );
+		}
+	}
+
+	LockFreeQueue( const LockFreeQueue& ) = delete;
+	LockFreeQueue& operator=( const LockFreeQueue& ) = delete;
+
+	/**
+	 * Appends @a element. Safe to be called from any number of
+	 * threads concurrently.
+	 *
+	 * \return false if the queue is full and @a element was not added.
+	 */
+	bool push( const T& element ) {
+		size_t nPos = m_nWriteIndex.load( std::memory_order_relaxed );
+		Slot* pSlot;
+		for (;;) {
+			pSlot = &m_slots[ nPos & ( nCapacity - 1 ) ];
+			const size_t nSequence = pSlot->nSequence.load( std::memory_order_acquire );
+			const std::ptrdiff_t nDiff = static_cast<std::ptrdiff_t>( nSequence ) -
+				static_cast<std::ptrdiff_t>( nPos );
+			if ( nDiff == 0 ) {
+				if ( m_nWriteIndex.compare_exchange_weak( nPos, nPos + 1,
+														  std::memory_order_relaxed ) ) {
+					break;
+				}
+			} else if ( nDiff < 0 ) {
+				// Consumer did not catch up yet.
+				return false;
+			} else {
+				nPos = m_nWriteIndex.load( std::memory_order_relaxed );
+			}
+		}
+		pSlot->element = element;
+		pSlot->nSequence.store( nPos + 1, std::memory_order_release );
+		return true;
+	}
+
+	/**
+	 * Removes the oldest element and stores it in @a element. Must
+	 * only be called by a single thread at a time.
+	 *
+	 * \return false if the queue was empty.
+	 */
+	bool pop( T& element ) {
+		const size_t nPos = m_nReadIndex.load( std::memory_order_relaxed );
+		Slot* pSlot = &m_slots[ nPos & ( nCapacity - 1 ) ];
+		const size_t nSequence = pSlot->nSequence.load( std::memory_order_acquire );
+		if ( nSequence != nPos + 1 ) {
+			// Empty or the producer owning the slot did not finish
+			// writing yet.
+			return false;
+		}
+		element = pSlot->element;
+		pSlot->nSequence.store( nPos + nCapacity, std::memory_order_release );
+		m_nReadIndex.store( nPos + 1, std::memory_order_relaxed );
+		return true;
+	}
+
+	/** \return Approximate number of elements. Only meaningful
+	 * for the consumer thread or for displaying purposes. */
+	size_t size() const {
+		const size_t nRead = m_nReadIndex.load( std::memory_order_relaxed );
+		const size_t nWrite = m_nWriteIndex.load( std::memory_order_relaxed );
+		return nWrite > nRead ? nWrite - nRead : 0;
+	}
+
+	bool empty() const {
+		return size() == 0;
+	}
+
+	static constexpr size_t capacity() {
+		return nCapacity;
+	}
+
+private:
+	struct Slot {
+		std::atomic<size_t> nSequence;
+		T element;
+	};
+
+	Slot m_slots[ nCapacity ];
+	/** Only modified by producers. Kept on a cache line of its own
+	 * to not invalidate the one of the consumer.*/
+	alignas( 64 ) std::atomic<size_t> m_nWriteIndex;
+	alignas( 64 ) std::atomic<size_t> m_nReadIndex;
+};
+
+};
+
+#endif // H2C_LOCK_FREE_QUEUE_H
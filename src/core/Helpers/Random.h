@@ -0,0 +1,163 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+
+#ifndef H2C_RANDOM_H
+#define H2C_RANDOM_H
+
+#include <cstdint>
+
+namespace H2Core
+{
+
+/**
+ * Pseudo random number generator used by the audio engine for
+ * humanization, note probability and the selection of layers.
+ *
+ * Based on xoshiro128** by D. Blackman and S. Vigna. In contrast to
+ * rand() each instance has a state of its own, so it neither
+ * interferes with other threads nor depends on them. Seeded with the
+ * same value it yields the same sequence on all platforms.
+ *
+ * Gaussian numbers are drawn in blocks of #nGaussianBlock using
+ * integer arithmetic only (see fillGaussian()). Neither the
+ * standard library nor the floating point settings of the compiler
+ * affect the results.
+ *
+ * Real-time safe. Not to be used by several threads at once.
+ */
+/** \ingroup docCore docAudioEngine*/
+class Random
+{
+public:
+	static constexpr int nGaussianBlock = 64;
+
+	explicit Random( uint64_t nSeed = 0 ) {
+		seed( nSeed );
+	}
+
+	/** Resets the state as well as all buffered Gaussian numbers.*/
+	void seed( uint64_t nSeed ) {
+		// The state must not be all zero. SplitMix64 ensures this
+		// and decorrelates similar seeds.
+		for ( int ii = 0; ii < 4; ii += 2 ) {
+			nSeed += 0x9e3779b97f4a7c15ULL;
+			uint64_t z = nSeed;
+			z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ULL;
+			z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebULL;
+			z ^= z >> 31;
+			m_state[ ii ] = static_cast<uint32_t>( z );
+			m_state[ ii + 1 ] = static_cast<uint32_t>( z >> 32 );
+		}
+		m_nGaussianIndex = nGaussianBlock;
+	}
+
+	/** \return Uniformly distributed 32 bit number.*/
+	uint32_t next() {
+		const uint32_t nResult = rotl( m_state[ 1 ] * 5, 7 ) * 9;
+		const uint32_t t = m_state[ 1 ] << 9;
+		m_state[ 2 ] ^= m_state[ 0 ];
+		m_state[ 3 ] ^= m_state[ 1 ];
+		m_state[ 1 ] ^= m_state[ 2 ];
+		m_state[ 0 ] ^= m_state[ 3 ];
+		m_state[ 2 ] ^= t;
+		m_state[ 3 ] = rotl( m_state[ 3 ], 11 );
+		return nResult;
+	}
+
+	/** \return Uniformly distributed number in [0, 1).*/
+	float uniform() {
+		return static_cast<float>( next() >> 8 ) * fScale;
+	}
+
+	/** \return Uniformly distributed integer in [0, @a nMax). @a
+	 * nMax has to be positive.*/
+	int below( int nMax ) {
+		return static_cast<int>( ( static_cast<uint64_t>( next() ) *
+								   static_cast<uint64_t>( nMax ) ) >> 32 );
+	}
+
+	/** \return Normally distributed number with zero mean and
+	 * standard deviation @a fStdDev.*/
+	float gaussian( float fStdDev = 1.0f ) {
+		if ( m_nGaussianIndex == nGaussianBlock ) {
+			fillGaussian( m_gaussians, nGaussianBlock );
+			m_nGaussianIndex = 0;
+		}
+		return m_gaussians[ m_nGaussianIndex++ ] * fStdDev;
+	}
+
+	/**
+	 * Writes @a nCount numbers of the standard normal distribution
+	 * into @a pBuffer.
+	 *
+	 * Each one is the sum of twelve uniform numbers shifted by -6
+	 * (Irwin-Hall), which is bound to [-6, 6) but otherwise close to
+	 * normal. Only drawing the raw numbers is sequential. Summing
+	 * them is done in integers in loops the compiler is able to
+	 * vectorize. The only rounding takes place in the final
+	 * conversion to float, which is the same on all platforms.
+	 */
+	void fillGaussian( float* pBuffer, int nCount ) {
+		uint32_t raw[ nTerms ][ nGaussianBlock ];
+		uint32_t sums[ nGaussianBlock ];
+		for ( int nStart = 0; nStart < nCount; nStart += nGaussianBlock ) {
+			const int nBlock = nCount - nStart < nGaussianBlock ?
+				nCount - nStart : nGaussianBlock;
+			for ( int ii = 0; ii < nBlock; ++ii ) {
+				for ( int nTerm = 0; nTerm < nTerms; ++nTerm ) {
+					raw[ nTerm ][ ii ] = next();
+				}
+			}
+			for ( int ii = 0; ii < nBlock; ++ii ) {
+				sums[ ii ] = 0;
+			}
+			for ( int nTerm = 0; nTerm < nTerms; ++nTerm ) {
+				for ( int ii = 0; ii < nBlock; ++ii ) {
+					sums[ ii ] += raw[ nTerm ][ ii ] >> 8;
+				}
+			}
+			for ( int ii = 0; ii < nBlock; ++ii ) {
+				pBuffer[ nStart + ii ] =
+					static_cast<float>( static_cast<int32_t>( sums[ ii ] ) - nOffset ) * fScale;
+			}
+		}
+	}
+
+private:
+	static constexpr int nTerms = 12;
+	/** Mean of the sum of #nTerms 24 bit numbers.*/
+	static constexpr int32_t nOffset = nTerms / 2 * ( 1 << 24 );
+	static constexpr float fScale = 1.0f / 16777216.0f;
+
+	static uint32_t rotl( uint32_t x, int k ) {
+		return ( x << k ) | ( x >> ( 32 - k ) );
+	}
+
+	uint32_t m_state[ 4 ];
+	float m_gaussians[ nGaussianBlock ];
+	int m_nGaussianIndex;
+};
+
+};
+
+#endif // H2C_RANDOM_H
@@ -39,6 +39,9 @@
 #include <algorithm>
 #include <thread>
 #include <chrono>
+#include <iterator>
+#include <map>
+#include <set>
 
 #include <QtCore/QMutex>
 #include <QtCore/QMutexLocker>
@@ -49,6 +52,7 @@
 #include <core/Basics/DrumkitComponent.h>
 #include <core/H2Exception.h>
 #include <core/AudioEngine/AudioEngine.h>
+#include <core/AudioEngine/OfflineRenderer.h>
 #include <core/AudioEngine/TransportInfo.h>
 #include <core/Basics/Instrument.h>
 #include <core/Basics/InstrumentComponent.h>
@@ -56,6 +60,9 @@
 #include <core/Basics/InstrumentLayer.h>
 #include <core/Basics/Playlist.h>
 #include <core/Basics/Sample.h>
+#include <core/Basics/SampleCache.h>
+#include <core/Basics/SampleLoader.h>
+#include <core/Basics/SampleStretcher.h>
 #include <core/Basics/AutomationPath.h>
 #include <core/Hydrogen.h>
 #include <core/Basics/Pattern.h>
@@ -66,6 +73,7 @@
 #include <core/FX/Effects.h>
 
 #include <core/Preferences/Preferences.h>
+#include <core/Sampler/LayerLoader.h>
 #include <core/Sampler/Sampler.h>
 #include "MidiMap.h"
 
@@ -117,6 +125,8 @@ Hydrogen::Hydrogen() : m_nSelectedInstrumentNumber( 0 )
 
 	m_pTimeline = std::make_shared<Timeline>();
 	m_pCoreActionController = new CoreActionController();
+	m_pSampleStretcher = new SampleStretcher( SampleLoader::getThreadCount(),
+											  SampleCache::get_instance()->getBudget() );
 
 	initBeatcounter();
 	InstrumentComponent::setMaxLayers( Preferences::get_instance()->getMaxLayers() );
@@ -156,6 +166,10 @@ Hydrogen::~Hydrogen()
 	}
 #endif
 	
+	// Workers assign their results while locking the AudioEngine.
+	delete m_pSampleStretcher;
+	m_pSampleStretcher = nullptr;
+
 	removeSong();
 	
 	__kill_instruments();
@@ -175,6 +189,7 @@ void Hydrogen::create_instance()
 	Preferences::create_instance();
 	EventQueue::create_instance();
 	MidiActionManager::create_instance();
+	SampleCache::create_instance();
 
 #ifdef H2CORE_HAVE_OSC
 	NsmClient::create_instance();
@@ -281,6 +296,13 @@ void Hydrogen::setSong( std::shared_ptr<Song> pSong )
 	// audioEngine_setSong().
 	__song = pSong;
 
+	// Layers used by the song are loaded right away.
+	if ( Preferences::get_instance()->m_bLazyLayerLoading ) {
+		loadDeferredLayers( pSong->getInstrumentList(), pSong->getPatternList() );
+	}
+	resampleSamples();
+	stretchSamples( pSong->getBpm() );
+
 	// Update the audio engine to work with the new song.
 	m_pAudioEngine->setSong( pSong );
 
@@ -498,12 +520,12 @@ void Hydrogen::addRealtimeNote(	int		instrument,
 
 	if ( !pPreferences->__playselectedinstrument ) {
 		if ( hearnote && instrRef ) {
-			Note *pNote2 = new Note( instrRef, nRealColumn, velocity, fPan, -1, 0 );
+			Note *pNote2 = pAudioEngine->getNotePool()->acquire( instrRef, nRealColumn, velocity, fPan, -1, 0 );
 			midi_noteOn( pNote2 );
 		}
 	} else if ( hearnote  ) {
 		auto pInstr = pSong->getInstrumentList()->get( getSelectedInstrumentNumber() );
-		Note *pNote2 = new Note( pInstr, nRealColumn, velocity, fPan, -1, 0 );
+		Note *pNote2 = pAudioEngine->getNotePool()->acquire( pInstr, nRealColumn, velocity, fPan, -1, 0 );
 
 		int divider = msg1 / 12;
 		Note::Octave octave = (Note::Octave)(divider -3);
@@ -521,63 +543,62 @@ void Hydrogen::addRealtimeNote(	int		instrument,
 void Hydrogen::sequencer_setNextPattern( int pos )
 {
 	AudioEngine* pAudioEngine = m_pAudioEngine;
-	
-	pAudioEngine->lock( RIGHT_HERE );
 	std::shared_ptr<Song> pSong = getSong();
 	if ( pSong != nullptr && getMode() == Song::Mode::Pattern ) {
 		PatternList* pPatternList = pSong->getPatternList();
-		
+
 		// Check whether `pos` is in range of the pattern list.
 		if ( ( pos >= 0 ) && ( pos < ( int )pPatternList->size() ) ) {
-			Pattern* pPattern = pPatternList->get( pos );
-			
-			// If the pattern is already in the `AudioEngine::m_pNextPatterns`, it
-			// will be removed from the latter and its `del()` method
-			// will return a pointer to the very pattern. The if
-			// clause is therefore only entered if the `pPattern` was
-			// not already present.
-			if ( pAudioEngine->getNextPatterns()->del( pPattern ) == nullptr ) {
-				pAudioEngine->getNextPatterns()->add( pPattern );
+			// Toggling is done by the audio thread at the beginning
+			// of the next cycle.
+			// The pattern itself is passed since its index might
+			// change before the command is applied.
+			EngineCommand command;
+			command.type = EngineCommand::Type::ToggleNextPattern;
+			command.pNote = nullptr;
+			command.nValue = 0;
+			command.pPattern = pPatternList->get( pos );
+			if ( pAudioEngine->pushCommand( command ) ) {
+				return;
 			}
 		} else {
 			ERRORLOG( QString( "pos not in patternList range. pos=%1 patternListSize=%2" )
 					  .arg( pos ).arg( pPatternList->size() ) );
-			pAudioEngine->getNextPatterns()->clear();
 		}
 	} else {
 		ERRORLOG( "can't set next pattern in song mode" );
-		pAudioEngine->getNextPatterns()->clear();
 	}
 
+	// Clearing has to happen right away since the caller might
+	// delete patterns afterwards.
+	pAudioEngine->lock( RIGHT_HERE );
+	pAudioEngine->getNextPatterns()->clear();
 	pAudioEngine->unlock();
 }
 
 void Hydrogen::sequencer_setOnlyNextPattern( int pos )
 {
-	AudioEngine* pAudioEngine = m_pAudioEngine;	
-	pAudioEngine->lock( RIGHT_HERE );
-	
+	AudioEngine* pAudioEngine = m_pAudioEngine;
 	std::shared_ptr<Song> pSong = getSong();
 	if ( pSong != nullptr && getMode() == Song::Mode::Pattern ) {
+		// An invalid `pos` still replaces the next patterns by the
+		// playing ones.
 		PatternList* pPatternList = pSong->getPatternList();
-		
-		// Clear the list of all patterns scheduled to be processed
-		// next and fill them with those currently played.
-		pAudioEngine->getNextPatterns()->clear( );
-		Pattern* pPattern;
-		for ( int nPattern = 0 ; nPattern < (int) pAudioEngine->getPlayingPatterns()->size() ; ++nPattern ) {
-			pPattern = pAudioEngine->getPlayingPatterns()->get( nPattern );
-			pAudioEngine->getNextPatterns()->add( pPattern );
+		EngineCommand command;
+		command.type = EngineCommand::Type::SetOnlyNextPattern;
+		command.pNote = nullptr;
+		command.nValue = 0;
+		command.pPattern = ( pos >= 0 && pos < pPatternList->size() ) ?
+			pPatternList->get( pos ) : nullptr;
+		if ( pAudioEngine->pushCommand( command ) ) {
+			return;
 		}
-		
-		// Appending the requested pattern.
-		pPattern = pPatternList->get( pos );
-		pAudioEngine->getNextPatterns()->add( pPattern );
 	} else {
 		ERRORLOG( "can't set next pattern in song mode" );
-		pAudioEngine->getNextPatterns()->clear();
 	}
-	
+
+	pAudioEngine->lock( RIGHT_HERE );
+	pAudioEngine->getNextPatterns()->clear();
 	pAudioEngine->unlock();
 }
 
@@ -612,7 +633,8 @@ bool Hydrogen::startExportSession(int sampleRate, int sampleDepth )
 	pAudioEngine->stopAudioDrivers();
 
 	DiskWriterDriver* pNewDriver = new DiskWriterDriver( AudioEngine::audioEngine_process, nSamplerate, sampleDepth );
-	int nRes = pNewDriver->init( Preferences::get_instance()->m_nBufferSize );
+	// Exporting is not bound to the latency of the realtime drivers.
+	int nRes = pNewDriver->init( OfflineRenderer::nDefaultBlockSize );
 	if ( nRes != 0 ) {
 		ERRORLOG( "Unable to initialize disk writer driver." );
 		return false;
@@ -626,16 +648,25 @@ bool Hydrogen::startExportSession(int sampleRate, int sampleDepth )
 }
 
 /// Export a song to a wav file
-void Hydrogen::startExportSong( const QString& filename)
+void Hydrogen::startExportSong( const QString& filename, bool bExportStems, bool bDeterministic )
 {
 	AudioEngine* pAudioEngine = m_pAudioEngine;
+	// The export has to use the stretched samples and must not fall
+	// back to other layers.
+	m_pSampleStretcher->wait();
+	loadDeferredLayers( getSong()->getInstrumentList() );
 	pAudioEngine->reset();
 	pAudioEngine->play();
 	getCoreActionController()->locateToFrame( 0 );
 	pAudioEngine->getSampler()->stopPlayingNotes();
+	if ( bDeterministic ) {
+		getSong()->clearLatestRoundRobins();
+		pAudioEngine->seedRandom( getSong()->getRandomSeed() );
+	}
 
 	DiskWriterDriver* pDiskWriterDriver = static_cast<DiskWriterDriver*>(pAudioEngine->getAudioDriver());
 	pDiskWriterDriver->setFileName( filename );
+	pDiskWriterDriver->getRenderer()->setExportStems( bExportStems );
 	pDiskWriterDriver->write();
 }
 
@@ -682,6 +713,120 @@ MidiOutput* Hydrogen::getMidiOutput() const
 	return m_pAudioEngine->getMidiOutDriver();
 }
 
+void Hydrogen::resampleSamples()
+{
+	const auto pSong = getSong();
+	if ( pSong != nullptr ) {
+		resampleSamples( pSong->getInstrumentList() );
+	}
+}
+
+void Hydrogen::resampleSamples( InstrumentList* pInstrumentList )
+{
+	const auto pAudioDriver = getAudioOutput();
+	if ( ! Preferences::get_instance()->m_bResampleOnLoad ||
+		 pAudioDriver == nullptr ) {
+		return;
+	}
+
+	const int nSampleRate = pAudioDriver->getSampleRate();
+	INFOLOG( QString( "Resampling to [%1]" ).arg( nSampleRate ) );
+	pInstrumentList->resample_samples( nSampleRate );
+}
+
+void Hydrogen::loadDeferredLayers( InstrumentList* pInstrumentList, PatternList* pPatternList )
+{
+	// Velocities of all notes by instrument id.
+	std::map<int, std::set<float>> velocities;
+	if ( pPatternList != nullptr ) {
+		for ( int ii = 0; ii < pPatternList->size(); ++ii ) {
+			for ( const auto& [ nPosition, pNote ] : *pPatternList->get( ii )->get_notes() ) {
+				if ( pNote->get_instrument() != nullptr ) {
+					velocities[ pNote->get_instrument()->get_id() ].insert( pNote->get_velocity() );
+				}
+			}
+		}
+	}
+
+	int nSampleRate = 0;
+	const auto pAudioDriver = getAudioOutput();
+	if ( Preferences::get_instance()->m_bResampleOnLoad && pAudioDriver != nullptr ) {
+		nSampleRate = pAudioDriver->getSampleRate();
+	}
+
+	SampleLoader sampleLoader;
+	for ( int ii = 0; ii < pInstrumentList->size(); ++ii ) {
+		const auto pInstrument = pInstrumentList->get( ii );
+		const auto it = velocities.find( pInstrument->get_id() );
+		if ( pPatternList != nullptr && it == velocities.end() ) {
+			continue;
+		}
+
+		for ( const auto& pComponent : *pInstrument->get_components() ) {
+			std::set<int> layers;
+			for ( int nLayer = 0; nLayer < InstrumentComponent::getMaxLayers(); ++nLayer ) {
+				const auto pLayer = pComponent->get_layer( nLayer );
+				if ( pLayer != nullptr && pLayer->is_deferred() ) {
+					layers.insert( nLayer );
+				}
+			}
+			if ( pPatternList != nullptr ) {
+				// Keep the layers containing a velocity or the one
+				// closest to it in case it falls into a hole.
+				std::set<int> usedLayers;
+				for ( const float fVelocity : it->second ) {
+					int nNearestLayer = -1;
+					float fShortestDistance = 2.0f;
+					for ( int nLayer = 0; nLayer < InstrumentComponent::getMaxLayers(); ++nLayer ) {
+						const auto pLayer = pComponent->get_layer( nLayer );
+						if ( pLayer == nullptr ) {
+							continue;
+						}
+						const float fDistance = std::max( { 0.0f,
+								pLayer->get_start_velocity() - fVelocity,
+								fVelocity - pLayer->get_end_velocity() } );
+						if ( fDistance == 0.0f ) {
+							usedLayers.insert( nLayer );
+						}
+						if ( fDistance < fShortestDistance ) {
+							fShortestDistance = fDistance;
+							nNearestLayer = nLayer;
+						}
+					}
+					if ( nNearestLayer != -1 ) {
+						usedLayers.insert( nNearestLayer );
+					}
+				}
+				std::set<int> intersection;
+				std::set_intersection( layers.begin(), layers.end(),
+									   usedLayers.begin(), usedLayers.end(),
+									   std::inserter( intersection, intersection.end() ) );
+				layers.swap( intersection );
+			}
+
+			for ( const int nLayer : layers ) {
+				const auto pLayer = pComponent->get_layer( nLayer );
+				sampleLoader.add( [pLayer, nSampleRate]() {
+					return LayerLoader::loadSample( pLayer, nSampleRate );
+				}, [=]( std::shared_ptr<Sample> pSample ) {
+					m_pAudioEngine->lock( RIGHT_HERE );
+					if ( pLayer->is_deferred() ) {
+						// Layers which could not be loaded keep their
+						// empty sample.
+						pLayer->set_sample( pSample != nullptr ? pSample : pLayer->get_sample() );
+					}
+					m_pAudioEngine->unlock();
+				} );
+			}
+		}
+	}
+
+	if ( sampleLoader.size() > 0 ) {
+		INFOLOG( QString( "Loading [%1] deferred layers" ).arg( sampleLoader.size() ) );
+		sampleLoader.run();
+	}
+}
+
 // Setting conditional to true will keep instruments that have notes if new kit has less instruments than the old one
 int Hydrogen::loadDrumkit( Drumkit *pDrumkitInfo )
 {
@@ -693,12 +838,6 @@ int Hydrogen::loadDrumkit( Drumkit *pDrumkitInfo, bool conditional )
 	AudioEngine* pAudioEngine = m_pAudioEngine;
 	assert ( pDrumkitInfo );
 
-	AudioEngine::State oldAudioEngineState = pAudioEngine->getState();
-	if( pAudioEngine->getState() == AudioEngine::State::Ready ||
-		pAudioEngine->getState() == AudioEngine::State::Playing ) {
-		pAudioEngine->setState( AudioEngine::State::Prepared );
-	}
-
 	INFOLOG( pDrumkitInfo->get_name() );
 	m_sCurrentDrumkitName = pDrumkitInfo->get_name();
 	if ( pDrumkitInfo->isUserDrumkit() ) {
@@ -707,24 +846,6 @@ int Hydrogen::loadDrumkit( Drumkit *pDrumkitInfo, bool conditional )
 		m_currentDrumkitLookup = Filesystem::Lookup::system;
 	}
 
-	std::vector<DrumkitComponent*>* pSongCompoList= getSong()->getComponents();
-	std::vector<DrumkitComponent*>* pDrumkitCompoList = pDrumkitInfo->get_components();
-	
-	pAudioEngine->lock( RIGHT_HERE );	
-	for( auto &pComponent : *pSongCompoList ){
-		delete pComponent;
-	}
-	pSongCompoList->clear();
-	pAudioEngine->unlock();
-	
-	for (std::vector<DrumkitComponent*>::iterator it = pDrumkitCompoList->begin() ; it != pDrumkitCompoList->end(); ++it) {
-		DrumkitComponent* pSrcComponent = *it;
-		DrumkitComponent* pNewComponent = new DrumkitComponent( pSrcComponent->get_id(), pSrcComponent->get_name() );
-		pNewComponent->load_from( pSrcComponent );
-
-		pSongCompoList->push_back( pNewComponent );
-	}
-
 	//current instrument list
 	InstrumentList *pSongInstrList = getSong()->getInstrumentList();
 	
@@ -755,22 +876,22 @@ int Hydrogen::loadDrumkit( Drumkit *pDrumkitInfo, bool conditional )
 	//needed for the new delete function
 	int instrumentDiff =  pSongInstrList->size() - pDrumkitInstrList->size();
 	int nMaxID = -1;
-	
-	for ( unsigned nInstr = 0; nInstr < pDrumkitInstrList->size(); ++nInstr ) {
-		std::shared_ptr<Instrument> pInstr = nullptr;
-		if ( nInstr < pSongInstrList->size() ) {
-			//instrument exists already
-			pInstr = pSongInstrList->get( nInstr );
-			assert( pInstr );
-		} else {
-			pInstr = std::make_shared<Instrument>();
-			// The instrument isn't playing yet; no need for locking
-			// :-) - Jakob Lund.  m_pAudioEngine->lock(
-			// "Hydrogen::loadDrumkit" );
-			pSongInstrList->add( pInstr );
-			// m_pAudioEngine->unlock();
-		}
 
+	// The new drumkit is loaded into components and instruments
+	// unknown to the audio engine. The current one keeps on
+	// playing meanwhile.
+	std::vector<DrumkitComponent*> stagedComponents;
+	for ( const auto& pSrcComponent : *pDrumkitInfo->get_components() ) {
+		DrumkitComponent* pNewComponent = new DrumkitComponent( pSrcComponent->get_id(), pSrcComponent->get_name() );
+		pNewComponent->load_from( pSrcComponent );
+
+		stagedComponents.push_back( pNewComponent );
+	}
+
+	// The samples of all instruments are decoded concurrently.
+	InstrumentList stagedInstruments;
+	SampleLoader sampleLoader;
+	for ( int nInstr = 0; nInstr < pDrumkitInstrList->size(); ++nInstr ) {
 		auto pNewInstr = pDrumkitInstrList->get( nInstr );
 		assert( pNewInstr );
 		INFOLOG( QString( "Loading instrument (%1 of %2) [%3]" )
@@ -780,17 +901,60 @@ int Hydrogen::loadDrumkit( Drumkit *pDrumkitInfo, bool conditional )
 
 		// Preserve instrument IDs. Where the new drumkit has more instruments than the song does, new
 		// instruments need new ids.
-		int nID = pInstr->get_id();
+		int nID = EMPTY_INSTR_ID;
+		if ( nInstr < pSongInstrList->size() ) {
+			nID = pSongInstrList->get( nInstr )->get_id();
+		}
 		if ( nID == EMPTY_INSTR_ID ) {
 			nID = nMaxID + 1;
 		}
 		nMaxID = std::max( nID, nMaxID );
 
-		// Moved code from here right into the Instrument class - Jakob Lund.
-		pInstr->load_from( pDrumkitInfo, pNewInstr );
-		pInstr->set_id( nID );
+		auto pStagedInstr = std::make_shared<Instrument>();
+		pStagedInstr->load_from( pDrumkitInfo, pNewInstr, false, &sampleLoader );
+		pStagedInstr->set_id( nID );
+		stagedInstruments.add( pStagedInstr );
+	}
+	sampleLoader.run();
+	if ( Preferences::get_instance()->m_bLazyLayerLoading ) {
+		loadDeferredLayers( &stagedInstruments, getSong()->getPatternList() );
+	}
+	resampleSamples( &stagedInstruments );
+
+	// The audio thread swaps in the new drumkit at the beginning of
+	// a period. Instruments already part of the song are kept since
+	// patterns and notes refer to them. They exchange their
+	// components with the staged ones instead.
+	const int nSongInstruments = pSongInstrList->size();
+	std::vector<DrumkitComponent*>* pSongComponents = getSong()->getComponents();
+	pAudioEngine->applyEdit( [&]() {
+		pSongComponents->swap( stagedComponents );
+		for ( int nInstr = 0; nInstr < stagedInstruments.size(); ++nInstr ) {
+			if ( nInstr < nSongInstruments ) {
+				pSongInstrList->get( nInstr )->take_over( stagedInstruments.get( nInstr ) );
+			} else {
+				pSongInstrList->add( stagedInstruments.get( nInstr ) );
+			}
+		}
+	} );
+
+	// The Sampler looks up the components of the song each period.
+	// The previous ones are not used anymore.
+	for ( auto& pComponent : stagedComponents ) {
+		delete pComponent;
 	}
 
+	// The staged instruments now hold the previous components, which
+	// might still be used by ringing notes.
+	{
+		std::lock_guard<std::mutex> lock( m_deathRowMutex );
+		for ( int nInstr = std::min( nSongInstruments, stagedInstruments.size() ) - 1;
+			  nInstr >= 0; --nInstr ) {
+			__component_death_row.push_back( stagedInstruments.del( nInstr )->share_components() );
+		}
+	}
+	__kill_instruments();
+
 	//wolke: new delete function
 	if ( instrumentDiff >= 0 ) {
 		for ( int i = 0; i < instrumentDiff ; i++ ){
@@ -809,8 +973,11 @@ int Hydrogen::loadDrumkit( Drumkit *pDrumkitInfo, bool conditional )
 
 	setIsModified( true );
 
-	pAudioEngine->setState( oldAudioEngineState );
-	
+	// The samples of the previous drumkit are not used anymore and
+	// might exceed the budget of the cache.
+	SampleCache::get_instance()->trim();
+	INFOLOG( SampleCache::get_instance()->toQString( "" ) );
+
 	m_pCoreActionController->initExternalControlInterfaces();
 	
 	// Create a symbolic link in the session folder when under session
@@ -870,16 +1037,24 @@ void Hydrogen::removeInstrument( int instrumentNumber, bool conditional )
 
 	InstrumentList* pList = pSong->getInstrumentList();
 	if ( pList->size()==1 ){
-		m_pAudioEngine->lock( RIGHT_HERE );
 		auto pInstr = pList->get( 0 );
-		pInstr->set_name( (QString( "Instrument 1" )) );
+		// The layers are released by this thread once the audio
+		// thread dropped them.
+		std::vector<std::shared_ptr<InstrumentLayer>> removedLayers;
 		for ( auto& pCompo : *pInstr->get_components() ) {
-			// remove all layers
 			for ( int nLayer = 0; nLayer < InstrumentComponent::getMaxLayers(); nLayer++ ) {
-				pCompo->set_layer( nullptr, nLayer );
+				removedLayers.push_back( pCompo->get_layer( nLayer ) );
 			}
 		}
-		m_pAudioEngine->unlock();
+		pInstr->set_name( (QString( "Instrument 1" )) );
+		m_pAudioEngine->applyEdit( [&]() {
+			for ( auto& pCompo : *pInstr->get_components() ) {
+				// remove all layers
+				for ( int nLayer = 0; nLayer < InstrumentComponent::getMaxLayers(); nLayer++ ) {
+					pCompo->set_layer( nullptr, nLayer );
+				}
+			}
+		} );
 		EventQueue::get_instance()->push_event( EVENT_SELECTED_INSTRUMENT_CHANGED, -1 );
 		INFOLOG("clear last instrument to empty instrument 1 instead delete the last instrument");
 		return;
@@ -892,10 +1067,11 @@ void Hydrogen::removeInstrument( int instrumentNumber, bool conditional )
 	}
 	//
 	// delete the instrument from the instruments list
-	m_pAudioEngine->lock( RIGHT_HERE );
-	getSong()->getInstrumentList()->del( instrumentNumber );
+	InstrumentList* pInstrumentList = getSong()->getInstrumentList();
+	m_pAudioEngine->applyEdit( [&]() {
+		pInstrumentList->del( instrumentNumber );
+	} );
 	setIsModified( true );
-	m_pAudioEngine->unlock();
 
 	// At this point the instrument has been removed from both the
 	// instrument list and every pattern in the song.  Hence there's no way
@@ -904,7 +1080,10 @@ void Hydrogen::removeInstrument( int instrumentNumber, bool conditional )
 	// the ugly name is just for debugging...
 	QString xxx_name = QString( "XXX_%1" ) . arg( pInstr->get_name() );
 	pInstr->set_name( xxx_name );
-	__instrument_death_row.push_back( pInstr );
+	{
+		std::lock_guard<std::mutex> lock( m_deathRowMutex );
+		__instrument_death_row.push_back( pInstr );
+	}
 	__kill_instruments(); // checks if there are still notes.
 
 	// this will force a GUI update.
@@ -1255,8 +1434,14 @@ void Hydrogen::setPlaysSelected( bool bPlaysSelected )
 	pAudioEngine->unlock();
 }
 
-void Hydrogen::__kill_instruments()
+void Hydrogen::releaseRetiredInstruments()
 {
+	__kill_instruments( false );
+}
+
+void Hydrogen::__kill_instruments( bool bReportPending )
+{
+	std::lock_guard<std::mutex> lock( m_deathRowMutex );
 	int c = 0;
 	std::shared_ptr<Instrument> pInstr = nullptr;
 	while ( __instrument_death_row.size()
@@ -1270,13 +1455,24 @@ void Hydrogen::__kill_instruments()
 		pInstr = nullptr;
 		c++;
 	}
-	if ( __instrument_death_row.size() ) {
+	if ( bReportPending && __instrument_death_row.size() ) {
 		pInstr = __instrument_death_row.front();
 		INFOLOG( QString( "Instrument %1 still has %2 active notes. "
 						  "Delaying 'delete instrument' operation." )
 				 . arg( pInstr->get_name() )
 				 . arg( pInstr->is_queued() ) );
 	}
+
+	// Only the death row itself refers to unused components. Since
+	// notes capture the current components of their instrument,
+	// retired ones can not be picked up again.
+	__component_death_row.remove_if( []( const auto& pComponents ) {
+		return pComponents.use_count() == 1;
+	} );
+	if ( bReportPending && __component_death_row.size() ) {
+		INFOLOG( QString( "%1 replaced components are still used by active notes." )
+				 . arg( __component_death_row.size() ) );
+	}
 }
 
 
@@ -1427,57 +1623,39 @@ void Hydrogen::recalculateRubberband( float fBpm ) {
 	if ( !Preferences::get_instance()->getRubberBandBatchMode() ) {
 		return;
 	}
-	
+
 	if ( getSong() != nullptr ) {
-		auto pInstrumentList = getSong()->getInstrumentList();
-		if ( pInstrumentList != nullptr ) {
-			for ( unsigned nnInstr = 0; nnInstr < pInstrumentList->size(); ++nnInstr ) {
-				auto pInstr = pInstrumentList->get( nnInstr );
-				if ( pInstr == nullptr ) {
-					return;
+		stretchSamples( fBpm );
+		setIsModified( true );
+	} else {
+		ERRORLOG( "No song set" );
+	}
+}
+
+void Hydrogen::stretchSamples( float fBpm ) {
+	if ( getSong() == nullptr ) {
+		return;
+	}
+
+	auto pInstrumentList = getSong()->getInstrumentList();
+	for ( int nnInstr = 0; nnInstr < pInstrumentList->size(); ++nnInstr ) {
+		auto pInstr = pInstrumentList->get( nnInstr );
+		for ( const auto& pInstrumentComponent : *pInstr->get_components() ) {
+			if ( pInstrumentComponent == nullptr ) {
+				continue; // regular case when you have a new component empty
+			}
+
+			for ( int nnLayer = 0; nnLayer < InstrumentComponent::getMaxLayers(); nnLayer++ ) {
+				auto pLayer = pInstrumentComponent->get_layer( nnLayer );
+				if ( pLayer == nullptr ) {
+					continue;
 				}
-				assert( pInstr );
-				if ( pInstr != nullptr ){
-					for ( int nnComponent = 0; nnComponent < pInstr->get_components()->size();
-						  ++nnComponent ) {
-						auto pInstrumentComponent = pInstr->get_component( nnComponent );
-						if ( pInstrumentComponent == nullptr ) {
-							continue; // regular case when you have a new component empty
-						}
-				
-						for ( int nnLayer = 0; nnLayer < InstrumentComponent::getMaxLayers(); nnLayer++ ) {
-							auto pLayer = pInstrumentComponent->get_layer( nnLayer );
-							if ( pLayer != nullptr ) {
-								auto pSample = pLayer->get_sample();
-								if ( pSample != nullptr ) {
-									if( pSample->get_rubberband().use ) {
-										auto pNewSample = Sample::load(
-																	   pSample->get_filepath(),
-																	   pSample->get_loops(),
-																	   pSample->get_rubberband(),
-																	   *pSample->get_velocity_envelope(),
-																	   *pSample->get_pan_envelope(),
-																	   fBpm
-																	   );
-										if( pNewSample == nullptr ){
-											continue;
-										}
-								
-										// insert new sample from newInstrument
-										pLayer->set_sample( pNewSample );
-									}
-								}
-							}
-						}
-					}
+				auto pSample = pLayer->get_sample();
+				if ( pSample != nullptr && pSample->get_rubberband().use ) {
+					m_pSampleStretcher->request( pLayer, pSample, fBpm );
 				}
 			}
-			setIsModified( true );
-		} else {
-			ERRORLOG( "No InstrumentList present" );
 		}
-	} else {
-		ERRORLOG( "No song set" );
 	}
 }
 
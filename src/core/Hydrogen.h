@@ -38,6 +38,7 @@
 #include <stdint.h> // for uint32_t et al
 #include <cassert>
 #include <memory>
+#include <mutex>
 
 inline int randomValue( int max );
 
@@ -45,6 +46,10 @@ namespace H2Core
 {
 	class CoreActionController;
 	class AudioEngine;
+	class InstrumentComponent;
+	class InstrumentList;
+	class PatternList;
+	class SampleStretcher;
 ///
 /// Hydrogen Audio Engine.
 ///
@@ -122,10 +127,11 @@ public:
 	 * Adding and removing a Pattern from
 	 * #H2Core::AudioEngine::m_pNextPatterns.
 	 *
-	 * After locking the AudioEngine the function retrieves the
-	 * particular pattern @a pos from the Song::m_pPatternList and
-	 * either deletes it from #H2Core::AudioEngine::m_pNextPatterns if
-	 * already present or add it to the same pattern list if not
+	 * The function posts a command to the AudioEngine, which
+	 * retrieves the particular pattern @a pos from the
+	 * Song::m_pPatternList at the beginning of the next process cycle
+	 * and either deletes it from #H2Core::AudioEngine::m_pNextPatterns
+	 * if already present or add it to the same pattern list if not
 	 * present yet.
 	 *
 	 * If the Song is not in Song::PATTERN_MODE or @a pos is not
@@ -142,7 +148,8 @@ public:
 	 * Clear #H2Core::AudioEngine::m_pNextPatterns and add one
 	 * Pattern.
 	 *
-	 * After locking the AudioEngine the function clears
+	 * The function posts a command to the AudioEngine, which
+	 * at the beginning of the next process cycle clears
 	 * #H2Core::AudioEngine::m_pNextPatterns, fills it with all
 	 * currently played one in
 	 * #H2Core::AudioEngine::m_pPlayingPatterns, and appends the
@@ -225,6 +232,14 @@ public:
 		 * name "drumkit" in the folder
 		 * NsmClient::m_sSessionFolderPath.
 		 *
+		 * The audio engine keeps running while the samples are
+		 * loaded. The new instruments and components are staged
+		 * in the background and take the place of the current
+		 * ones at once (see Instrument::take_over()). Notes
+		 * still ringing finish with the samples of the previous
+		 * drumkit, which are released by
+		 * releaseRetiredInstruments() afterwards.
+		 *
 		 * \param pDrumkitInfo Full-fledged H2Core::Drumkit to load.
 		 * \param conditional Argument passed on as second input
 		 *   argument to removeInstrument().
@@ -235,6 +250,42 @@ public:
 
 		int			loadDrumkit( Drumkit *pDrumkitInfo, bool conditional );
 
+		/**
+		 * Releases instruments removed by removeInstrument() and
+		 * components replaced by loadDrumkit() once the last note
+		 * using them is done.
+		 *
+		 * The audio thread must not free their samples itself. This
+		 * function is called periodically by the event loops of the
+		 * GUI and the CLI instead.
+		 */
+		void			releaseRetiredInstruments();
+
+		/**
+		 * Converts the samples of all instruments of the current
+		 * song to the sample rate of the audio driver in case
+		 * Preferences::m_bResampleOnLoad is set (see
+		 * InstrumentList::resample_samples()).
+		 *
+		 * Called once a song or drumkit was loaded and whenever
+		 * the audio driver changes.
+		 */
+		void			resampleSamples();
+		/** Same as resampleSamples() for the instruments in @a
+		 * pInstrumentList instead of those of the current song.*/
+		void			resampleSamples( InstrumentList* pInstrumentList );
+		/**
+		 * Decodes the deferred layers of @a pInstrumentList (see
+		 * Preferences::m_bLazyLayerLoading).
+		 *
+		 * \param pInstrumentList Instruments to load the layers of.
+		 * \param pPatternList If given, only layers selected by the
+		 * velocities of its notes are loaded. Instruments are matched
+		 * by their id.
+		 */
+		void			loadDeferredLayers( InstrumentList* pInstrumentList,
+											PatternList* pPatternList = nullptr );
+
 		/** Test if an Instrument has some Note in the Pattern (used to
 		    test before deleting an Instrument)*/
 		bool 			instrumentHasNotes( std::shared_ptr<Instrument> pInst );
@@ -260,9 +311,20 @@ void			previewSample( Sample *pSample );
 	void			previewInstrument( std::shared_ptr<Instrument> pInstr );
 
 	/** Recalculates all Samples using RubberBand for a specific
-		tempo @a fBpm.
+		tempo @a fBpm in case Preferences::getRubberBandBatchMode()
+		is enabled (see stretchSamples()).
 	*/ 
 	void recalculateRubberband( float fBpm );
+	/**
+	 * Requests all samples of the current song using Rubber Band
+	 * to be stretched to @a fBpm by the SampleStretcher. They keep
+	 * playing their current content till the stretched one is
+	 * ready.
+	 *
+	 * Called once a song was loaded. Neither blocks nor locks the
+	 * AudioEngine.
+	 */
+	void stretchSamples( float fBpm );
 	/** Wrapper around Song::setIsModified() that checks whether a
 		song is set.*/
 	void setIsModified( bool bIsModified );
@@ -382,10 +444,18 @@ void			previewSample( Sample *pSample );
 	/** \return true on success.*/
 	bool			startExportSession( int rate, int depth );
 	void			stopExportSession();
-	void			startExportSong( const QString& filename );
+	/** \param bExportStems Additionally writes each instrument into a
+	 * file of its own (see OfflineRenderer::setExportStems()).
+	 * \param bDeterministic Seeds the random numbers with
+	 * Song::getRandomSeed() and resets the round robin state of all
+	 * instruments. Exporting the same song twice does then yield
+	 * identical files.*/
+	void			startExportSong( const QString& filename, bool bExportStems = false,
+									 bool bDeterministic = false );
 	void			stopExportSong();
 	
 	CoreActionController* 	getCoreActionController() const;
+	SampleStretcher*	getSampleStretcher() const;
 
 	/************************************************************/
 	/********************** Playback track **********************/
@@ -549,6 +619,9 @@ private:
 	 * Local instance of the CoreActionController object.
 	 */ 
 	CoreActionController* 	m_pCoreActionController;
+	/** Time-stretches samples using Rubber Band in the
+	 * background.*/
+	SampleStretcher*	m_pSampleStretcher;
 
 	/** Name of the currently used Drumkit.*/
 	QString			m_sCurrentDrumkitName;
@@ -556,8 +629,16 @@ private:
 		level.*/
 	Filesystem::Lookup	m_currentDrumkitLookup;
 	
+	/// Guards #__instrument_death_row and #__component_death_row.
+	/// They are reaped by the event loops while loadDrumkit() might
+	/// be called by the OSC server.
+	std::mutex m_deathRowMutex;
 	/// Deleting instruments too soon leads to potential crashes.
 	std::list<std::shared_ptr<Instrument>> 	__instrument_death_row; 
+	/// Components replaced by loadDrumkit(). Releasing them within
+	/// the audio thread once the last note using them is done would
+	/// free memory there.
+	std::list<std::shared_ptr<std::vector<std::shared_ptr<InstrumentComponent>>>> __component_death_row;
 	
 	/**
 	 * Instrument currently focused/selected in the GUI. 
@@ -593,7 +674,12 @@ private:
 	 */
 	Hydrogen();
 
-	void __kill_instruments();
+	/** Releases instruments removed from the song as well as
+	 * components replaced by loadDrumkit() as soon as no note uses
+	 * them anymore.
+	 *
+	 * \param bReportPending Whether to log the ones still in use.*/
+	void __kill_instruments( bool bReportPending = true );
 
 };
 
@@ -615,6 +701,11 @@ inline CoreActionController* Hydrogen::getCoreActionController() const
 	return m_pCoreActionController;
 }
 
+inline SampleStretcher* Hydrogen::getSampleStretcher() const
+{
+	return m_pSampleStretcher;
+}
+
 
 inline const QString& Hydrogen::getCurrentDrumkitName()
 {
@@ -33,10 +33,15 @@
 namespace H2Core
 {
 
+class OfflineRenderer;
+
 	void* diskWriterDriver_thread( void *param );
 ///
 /// Driver for export audio to disk
 ///
+/// The actual rendering is done by the OfflineRenderer within a
+/// thread of its own started by write().
+///
 /** \ingroup docCore docAudioDriver */
 class DiskWriterDriver : public Object<DiskWriterDriver>, public AudioOutput
 {
@@ -50,6 +55,7 @@ class DiskWriterDriver : public Object<DiskWriterDriver>, public AudioOutput
 		audioProcessCallback	m_processCallback;
 		float*					m_pOut_L;
 		float*					m_pOut_R;
+		OfflineRenderer*		m_pRenderer;
 
 		DiskWriterDriver( audioProcessCallback processCallback, unsigned nSamplerate, int nSampleDepth );
 		~DiskWriterDriver();
@@ -78,6 +84,10 @@ class DiskWriterDriver : public Object<DiskWriterDriver>, public AudioOutput
 			m_sFilename = sFilename;
 		}
 
+		OfflineRenderer* getRenderer() const {
+			return m_pRenderer;
+		}
+
 	private:
 
 
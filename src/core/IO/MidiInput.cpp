@@ -372,31 +372,20 @@ void MidiInput::handleNoteOffMessage( const MidiMessage& msg, bool CymbalChoke )
 		fStep = 1;
 	}
 
-	bool use_note_off = Hydrogen::get_instance()->getAudioEngine()->getSampler()->isInstrumentPlaying( pInstr );
-	if(use_note_off){
-		if ( Preferences::get_instance()->__playselectedinstrument ){
-			Hydrogen::get_instance()->getAudioEngine()->getSampler()->midiKeyboardNoteOff( msg.m_nData1 );
-		}
-		else
-		{
-			if ( pInstrList->size() < nInstrument +1 ) {
-				return;
-			}
-			
-			Note *pOffNote = new Note( pInstr,
-										0.0,
-										0.0,
-										0.0,
-										-1,
-										0 );
-			pOffNote->set_note_off( true );
-			Hydrogen::get_instance()->getAudioEngine()->getSampler()->noteOn( pOffNote );
-			delete pOffNote;
-		}
-		
-		if(Preferences::get_instance()->getRecordEvents()) {
-			Hydrogen::get_instance()->getAudioEngine()->getSampler()->setPlayingNotelength( pInstr, notelength * fStep, __noteOnTick );
-		}
+	// Whether the instrument is still playing is checked by the
+	// audio thread. The MIDI thread must not access the voices of
+	// the Sampler.
+	const int nKey = Preferences::get_instance()->__playselectedinstrument ? msg.m_nData1 : -1;
+	if ( nKey == -1 && pInstrList->size() < nInstrument + 1 ) {
+		return;
+	}
+	Note *pOffNote = Hydrogen::get_instance()->getAudioEngine()->getNotePool()->acquire(
+		pInstr, 0.0, 0.0, 0.0, -1, 0 );
+	// The AudioEngine takes care of deleting the note.
+	Hydrogen::get_instance()->getAudioEngine()->midiNoteOff( pOffNote, nKey );
+
+	if(Preferences::get_instance()->getRecordEvents()) {
+		Hydrogen::get_instance()->getAudioEngine()->getSampler()->setPlayingNotelength( pInstr, notelength * fStep, __noteOnTick );
 	}
 }
 
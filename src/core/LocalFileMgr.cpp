@@ -486,6 +486,7 @@ int SongWriter::writeSong( std::shared_ptr<Song> pSong, const QString& filename
 	LocalFileMng::writeXmlString( songNode, "humanize_time", QString("%1").arg( pSong->getHumanizeTimeValue() ) );
 	LocalFileMng::writeXmlString( songNode, "humanize_velocity", QString("%1").arg( pSong->getHumanizeVelocityValue() ) );
 	LocalFileMng::writeXmlString( songNode, "swing_factor", QString("%1").arg( pSong->getSwingFactor() ) );
+	LocalFileMng::writeXmlString( songNode, "random_seed", QString::number( pSong->getRandomSeed() ) );
 
 	// component List
 	QDomNode componentListNode = doc.createElement( "componentList" );
@@ -542,6 +543,7 @@ int SongWriter::writeSong( std::shared_ptr<Song> pSong, const QString& filename
 		LocalFileMng::writeXmlString( instrumentNode, "randomPitchFactor", QString("%1").arg( pInstr->get_random_pitch_factor() ) );
 
 		LocalFileMng::writeXmlString( instrumentNode, "muteGroup", QString("%1").arg( pInstr->get_mute_group() ) );
+		LocalFileMng::writeXmlString( instrumentNode, "maxVoices", QString("%1").arg( pInstr->get_max_voices() ) );
 		LocalFileMng::writeXmlBool( instrumentNode, "isStopNote", pInstr->is_stop_notes() );
 		switch ( pInstr->sample_selection_alg() ) {
 			case Instrument::VELOCITY:
@@ -38,6 +38,7 @@
 #include "core/CoreActionController.h"
 #include "core/EventQueue.h"
 #include "core/Hydrogen.h"
+#include "core/AudioEngine/AudioEngine.h"
 #include "core/Basics/Song.h"
 #include "core/MidiAction.h"
 
@@ -756,6 +757,38 @@ void OscServer::SONG_EDITOR_TOGGLE_GRID_CELL_Handler(lo_arg **argv, int argc) {
 								 static_cast<int>(std::round( argv[1]->f )) );
 }
 
+void OscServer::DSP_PROFILE_Handler(lo_arg **argv, int argc) {
+
+	auto pProfiler = H2Core::Hydrogen::get_instance()->getAudioEngine()->getProfiler();
+	for ( int nPhase = 0; nPhase < H2Core::DspProfiler::PhaseCount; ++nPhase ) {
+		const auto stats = pProfiler->getStats( nPhase );
+		if ( stats.nCount == 0 ) {
+			continue;
+		}
+
+		lo_message reply = lo_message_new();
+		lo_message_add_string( reply, H2Core::DspProfiler::getPhaseName( nPhase ).toUtf8().constData() );
+		lo_message_add_float( reply, stats.fP50 / 1000.0 );
+		lo_message_add_float( reply, stats.fP99 / 1000.0 );
+		lo_message_add_float( reply, stats.fMax / 1000.0 );
+		lo_message_add_float( reply, static_cast<float>( stats.nCount ) );
+
+		get_instance()->broadcastMessage( "/Hydrogen/DSP_PROFILE", reply );
+
+		lo_message_free( reply );
+	}
+}
+
+void OscServer::DSP_PROFILE_RESET_Handler(lo_arg **argv, int argc) {
+
+	H2Core::Hydrogen::get_instance()->getAudioEngine()->getProfiler()->reset();
+}
+
+void OscServer::DSP_PROFILE_TRACE_Handler(lo_arg **argv, int argc) {
+
+	H2Core::Hydrogen::get_instance()->getAudioEngine()->getProfiler()->dumpChromeTrace( QString::fromUtf8( &argv[0]->s ) );
+}
+
 // -------------------------------------------------------------------
 // Helper functions
 
@@ -1038,6 +1071,12 @@ bool OscServer::init()
 	m_pServerThread->add_method("/Hydrogen/REMOVE_PATTERN", "f", REMOVE_PATTERN_Handler);
 	m_pServerThread->add_method("/Hydrogen/SONG_EDITOR_TOGGLE_GRID_CELL", "ff", SONG_EDITOR_TOGGLE_GRID_CELL_Handler);
 
+	m_pServerThread->add_method("/Hydrogen/DSP_PROFILE", "", DSP_PROFILE_Handler);
+	m_pServerThread->add_method("/Hydrogen/DSP_PROFILE", "f", DSP_PROFILE_Handler);
+	m_pServerThread->add_method("/Hydrogen/DSP_PROFILE_RESET", "", DSP_PROFILE_RESET_Handler);
+	m_pServerThread->add_method("/Hydrogen/DSP_PROFILE_RESET", "f", DSP_PROFILE_RESET_Handler);
+	m_pServerThread->add_method("/Hydrogen/DSP_PROFILE_TRACE", "s", DSP_PROFILE_TRACE_Handler);
+
 	m_bInitialized = true;
 	
 	return true;
@@ -757,6 +757,35 @@ class OscServer : public H2Core::Object<OscServer>
 		 * \param argc Number of arguments passed by the OSC message.
 		 */
 		static void SONG_EDITOR_TOGGLE_GRID_CELL_Handler(lo_arg **argv, int argc);
+		/**
+		 * Sends the percentiles of all phases of
+		 * H2Core::AudioEngine::audioEngine_process() measured by
+		 * H2Core::DspProfiler to all connected clients.
+		 *
+		 * For each phase a message is sent to \e
+		 * /Hydrogen/DSP_PROFILE containing its name ("s") followed
+		 * by the 50th and 99th percentile, the maximum duration in
+		 * milliseconds, and the number of periods ("f").
+		 *
+		 * \param argv Unused.
+		 * \param argc Unused number of arguments passed by the OSC
+		 * message.*/
+		static void DSP_PROFILE_Handler(lo_arg **argv, int argc);
+		/**
+		 * Triggers H2Core::DspProfiler::reset().
+		 *
+		 * \param argv Unused.
+		 * \param argc Unused number of arguments passed by the OSC
+		 * message.*/
+		static void DSP_PROFILE_RESET_Handler(lo_arg **argv, int argc);
+		/**
+		 * Triggers H2Core::DspProfiler::dumpChromeTrace().
+		 *
+		 * \param argv The "s" field does contain the absolute path
+		 * of the resulting .json file.
+		 * \param argc Number of arguments passed by the OSC message.
+		 */
+		static void DSP_PROFILE_TRACE_Handler(lo_arg **argv, int argc);
 		/** 
 		 * Catches any incoming messages and display them. 
 		 *
@@ -142,6 +142,19 @@ Preferences::Preferences()
 	m_bUseMetronome = false;
 	m_fMetronomeVolume = 0.5;
 	m_nMaxNotes = 256;
+	m_voiceStealing = VoiceStealing::oldest;
+	m_nNotePoolSize = 4096;
+	m_nSamplerWorkers = 0;
+	m_nSampleCacheSize = 512;
+	m_bPersistentSampleCache = false;
+	m_sSampleFormat = "auto";
+	m_bDiskStreaming = false;
+	m_nStreamingHeadFrames = 65536;
+	m_nStreamingBufferFrames = 32768;
+	m_nStreamingVoices = 64;
+	m_nSampleLoadingThreads = 4;
+	m_bResampleOnLoad = false;
+	m_bLazyLayerLoading = false;
 	m_nBufferSize = 1024;
 	m_nSampleRate = 44100;
 
@@ -407,6 +420,34 @@ void Preferences::loadPreferences( bool bGlobal )
 				m_bUseMetronome = LocalFileMng::readXmlBool( audioEngineNode, "use_metronome", m_bUseMetronome );
 				m_fMetronomeVolume = LocalFileMng::readXmlFloat( audioEngineNode, "metronome_volume", 0.5f );
 				m_nMaxNotes = LocalFileMng::readXmlInt( audioEngineNode, "maxNotes", m_nMaxNotes );
+				int nVoiceStealing = LocalFileMng::readXmlInt( audioEngineNode, "voiceStealing", 0 );
+				switch ( nVoiceStealing ) {
+				case 0:
+					m_voiceStealing = VoiceStealing::oldest;
+					break;
+				case 1:
+					m_voiceStealing = VoiceStealing::quietest;
+					break;
+				case 2:
+					m_voiceStealing = VoiceStealing::sameInstrument;
+					break;
+				default:
+					WARNINGLOG( QString( "Unknown voiceStealing value [%1]. Using VoiceStealing::oldest instead." )
+								.arg( nVoiceStealing ) );
+					m_voiceStealing = VoiceStealing::oldest;
+				}
+				m_nNotePoolSize = LocalFileMng::readXmlInt( audioEngineNode, "notePoolSize", m_nNotePoolSize );
+				m_nSamplerWorkers = LocalFileMng::readXmlInt( audioEngineNode, "samplerWorkers", m_nSamplerWorkers );
+				m_nSampleCacheSize = LocalFileMng::readXmlInt( audioEngineNode, "sampleCacheSize", m_nSampleCacheSize );
+				m_bPersistentSampleCache = LocalFileMng::readXmlBool( audioEngineNode, "persistentSampleCache", m_bPersistentSampleCache );
+				m_sSampleFormat = LocalFileMng::readXmlString( audioEngineNode, "sampleFormat", m_sSampleFormat );
+				m_bDiskStreaming = LocalFileMng::readXmlBool( audioEngineNode, "diskStreaming", m_bDiskStreaming );
+				m_nStreamingHeadFrames = LocalFileMng::readXmlInt( audioEngineNode, "streamingHeadFrames", m_nStreamingHeadFrames );
+				m_nStreamingBufferFrames = LocalFileMng::readXmlInt( audioEngineNode, "streamingBufferFrames", m_nStreamingBufferFrames );
+				m_nStreamingVoices = LocalFileMng::readXmlInt( audioEngineNode, "streamingVoices", m_nStreamingVoices );
+				m_nSampleLoadingThreads = LocalFileMng::readXmlInt( audioEngineNode, "sampleLoadingThreads", m_nSampleLoadingThreads );
+				m_bResampleOnLoad = LocalFileMng::readXmlBool( audioEngineNode, "resampleOnLoad", m_bResampleOnLoad );
+				m_bLazyLayerLoading = LocalFileMng::readXmlBool( audioEngineNode, "lazyLayerLoading", m_bLazyLayerLoading );
 				m_nBufferSize = LocalFileMng::readXmlInt( audioEngineNode, "buffer_size", m_nBufferSize );
 				m_nSampleRate = LocalFileMng::readXmlInt( audioEngineNode, "samplerate", m_nSampleRate );
 
@@ -908,6 +949,20 @@ void Preferences::savePreferences()
 		LocalFileMng::writeXmlString( audioEngineNode, "use_metronome", m_bUseMetronome ? "true": "false" );
 		LocalFileMng::writeXmlString( audioEngineNode, "metronome_volume", QString("%1").arg( m_fMetronomeVolume ) );
 		LocalFileMng::writeXmlString( audioEngineNode, "maxNotes", QString("%1").arg( m_nMaxNotes ) );
+		LocalFileMng::writeXmlString( audioEngineNode, "voiceStealing",
+									  QString("%1").arg( static_cast<int>( m_voiceStealing ) ) );
+		LocalFileMng::writeXmlString( audioEngineNode, "notePoolSize", QString("%1").arg( m_nNotePoolSize ) );
+		LocalFileMng::writeXmlString( audioEngineNode, "samplerWorkers", QString("%1").arg( m_nSamplerWorkers ) );
+		LocalFileMng::writeXmlString( audioEngineNode, "sampleCacheSize", QString("%1").arg( m_nSampleCacheSize ) );
+		LocalFileMng::writeXmlBool( audioEngineNode, "persistentSampleCache", m_bPersistentSampleCache );
+		LocalFileMng::writeXmlString( audioEngineNode, "sampleFormat", m_sSampleFormat );
+		LocalFileMng::writeXmlBool( audioEngineNode, "diskStreaming", m_bDiskStreaming );
+		LocalFileMng::writeXmlString( audioEngineNode, "streamingHeadFrames", QString("%1").arg( m_nStreamingHeadFrames ) );
+		LocalFileMng::writeXmlString( audioEngineNode, "streamingBufferFrames", QString("%1").arg( m_nStreamingBufferFrames ) );
+		LocalFileMng::writeXmlString( audioEngineNode, "streamingVoices", QString("%1").arg( m_nStreamingVoices ) );
+		LocalFileMng::writeXmlString( audioEngineNode, "sampleLoadingThreads", QString("%1").arg( m_nSampleLoadingThreads ) );
+		LocalFileMng::writeXmlBool( audioEngineNode, "resampleOnLoad", m_bResampleOnLoad );
+		LocalFileMng::writeXmlBool( audioEngineNode, "lazyLayerLoading", m_bLazyLayerLoading );
 		LocalFileMng::writeXmlString( audioEngineNode, "buffer_size", QString("%1").arg( m_nBufferSize ) );
 		LocalFileMng::writeXmlString( audioEngineNode, "samplerate", QString("%1").arg( m_nSampleRate ) );
 
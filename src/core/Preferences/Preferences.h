@@ -187,6 +187,84 @@ public:
 	float				m_fMetronomeVolume;
 	/// max notes
 	unsigned			m_nMaxNotes;
+	/** Which note the Sampler fades out once #m_nMaxNotes or
+	 * Instrument::get_max_voices() is exceeded (see VoiceAllocator).*/
+	enum class VoiceStealing {
+		/** The note started first.*/
+		oldest = 0,
+		/** The note with the lowest velocity and envelope.*/
+		quietest = 1,
+		/** The oldest note of the instrument of the new note or the
+		 * oldest note in case it is not playing.*/
+		sameInstrument = 2 };
+	VoiceStealing		m_voiceStealing;
+	/**
+	 * Number of notes preallocated by the NotePool of the
+	 * AudioEngine. Changes take effect after a restart.
+	 */
+	int					m_nNotePoolSize;
+	/**
+	 * Number of threads rendering notes in the Sampler in addition
+	 * to the audio thread. 0 renders all notes on the audio
+	 * thread. Changes take effect after a restart.
+	 */
+	int					m_nSamplerWorkers;
+	/**
+	 * Memory in MiB the SampleCache may use for decoded samples no
+	 * longer used by any instrument. Samples in use are always
+	 * shared and do not count. Changes take effect after a restart.
+	 */
+	int					m_nSampleCacheSize;
+	/**
+	 * Whether decoded samples are stored on disk as well (see
+	 * SampleDiskCache). Subsequent loads of the same files map the
+	 * cached content instead of decoding them again. Changes take
+	 * effect after a restart.
+	 */
+	bool				m_bPersistentSampleCache;
+	/**
+	 * Format samples are kept in memory: "float", "int16",
+	 * "int24", "half", or "auto" for the most compact one without
+	 * any loss (e.g. int16 for 16 bit files). See
+	 * SampleBuffer::Format. Changes take effect after a restart.
+	 */
+	QString				m_sSampleFormat;
+	/**
+	 * Whether long samples of drumkits are streamed from disk. Only
+	 * the first #m_nStreamingHeadFrames frames of each sample are kept
+	 * in memory, the remainder is read by the DiskStreamer while a
+	 * note is playing. Changes take effect after a restart.
+	 */
+	bool				m_bDiskStreaming;
+	/** Number of frames of a streamed sample kept in memory. */
+	int					m_nStreamingHeadFrames;
+	/** Number of frames read ahead for each streamed voice. */
+	int					m_nStreamingBufferFrames;
+	/** Maximum number of voices streamed at the same time. */
+	int					m_nStreamingVoices;
+	/**
+	 * Maximum number of samples decoded at the same time when
+	 * loading drumkits and songs (see SampleLoader). Further bound
+	 * by the number of cores. 1 loads them one after another.
+	 */
+	int					m_nSampleLoadingThreads;
+	/**
+	 * Whether the samples of the current song are converted to the
+	 * sample rate of the audio driver once they are loaded and
+	 * whenever the driver changes (see Sample::resample()). Notes
+	 * played at their original pitch are rendered without any
+	 * interpolation then.
+	 */
+	bool				m_bResampleOnLoad;
+	/**
+	 * Whether the layers of drumkits are decoded on first use instead
+	 * of at load time. Layers hit by the notes of the song are still
+	 * decoded right away. All others are loaded in the background
+	 * once the Sampler selects them (see LayerLoader) while the
+	 * nearest loaded layer is played in their place. Changes take
+	 * effect after a restart.
+	 */
+	bool				m_bLazyLayerLoading;
 	/** 
 	 * Buffer size of the audio.
 	 *
@@ -0,0 +1,294 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/Sampler/DiskStreamer.h>
+#include <core/Basics/Sample.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace H2Core
+{
+
+/** Time the thread sleeps in case there is nothing to read.*/
+static constexpr std::chrono::milliseconds pollInterval( 2 );
+
+DiskStream::DiskStream()
+	: m_state( State::Free )
+	, m_pSample( nullptr )
+	, m_nChannels( 0 )
+	, m_nFrames( 0 )
+	, m_nStartFrame( 0 )
+	, m_nWriteFrame( 0 )
+	, m_nReadFrame( 0 )
+	, m_bFailed( false )
+	, m_nMask( 0 )
+	, m_pFile( nullptr )
+	, m_nFileChannels( 0 )
+{
+}
+
+DiskStreamer::DiskStreamer( int nStreams, int nBufferFrames )
+	: m_nStreams( std::max( 1, nStreams ) )
+	, m_nBufferFrames( 1 )
+	, m_bQuit( false )
+	, m_nStarvations( 0 )
+	, m_nUnavailable( 0 )
+	, m_nMinHeadroom( -1 )
+{
+	// The ring buffers have to hold at least a single chunk.
+	nBufferFrames = std::max( nBufferFrames, nChunkFrames );
+	while ( m_nBufferFrames < nBufferFrames ) {
+		m_nBufferFrames *= 2;
+	}
+
+	m_streams.reset( new DiskStream[ m_nStreams ] );
+	for ( int ii = 0; ii < m_nStreams; ++ii ) {
+		auto& stream = m_streams[ ii ];
+		stream.m_nMask = m_nBufferFrames - 1;
+		stream.m_ring[ 0 ].reset( new float[ m_nBufferFrames ] );
+		stream.m_ring[ 1 ].reset( new float[ m_nBufferFrames ] );
+	}
+
+	m_thread = std::thread( &DiskStreamer::threadMain, this );
+	INFOLOG( QString( "Streaming up to [%1] voices reading [%2] frames ahead" )
+			 .arg( m_nStreams ).arg( m_nBufferFrames ) );
+}
+
+DiskStreamer::~DiskStreamer()
+{
+	{
+		std::lock_guard<std::mutex> lock( m_mutex );
+		m_bQuit.store( true );
+	}
+	m_condition.notify_all();
+	m_thread.join();
+
+	for ( int ii = 0; ii < m_nStreams; ++ii ) {
+		closeFile( m_streams[ ii ] );
+		m_streams[ ii ].m_pSample = nullptr;
+	}
+}
+
+DiskStream* DiskStreamer::open( std::shared_ptr<Sample> pSample, int nStartFrame )
+{
+	for ( int ii = 0; ii < m_nStreams; ++ii ) {
+		auto& stream = m_streams[ ii ];
+		if ( stream.m_state.load( std::memory_order_acquire ) != DiskStream::State::Free ) {
+			continue;
+		}
+
+		// The thread does not touch free streams.
+		stream.m_pSample = pSample;
+		stream.m_nChannels = pSample->get_channels();
+		stream.m_nFrames = pSample->get_frames();
+		stream.m_nStartFrame = nStartFrame;
+		stream.m_nWriteFrame.store( nStartFrame, std::memory_order_relaxed );
+		stream.m_nReadFrame.store( nStartFrame, std::memory_order_relaxed );
+		stream.m_bFailed.store( false, std::memory_order_relaxed );
+		stream.m_state.store( DiskStream::State::Requested, std::memory_order_release );
+		return &stream;
+	}
+
+	m_nUnavailable.fetch_add( 1, std::memory_order_relaxed );
+	return nullptr;
+}
+
+void DiskStreamer::threadMain()
+{
+	while ( ! m_bQuit.load() ) {
+		bool bBusy = false;
+		for ( int ii = 0; ii < m_nStreams; ++ii ) {
+			auto& stream = m_streams[ ii ];
+			switch ( stream.m_state.load( std::memory_order_acquire ) ) {
+			case DiskStream::State::Requested:
+				openFile( stream );
+				bBusy = true;
+				break;
+			case DiskStream::State::Active:
+				bBusy = fill( stream ) || bBusy;
+				break;
+			case DiskStream::State::Closing:
+				closeFile( stream );
+				stream.m_pSample = nullptr;
+				stream.m_state.store( DiskStream::State::Free, std::memory_order_release );
+				break;
+			default:
+				break;
+			}
+		}
+
+		// Chunks of all streams are read in turn till there is
+		// nothing left to do.
+		if ( ! bBusy ) {
+			std::unique_lock<std::mutex> lock( m_mutex );
+			m_condition.wait_for( lock, pollInterval, [&]() { return m_bQuit.load(); } );
+		}
+	}
+}
+
+void DiskStreamer::openFile( DiskStream& stream )
+{
+	const QString sFilepath = stream.m_pSample->get_filepath();
+	SF_INFO soundInfo = {0};
+	stream.m_pFile = sf_open( sFilepath.toLocal8Bit(), SFM_READ, &soundInfo );
+	if ( stream.m_pFile == nullptr ) {
+		ERRORLOG( QString( "Unable to stream [%1]" ).arg( sFilepath ) );
+		stream.m_bFailed.store( true, std::memory_order_release );
+	}
+	else if ( sf_seek( stream.m_pFile, stream.m_nStartFrame, SEEK_SET ) < 0 ) {
+		ERRORLOG( QString( "Unable to seek to frame [%1] in [%2]" )
+				  .arg( stream.m_nStartFrame ).arg( sFilepath ) );
+		closeFile( stream );
+		stream.m_bFailed.store( true, std::memory_order_release );
+	}
+	else {
+		stream.m_nFileChannels = soundInfo.channels;
+	}
+
+	// The owner might have closed the stream in the meantime.
+	// Streams which could not be opened stay active and will starve.
+	auto state = DiskStream::State::Requested;
+	stream.m_state.compare_exchange_strong( state, DiskStream::State::Active,
+											std::memory_order_acq_rel );
+}
+
+bool DiskStreamer::fill( DiskStream& stream )
+{
+	if ( stream.m_pFile == nullptr ) {
+		return false;
+	}
+
+	const int nWriteFrame = stream.m_nWriteFrame.load( std::memory_order_relaxed );
+	const int nReadFrame = stream.m_nReadFrame.load( std::memory_order_acquire );
+	const int nFrames = std::min( { nChunkFrames,
+									nReadFrame + m_nBufferFrames - nWriteFrame,
+									stream.m_nFrames - nWriteFrame } );
+	if ( nFrames <= 0 ) {
+		return false;
+	}
+
+	const size_t nValues = static_cast<size_t>( nFrames ) * stream.m_nFileChannels;
+	if ( m_readBuffer.size() < nValues ) {
+		m_readBuffer.resize( nValues );
+	}
+	const sf_count_t nRead = sf_readf_float( stream.m_pFile, m_readBuffer.data(), nFrames );
+	if ( nRead <= 0 ) {
+		// The file is shorter than expected or was altered. The
+		// remainder will starve.
+		WARNINGLOG( QString( "Unable to read frame [%1] of [%2]" )
+					.arg( nWriteFrame ).arg( stream.m_pSample->get_filepath() ) );
+		closeFile( stream );
+		stream.m_bFailed.store( true, std::memory_order_release );
+		return false;
+	}
+
+	for ( int nChannel = 0; nChannel < std::min( stream.m_nChannels, 2 ); ++nChannel ) {
+		float* pRing = stream.m_ring[ nChannel ].get();
+		const float* pIn = m_readBuffer.data() + nChannel;
+		for ( int ii = 0; ii < nRead; ++ii, pIn += stream.m_nFileChannels ) {
+			pRing[ ( nWriteFrame + ii ) & stream.m_nMask ] = *pIn;
+		}
+	}
+	stream.m_nWriteFrame.store( nWriteFrame + nRead, std::memory_order_release );
+
+	return true;
+}
+
+void DiskStreamer::closeFile( DiskStream& stream )
+{
+	if ( stream.m_pFile != nullptr ) {
+		sf_close( stream.m_pFile );
+		stream.m_pFile = nullptr;
+	}
+}
+
+void DiskStreamer::reportStarvation()
+{
+	m_nStarvations.fetch_add( 1, std::memory_order_relaxed );
+}
+
+void DiskStreamer::reportHeadroom( int nFrames )
+{
+	const int nMin = m_nMinHeadroom.load( std::memory_order_relaxed );
+	if ( nMin < 0 || nFrames < nMin ) {
+		m_nMinHeadroom.store( nFrames, std::memory_order_relaxed );
+	}
+}
+
+void DiskStreamer::waitFor( const DiskStream* pStream )
+{
+	while ( ! pStream->isReady() && ! m_bQuit.load() ) {
+		m_condition.notify_all();
+		std::this_thread::sleep_for( std::chrono::microseconds( 100 ) );
+	}
+}
+
+DiskStreamer::Stats DiskStreamer::getStats() const
+{
+	Stats stats;
+	stats.nActiveStreams = 0;
+	for ( int ii = 0; ii < m_nStreams; ++ii ) {
+		if ( m_streams[ ii ].m_state.load( std::memory_order_relaxed ) !=
+			 DiskStream::State::Free ) {
+			++stats.nActiveStreams;
+		}
+	}
+	stats.nStreams = m_nStreams;
+	stats.nBufferFrames = m_nBufferFrames;
+	stats.nStarvations = m_nStarvations.load( std::memory_order_relaxed );
+	stats.nUnavailable = m_nUnavailable.load( std::memory_order_relaxed );
+	stats.nMinHeadroom = m_nMinHeadroom.load( std::memory_order_relaxed );
+	return stats;
+}
+
+void DiskStreamer::resetStats()
+{
+	m_nStarvations.store( 0 );
+	m_nUnavailable.store( 0 );
+	m_nMinHeadroom.store( -1 );
+}
+
+QString DiskStreamer::toQString( const QString& sPrefix, bool bShort ) const {
+	const auto stats = getStats();
+	QString s = Base::sPrintIndention;
+	QString sOutput;
+	if ( ! bShort ) {
+		sOutput = QString( "%1[DiskStreamer]\n" ).arg( sPrefix )
+			.append( QString( "%1%2streams: %3 / %4\n" ).arg( sPrefix ).arg( s )
+					 .arg( stats.nActiveStreams ).arg( stats.nStreams ) )
+			.append( QString( "%1%2buffer frames: %3\n" ).arg( sPrefix ).arg( s ).arg( stats.nBufferFrames ) )
+			.append( QString( "%1%2starvations: %3\n" ).arg( sPrefix ).arg( s ).arg( stats.nStarvations ) )
+			.append( QString( "%1%2unavailable: %3\n" ).arg( sPrefix ).arg( s ).arg( stats.nUnavailable ) )
+			.append( QString( "%1%2min headroom: %3\n" ).arg( sPrefix ).arg( s ).arg( stats.nMinHeadroom ) );
+	} else {
+		sOutput = QString( "[DiskStreamer]" )
+			.append( QString( " streams: %1 / %2" ).arg( stats.nActiveStreams ).arg( stats.nStreams ) )
+			.append( QString( ", buffer frames: %1" ).arg( stats.nBufferFrames ) )
+			.append( QString( ", starvations: %1" ).arg( stats.nStarvations ) )
+			.append( QString( ", unavailable: %1" ).arg( stats.nUnavailable ) )
+			.append( QString( ", min headroom: %1" ).arg( stats.nMinHeadroom ) );
+	}
+	return sOutput;
+}
+
+};
@@ -0,0 +1,303 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2C_DISK_STREAMER_H
+#define H2C_DISK_STREAMER_H
+
+#include <core/Object.h>
+
+#include <sndfile.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace H2Core
+{
+
+class Sample;
+
+/**
+ * Frames of a streamed Sample beyond its resident head, read ahead
+ * from disk for a single voice.
+ *
+ * The frames are kept in a ring buffer. The DiskStreamer thread
+ * appends to it while the audio thread consumes. Neither side does
+ * block or allocate memory.
+ *
+ * \ingroup docCore docAudioEngine
+ */
+class DiskStream
+{
+public:
+	/**
+	 * Float access to a single channel of a streamed sample via
+	 * operator[]. Frames within the head are read using @a
+	 * HeadReader (see SampleBuffer::Reader), all others from the
+	 * ring buffer.
+	 *
+	 * Frames not read from disk yet result in silence and mark the
+	 * voice as starved.
+	 */
+	template <typename HeadReader>
+	struct Reader {
+		HeadReader head;
+		int nHeadFrames;
+		const float* pRing;
+		int nMask;
+		/** First frame in the ring buffer.*/
+		int nStartFrame;
+		/** Number of frames following #nStartFrame available.*/
+		unsigned nAvailable;
+		bool* pStarved;
+
+		float operator[]( int nFrame ) const {
+			if ( nFrame < nHeadFrames ) {
+				return head[ nFrame ];
+			}
+			const unsigned nOffset = static_cast<unsigned>( nFrame - nStartFrame );
+			if ( nOffset < nAvailable ) {
+				return pRing[ nFrame & nMask ];
+			}
+			*pStarved = true;
+			return 0.0f;
+		}
+	};
+
+	/**
+	 * \return Reader for channel @a nChannel. Frames up to the
+	 * current fill level are readable until setReadFrame() is
+	 * called.
+	 */
+	template <typename HeadReader>
+	Reader<HeadReader> getReader( HeadReader head, int nChannel, int nHeadFrames,
+								  bool* pStarved ) const;
+
+	/** \return Sample the stream was opened for.*/
+	const Sample* getSample() const;
+	/** \return Frame following the last one read from disk.*/
+	int getWriteFrame() const;
+	/** \return Whether all remaining frames of the sample were read.*/
+	bool isComplete() const;
+	/** \return Whether the ring buffer is filled entirely, all
+	 * remaining frames were read, or reading the file failed.*/
+	bool isReady() const;
+	/**
+	 * Allows the DiskStreamer to overwrite all frames in front of
+	 * @a nFrame.
+	 *
+	 * Must not be called while a Reader of the stream is in use.
+	 */
+	void setReadFrame( int nFrame );
+	/** Returns the stream to the DiskStreamer. It must not be used
+	 * afterwards. Real-time safe.*/
+	void close();
+
+private:
+	friend class DiskStreamer;
+
+	enum class State {
+		Free,
+		/** Handed out by DiskStreamer::open() but not opened on
+		 * disk yet.*/
+		Requested,
+		Active,
+		/** Closed by its owner but the file is still open.*/
+		Closing
+	};
+
+	DiskStream();
+
+	std::atomic<State> m_state;
+	/** Set by the audio thread prior to publishing #m_state
+	 * Requested. Reset by the DiskStreamer thread once closed.*/
+	std::shared_ptr<Sample> m_pSample;
+	int m_nChannels;
+	int m_nFrames;
+	int m_nStartFrame;
+	std::atomic<int> m_nWriteFrame;
+	std::atomic<int> m_nReadFrame;
+	/** Set by the DiskStreamer thread in case the file could not be
+	 * read.*/
+	std::atomic<bool> m_bFailed;
+	/** Ring buffer of each channel. The position of a frame is
+	 * its index masked by #m_nMask.*/
+	std::unique_ptr<float[]> m_ring[ 2 ];
+	int m_nMask;
+
+	/** Only accessed by the DiskStreamer thread. @{ */
+	SNDFILE* m_pFile;
+	int m_nFileChannels;
+	/** @} */
+};
+
+/**
+ * Streams long samples of drumkits from disk (see
+ * Preferences::m_bDiskStreaming).
+ *
+ * Streamed samples only keep their first
+ * Preferences::m_nStreamingHeadFrames frames in memory. Once a note
+ * starts playing one of them, the Sampler opens a DiskStream and a
+ * background thread reads the following frames into its ring buffer
+ * while the head is played.
+ *
+ * All streams and their buffers are allocated on construction.
+ * open() and DiskStream::close() only exchange the state of a stream
+ * and are real-time safe. The thread polls the streams every few
+ * milliseconds and reads in chunks of #nChunkFrames frames.
+ *
+ * Each period a voice tried to read frames not available yet is
+ * counted as a starvation. Along with the minimal number of frames
+ * read ahead this allows to size the buffers for the storage in use.
+ *
+ * \ingroup docCore docAudioEngine
+ */
+class DiskStreamer : public H2Core::Object<DiskStreamer>
+{
+	H2_OBJECT(DiskStreamer)
+public:
+	struct Stats {
+		/** Number of streams in use.*/
+		int nActiveStreams;
+		int nStreams;
+		/** Frames read ahead for each stream.*/
+		int nBufferFrames;
+		/** Number of periods voices had to render silence since the
+		 * frames were not read from disk in time.*/
+		long long nStarvations;
+		/** Number of periods voices did not get a stream since all
+		 * of them were in use.*/
+		long long nUnavailable;
+		/** Smallest number of frames read ahead of a playing voice
+		 * observed. -1 if none was observed yet.*/
+		int nMinHeadroom;
+	};
+
+	/**
+	 * \param nStreams Maximum number of voices streamed at the same
+	 * time.
+	 * \param nBufferFrames Number of frames read ahead for each
+	 * voice. Rounded up to the next power of two.
+	 */
+	DiskStreamer( int nStreams, int nBufferFrames );
+	~DiskStreamer();
+
+	DiskStreamer( const DiskStreamer& ) = delete;
+	DiskStreamer& operator=( const DiskStreamer& ) = delete;
+
+	/**
+	 * Starts to read @a pSample from @a nStartFrame on.
+	 *
+	 * To be called by the audio thread only.
+	 *
+	 * \return nullptr if all streams are in use.
+	 */
+	DiskStream* open( std::shared_ptr<Sample> pSample, int nStartFrame );
+
+	/** Called by the Sampler for each starved voice.*/
+	void reportStarvation();
+	/** Called by the Sampler with the number of frames read ahead
+	 * of a playing voice.*/
+	void reportHeadroom( int nFrames );
+	/**
+	 * Blocks till @a pStream is ready (see DiskStream::isReady()).
+	 *
+	 * Used while rendering offline, which must not miss any frames
+	 * but does not have to keep up with the clock either. Not
+	 * real-time safe.
+	 */
+	void waitFor( const DiskStream* pStream );
+
+	Stats getStats() const;
+	void resetStats();
+
+	/** Number of frames read from disk at once.*/
+	static constexpr int nChunkFrames = 4096;
+
+	QString toQString( const QString& sPrefix, bool bShort = true ) const override;
+
+private:
+	void threadMain();
+	/** Opens the file of a stream in state Requested.*/
+	void openFile( DiskStream& stream );
+	/** Reads the next chunk of @a stream.
+	 * \return Whether there was anything to read.*/
+	bool fill( DiskStream& stream );
+	void closeFile( DiskStream& stream );
+
+	std::unique_ptr<DiskStream[]> m_streams;
+	int m_nStreams;
+	int m_nBufferFrames;
+
+	std::thread m_thread;
+	std::atomic<bool> m_bQuit;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	/** Interleaved frames as read from a file.*/
+	std::vector<float> m_readBuffer;
+
+	std::atomic<long long> m_nStarvations;
+	std::atomic<long long> m_nUnavailable;
+	std::atomic<int> m_nMinHeadroom;
+};
+
+template <typename HeadReader>
+inline DiskStream::Reader<HeadReader> DiskStream::getReader( HeadReader head, int nChannel,
+															  int nHeadFrames,
+															  bool* pStarved ) const {
+	const int nWriteFrame = m_nWriteFrame.load( std::memory_order_acquire );
+	return Reader<HeadReader>{
+		head, nHeadFrames, m_ring[ nChannel < m_nChannels ? nChannel : 0 ].get(),
+		m_nMask, m_nStartFrame,
+		static_cast<unsigned>( nWriteFrame - m_nStartFrame ), pStarved };
+}
+
+inline const Sample* DiskStream::getSample() const {
+	return m_pSample.get();
+}
+inline int DiskStream::getWriteFrame() const {
+	return m_nWriteFrame.load( std::memory_order_acquire );
+}
+inline bool DiskStream::isComplete() const {
+	return getWriteFrame() >= m_nFrames;
+}
+inline bool DiskStream::isReady() const {
+	return getWriteFrame() >= std::min( m_nFrames, m_nReadFrame.load( std::memory_order_relaxed ) +
+										m_nMask + 1 ) ||
+		m_bFailed.load( std::memory_order_acquire );
+}
+inline void DiskStream::setReadFrame( int nFrame ) {
+	if ( nFrame > m_nReadFrame.load( std::memory_order_relaxed ) ) {
+		m_nReadFrame.store( nFrame, std::memory_order_release );
+	}
+}
+inline void DiskStream::close() {
+	m_state.store( State::Closing, std::memory_order_release );
+}
+
+};
+
+#endif // H2C_DISK_STREAMER_H
@@ -0,0 +1,124 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2C_FILTER_H
+#define H2C_FILTER_H
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace H2Core
+{
+
+/**
+ * Block-wise kernel of the resonant low pass filter of the
+ * instruments (see Note::apply_filter()).
+ *
+ * \ingroup docCore docAudioEngine
+ */
+namespace Filter
+{
+	/**
+	 * Feedback of the state-variable filter of both channels. Index
+	 * 0 refers to the left, 1 to the right one.
+	 */
+	struct State {
+		float fBandPass[ 2 ];
+		float fLowPass[ 2 ];
+	};
+
+	/**
+	 * Filters the first @a nFrames frames of @a pBuffer_L and @a
+	 * pBuffer_R in place.
+	 *
+	 * The coefficients are interpolated linearly from @a fCutoffFrom
+	 * and @a fResonanceFrom to @a fCutoffTo and @a fResonanceTo,
+	 * which are reached by the last frame. This way changes of the
+	 * parameters in between two blocks do not cause zipper noise.
+	 * With constant coefficients the results are identical to
+	 * filtering frame by frame.
+	 *
+	 * The filter is recursive in time. Instead of several frames the
+	 * SSE2 kernel does process the left and right channel at once.
+	 */
+	inline void lowPass( float* pBuffer_L, float* pBuffer_R, int nFrames, State& state,
+						 float fCutoffFrom, float fCutoffTo,
+						 float fResonanceFrom, float fResonanceTo )
+	{
+		if ( nFrames <= 0 ) {
+			return;
+		}
+
+		const float fCutoffStep = ( fCutoffTo - fCutoffFrom ) / nFrames;
+		const float fResonanceStep = ( fResonanceTo - fResonanceFrom ) / nFrames;
+
+#ifdef __SSE2__
+		const __m128 cutoffStep = _mm_set1_ps( fCutoffStep );
+		const __m128 resonanceStep = _mm_set1_ps( fResonanceStep );
+		__m128 cutoff = _mm_set1_ps( fCutoffFrom );
+		__m128 resonance = _mm_set1_ps( fResonanceFrom );
+		__m128 bandPass = _mm_setr_ps( state.fBandPass[ 0 ], state.fBandPass[ 1 ], 0.f, 0.f );
+		__m128 lowPass = _mm_setr_ps( state.fLowPass[ 0 ], state.fLowPass[ 1 ], 0.f, 0.f );
+		for ( int ii = 0; ii < nFrames; ++ii ) {
+			cutoff = _mm_add_ps( cutoff, cutoffStep );
+			resonance = _mm_add_ps( resonance, resonanceStep );
+			const __m128 input = _mm_unpacklo_ps( _mm_load_ss( pBuffer_L + ii ),
+												  _mm_load_ss( pBuffer_R + ii ) );
+			bandPass = _mm_add_ps( _mm_mul_ps( resonance, bandPass ),
+								   _mm_mul_ps( cutoff, _mm_sub_ps( input, lowPass ) ) );
+			lowPass = _mm_add_ps( lowPass, _mm_mul_ps( cutoff, bandPass ) );
+			_mm_store_ss( pBuffer_L + ii, lowPass );
+			_mm_store_ss( pBuffer_R + ii,
+						  _mm_shuffle_ps( lowPass, lowPass, _MM_SHUFFLE( 1, 1, 1, 1 ) ) );
+		}
+
+		float fBandPass[ 4 ];
+		float fLowPass[ 4 ];
+		_mm_storeu_ps( fBandPass, bandPass );
+		_mm_storeu_ps( fLowPass, lowPass );
+		state = { { fBandPass[ 0 ], fBandPass[ 1 ] }, { fLowPass[ 0 ], fLowPass[ 1 ] } };
+#else
+		float fCutoff = fCutoffFrom;
+		float fResonance = fResonanceFrom;
+		float fBandPass_L = state.fBandPass[ 0 ];
+		float fBandPass_R = state.fBandPass[ 1 ];
+		float fLowPass_L = state.fLowPass[ 0 ];
+		float fLowPass_R = state.fLowPass[ 1 ];
+		for ( int ii = 0; ii < nFrames; ++ii ) {
+			fCutoff += fCutoffStep;
+			fResonance += fResonanceStep;
+			fBandPass_L = fResonance * fBandPass_L + fCutoff * ( pBuffer_L[ ii ] - fLowPass_L );
+			fLowPass_L += fCutoff * fBandPass_L;
+			fBandPass_R = fResonance * fBandPass_R + fCutoff * ( pBuffer_R[ ii ] - fLowPass_R );
+			fLowPass_R += fCutoff * fBandPass_R;
+			pBuffer_L[ ii ] = fLowPass_L;
+			pBuffer_R[ ii ] = fLowPass_R;
+		}
+		state = { { fBandPass_L, fBandPass_R }, { fLowPass_L, fLowPass_R } };
+#endif
+	}
+};
+
+};
+
+#endif // H2C_FILTER_H
@@ -25,6 +25,10 @@
 
 #include <cmath>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 namespace H2Core
 {
 
@@ -118,6 +122,226 @@ namespace Interpolation
 			return( a0 * mu * mu2 + a1 * mu2 + a2 * mu + a3 );
 	};
 
+	/**
+	 * Interpolates a single value using the method given at
+	 * compile-time.
+	 *
+	 * For InterpolateMode::Cosine @a fMu is expected to be already
+	 * transformed using cosineMu().
+	 */
+	template <InterpolateMode mode>
+	inline float interpolate( float y0, float y1, float y2, float y3, float fMu )
+	{
+		if constexpr ( mode == InterpolateMode::Linear ||
+					   mode == InterpolateMode::Cosine ) {
+			return linear_Interpolate( y1, y2, fMu );
+		}
+		else if constexpr ( mode == InterpolateMode::Third ) {
+			return third_Interpolate( y0, y1, y2, y3, fMu );
+		}
+		else if constexpr ( mode == InterpolateMode::Cubic ) {
+			return cubic_Interpolate( y0, y1, y2, y3, fMu );
+		}
+		else {
+			return hermite_Interpolate( y0, y1, y2, y3, fMu );
+		}
+	}
+
+	/** Maps @a fMu onto the cosine slope used by cosine_Interpolate().*/
+	inline float cosineMu( double fMu )
+	{
+		return ( 1 - cos( fMu * 3.14159 ) ) / 2;
+	}
+
+#ifdef __SSE2__
+	/** Four-wide version of interpolate(). */
+	template <InterpolateMode mode>
+	inline __m128 interpolate( __m128 y0, __m128 y1, __m128 y2, __m128 y3, __m128 mu )
+	{
+		const __m128 half = _mm_set1_ps( 0.5f );
+		if constexpr ( mode == InterpolateMode::Linear ||
+					   mode == InterpolateMode::Cosine ) {
+			const __m128 one = _mm_set1_ps( 1.0f );
+			return _mm_add_ps( _mm_mul_ps( y1, _mm_sub_ps( one, mu ) ),
+							   _mm_mul_ps( y2, mu ) );
+		}
+		else if constexpr ( mode == InterpolateMode::Third ) {
+			const __m128 c0 = y1;
+			const __m128 c1 = _mm_mul_ps( half, _mm_sub_ps( y2, y0 ) );
+			const __m128 c3 = _mm_add_ps( _mm_mul_ps( _mm_set1_ps( 1.5f ), _mm_sub_ps( y1, y2 ) ),
+										  _mm_mul_ps( half, _mm_sub_ps( y3, y0 ) ) );
+			const __m128 c2 = _mm_sub_ps( _mm_add_ps( _mm_sub_ps( y0, y1 ), c1 ), c3 );
+			__m128 val = _mm_add_ps( _mm_mul_ps( c3, mu ), c2 );
+			val = _mm_add_ps( _mm_mul_ps( val, mu ), c1 );
+			return _mm_add_ps( _mm_mul_ps( val, mu ), c0 );
+		}
+		else {
+			__m128 a0, a1, a2;
+			if constexpr ( mode == InterpolateMode::Cubic ) {
+				a0 = _mm_add_ps( _mm_sub_ps( _mm_sub_ps( y3, y2 ), y0 ), y1 );
+				a1 = _mm_sub_ps( _mm_sub_ps( y0, y1 ), a0 );
+				a2 = _mm_sub_ps( y2, y0 );
+			} else {
+				const __m128 onehalf = _mm_set1_ps( 1.5f );
+				a0 = _mm_add_ps( _mm_mul_ps( half, _mm_sub_ps( y3, y0 ) ),
+								 _mm_mul_ps( onehalf, _mm_sub_ps( y1, y2 ) ) );
+				a1 = _mm_sub_ps( _mm_add_ps( y0, _mm_add_ps( y2, y2 ) ),
+								 _mm_add_ps( _mm_mul_ps( _mm_set1_ps( 2.5f ), y1 ),
+											 _mm_mul_ps( half, y3 ) ) );
+				a2 = _mm_mul_ps( half, _mm_sub_ps( y2, y0 ) );
+			}
+			// Horner scheme of a0 * mu^3 + a1 * mu^2 + a2 * mu + y1
+			__m128 val = _mm_add_ps( _mm_mul_ps( a0, mu ), a1 );
+			val = _mm_add_ps( _mm_mul_ps( val, mu ), a2 );
+			return _mm_add_ps( _mm_mul_ps( val, mu ), y1 );
+		}
+	}
+#endif
+
+	/**
+	 * Gathers the four frames around @a nPos required by the
+	 * interpolation. Frames outside of the sample are set to zero.
+	 *
+	 * @a Data is either a pointer to float or one of the
+	 * SampleBuffer::Reader.
+	 */
+	template <typename Data>
+	inline void gatherFrames( const Data& pData, int nFrames, int nPos,
+							  float& y0, float& y1, float& y2, float& y3 )
+	{
+		y0 = ( nPos >= 1 && nPos <= nFrames ) ? pData[ nPos - 1 ] : 0.0;
+		y1 = ( nPos >= 0 && nPos < nFrames ) ? pData[ nPos ] : 0.0;
+		y2 = ( nPos >= -1 && nPos + 1 < nFrames ) ? pData[ nPos + 1 ] : 0.0;
+		y3 = ( nPos >= -2 && nPos + 2 < nFrames ) ? pData[ nPos + 2 ] : 0.0;
+	}
+
+	/**
+	 * Interpolates the stereo frame at @a fSamplePos. Positions past
+	 * the end of the sample yield silence.
+	 */
+	template <InterpolateMode mode, typename Data>
+	inline void resampleFrame( const Data& pData_L, const Data& pData_R, int nFrames,
+							   double fSamplePos, float* pOut_L, float* pOut_R )
+	{
+		const int nPos = static_cast<int>( fSamplePos );
+		float fMu;
+		if constexpr ( mode == InterpolateMode::Cosine ) {
+			fMu = cosineMu( fSamplePos - nPos );
+		} else {
+			fMu = fSamplePos - nPos;
+		}
+
+		if ( nPos >= 1 && nPos + 2 < nFrames ) {
+			// Common case: all required frames are within the sample.
+			*pOut_L = interpolate<mode>( pData_L[ nPos - 1 ], pData_L[ nPos ],
+										 pData_L[ nPos + 1 ], pData_L[ nPos + 2 ], fMu );
+			*pOut_R = interpolate<mode>( pData_R[ nPos - 1 ], pData_R[ nPos ],
+										 pData_R[ nPos + 1 ], pData_R[ nPos + 2 ], fMu );
+		}
+		else if ( nPos - 1 >= nFrames ) {
+			// We reached the last frame of the sample.
+			*pOut_L = 0.0;
+			*pOut_R = 0.0;
+		}
+		else {
+			float y0, y1, y2, y3;
+			gatherFrames( pData_L, nFrames, nPos, y0, y1, y2, y3 );
+			*pOut_L = interpolate<mode>( y0, y1, y2, y3, fMu );
+			gatherFrames( pData_R, nFrames, nPos, y0, y1, y2, y3 );
+			*pOut_R = interpolate<mode>( y0, y1, y2, y3, fMu );
+		}
+	}
+
+	/**
+	 * Renders @a nBufferSize frames of a stereo sample resampled by
+	 * @a fStep into @a pOut_L and @a pOut_R.
+	 *
+	 * The interpolation method is chosen at compile time so the
+	 * compiler can create a dedicated loop for each of them. On
+	 * platforms supporting SSE2 four frames lying completely within
+	 * the sample are interpolated at once. Positions past the end of
+	 * the sample yield silence.
+	 *
+	 * \param pData_L Left channel of the sample. Either a pointer to
+	 * float or one of the SampleBuffer::Reader.
+	 * \param pData_R Right channel of the sample
+	 * \param nFrames Number of frames of the sample
+	 * \param fSamplePos Position within the sample of the first frame
+	 * \param fStep Increment of the position per rendered frame
+	 * \param pOut_L Left output buffer. Must not overlap with the sample.
+	 * \param pOut_R Right output buffer. Must not overlap with the sample.
+	 * \param nBufferSize Number of frames to render
+	 *
+	 * \return Position within the sample following the last rendered
+	 * frame.
+	 */
+	template <InterpolateMode mode, typename Data>
+	inline double resample( const Data& pData_L, const Data& pData_R, int nFrames,
+							double fSamplePos, float fStep,
+							float* pOut_L, float* pOut_R, int nBufferSize )
+	{
+		int nBufferPos = 0;
+
+#ifdef __SSE2__
+		for ( ; nBufferPos + 4 <= nBufferSize; nBufferPos += 4 ) {
+			int nPos[ 4 ];
+			float fMu[ 4 ];
+			double fPos = fSamplePos;
+			for ( int ii = 0; ii < 4; ++ii ) {
+				nPos[ ii ] = static_cast<int>( fPos );
+				if constexpr ( mode == InterpolateMode::Cosine ) {
+					fMu[ ii ] = cosineMu( fPos - nPos[ ii ] );
+				} else {
+					fMu[ ii ] = fPos - nPos[ ii ];
+				}
+				fPos += fStep;
+			}
+
+			// Positions are strictly increasing. Checking the first
+			// and last one is sufficient.
+			if ( nPos[ 0 ] < 1 || nPos[ 3 ] + 2 >= nFrames ) {
+				for ( int ii = 0; ii < 4; ++ii ) {
+					resampleFrame<mode>( pData_L, pData_R, nFrames, fSamplePos,
+										 &pOut_L[ nBufferPos + ii ], &pOut_R[ nBufferPos + ii ] );
+					fSamplePos += fStep;
+				}
+				continue;
+			}
+
+			const __m128 mu = _mm_loadu_ps( fMu );
+			const __m128 l0 = _mm_setr_ps( pData_L[ nPos[ 0 ] - 1 ], pData_L[ nPos[ 1 ] - 1 ],
+										   pData_L[ nPos[ 2 ] - 1 ], pData_L[ nPos[ 3 ] - 1 ] );
+			const __m128 l1 = _mm_setr_ps( pData_L[ nPos[ 0 ] ], pData_L[ nPos[ 1 ] ],
+										   pData_L[ nPos[ 2 ] ], pData_L[ nPos[ 3 ] ] );
+			const __m128 l2 = _mm_setr_ps( pData_L[ nPos[ 0 ] + 1 ], pData_L[ nPos[ 1 ] + 1 ],
+										   pData_L[ nPos[ 2 ] + 1 ], pData_L[ nPos[ 3 ] + 1 ] );
+			const __m128 l3 = _mm_setr_ps( pData_L[ nPos[ 0 ] + 2 ], pData_L[ nPos[ 1 ] + 2 ],
+										   pData_L[ nPos[ 2 ] + 2 ], pData_L[ nPos[ 3 ] + 2 ] );
+			const __m128 r0 = _mm_setr_ps( pData_R[ nPos[ 0 ] - 1 ], pData_R[ nPos[ 1 ] - 1 ],
+										   pData_R[ nPos[ 2 ] - 1 ], pData_R[ nPos[ 3 ] - 1 ] );
+			const __m128 r1 = _mm_setr_ps( pData_R[ nPos[ 0 ] ], pData_R[ nPos[ 1 ] ],
+										   pData_R[ nPos[ 2 ] ], pData_R[ nPos[ 3 ] ] );
+			const __m128 r2 = _mm_setr_ps( pData_R[ nPos[ 0 ] + 1 ], pData_R[ nPos[ 1 ] + 1 ],
+										   pData_R[ nPos[ 2 ] + 1 ], pData_R[ nPos[ 3 ] + 1 ] );
+			const __m128 r3 = _mm_setr_ps( pData_R[ nPos[ 0 ] + 2 ], pData_R[ nPos[ 1 ] + 2 ],
+										   pData_R[ nPos[ 2 ] + 2 ], pData_R[ nPos[ 3 ] + 2 ] );
+
+			_mm_storeu_ps( &pOut_L[ nBufferPos ], interpolate<mode>( l0, l1, l2, l3, mu ) );
+			_mm_storeu_ps( &pOut_R[ nBufferPos ], interpolate<mode>( r0, r1, r2, r3, mu ) );
+
+			fSamplePos = fPos;
+		}
+#endif
+
+		for ( ; nBufferPos < nBufferSize; ++nBufferPos ) {
+			resampleFrame<mode>( pData_L, pData_R, nFrames, fSamplePos,
+								 &pOut_L[ nBufferPos ], &pOut_R[ nBufferPos ] );
+			fSamplePos += fStep;
+		}
+
+		return fSamplePos;
+	}
+
 };
 
 }
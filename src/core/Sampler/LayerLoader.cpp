@@ -0,0 +1,214 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+
+#include <core/Sampler/LayerLoader.h>
+#include <core/AudioEngine/AudioEngine.h>
+#include <core/Basics/InstrumentLayer.h>
+#include <core/Basics/Sample.h>
+#include <core/Hydrogen.h>
+#include <core/IO/AudioOutput.h>
+#include <core/Preferences/Preferences.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace H2Core
+{
+
+/** Time the thread sleeps in case there is nothing to load.*/
+static constexpr std::chrono::milliseconds pollInterval( 5 );
+
+LayerLoader::LayerLoader( int nSlots )
+	: m_nSlots( std::max( 1, nSlots ) )
+	, m_bQuit( false )
+	, m_nPending( 0 )
+	, m_nLoaded( 0 )
+	, m_nFailed( 0 )
+	, m_nUnavailable( 0 )
+{
+	m_slots.reset( new Slot[ m_nSlots ] );
+	for ( int ii = 0; ii < m_nSlots; ++ii ) {
+		m_slots[ ii ].state.store( Slot::State::Free, std::memory_order_relaxed );
+	}
+
+	m_thread = std::thread( &LayerLoader::threadMain, this );
+	INFOLOG( QString( "Loading layers on demand using [%1] slots" ).arg( m_nSlots ) );
+}
+
+LayerLoader::~LayerLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock( m_mutex );
+		m_bQuit.store( true );
+	}
+	m_condition.notify_all();
+	m_thread.join();
+
+	for ( int ii = 0; ii < m_nSlots; ++ii ) {
+		m_slots[ ii ].pLayer = nullptr;
+	}
+}
+
+void LayerLoader::request( std::shared_ptr<InstrumentLayer> pLayer )
+{
+	if ( ! pLayer->request_sample() ) {
+		return;
+	}
+
+	for ( int ii = 0; ii < m_nSlots; ++ii ) {
+		auto& slot = m_slots[ ii ];
+		auto state = Slot::State::Free;
+		if ( ! slot.state.compare_exchange_strong( state, Slot::State::Claimed,
+												   std::memory_order_acquire ) ) {
+			continue;
+		}
+
+		// The thread does not touch claimed slots and resets
+		// pLayer before freeing one. No memory is released here.
+		slot.pLayer = pLayer;
+		m_nPending.fetch_add( 1, std::memory_order_relaxed );
+		slot.state.store( Slot::State::Requested, std::memory_order_release );
+		return;
+	}
+
+	// Try again on the next note.
+	pLayer->defer_sample();
+	m_nUnavailable.fetch_add( 1, std::memory_order_relaxed );
+}
+
+void LayerLoader::wait()
+{
+	std::unique_lock<std::mutex> lock( m_mutex );
+	while ( m_nPending.load() > 0 ) {
+		m_doneCondition.wait_for( lock, pollInterval );
+	}
+}
+
+std::shared_ptr<Sample> LayerLoader::loadSample( std::shared_ptr<InstrumentLayer> pLayer,
+												 int nSampleRate )
+{
+	const auto pDeferred = pLayer->get_sample();
+	if ( pDeferred == nullptr ) {
+		return nullptr;
+	}
+
+	// Layers of drumkits may be streamed from disk.
+	auto pSample = std::make_shared<Sample>( pDeferred->get_filepath() );
+	if ( ! pSample->load( true ) ) {
+		return nullptr;
+	}
+	if ( nSampleRate > 0 && ! pSample->is_streamed() ) {
+		pSample->resample( nSampleRate );
+	}
+	return pSample;
+}
+
+void LayerLoader::threadMain()
+{
+	while ( ! m_bQuit.load() ) {
+		bool bBusy = false;
+		for ( int ii = 0; ii < m_nSlots; ++ii ) {
+			auto& slot = m_slots[ ii ];
+			if ( slot.state.load( std::memory_order_acquire ) != Slot::State::Requested ) {
+				continue;
+			}
+			auto pLayer = std::move( slot.pLayer );
+			slot.pLayer = nullptr;
+			slot.state.store( Slot::State::Free, std::memory_order_release );
+
+			load( pLayer );
+			m_nPending.fetch_sub( 1 );
+			m_doneCondition.notify_all();
+			bBusy = true;
+		}
+
+		if ( ! bBusy ) {
+			std::unique_lock<std::mutex> lock( m_mutex );
+			m_condition.wait_for( lock, pollInterval, [&]() { return m_bQuit.load(); } );
+		}
+	}
+}
+
+void LayerLoader::load( std::shared_ptr<InstrumentLayer> pLayer )
+{
+	auto pHydrogen = Hydrogen::get_instance();
+	int nSampleRate = 0;
+	const auto pAudioDriver = pHydrogen->getAudioOutput();
+	if ( Preferences::get_instance()->m_bResampleOnLoad && pAudioDriver != nullptr ) {
+		nSampleRate = pAudioDriver->getSampleRate();
+	}
+
+	const auto pDeferred = pLayer->get_sample();
+	const auto pSample = loadSample( pLayer, nSampleRate );
+	if ( pSample == nullptr ) {
+		ERRORLOG( QString( "Unable to load [%1]" )
+				  .arg( pDeferred != nullptr ? pDeferred->get_filepath() : "" ) );
+		m_nFailed.fetch_add( 1 );
+	} else {
+		m_nLoaded.fetch_add( 1 );
+	}
+
+	auto pAudioEngine = pHydrogen->getAudioEngine();
+	pAudioEngine->lock( RIGHT_HERE );
+	// The layer might have been loaded in the meantime. In case
+	// loading failed the empty sample is kept and the layer is not
+	// requested again.
+	if ( pLayer->is_deferred() && pLayer->get_sample() == pDeferred ) {
+		pLayer->set_sample( pSample != nullptr ? pSample : pDeferred );
+	}
+	pAudioEngine->unlock();
+}
+
+LayerLoader::Stats LayerLoader::getStats() const
+{
+	Stats stats;
+	stats.nLoaded = m_nLoaded.load( std::memory_order_relaxed );
+	stats.nFailed = m_nFailed.load( std::memory_order_relaxed );
+	stats.nUnavailable = m_nUnavailable.load( std::memory_order_relaxed );
+	stats.nPending = m_nPending.load( std::memory_order_relaxed );
+	return stats;
+}
+
+QString LayerLoader::toQString( const QString& sPrefix, bool bShort ) const {
+	const auto stats = getStats();
+	QString s = Base::sPrintIndention;
+	QString sOutput;
+	if ( ! bShort ) {
+		sOutput = QString( "%1[LayerLoader]\n" ).arg( sPrefix )
+			.append( QString( "%1%2slots: %3\n" ).arg( sPrefix ).arg( s ).arg( m_nSlots ) )
+			.append( QString( "%1%2pending: %3\n" ).arg( sPrefix ).arg( s ).arg( stats.nPending ) )
+			.append( QString( "%1%2loaded: %3\n" ).arg( sPrefix ).arg( s ).arg( stats.nLoaded ) )
+			.append( QString( "%1%2failed: %3\n" ).arg( sPrefix ).arg( s ).arg( stats.nFailed ) )
+			.append( QString( "%1%2unavailable: %3\n" ).arg( sPrefix ).arg( s ).arg( stats.nUnavailable ) );
+	} else {
+		sOutput = QString( "[LayerLoader]" )
+			.append( QString( " slots: %1" ).arg( m_nSlots ) )
+			.append( QString( ", pending: %1" ).arg( stats.nPending ) )
+			.append( QString( ", loaded: %1" ).arg( stats.nLoaded ) )
+			.append( QString( ", failed: %1" ).arg( stats.nFailed ) )
+			.append( QString( ", unavailable: %1" ).arg( stats.nUnavailable ) );
+	}
+	return sOutput;
+}
+
+};
@@ -0,0 +1,143 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+
+#ifndef H2C_LAYER_LOADER_H
+#define H2C_LAYER_LOADER_H
+
+#include <core/Object.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace H2Core
+{
+
+class InstrumentLayer;
+class Sample;
+
+/**
+ * Decodes the samples of layers loaded lazily (see
+ * Preferences::m_bLazyLayerLoading) once the Sampler selects them
+ * for the first time.
+ *
+ * request() claims one of a fixed number of slots and is real-time
+ * safe. A background thread polls the slots every few milliseconds,
+ * decodes the sample, and assigns it to the layer while holding the
+ * lock of the AudioEngine. Till then the Sampler plays the nearest
+ * loaded layer instead.
+ *
+ * \ingroup docCore docAudioEngine
+ */
+class LayerLoader : public H2Core::Object<LayerLoader>
+{
+	H2_OBJECT(LayerLoader)
+public:
+	struct Stats {
+		/** Number of samples loaded on request.*/
+		long long nLoaded;
+		/** Number of samples which could not be loaded.*/
+		long long nFailed;
+		/** Number of requests dropped since all slots were in use.
+		 * The layer is requested again on its next note.*/
+		long long nUnavailable;
+		/** Number of requests not handled yet.*/
+		int nPending;
+	};
+
+	/**
+	 * \param nSlots Maximum number of layers waiting to be loaded at
+	 * the same time.
+	 */
+	LayerLoader( int nSlots );
+	~LayerLoader();
+
+	LayerLoader( const LayerLoader& ) = delete;
+	LayerLoader& operator=( const LayerLoader& ) = delete;
+
+	/**
+	 * Queues the sample of @a pLayer for loading unless it was
+	 * already requested (see InstrumentLayer::request_sample()).
+	 *
+	 * Real-time safe.
+	 */
+	void request( std::shared_ptr<InstrumentLayer> pLayer );
+	/** Blocks till all requests are handled. Not real-time safe.*/
+	void wait();
+
+	/**
+	 * Decodes the sample of a deferred layer without altering the
+	 * layer itself.
+	 *
+	 * \param pLayer Layer to load the sample of.
+	 * \param nSampleRate Rate the sample is converted to. 0 keeps the
+	 * rate of the file.
+	 *
+	 * \return nullptr if the sample could not be loaded.
+	 */
+	static std::shared_ptr<Sample> loadSample( std::shared_ptr<InstrumentLayer> pLayer,
+											   int nSampleRate = 0 );
+
+	Stats getStats() const;
+
+	/** Number of slots used by the Sampler.*/
+	static constexpr int nDefaultSlots = 128;
+
+	QString toQString( const QString& sPrefix, bool bShort = true ) const override;
+
+private:
+	struct Slot {
+		enum class State {
+			Free,
+			/** Written by request().*/
+			Claimed,
+			Requested
+		};
+		std::atomic<State> state;
+		std::shared_ptr<InstrumentLayer> pLayer;
+	};
+
+	void threadMain();
+	void load( std::shared_ptr<InstrumentLayer> pLayer );
+
+	std::unique_ptr<Slot[]> m_slots;
+	int m_nSlots;
+
+	std::thread m_thread;
+	std::atomic<bool> m_bQuit;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	/** Notified whenever a request was handled.*/
+	std::condition_variable m_doneCondition;
+
+	std::atomic<int> m_nPending;
+	std::atomic<long long> m_nLoaded;
+	std::atomic<long long> m_nFailed;
+	std::atomic<long long> m_nUnavailable;
+};
+
+};
+
+#endif // H2C_LAYER_LOADER_H
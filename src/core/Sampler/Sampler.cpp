@@ -20,6 +20,7 @@
  *
  */
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <cstdlib>
@@ -29,6 +30,8 @@
 
 #include <core/Basics/Adsr.h>
 #include <core/AudioEngine/AudioEngine.h>
+#include <core/AudioEngine/NotePool.h>
+#include <core/AudioEngine/WorkerPool.h>
 #include <core/Globals.h>
 #include <core/Hydrogen.h>
 #include <core/Basics/DrumkitComponent.h>
@@ -46,7 +49,10 @@
 #include <core/EventQueue.h>
 
 #include <core/FX/Effects.h>
+#include <core/Sampler/DiskStreamer.h>
+#include <core/Sampler/LayerLoader.h>
 #include <core/Sampler/Sampler.h>
+#include <core/Sampler/VoiceAllocator.h>
 
 #include <iostream>
 #include <QDebug>
@@ -66,11 +72,51 @@ static std::shared_ptr<Instrument> createInstrument(int id, const QString& filep
 	return pInstrument;
 }
 
-Sampler::Sampler()
+/** \return Preferences::m_nMaxNotes bound by the capacity of @a
+ * pVoiceAllocator.*/
+static int getMaxNotes( const VoiceAllocator* pVoiceAllocator )
+{
+	return static_cast<int>( std::min( Preferences::get_instance()->m_nMaxNotes,
+									   static_cast<unsigned>( pVoiceAllocator->getCapacity() ) ) );
+}
+
+/**
+ * Applies the envelope of @a pNote to the rendered frames [@a nFrom,
+ * @a nTo). In case @a bFilterActive is set, the resonant low pass
+ * filter of the instrument is applied as well.
+ */
+template <bool bFilterActive>
+static void applyEnvelopeAndFilter( Note* pNote, float fStep, float* pBuffer_L, float* pBuffer_R,
+									int nFrom, int nTo )
+{
+	if ( nTo <= nFrom ) {
+		return;
+	}
+
+	float fADSRValues[ MAX_BUFFER_SIZE ];
+	pNote->get_adsr()->get_values( fStep, &fADSRValues[ nFrom ], nTo - nFrom );
+	for ( int nBufferPos = nFrom; nBufferPos < nTo; ++nBufferPos ) {
+		pBuffer_L[ nBufferPos ] *= fADSRValues[ nBufferPos ];
+		pBuffer_R[ nBufferPos ] *= fADSRValues[ nBufferPos ];
+	}
+
+	if constexpr ( bFilterActive ) {
+		pNote->apply_filter( &pBuffer_L[ nFrom ], &pBuffer_R[ nFrom ], nTo - nFrom );
+	}
+}
+
+Sampler::Sampler( NotePool* pNotePool )
 		: m_pMainOut_L( nullptr )
 		, m_pMainOut_R( nullptr )
+		, m_pVoiceAllocator( nullptr )
 		, m_pPreviewInstrument( nullptr )
 		, m_interpolateMode( Interpolation::InterpolateMode::Linear )
+		, m_pNotePool( pNotePool )
+		, m_pWorkerPool( nullptr )
+		, m_pDiskStreamer( nullptr )
+		, m_pLayerLoader( nullptr )
+		, m_nMaxVoices( 0 )
+		, m_nVoiceBufferSize( 0 )
 {
 	
 	
@@ -88,6 +134,34 @@ Sampler::Sampler()
 	// dummy instrument used for playback track
 	m_pPlaybackTrackInstrument = createInstrument( PLAYBACK_INSTR_ID, sEmptySampleFilename, 0.8 );
 	m_nPlayBackSamplePosition = 0;
+
+	auto pPref = Preferences::get_instance();
+	m_pVoiceAllocator = new VoiceAllocator(
+		std::max( VoiceAllocator::nDefaultCapacity, static_cast<int>( pPref->m_nMaxNotes ) ) );
+	m_queuedNoteOffs.reserve( m_pVoiceAllocator->getCapacity() );
+
+	// The per-period voice data is never resized by process().
+	m_nMaxVoices = m_pVoiceAllocator->getCapacity();
+	m_voices.reserve( m_nMaxVoices );
+	m_noteVoices.reserve( m_pVoiceAllocator->getCapacity() );
+	m_returnValues.reserve( m_nMaxVoices );
+
+	// Without workers each voice is mixed right after being rendered
+	// and they all share a single buffer.
+	int nWorkers = pPref->m_nSamplerWorkers;
+	int nVoiceBuffers = 1;
+	if ( nWorkers > 0 ) {
+		m_pWorkerPool = new WorkerPool( nWorkers );
+		nVoiceBuffers = m_nMaxVoices;
+	}
+	m_voiceBuffers.reset( new float[ static_cast<size_t>( nVoiceBuffers ) * 2 * MAX_BUFFER_SIZE ] );
+	if ( pPref->m_bDiskStreaming ) {
+		m_pDiskStreamer = new DiskStreamer( pPref->m_nStreamingVoices,
+											pPref->m_nStreamingBufferFrames );
+	}
+	if ( pPref->m_bLazyLayerLoading ) {
+		m_pLayerLoader = new LayerLoader( LayerLoader::nDefaultSlots );
+	}
 }
 
 
@@ -97,6 +171,16 @@ Sampler::~Sampler()
 
 	delete[] m_pMainOut_L;
 	delete[] m_pMainOut_R;
+	delete m_pWorkerPool;
+
+	// Notes still playing hold streams of the DiskStreamer.
+	stopPlayingNotes();
+	for ( auto pNote : m_queuedNoteOffs ) {
+		m_pNotePool->release( pNote );
+	}
+	delete m_pVoiceAllocator;
+	delete m_pDiskStreamer;
+	delete m_pLayerLoader;
 
 	m_pPreviewInstrument = nullptr;
 	m_pPlaybackTrackInstrument = nullptr;
@@ -119,56 +203,118 @@ void Sampler::process( uint32_t nFrames, std::shared_ptr<Song> pSong )
 	// Track output queues are zeroed by
 	// audioEngine_process_clearAudioBuffers()
 
-	// Max notes limit
-	int m_nMaxNotes = Preferences::get_instance()->m_nMaxNotes;
-	while ( ( int )m_playingNotesQueue.size() > m_nMaxNotes ) {
-		Note * pOldNote = m_playingNotesQueue[ 0 ];
-		m_playingNotesQueue.erase( m_playingNotesQueue.begin() );
-		 pOldNote->get_instrument()->dequeue();
-		delete  pOldNote;	// FIXME: send note-off instead of removing the note from the list?
-	}
+	// Max notes limit. It is enforced by noteOn() as well but might
+	// have been lowered in the meantime.
+	m_pVoiceAllocator->limit( getMaxNotes( m_pVoiceAllocator ),
+							  Preferences::get_instance()->m_voiceStealing );
 
 	for ( auto& pComponent : *pSong->getComponents() ) {
 		pComponent->reset_outs(nFrames);
 	}
+	for ( auto& stem : m_stems ) {
+		memset( stem.second.data(), 0, nFrames * sizeof( float ) );
+		memset( stem.second.data() + MAX_BUFFER_SIZE, 0, nFrames * sizeof( float ) );
+	}
 
 	// eseguo tutte le note nella lista di note in esecuzione
-	unsigned i = 0;
-	Note* pNote;
-	while ( i < m_playingNotesQueue.size() ) {
-		pNote = m_playingNotesQueue[ i ];		// recupero una nuova nota
-		if ( renderNote( pNote, nFrames, pSong ) ) {	// la nota e' finita
-			m_playingNotesQueue.erase( m_playingNotesQueue.begin() + i );
-			pNote->get_instrument()->dequeue();
-			m_queuedNoteOffs.push_back( pNote );
-		} else {
-			++i; // carico la prox nota
+	for ( int nNote = 0; nNote < m_pVoiceAllocator->size(); ++nNote ) {
+		prepareNote( m_pVoiceAllocator->getNote( nNote ), nFrames, pSong );
+	}
+
+	// Offline rendering does not have to keep up with the clock but
+	// must not miss any frames streamed from disk.
+	if ( m_pDiskStreamer != nullptr &&
+		 Hydrogen::get_instance()->getAudioEngine()->getOfflineRendering() ) {
+		for ( const auto& voice : m_voices ) {
+			if ( voice.pStream != nullptr ) {
+				m_pDiskStreamer->waitFor( voice.pStream );
+			}
 		}
 	}
 
-	//Queue midi note off messages for notes that have a length specified for them
-	while ( !m_queuedNoteOffs.empty() ) {
-		pNote =  m_queuedNoteOffs[0];
-		MidiOutput* pMidiOut = Hydrogen::get_instance()->getMidiOutput();
-		
-		if( pMidiOut != nullptr && !pNote->get_instrument()->is_muted() ){
-			pMidiOut->handleQueueNoteOff(	pNote->get_instrument()->get_midi_out_channel(), 
-											pNote->get_midi_key(),
-											pNote->get_midi_velocity() );
+	m_nVoiceBufferSize = nFrames;
+	m_pSong = pSong;
+	if ( m_pWorkerPool != nullptr ) {
+		// Each voice gets a buffer of its own.
+		for ( int nVoice = 0; nVoice < m_voices.size(); ++nVoice ) {
+			m_voices[ nVoice ].nBufferOffset = nVoice * 2 * nFrames;
 		}
-		
-		m_queuedNoteOffs.erase( m_queuedNoteOffs.begin() );
-		
-		if( pNote != nullptr ){
-			delete pNote;
+		m_pWorkerPool->run( m_noteVoices.size(), &Sampler::renderNoteVoices, this );
+
+		// Mixing is done in a fixed order to keep the output
+		// independent of the number of workers.
+		for ( auto& voice : m_voices ) {
+			completeVoice( voice, pSong );
+		}
+	} else {
+		// Voices are rendered in the same order they are mixed in
+		// and a single buffer suffices.
+		for ( auto& voice : m_voices ) {
+			voice.nBufferOffset = 0;
+			renderVoice( voice );
+			completeVoice( voice, pSong );
+		}
+	}
+	m_pSong = nullptr;
+
+	// Stolen notes are done once their fade is.
+	m_pVoiceAllocator->advance( nFrames );
+	m_pVoiceAllocator->removeIf( [&]( int nNote, Note* pNote, bool bFadedOut ) {
+		const auto& noteVoices = m_noteVoices[ nNote ];
+		bool bEnded = true;
+		for ( int ii = 0; ii < noteVoices.nReturnValues; ++ii ) {
+			if ( ! m_returnValues[ noteVoices.nFirstReturnValue + ii ] ) {
+				bEnded = false;
+				break;
+			}
 		}
-		
-		pNote = nullptr;
-	}//while
+
+		if ( bEnded || bFadedOut ) {	// la nota e' finita
+			pNote->get_instrument()->dequeue();
+			queueNoteOff( pNote );
+			return true;
+		}
+		return false;
+	} );
+
+	// Releases the samples as well.
+	m_voices.clear();
+	m_noteVoices.clear();
+	m_returnValues.clear();
+
+	//Queue midi note off messages for notes that have a length specified for them
+	for ( auto pNote : m_queuedNoteOffs ) {
+		sendNoteOff( pNote );
+	}
+	m_queuedNoteOffs.clear();
 
 	processPlaybackTrack(nFrames);
 }
 
+void Sampler::queueNoteOff( Note* pNote )
+{
+	// The queue is reserved to the number of voices. Notes exceeding
+	// it, e.g. when more notes are dropped within a single period,
+	// are handled right away instead of growing it.
+	if ( m_queuedNoteOffs.size() < m_queuedNoteOffs.capacity() ) {
+		m_queuedNoteOffs.push_back( pNote );
+	} else {
+		sendNoteOff( pNote );
+	}
+}
+
+void Sampler::sendNoteOff( Note* pNote )
+{
+	MidiOutput* pMidiOut = Hydrogen::get_instance()->getMidiOutput();
+	if( pMidiOut != nullptr && !pNote->get_instrument()->is_muted() ){
+		pMidiOut->handleQueueNoteOff(	pNote->get_instrument()->get_midi_out_channel(), 
+										pNote->get_midi_key(),
+										pNote->get_midi_velocity() );
+	}
+
+	m_pNotePool->release( pNote );
+}
+
 
 
 void Sampler::noteOn(Note *pNote )
@@ -177,42 +323,45 @@ void Sampler::noteOn(Note *pNote )
 	assert( pNote );
 
 	pNote->get_adsr()->attack();
+	pNote->capture_components();
 	auto pInstr = pNote->get_instrument();
 
 	// mute group
 	int nMuteGrp = pInstr->get_mute_group();
 	if ( nMuteGrp != -1 ) {
 		// remove all notes using the same mute group
-		for ( const auto& pNote: m_playingNotesQueue ) {	// delete older note
-			if ( ( pNote->get_instrument() != pInstr )  && ( pNote->get_instrument()->get_mute_group() == nMuteGrp ) ) {
-				pNote->get_adsr()->release();
+		m_pVoiceAllocator->visitMuteGroup( nMuteGrp, [&]( Note* pPlayingNote ) {
+			if ( pPlayingNote->get_instrument() != pInstr ) {
+				pPlayingNote->get_adsr()->release();
 			}
-		}
+		} );
 	}
 
 	//note off notes
 	if( pNote->get_note_off() ){
-		for ( const auto& pNote: m_playingNotesQueue ) {
-			if ( ( pNote->get_instrument() == pInstr ) ) {
-				//ERRORLOG("note_off");
-				pNote->get_adsr()->release();
-			}
-		}
+		m_pVoiceAllocator->visitInstrument( pInstr.get(), []( Note* pPlayingNote ) {
+			pPlayingNote->get_adsr()->release();
+		} );
 	}
 
 	pInstr->enqueue();
 	if( !pNote->get_note_off() ){
-		m_playingNotesQueue.push_back( pNote );
+		// In case all voices are in use the one closest to finish
+		// its fade is cut.
+		Note* pDropped = m_pVoiceAllocator->add( pNote, getMaxNotes( m_pVoiceAllocator ),
+												Preferences::get_instance()->m_voiceStealing );
+		if ( pDropped != nullptr ) {
+			pDropped->get_instrument()->dequeue();
+			queueNoteOff( pDropped );
+		}
 	}
 }
 
 void Sampler::midiKeyboardNoteOff( int key )
 {
-	for ( const auto& pNote: m_playingNotesQueue ) {
-		if ( ( pNote->get_midi_msg() == key) ) {
-			pNote->get_adsr()->release();
-		}
-	}
+	m_pVoiceAllocator->visitMidiKey( key, []( Note* pNote ) {
+		pNote->get_adsr()->release();
+	} );
 }
 
 
@@ -222,13 +371,16 @@ void Sampler::noteOff(Note* pNote )
 {
 	auto pInstr = pNote->get_instrument();
 	// find the notes using the same instrument, and release them
-	for ( const auto& pNote: m_playingNotesQueue ) {
-		if ( pNote->get_instrument() == pInstr ) {
-			pNote->get_adsr()->release();
-		}
-	}
+	m_pVoiceAllocator->visitInstrument( pInstr.get(), []( Note* pPlayingNote ) {
+		pPlayingNote->get_adsr()->release();
+	} );
 	
-	delete pNote;
+	m_pNotePool->release( pNote );
+}
+
+int Sampler::getPlayingNotesNumber() const
+{
+	return m_pVoiceAllocator->size();
 }
 
 
@@ -408,11 +560,17 @@ inline float Sampler::panLaw( float fPan, std::shared_ptr<Song> pSong ) {
 /// Render a note
 /// Return false: the note is not ended
 /// Return true: the note is ended
-bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Song> pSong )
+void Sampler::prepareNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Song> pSong )
 {
 	//infoLog( "[renderNote] instr: " + pNote->getInstrument()->m_sName );
 	assert( pSong );
 
+	NoteVoices noteVoices;
+	noteVoices.nFirstVoice = m_voices.size();
+	noteVoices.nVoices = 0;
+	noteVoices.nFirstReturnValue = m_returnValues.size();
+	noteVoices.nReturnValues = 0;
+
 	unsigned int nFramepos;
 	Hydrogen* pHydrogen = Hydrogen::get_instance();
 	auto pAudioDriver = pHydrogen->getAudioOutput();
@@ -427,7 +585,9 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 	auto pInstr = pNote->get_instrument();
 	if ( !pInstr ) {
 		ERRORLOG( "NULL instrument" );
-		return 1;
+		// Without return values the note is considered done.
+		m_noteVoices.push_back( noteVoices );
+		return;
 	}
 
 	// new instrument and note pan interaction--------------------------
@@ -457,16 +617,22 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 	float fPan_R = panLaw( -fPan, pSong );
 	//---------------------------------------------------------
 
-	bool nReturnValues [pInstr->get_components()->size()];
-	
-	for(int i = 0; i < pInstr->get_components()->size(); i++){
-		nReturnValues[i] = false;
-	}
+	// The components the note started with. They differ from those
+	// of the instrument once a new drumkit was swapped in.
+	const auto pComponents = pNote->get_components();
+	// Components exceeding the preallocated voices are dropped.
+	noteVoices.nReturnValues = std::min( static_cast<int>( pComponents->size() ),
+										 m_nMaxVoices - static_cast<int>( m_returnValues.size() ) );
+	m_returnValues.insert( m_returnValues.end(), noteVoices.nReturnValues, false );
+	char* nReturnValues = m_returnValues.data() + noteVoices.nFirstReturnValue;
 	
 	int nReturnValueIndex = 0;
 	int nAlreadySelectedLayer = -1;
 
-	for (const auto& pCompo : *pInstr->get_components()) {
+	for (const auto& pCompo : *pComponents) {
+		if ( nReturnValueIndex >= noteVoices.nReturnValues ) {
+			break;
+		}
 		nReturnValues[nReturnValueIndex] = false;
 		DrumkitComponent* pMainCompo = nullptr;
 
@@ -486,6 +652,11 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 				pMainCompo = pHydrogen->getSong()->getComponents()->front();
 			}
 		}
+		if ( pMainCompo == nullptr ) {
+			// Component of a drumkit replaced while the note was
+			// still ringing.
+			pMainCompo = pHydrogen->getSong()->getComponents()->front();
+		}
 
 		assert(pMainCompo);
 
@@ -516,43 +687,25 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 		}
 		else {
 			switch ( pInstr->sample_selection_alg() ) {
-				case Instrument::VELOCITY:
-					for ( unsigned nLayer = 0; nLayer < m_nMaxLayers; ++nLayer ) {
+				case Instrument::VELOCITY: {
+					const int nLayer = pCompo->find_layer( pNote->get_velocity() );
+					if ( nLayer != -1 ) {
 						auto pLayer = pCompo->get_layer( nLayer );
-						if ( pLayer == nullptr ) continue;
+						pSelectedLayer->SelectedLayer = nLayer;
 
-						if ( ( pNote->get_velocity() >= pLayer->get_start_velocity() ) && ( pNote->get_velocity() <= pLayer->get_end_velocity() ) ) {
-							pSelectedLayer->SelectedLayer = nLayer;
-
-							pSample = pLayer->get_sample();
-							fLayerGain = pLayer->get_gain();
-							fLayerPitch = pLayer->get_pitch();
-							break;
-						}
+						pSample = pLayer->get_sample();
+						fLayerGain = pLayer->get_gain();
+						fLayerPitch = pLayer->get_pitch();
 					}
 
 					if ( !pSample ){
-						WARNINGLOG( "Velocity did fall into a hole between the instrument layers." );
 						// There are a small distance between the
 						// layers of the instruments the velocity of
 						// the pNote has fallen into. This can if the
 						// drumkits weren't written with enough care.
-						// To fix this rare problem, we have to search
-						// for the nearest layer and use its sample.
-						float shortestDistance = 1.0f;
-						int nearestLayer = -1;
-						for ( unsigned nLayer = 0; nLayer < m_nMaxLayers; ++nLayer ){
-							auto pLayer = pCompo->get_layer( nLayer );
-							if ( pLayer == nullptr ) continue;
-							
-							if ( std::min( abs( pLayer->get_start_velocity() - pNote->get_velocity() ),
-								  abs( pLayer->get_start_velocity() - pNote->get_velocity() ) ) <
-							     shortestDistance ){
-								shortestDistance = std::min( abs( pLayer->get_start_velocity() - pNote->get_velocity() ),
-											abs( pLayer->get_start_velocity() - pNote->get_velocity() ) );
-								nearestLayer = nLayer;
-							}
-						}
+						// To fix this rare problem, we use the sample
+						// of the nearest layer.
+						const int nearestLayer = pCompo->find_nearest_layer( pNote->get_velocity() );
 
 						// Check whether the search was successful and assign the results.
 						if ( nearestLayer > -1 ){
@@ -565,6 +718,7 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 						}
 					}
 					break;
+				}
 
 				case Instrument::RANDOM:
 					if( nAlreadySelectedLayer != -1 ) {
@@ -579,18 +733,7 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 					}
 					if( pSample == nullptr ) {
 						int __possibleIndex[ m_nMaxLayers ];
-						int __foundSamples = 0;
-						for ( unsigned nLayer = 0; nLayer < m_nMaxLayers; ++nLayer ) {
-							auto pLayer = pCompo->get_layer( nLayer );
-							if ( pLayer == nullptr ) continue;
-
-							if ( ( pNote->get_velocity() >= pLayer->get_start_velocity() ) && ( pNote->get_velocity() <= pLayer->get_end_velocity() ) ) {
-								__possibleIndex[__foundSamples] = nLayer;
-								__foundSamples++;
-							}
-						}
-
-						
+						int __foundSamples = pCompo->find_layers( pNote->get_velocity(), __possibleIndex );
 
 						// In some instruments the start and end
 						// velocities of a layer are not set
@@ -601,21 +744,7 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 						// for the nearest sample and play this
 						// one instead.
 						if ( __foundSamples == 0 ){
-							WARNINGLOG( "Velocity did fall into a hole between the instrument layers." );
-							float shortestDistance = 1.0f;
-							int nearestLayer = -1;
-							for ( unsigned nLayer = 0; nLayer < m_nMaxLayers; ++nLayer ){
-								auto pLayer = pCompo->get_layer( nLayer );
-								if ( pLayer == nullptr ) continue;
-								
-								if ( std::min( abs( pLayer->get_start_velocity() - pNote->get_velocity() ),
-									  abs( pLayer->get_start_velocity() - pNote->get_velocity() ) ) <
-								     shortestDistance ){
-									shortestDistance = std::min( abs( pLayer->get_start_velocity() - pNote->get_velocity() ),
-												abs( pLayer->get_start_velocity() - pNote->get_velocity() ) );
-									nearestLayer = nLayer;
-								}
-							}
+							const int nearestLayer = pCompo->find_nearest_layer( pNote->get_velocity() );
 							// Check whether the search was
 							// successful and assign the
 							// results.
@@ -633,7 +762,7 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 						}
 
 						if( __foundSamples > 0 ) {
-							nAlreadySelectedLayer = __possibleIndex[rand() % __foundSamples];
+							nAlreadySelectedLayer = __possibleIndex[ m_random.below( __foundSamples ) ];
 							pSelectedLayer->SelectedLayer = nAlreadySelectedLayer;
 
 							auto pLayer = pCompo->get_layer( nAlreadySelectedLayer );
@@ -658,17 +787,11 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 					}
 					if( !pSample ) {
 						int __possibleIndex[ m_nMaxLayers ];
-						int __foundSamples = 0;
+						int __foundSamples = pCompo->find_layers( pNote->get_velocity(), __possibleIndex );
 						float __roundRobinID;
-						for ( unsigned nLayer = 0; nLayer < m_nMaxLayers; ++nLayer ) {
-							auto pLayer = pCompo->get_layer( nLayer );
-							if ( pLayer == nullptr ) continue;
-
-							if ( ( pNote->get_velocity() >= pLayer->get_start_velocity() ) && ( pNote->get_velocity() <= pLayer->get_end_velocity() ) ) {
-								__possibleIndex[__foundSamples] = nLayer;
-								__roundRobinID = pLayer->get_start_velocity();
-								__foundSamples++;
-							}
+						if ( __foundSamples > 0 ) {
+							__roundRobinID = pCompo->get_layer( __possibleIndex[ __foundSamples - 1 ] )
+								->get_start_velocity();
 						}
 
 						// In some instruments the start and end
@@ -680,24 +803,7 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 						// for the nearest sample and play this
 						// one instead.
 						if ( __foundSamples == 0 ){
-							WARNINGLOG( "Velocity did fall into a hole between the instrument layers." );
-							float shortestDistance = 1.0f;
-							int nearestLayer = -1;
-							for ( unsigned nLayer = 0; nLayer < m_nMaxLayers; ++nLayer ){
-								auto pLayer = pCompo->get_layer( nLayer );
-								if ( pLayer == nullptr ) {
-									continue;
-								}
-								
-								
-								if ( std::min( abs( pLayer->get_start_velocity() - pNote->get_velocity() ),
-									  abs( pLayer->get_start_velocity() - pNote->get_velocity() ) ) <
-								     shortestDistance ){
-									shortestDistance = std::min( abs( pLayer->get_start_velocity() - pNote->get_velocity() ),
-												abs( pLayer->get_start_velocity() - pNote->get_velocity() ) );
-									nearestLayer = nLayer;
-								}
-							}
+							const int nearestLayer = pCompo->find_nearest_layer( pNote->get_velocity() );
 							// Check whether the search was
 							// successful and assign the
 							// results.
@@ -737,6 +843,27 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 					break;
 			}
 		}
+		// Layers loaded lazily are decoded in the background once
+		// selected for the first time. Till then the nearest loaded
+		// layer is played in their place.
+		if ( pSelectedLayer->SelectedLayer != -1 ) {
+			auto pLayer = pCompo->get_layer( pSelectedLayer->SelectedLayer );
+			if ( pLayer != nullptr && pLayer->is_deferred() ) {
+				if ( m_pLayerLoader != nullptr ) {
+					m_pLayerLoader->request( pLayer );
+				}
+				pSample = nullptr;
+				const int nFallback = findNearestLoadedLayer( pCompo, pNote->get_velocity() );
+				if ( nFallback != -1 ) {
+					auto pFallback = pCompo->get_layer( nFallback );
+					pSelectedLayer->SelectedLayer = nFallback;
+					pSample = pFallback->get_sample();
+					fLayerGain = pFallback->get_gain();
+					fLayerPitch = pFallback->get_pitch();
+				}
+			}
+		}
+
 		if ( !pSample ) {
 			QString dummy = QString( "NULL sample for instrument %1. Note velocity: %2" ).arg( pInstr->get_name() ).arg( pNote->get_velocity() );
 			WARNINGLOG( dummy );
@@ -855,21 +982,144 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 			}
 		}
 
-		if ( fTotalPitch == 0.0 && pSample->get_sample_rate() == pAudioDriver->getSampleRate() ) { // NO RESAMPLE
-			nReturnValues[nReturnValueIndex] = renderNoteNoResample( pSample, pNote, pSelectedLayer, pCompo, pMainCompo, nBufferSize, nInitialSilence, cost_L, cost_R, cost_track_L, cost_track_R, pSong );
+		// Frames of streamed samples beyond their head are read from
+		// disk. Opening a stream is retried each period in case all
+		// of them are in use.
+		DiskStream* pStream = pSelectedLayer->pStream;
+		if ( pStream != nullptr && pStream->getSample() != pSample.get() ) {
+			// The layer was exchanged while the note was playing.
+			pStream->close();
+			pStream = nullptr;
 		}
-		else { // RESAMPLE
-			nReturnValues[nReturnValueIndex] = renderNoteResample( pSample, pNote, pSelectedLayer, pCompo, pMainCompo, nBufferSize, nInitialSilence, cost_L, cost_R, cost_track_L, cost_track_R, fLayerPitch, pSong );
+		const bool bStreamed = pSample->is_streamed();
+		if ( bStreamed && pStream == nullptr && m_pDiskStreamer != nullptr ) {
+			const int nStartFrame = std::max( pSample->get_resident_frames(),
+											  static_cast<int>( pSelectedLayer->SamplePosition ) - 1 );
+			pStream = m_pDiskStreamer->open( pSample, nStartFrame );
 		}
+		pSelectedLayer->pStream = pStream;
+
+		// The return value is set once the voice is rendered.
+		Voice voice;
+		voice.pNote = pNote;
+		voice.pSample = pSample;
+		voice.pSelectedLayerInfo = pSelectedLayer;
+		voice.pCompo = pCompo;
+		voice.pDrumCompo = pMainCompo;
+		voice.nInitialSilence = nInitialSilence;
+		voice.cost_L = cost_L;
+		voice.cost_R = cost_R;
+		voice.cost_track_L = cost_track_L;
+		voice.cost_track_R = cost_track_R;
+		voice.fLayerPitch = fLayerPitch;
+		// NO RESAMPLE in case the pitch is not altered and the sample
+		// rates match.
+		voice.bResample = ! ( fTotalPitch == 0.0 &&
+							  pSample->get_sample_rate() == pAudioDriver->getSampleRate() );
+		voice.nReturnValueIndex = noteVoices.nFirstReturnValue + nReturnValueIndex;
+		voice.nBufferOffset = 0;
+		voice.bStreamed = bStreamed;
+		voice.pStream = pStream;
+		voice.bStarved = false;
+		voice.bEnded = true;
+		voice.nInitialBufferPos = 0;
+		voice.nTimes = 0;
+		voice.nAvailFrames = 0;
+		voice.nInitialSamplePos = 0;
+		m_voices.push_back( voice );
+		noteVoices.nVoices++;
 
 		nReturnValueIndex++;
 	}
-	for ( unsigned i = 0 ; i < pInstr->get_components()->size() ; i++ ) {
-		if ( !nReturnValues[i] ) {
-			return false;
+
+	m_noteVoices.push_back( noteVoices );
+}
+
+template <typename Function>
+void Sampler::visitVoiceData( Voice& voice, Function&& function )
+{
+	if ( ! voice.bStreamed ) {
+		voice.pSample->visit_data( function );
+		return;
+	}
+
+	const int nHeadFrames = voice.pSample->get_resident_frames();
+	voice.pSample->visit_data( [&]( auto head_L, auto head_R ) {
+		if ( voice.pStream != nullptr ) {
+			function( voice.pStream->getReader( head_L, 0, nHeadFrames, &voice.bStarved ),
+					  voice.pStream->getReader( head_R, 1, nHeadFrames, &voice.bStarved ) );
+		} else {
+			// Without a stream everything beyond the head is silent.
+			using Reader = DiskStream::Reader<decltype( head_L )>;
+			function( Reader{ head_L, nHeadFrames, nullptr, 0, nHeadFrames, 0, &voice.bStarved },
+					  Reader{ head_R, nHeadFrames, nullptr, 0, nHeadFrames, 0, &voice.bStarved } );
+		}
+	} );
+}
+
+int Sampler::findNearestLoadedLayer( const std::shared_ptr<InstrumentComponent>& pComponent,
+									 float fVelocity ) const
+{
+	float fShortestDistance = 2.0f;
+	int nNearestLayer = -1;
+	for ( unsigned nLayer = 0; nLayer < m_nMaxLayers; ++nLayer ) {
+		auto pLayer = pComponent->get_layer( nLayer );
+		if ( pLayer == nullptr || pLayer->is_deferred() || pLayer->get_sample() == nullptr ) {
+			continue;
+		}
+
+		float fDistance = 0.0f;
+		if ( fVelocity < pLayer->get_start_velocity() ) {
+			fDistance = pLayer->get_start_velocity() - fVelocity;
+		} else if ( fVelocity > pLayer->get_end_velocity() ) {
+			fDistance = fVelocity - pLayer->get_end_velocity();
+		}
+		if ( fDistance < fShortestDistance ) {
+			fShortestDistance = fDistance;
+			nNearestLayer = nLayer;
 		}
 	}
-	return true;
+	return nNearestLayer;
+}
+
+void Sampler::renderNoteVoices( void* pContext, int nNote )
+{
+	auto pSampler = static_cast<Sampler*>( pContext );
+	const auto& noteVoices = pSampler->m_noteVoices[ nNote ];
+	// Voices of a single note share its envelope and filter and are
+	// rendered in order.
+	for ( int nVoice = noteVoices.nFirstVoice;
+		  nVoice < noteVoices.nFirstVoice + noteVoices.nVoices; ++nVoice ) {
+		pSampler->renderVoice( pSampler->m_voices[ nVoice ] );
+	}
+}
+
+void Sampler::renderVoice( Voice& voice )
+{
+	if ( voice.bResample ) {
+		voice.bEnded = renderNoteResample( voice, m_nVoiceBufferSize, m_pSong );
+	} else {
+		voice.bEnded = renderNoteNoResample( voice, m_nVoiceBufferSize );
+	}
+}
+
+void Sampler::completeVoice( Voice& voice, std::shared_ptr<Song> pSong )
+{
+	mixVoice( voice, pSong );
+	m_returnValues[ voice.nReturnValueIndex ] = voice.bEnded;
+
+	if ( voice.pStream != nullptr ) {
+		const int nPosition = static_cast<int>( voice.pSelectedLayerInfo->SamplePosition );
+		if ( ! voice.pStream->isComplete() ) {
+			m_pDiskStreamer->reportHeadroom( voice.pStream->getWriteFrame() - nPosition );
+		}
+		// The interpolation reads a single frame in front of
+		// the position.
+		voice.pStream->setReadFrame( nPosition - 1 );
+	}
+	if ( voice.bStarved && m_pDiskStreamer != nullptr ) {
+		m_pDiskStreamer->reportStarvation();
+	}
 }
 
 bool Sampler::processPlaybackTrack(int nBufferSize)
@@ -895,138 +1145,138 @@ bool Sampler::processPlaybackTrack(int nBufferSize)
 	float fVal_L;
 	float fVal_R;
 
-	auto pSample_data_L = pSample->get_data_l();
-	auto pSample_data_R = pSample->get_data_r();
-	
 	float fInstrPeak_L = m_pPlaybackTrackInstrument->get_peak_l(); // this value will be reset to 0 by the mixer..
 	float fInstrPeak_R = m_pPlaybackTrackInstrument->get_peak_r(); // this value will be reset to 0 by the mixer..
 
 	int nAvail_bytes = 0;
 	int	nInitialBufferPos = 0;
 
-	if(pSample->get_sample_rate() == pAudioDriver->getSampleRate()){
-		//No resampling	
-		m_nPlayBackSamplePosition = pAudioEngine->getFrames();
+	// The sample is read in the format it is stored in.
+	pSample->visit_data( [&]( auto pSample_data_L, auto pSample_data_R ) {
+		if(pSample->get_sample_rate() == pAudioDriver->getSampleRate()){
+			//No resampling	
+			m_nPlayBackSamplePosition = pAudioEngine->getFrames();
 	
-		nAvail_bytes = pSample->get_frames() - ( int )m_nPlayBackSamplePosition;
+			nAvail_bytes = pSample->get_frames() - ( int )m_nPlayBackSamplePosition;
 		
-		if ( nAvail_bytes > nBufferSize ) {
-			nAvail_bytes = nBufferSize;
-		}
+			if ( nAvail_bytes > nBufferSize ) {
+				nAvail_bytes = nBufferSize;
+			}
 
-		int nInitialSamplePos = ( int ) m_nPlayBackSamplePosition;
-		int nSamplePos = nInitialSamplePos;
+			int nInitialSamplePos = ( int ) m_nPlayBackSamplePosition;
+			int nSamplePos = nInitialSamplePos;
 	
-		int nTimes = nInitialBufferPos + nAvail_bytes;
+			int nTimes = nInitialBufferPos + nAvail_bytes;
 	
-		if(m_nPlayBackSamplePosition > pSample->get_frames()){
-			//playback track has ended..
-			return true;
-		}
+			if(m_nPlayBackSamplePosition > pSample->get_frames()){
+				//playback track has ended..
+				return;
+			}
 	
-		for ( int nBufferPos = nInitialBufferPos; nBufferPos < nTimes; ++nBufferPos ) {
-			fVal_L = pSample_data_L[ nSamplePos ];
-			fVal_R = pSample_data_R[ nSamplePos ];
+			for ( int nBufferPos = nInitialBufferPos; nBufferPos < nTimes; ++nBufferPos ) {
+				fVal_L = pSample_data_L[ nSamplePos ];
+				fVal_R = pSample_data_R[ nSamplePos ];
 	
-			fVal_L = fVal_L * 1.0f * pSong->getPlaybackTrackVolume(); //costr
-			fVal_R = fVal_R * 1.0f * pSong->getPlaybackTrackVolume(); //cost l
+				fVal_L = fVal_L * 1.0f * pSong->getPlaybackTrackVolume(); //costr
+				fVal_R = fVal_R * 1.0f * pSong->getPlaybackTrackVolume(); //cost l
 	
-			//pDrumCompo->set_outs( nBufferPos, fVal_L, fVal_R );
+				//pDrumCompo->set_outs( nBufferPos, fVal_L, fVal_R );
 	
-			// to main mix
-			if ( fVal_L > fInstrPeak_L ) {
-				fInstrPeak_L = fVal_L;
-			}
-			if ( fVal_R > fInstrPeak_R ) {
-				fInstrPeak_R = fVal_R;
-			}
+				// to main mix
+				if ( fVal_L > fInstrPeak_L ) {
+					fInstrPeak_L = fVal_L;
+				}
+				if ( fVal_R > fInstrPeak_R ) {
+					fInstrPeak_R = fVal_R;
+				}
 			
-			m_pMainOut_L[nBufferPos] += fVal_L;
-			m_pMainOut_R[nBufferPos] += fVal_R;
+				m_pMainOut_L[nBufferPos] += fVal_L;
+				m_pMainOut_R[nBufferPos] += fVal_R;
 			
-			++nSamplePos;
-		}
-	} else {
-		//Perform resampling
-		double	fSamplePos = 0;
-		int		nSampleFrames = pSample->get_frames();
-		float	fStep = 1;
-		fStep *= ( float )pSample->get_sample_rate() / pAudioDriver->getSampleRate(); // Adjust for audio driver sample rate
+				++nSamplePos;
+			}
+		} else {
+			//Perform resampling
+			double	fSamplePos = 0;
+			int		nSampleFrames = pSample->get_frames();
+			float	fStep = 1;
+			fStep *= ( float )pSample->get_sample_rate() / pAudioDriver->getSampleRate(); // Adjust for audio driver sample rate
 		
 		
-		if( pAudioEngine->getFrames() == 0){
-			fSamplePos = 0;
-		} else {
-			fSamplePos = ( ( pAudioEngine->getFrames() /nBufferSize) * (nBufferSize * fStep));
-		}
+			if( pAudioEngine->getFrames() == 0){
+				fSamplePos = 0;
+			} else {
+				fSamplePos = ( ( pAudioEngine->getFrames() /nBufferSize) * (nBufferSize * fStep));
+			}
 		
-		nAvail_bytes = ( int )( ( float )( pSample->get_frames() - fSamplePos ) / fStep );
+			nAvail_bytes = ( int )( ( float )( pSample->get_frames() - fSamplePos ) / fStep );
 	
-		if ( nAvail_bytes > nBufferSize ) {
-			nAvail_bytes = nBufferSize;
-		}
+			if ( nAvail_bytes > nBufferSize ) {
+				nAvail_bytes = nBufferSize;
+			}
 
-		int nTimes = nInitialBufferPos + nAvail_bytes;
+			int nTimes = nInitialBufferPos + nAvail_bytes;
 	
-		for ( int nBufferPos = nInitialBufferPos; nBufferPos < nTimes; ++nBufferPos ) {
-			int nSamplePos = ( int ) fSamplePos;
-			double fDiff = fSamplePos - nSamplePos;
-			if ( ( nSamplePos + 1 ) >= nSampleFrames ) {
-				//we reach the last audioframe.
-				//set this last frame to zero do nothing wrong.
-							fVal_L = 0.0;
-							fVal_R = 0.0;
-			} else {
-				// some interpolation methods need 4 frames data.
-					float last_l;
-					float last_r;
-					if ( ( nSamplePos + 2 ) >= nSampleFrames ) {
-						last_l = 0.0;
-						last_r = 0.0;
-					} else {
-						last_l =  pSample_data_L[nSamplePos + 2];
-						last_r =  pSample_data_R[nSamplePos + 2];
-					}
+			for ( int nBufferPos = nInitialBufferPos; nBufferPos < nTimes; ++nBufferPos ) {
+				int nSamplePos = ( int ) fSamplePos;
+				double fDiff = fSamplePos - nSamplePos;
+				if ( ( nSamplePos + 1 ) >= nSampleFrames ) {
+					//we reach the last audioframe.
+					//set this last frame to zero do nothing wrong.
+								fVal_L = 0.0;
+								fVal_R = 0.0;
+				} else {
+					// some interpolation methods need 4 frames data.
+						float last_l;
+						float last_r;
+						if ( ( nSamplePos + 2 ) >= nSampleFrames ) {
+							last_l = 0.0;
+							last_r = 0.0;
+						} else {
+							last_l =  pSample_data_L[nSamplePos + 2];
+							last_r =  pSample_data_R[nSamplePos + 2];
+						}
 	
-					switch( m_interpolateMode ){
+						switch( m_interpolateMode ){
 	
-						case Interpolation::InterpolateMode::Linear:
-								fVal_L = pSample_data_L[nSamplePos] * (1 - fDiff ) + pSample_data_L[nSamplePos + 1] * fDiff;
-								fVal_R = pSample_data_R[nSamplePos] * (1 - fDiff ) + pSample_data_R[nSamplePos + 1] * fDiff;
-								break;
-						case Interpolation::InterpolateMode::Cosine:
-								fVal_L = Interpolation::cosine_Interpolate( pSample_data_L[nSamplePos], pSample_data_L[nSamplePos + 1], fDiff);
-								fVal_R = Interpolation::cosine_Interpolate( pSample_data_R[nSamplePos], pSample_data_R[nSamplePos + 1], fDiff);
-								break;
-						case Interpolation::InterpolateMode::Third:
-								fVal_L = Interpolation::third_Interpolate( pSample_data_L[ nSamplePos -1], pSample_data_L[nSamplePos], pSample_data_L[nSamplePos + 1], last_l, fDiff);
-								fVal_R = Interpolation::third_Interpolate( pSample_data_R[ nSamplePos -1], pSample_data_R[nSamplePos], pSample_data_R[nSamplePos + 1], last_r, fDiff);
-								break;
-						case Interpolation::InterpolateMode::Cubic:
-								fVal_L = Interpolation::cubic_Interpolate( pSample_data_L[ nSamplePos -1], pSample_data_L[nSamplePos], pSample_data_L[nSamplePos + 1], last_l, fDiff);
-								fVal_R = Interpolation::cubic_Interpolate( pSample_data_R[ nSamplePos -1], pSample_data_R[nSamplePos], pSample_data_R[nSamplePos + 1], last_r, fDiff);
-								break;
-						case Interpolation::InterpolateMode::Hermite:
-								fVal_L = Interpolation::hermite_Interpolate( pSample_data_L[ nSamplePos -1], pSample_data_L[nSamplePos], pSample_data_L[nSamplePos + 1], last_l, fDiff);
-								fVal_R = Interpolation::hermite_Interpolate( pSample_data_R[ nSamplePos -1], pSample_data_R[nSamplePos], pSample_data_R[nSamplePos + 1], last_r, fDiff);
-								break;
-					}
-			}
+							case Interpolation::InterpolateMode::Linear:
+									fVal_L = pSample_data_L[nSamplePos] * (1 - fDiff ) + pSample_data_L[nSamplePos + 1] * fDiff;
+									fVal_R = pSample_data_R[nSamplePos] * (1 - fDiff ) + pSample_data_R[nSamplePos + 1] * fDiff;
+									break;
+							case Interpolation::InterpolateMode::Cosine:
+									fVal_L = Interpolation::cosine_Interpolate( pSample_data_L[nSamplePos], pSample_data_L[nSamplePos + 1], fDiff);
+									fVal_R = Interpolation::cosine_Interpolate( pSample_data_R[nSamplePos], pSample_data_R[nSamplePos + 1], fDiff);
+									break;
+							case Interpolation::InterpolateMode::Third:
+									fVal_L = Interpolation::third_Interpolate( pSample_data_L[ nSamplePos -1], pSample_data_L[nSamplePos], pSample_data_L[nSamplePos + 1], last_l, fDiff);
+									fVal_R = Interpolation::third_Interpolate( pSample_data_R[ nSamplePos -1], pSample_data_R[nSamplePos], pSample_data_R[nSamplePos + 1], last_r, fDiff);
+									break;
+							case Interpolation::InterpolateMode::Cubic:
+									fVal_L = Interpolation::cubic_Interpolate( pSample_data_L[ nSamplePos -1], pSample_data_L[nSamplePos], pSample_data_L[nSamplePos + 1], last_l, fDiff);
+									fVal_R = Interpolation::cubic_Interpolate( pSample_data_R[ nSamplePos -1], pSample_data_R[nSamplePos], pSample_data_R[nSamplePos + 1], last_r, fDiff);
+									break;
+							case Interpolation::InterpolateMode::Hermite:
+									fVal_L = Interpolation::hermite_Interpolate( pSample_data_L[ nSamplePos -1], pSample_data_L[nSamplePos], pSample_data_L[nSamplePos + 1], last_l, fDiff);
+									fVal_R = Interpolation::hermite_Interpolate( pSample_data_R[ nSamplePos -1], pSample_data_R[nSamplePos], pSample_data_R[nSamplePos + 1], last_r, fDiff);
+									break;
+						}
+				}
 			
-			if ( fVal_L > fInstrPeak_L ) {
-				fInstrPeak_L = fVal_L;
-			}
-			if ( fVal_R > fInstrPeak_R ) {
-				fInstrPeak_R = fVal_R;
-			}
+				if ( fVal_L > fInstrPeak_L ) {
+					fInstrPeak_L = fVal_L;
+				}
+				if ( fVal_R > fInstrPeak_R ) {
+					fInstrPeak_R = fVal_R;
+				}
 
-			m_pMainOut_L[nBufferPos] += fVal_L;
-			m_pMainOut_R[nBufferPos] += fVal_R;
+				m_pMainOut_L[nBufferPos] += fVal_L;
+				m_pMainOut_R[nBufferPos] += fVal_R;
 
 
-			fSamplePos += fStep;
-		} //for
-	}
+				fSamplePos += fStep;
+			} //for
+		}
+	} );
 	
 	m_pPlaybackTrackInstrument->set_peak_l( fInstrPeak_L );
 	m_pPlaybackTrackInstrument->set_peak_r( fInstrPeak_R );
@@ -1034,23 +1284,12 @@ bool Sampler::processPlaybackTrack(int nBufferSize)
 	return true;
 }
 
-bool Sampler::renderNoteNoResample(
-	std::shared_ptr<Sample> pSample,
-	Note *pNote,
-	SelectedLayerInfo *pSelectedLayerInfo,
-	std::shared_ptr<InstrumentComponent> pCompo,
-	DrumkitComponent *pDrumCompo,
-	int nBufferSize,
-	int nInitialSilence,
-	float cost_L,
-	float cost_R,
-	float cost_track_L,
-	float cost_track_R,
-	std::shared_ptr<Song> pSong
-)
+bool Sampler::renderNoteNoResample( Voice& voice, int nBufferSize )
 {
-	auto pAudioDriver = Hydrogen::get_instance()->getAudioOutput();
 	auto pAudioEngine = Hydrogen::get_instance()->getAudioEngine();
+	const auto& pSample = voice.pSample;
+	Note* pNote = voice.pNote;
+	SelectedLayerInfo* pSelectedLayerInfo = voice.pSelectedLayerInfo;
 	bool retValue = true; // the note is ended
 
 	int nNoteLength = -1;
@@ -1060,13 +1299,13 @@ bool Sampler::renderNoteNoResample(
 
 	int nAvail_bytes = pSample->get_frames() - ( int )pSelectedLayerInfo->SamplePosition;	// verifico il numero di frame disponibili ancora da eseguire
 
-	if ( nAvail_bytes > nBufferSize - nInitialSilence ) {	// il sample e' piu' grande del buffersize
+	if ( nAvail_bytes > nBufferSize - voice.nInitialSilence ) {	// il sample e' piu' grande del buffersize
 		// imposto il numero dei bytes disponibili uguale al buffersize
-		nAvail_bytes = nBufferSize - nInitialSilence;
+		nAvail_bytes = nBufferSize - voice.nInitialSilence;
 		retValue = false; // the note is not ended yet
 	}
 
-	int nInitialBufferPos = nInitialSilence;
+	int nInitialBufferPos = voice.nInitialSilence;
 	int nInitialSamplePos = ( int )pSelectedLayerInfo->SamplePosition;
 	int nSamplePos = nInitialSamplePos;
 	int nTimes = nInitialBufferPos + nAvail_bytes;
@@ -1074,79 +1313,52 @@ bool Sampler::renderNoteNoResample(
 
 	if ( pNote->get_instrument()->is_filter_active() && pNote->filter_sustain() ) {
 		// If filter is causing note to ring, process more samples.
-		nTimes = nInitialBufferPos + nBufferSize - nInitialSilence;
+		nTimes = nInitialBufferPos + nBufferSize - voice.nInitialSilence;
 	}
 
-	auto pSample_data_L = pSample->get_data_l();
-	auto pSample_data_R = pSample->get_data_r();
-
-	float fInstrPeak_L = pNote->get_instrument()->get_peak_l(); // this value will be reset to 0 by the mixer..
-	float fInstrPeak_R = pNote->get_instrument()->get_peak_r(); // this value will be reset to 0 by the mixer..
-
-	float fADSRValue;
-	float fVal_L;
-	float fVal_R;
-
-#ifdef H2CORE_HAVE_JACK
-	float *		pTrackOutL = nullptr;
-	float *		pTrackOutR = nullptr;
+	float* pBuffer_L = &m_voiceBuffers[ voice.nBufferOffset ];
+	float* pBuffer_R = pBuffer_L + nBufferSize;
 
-	if ( Preferences::get_instance()->m_bJackTrackOuts ) {
-		auto pJackAudioDriver = dynamic_cast<JackAudioDriver*>( pAudioDriver );
-		if( pJackAudioDriver ) {
-			pTrackOutL = pJackAudioDriver->getTrackOut_L( pNote->get_instrument(), pCompo );
-			pTrackOutR = pJackAudioDriver->getTrackOut_R( pNote->get_instrument(), pCompo );
-		}
+	// The sample position is only advanced at the end of the period.
+	// Notes exceeding their length are therefore released right away.
+	const bool bNoteLengthExceeded = ( nNoteLength != -1 ) &&
+		( nNoteLength <= pSelectedLayerInfo->SamplePosition );
+	if ( bNoteLengthExceeded ) {
+		pNote->get_adsr()->release();
 	}
-#endif
-
-	for ( int nBufferPos = nInitialBufferPos; nBufferPos < nTimes; ++nBufferPos ) {
-		if ( ( nNoteLength != -1 ) && ( nNoteLength <= pSelectedLayerInfo->SamplePosition ) ) {
-						if ( pNote->get_adsr()->release() == 0 ) {
-				retValue = true;	// the note is ended
-			}
-		}
-
-		if ( nBufferPos < nTimesSample ) {
-			fADSRValue = pNote->get_adsr()->get_value( 1 );
-			fVal_L = pSample_data_L[ nSamplePos ] * fADSRValue;
-			fVal_R = pSample_data_R[ nSamplePos ] * fADSRValue;
-		} else {
-			fVal_L = fVal_R = 0.0;
-		}
-
-		// Low pass resonant filter
-		if ( pNote->get_instrument()->is_filter_active() ) {
-			pNote->compute_lr_values( &fVal_L, &fVal_R );
-		}
-
-#ifdef H2CORE_HAVE_JACK
-		if(  pTrackOutL ) {
-			 pTrackOutL[nBufferPos] += fVal_L * cost_track_L;
-		}
-		if( pTrackOutR ) {
-			pTrackOutR[nBufferPos] += fVal_R * cost_track_R;
-		}
-#endif
 
-		fVal_L = fVal_L * cost_L;
-		fVal_R = fVal_R * cost_R;
+	// Envelope of all frames covered by the sample
+	float fADSRValues[ MAX_BUFFER_SIZE ];
+	if ( nTimesSample > nInitialBufferPos ) {
+		pNote->get_adsr()->get_values( 1, &fADSRValues[ nInitialBufferPos ],
+									   nTimesSample - nInitialBufferPos );
+	}
 
-		// update instr peak
-		if ( fVal_L > fInstrPeak_L ) {
-			fInstrPeak_L = fVal_L;
-		}
-		if ( fVal_R > fInstrPeak_R ) {
-			fInstrPeak_R = fVal_R;
+	// The sample is read in the format it is stored in.
+	visitVoiceData( voice, [&]( auto pSample_data_L, auto pSample_data_R ) {
+		for ( int nBufferPos = nInitialBufferPos; nBufferPos < nTimesSample; ++nBufferPos ) {
+			pBuffer_L[ nBufferPos ] = pSample_data_L[ nSamplePos ] * fADSRValues[ nBufferPos ];
+			pBuffer_R[ nBufferPos ] = pSample_data_R[ nSamplePos ] * fADSRValues[ nBufferPos ];
+			++nSamplePos;
 		}
+	} );
+	// Silence the filter keeps ringing on.
+	for ( int nBufferPos = std::max( nInitialBufferPos, nTimesSample ); nBufferPos < nTimes;
+		  ++nBufferPos ) {
+		pBuffer_L[ nBufferPos ] = 0.0;
+		pBuffer_R[ nBufferPos ] = 0.0;
+	}
 
-		pDrumCompo->set_outs( nBufferPos, fVal_L, fVal_R );
-
-		// to main mix
-		m_pMainOut_L[nBufferPos] += fVal_L;
-		m_pMainOut_R[nBufferPos] += fVal_R;
+	// Low pass resonant filter
+	if ( pNote->get_instrument()->is_filter_active() ) {
+		pNote->apply_filter( &pBuffer_L[ nInitialBufferPos ], &pBuffer_R[ nInitialBufferPos ],
+							 nTimes - nInitialBufferPos );
+	}
 
-		++nSamplePos;
+	// The release phase of the envelope might have finished within
+	// this period.
+	if ( bNoteLengthExceeded && pNote->get_adsr()->release() == 0 ) {
+		retValue = true;	// the note is ended
 	}
 	if ( pNote->get_instrument()->is_filter_active() && pNote->filter_sustain() ) {
 		// Note is still ringing, do not end.
@@ -1154,62 +1366,22 @@ bool Sampler::renderNoteNoResample(
 	}
 
 	pSelectedLayerInfo->SamplePosition += nAvail_bytes;
-	pNote->get_instrument()->set_peak_l( fInstrPeak_L );
-	pNote->get_instrument()->set_peak_r( fInstrPeak_R );
-
-
-#ifdef H2CORE_HAVE_LADSPA
-	// LADSPA
-	// change the below return logic if you add code after that ifdef
-	if (pNote->get_instrument()->is_muted() || pSong->getIsMuted() ) return retValue;
-	float masterVol =  pSong->getVolume();
-	for ( unsigned nFX = 0; nFX < MAX_FX; ++nFX ) {
-		LadspaFX *pFX = Effects::get_instance()->getLadspaFX( nFX );
 
-		float fLevel = pNote->get_instrument()->get_fx_level( nFX );
-
-		if ( ( pFX ) && ( fLevel != 0.0 ) ) {
-			fLevel = fLevel * pFX->getVolume();
-			float *pBuf_L = pFX->m_pBuffer_L;
-			float *pBuf_R = pFX->m_pBuffer_R;
-
-			float fFXCost_L = fLevel * masterVol;
-			float fFXCost_R = fLevel * masterVol;
-
-			int nBufferPos = nInitialBufferPos;
-			int nSamplePos = nInitialSamplePos;
-			for ( int i = 0; i < nAvail_bytes; ++i ) {
-				pBuf_L[ nBufferPos ] += pSample_data_L[ nSamplePos ] * fFXCost_L;
-				pBuf_R[ nBufferPos ] += pSample_data_R[ nSamplePos ] * fFXCost_R;
-				++nSamplePos;
-				++nBufferPos;
-			}
-		}
-	}
-	// ~LADSPA
-#endif
+	voice.nInitialBufferPos = nInitialBufferPos;
+	voice.nTimes = nTimes;
+	voice.nAvailFrames = nAvail_bytes;
+	voice.nInitialSamplePos = nInitialSamplePos;
 
 	return retValue;
 }
 
-bool Sampler::renderNoteResample(
-	std::shared_ptr<Sample> pSample,
-	Note *pNote,
-	SelectedLayerInfo *pSelectedLayerInfo,
-	std::shared_ptr<InstrumentComponent> pCompo,
-	DrumkitComponent *pDrumCompo,
-	int nBufferSize,
-	int nInitialSilence,
-	float cost_L,
-	float cost_R,
-	float cost_track_L,
-	float cost_track_R,
-	float fLayerPitch,
-	std::shared_ptr<Song> pSong
-)
+bool Sampler::renderNoteResample( Voice& voice, int nBufferSize, std::shared_ptr<Song> pSong )
 {
 	auto pAudioDriver = Hydrogen::get_instance()->getAudioOutput();
 	auto pAudioEngine = Hydrogen::get_instance()->getAudioEngine();
+	const auto& pSample = voice.pSample;
+	Note* pNote = voice.pNote;
+	SelectedLayerInfo* pSelectedLayerInfo = voice.pSelectedLayerInfo;
 
 	int nNoteLength = -1;
 	if ( pNote->get_length() != -1 ) {
@@ -1219,7 +1391,7 @@ bool Sampler::renderNoteResample(
 		
 		nNoteLength = ( int )( pNote->get_length() * resampledTickSize);
 	}
-	float fNotePitch = pNote->get_total_pitch() + fLayerPitch;
+	float fNotePitch = pNote->get_total_pitch() + voice.fLayerPitch;
 
 	float fStep = Note::pitchToFrequency( fNotePitch );
 //	_ERRORLOG( QString("pitch: %1, step: %2" ).arg(fNotePitch).arg( fStep) );
@@ -1230,168 +1402,152 @@ bool Sampler::renderNoteResample(
 
 
 	bool retValue = true; // the note is ended
-	if ( nAvail_bytes > nBufferSize - nInitialSilence ) {	// il sample e' piu' grande del buffersize
+	if ( nAvail_bytes > nBufferSize - voice.nInitialSilence ) {	// il sample e' piu' grande del buffersize
 		// imposto il numero dei bytes disponibili uguale al buffersize
-		nAvail_bytes = nBufferSize - nInitialSilence;
+		nAvail_bytes = nBufferSize - voice.nInitialSilence;
 		retValue = false; // the note is not ended yet
 	}
 
-	int nInitialBufferPos = nInitialSilence;
+	int nInitialBufferPos = voice.nInitialSilence;
 	//float fInitialSamplePos = pNote->get_sample_position( pCompo->get_drumkit_componentID() );
 	double fSamplePos = pSelectedLayerInfo->SamplePosition;
 	int nTimes = nInitialBufferPos + nAvail_bytes;
 
 	if ( pNote->get_instrument()->is_filter_active() && pNote->filter_sustain() ) {
 		// If filter is causing note to ring, process more samples.
-		nTimes = nInitialBufferPos + nBufferSize - nInitialSilence;
+		nTimes = nInitialBufferPos + nBufferSize - voice.nInitialSilence;
+	}
+	int nSampleFrames = pSample->get_frames();
+
+	float* buffer_L = &m_voiceBuffers[ voice.nBufferOffset ];
+	float* buffer_R = buffer_L + nBufferSize;
+
+	// The sample position is only advanced at the end of the period.
+	// Notes exceeding their length are therefore released right away.
+	const bool bNoteLengthExceeded = ( nNoteLength != -1 ) &&
+		( nNoteLength <= pSelectedLayerInfo->SamplePosition );
+	if ( bNoteLengthExceeded ) {
+		pNote->get_adsr()->release();
 	}
-	auto pSample_data_L = pSample->get_data_l();
-	auto pSample_data_R = pSample->get_data_r();
 
-	float fInstrPeak_L = pNote->get_instrument()->get_peak_l(); // this value will be reset to 0 by the mixer..
-	float fInstrPeak_R = pNote->get_instrument()->get_peak_r(); // this value will be reset to 0 by the mixer..
+	// Main rendering loop. Each interpolation method got a kernel
+	// of its own to avoid branching within the loop. The same holds
+	// for the formats the sample might be stored in.
+	const int nRenderedFrames = nTimes - nInitialBufferPos;
+	float* pRendered_L = &buffer_L[ nInitialBufferPos ];
+	float* pRendered_R = &buffer_R[ nInitialBufferPos ];
+	visitVoiceData( voice, [&]( auto pSample_data_L, auto pSample_data_R ) {
+		switch ( m_interpolateMode ) {
+		case Interpolation::InterpolateMode::Linear:
+			Interpolation::resample<Interpolation::InterpolateMode::Linear>(
+				pSample_data_L, pSample_data_R, nSampleFrames, fSamplePos, fStep,
+				pRendered_L, pRendered_R, nRenderedFrames );
+			break;
+		case Interpolation::InterpolateMode::Cosine:
+			Interpolation::resample<Interpolation::InterpolateMode::Cosine>(
+				pSample_data_L, pSample_data_R, nSampleFrames, fSamplePos, fStep,
+				pRendered_L, pRendered_R, nRenderedFrames );
+			break;
+		case Interpolation::InterpolateMode::Third:
+			Interpolation::resample<Interpolation::InterpolateMode::Third>(
+				pSample_data_L, pSample_data_R, nSampleFrames, fSamplePos, fStep,
+				pRendered_L, pRendered_R, nRenderedFrames );
+			break;
+		case Interpolation::InterpolateMode::Cubic:
+			Interpolation::resample<Interpolation::InterpolateMode::Cubic>(
+				pSample_data_L, pSample_data_R, nSampleFrames, fSamplePos, fStep,
+				pRendered_L, pRendered_R, nRenderedFrames );
+			break;
+		case Interpolation::InterpolateMode::Hermite:
+			Interpolation::resample<Interpolation::InterpolateMode::Hermite>(
+				pSample_data_L, pSample_data_R, nSampleFrames, fSamplePos, fStep,
+				pRendered_L, pRendered_R, nRenderedFrames );
+			break;
+		}
+	} );
+
+	// ADSR envelope and low pass resonant filter
+	if ( pNote->get_instrument()->is_filter_active() ) {
+		applyEnvelopeAndFilter<true>( pNote, fStep, buffer_L, buffer_R,
+									  nInitialBufferPos, nTimes );
+	} else {
+		applyEnvelopeAndFilter<false>( pNote, fStep, buffer_L, buffer_R,
+									   nInitialBufferPos, nTimes );
+	}
+
+	// The release phase of the envelope might have finished within
+	// this period.
+	if ( bNoteLengthExceeded && pNote->get_adsr()->release() == 0 ) {
+		retValue = true;	// the note is ended
+	}
+
+	if ( pNote->get_instrument()->is_filter_active() && pNote->filter_sustain() ) {
+		// Note is still ringing, do not end.
+		retValue = false;
+	}
+
+	pSelectedLayerInfo->SamplePosition += nAvail_bytes * fStep;
+
+	voice.nInitialBufferPos = nInitialBufferPos;
+	voice.nTimes = nTimes;
+	voice.nAvailFrames = nAvail_bytes;
+	voice.nInitialSamplePos = 0;
+
+	return retValue;
+}
+
+void Sampler::mixVoice( Voice& voice, std::shared_ptr<Song> pSong )
+{
+	auto pInstr = voice.pNote->get_instrument();
+	const float* pBuffer_L = &m_voiceBuffers[ voice.nBufferOffset ];
+	const float* pBuffer_R = pBuffer_L + m_nVoiceBufferSize;
+
+	float fInstrPeak_L = pInstr->get_peak_l(); // this value will be reset to 0 by the mixer..
+	float fInstrPeak_R = pInstr->get_peak_r(); // this value will be reset to 0 by the mixer..
 
-	float fADSRValue = 1.0;
 	float fVal_L;
 	float fVal_R;
-	int nSampleFrames = pSample->get_frames();
-
 
 #ifdef H2CORE_HAVE_JACK
 	float *		pTrackOutL = nullptr;
 	float *		pTrackOutR = nullptr;
 
 	if ( Preferences::get_instance()->m_bJackTrackOuts ) {
-		auto pJackAudioDriver = dynamic_cast<JackAudioDriver*>( pAudioDriver );
+		auto pJackAudioDriver = dynamic_cast<JackAudioDriver*>( Hydrogen::get_instance()->getAudioOutput() );
 		if( pJackAudioDriver ) {
-			pTrackOutL = pJackAudioDriver->getTrackOut_L( pNote->get_instrument(), pCompo );
-			pTrackOutR = pJackAudioDriver->getTrackOut_R( pNote->get_instrument(), pCompo );
+			pTrackOutL = pJackAudioDriver->getTrackOut_L( pInstr, voice.pCompo );
+			pTrackOutR = pJackAudioDriver->getTrackOut_R( pInstr, voice.pCompo );
 		}
 	}
 #endif
 
-	float buffer_L[MAX_BUFFER_SIZE];
-	float buffer_R[MAX_BUFFER_SIZE];
-
-
-	// Main rendering loop.
-	// With some re-work, more of this could likely be vectorised fairly easily.
-	//   - assert no buffer aliasing
-	//   - template and multiple instantiations for is_filter_active x each interpolation method
-	//   - iterate LP IIR filter coefficients to longer IIR filter to fit vector width
-	//
-	for ( int nBufferPos = nInitialBufferPos; nBufferPos < nTimes; ++nBufferPos ) {
-		if ( ( nNoteLength != -1 ) && ( nNoteLength <= pSelectedLayerInfo->SamplePosition ) ) {
-			if ( pNote->get_adsr()->release() == 0 ) {
-				if (!retValue) {
-					retValue = 1;	// the note is ended
-				}
-			}
-		}
-
-		int nSamplePos = ( int )fSamplePos;
-		double fDiff = fSamplePos - nSamplePos;
-		if ( ( nSamplePos - 1 ) >= nSampleFrames ) {
-			//we reach the last audioframe.
-			//set this last frame to zero do nothing wrong.
-			fVal_L = 0.0;
-			fVal_R = 0.0;
-		} else {
-			// Gather frame samples
-			float l0, l1, l2, l3, r0, r1, r2, r3;
-			// Short-circuit: the common case is that all required frames are within the sample.
-			if ( nSamplePos >= 1 && nSamplePos + 2 < nSampleFrames ) {
-				l0 = pSample_data_L[ nSamplePos-1 ];
-				l1 = pSample_data_L[ nSamplePos ];
-				l2 = pSample_data_L[ nSamplePos+1 ];
-				l3 = pSample_data_L[ nSamplePos+2 ];
-				r0 = pSample_data_R[ nSamplePos-1 ];
-				r1 = pSample_data_R[ nSamplePos ];
-				r2 = pSample_data_R[ nSamplePos+1 ];
-				r3 = pSample_data_R[ nSamplePos+2 ];
-			} else {
-				l0 = l1 = l2 = l3 = r0 = r1 = r2 = r3 = 0.0;
-				// Some required frames are off the beginning or end of the sample.
-				if ( nSamplePos >= 1 && nSamplePos < nSampleFrames + 1 ) {
-					l0 = pSample_data_L[ nSamplePos-1 ];
-					r0 = pSample_data_R[ nSamplePos-1 ];
-				}
-				// Each successive frame may be past the end of the sample so check individually.
-				if ( nSamplePos < nSampleFrames ) {
-					l1 = pSample_data_L[ nSamplePos ];
-					r1 = pSample_data_R[ nSamplePos ];
-					if ( nSamplePos+1 < nSamplePos ) {
-						l2 = pSample_data_L[ nSamplePos+1 ];
-						r2 = pSample_data_R[ nSamplePos+1 ];
-						if ( nSamplePos+2 < nSamplePos ) {
-							l3 = pSample_data_L[ nSamplePos+2 ];
-							r3 = pSample_data_R[ nSamplePos+2 ];
-						}
-					}
-				}
-			}
-
-			// Interpolate frame values from Sample domain to audio output range
-			switch ( m_interpolateMode ) {
-			case Interpolation::InterpolateMode::Linear:
-				fVal_L = l1 * (1 - fDiff ) + l2 * fDiff;
-				fVal_R = r1 * (1 - fDiff ) + r2 * fDiff;
-				break;
-			case Interpolation::InterpolateMode::Cosine:
-				fVal_L = Interpolation::cosine_Interpolate( l1, l2, fDiff);
-				fVal_R = Interpolation::cosine_Interpolate( r1, r2, fDiff);
-				break;
-			case Interpolation::InterpolateMode::Third:
-				fVal_L = Interpolation::third_Interpolate( l0, l1, l2, l3, fDiff);
-				fVal_R = Interpolation::third_Interpolate( r0, r1, r2, r3, fDiff);
-				break;
-			case Interpolation::InterpolateMode::Cubic:
-				fVal_L = Interpolation::cubic_Interpolate( l0, l1, l2, l3, fDiff);
-				fVal_R = Interpolation::cubic_Interpolate( r0, r1, r2, r3, fDiff);
-				break;
-			case Interpolation::InterpolateMode::Hermite:
-				fVal_L = Interpolation::hermite_Interpolate( l0, l1, l2, l3, fDiff);
-				fVal_R = Interpolation::hermite_Interpolate( r0, r1, r2, r3, fDiff);
-				break;
-			}
+	float* pStemOut_L = nullptr;
+	float* pStemOut_R = nullptr;
+	if ( ! m_stems.empty() ) {
+		auto it = m_stems.find( pInstr->get_id() );
+		if ( it != m_stems.end() ) {
+			pStemOut_L = it->second.data();
+			pStemOut_R = pStemOut_L + MAX_BUFFER_SIZE;
 		}
-
-		// ADSR envelope
-		fADSRValue = pNote->get_adsr()->get_value( fStep );
-		fVal_L = fVal_L * fADSRValue;
-		fVal_R = fVal_R * fADSRValue;
-		// Low pass resonant filter
-		if ( pNote->get_instrument()->is_filter_active() ) {
-			pNote->compute_lr_values( &fVal_L, &fVal_R );
-		}
-
-		buffer_L[nBufferPos] = fVal_L;
-		buffer_R[nBufferPos] = fVal_R;
-
-		fSamplePos += fStep;
-	}
-	if ( pNote->get_instrument()->is_filter_active() && pNote->filter_sustain() ) {
-		// Note is still ringing, do not end.
-		retValue = false;
 	}
 
 	// Mix rendered sample buffer to track and mixer output
-	for ( int nBufferPos = nInitialBufferPos; nBufferPos < nTimes; ++nBufferPos ) {
+	for ( int nBufferPos = voice.nInitialBufferPos; nBufferPos < voice.nTimes; ++nBufferPos ) {
 
-		fVal_L = buffer_L[nBufferPos];
-		fVal_R = buffer_R[nBufferPos];
+		fVal_L = pBuffer_L[nBufferPos];
+		fVal_R = pBuffer_R[nBufferPos];
 
 #ifdef H2CORE_HAVE_JACK
 		if ( pTrackOutL ) {
-			pTrackOutL[nBufferPos] += fVal_L * cost_track_L;
+			pTrackOutL[nBufferPos] += fVal_L * voice.cost_track_L;
 		}
 		if ( pTrackOutR ) {
-			pTrackOutR[nBufferPos] += fVal_R * cost_track_R;
+			pTrackOutR[nBufferPos] += fVal_R * voice.cost_track_R;
 		}
 #endif
 
-		fVal_L = fVal_L * cost_L;
-		fVal_R = fVal_R * cost_R;
+		fVal_L = fVal_L * voice.cost_L;
+		fVal_R = fVal_R * voice.cost_R;
 
 		// update instr peak
 		if ( fVal_L > fInstrPeak_L ) {
@@ -1401,29 +1557,32 @@ bool Sampler::renderNoteResample(
 			fInstrPeak_R = fVal_R;
 		}
 
-		pDrumCompo->set_outs( nBufferPos, fVal_L, fVal_R );
+		voice.pDrumCompo->set_outs( nBufferPos, fVal_L, fVal_R );
 
 		// to main mix
 		m_pMainOut_L[nBufferPos] += fVal_L;
 		m_pMainOut_R[nBufferPos] += fVal_R;
 
+		if ( pStemOut_L ) {
+			pStemOut_L[nBufferPos] += fVal_L;
+			pStemOut_R[nBufferPos] += fVal_R;
+		}
+
 	}
 
-	pSelectedLayerInfo->SamplePosition += nAvail_bytes * fStep;
-	pNote->get_instrument()->set_peak_l( fInstrPeak_L );
-	pNote->get_instrument()->set_peak_r( fInstrPeak_R );
+	pInstr->set_peak_l( fInstrPeak_L );
+	pInstr->set_peak_r( fInstrPeak_R );
 
 
 #ifdef H2CORE_HAVE_LADSPA
 	// LADSPA
-	// change the below return logic if you add code after that ifdef
-	if ( pNote->get_instrument()->is_muted() || pSong->getIsMuted() ) {
-		return retValue;
+	if ( pInstr->is_muted() || pSong->getIsMuted() ) {
+		return;
 	}
 	float masterVol = pSong->getVolume();
 	for ( unsigned nFX = 0; nFX < MAX_FX; ++nFX ) {
 		LadspaFX *pFX = Effects::get_instance()->getLadspaFX( nFX );
-		float fLevel = pNote->get_instrument()->get_fx_level( nFX );
+		float fLevel = pInstr->get_fx_level( nFX );
 		if ( ( pFX ) && ( fLevel != 0.0 ) ) {
 			fLevel = fLevel * pFX->getVolume();
 
@@ -1433,45 +1592,52 @@ bool Sampler::renderNoteResample(
 			float fFXCost_L = fLevel * masterVol;
 			float fFXCost_R = fLevel * masterVol;
 
-			int nBufferPos = nInitialBufferPos;
-			for ( int i = 0; i < nAvail_bytes; ++i ) {
+			int nBufferPos = voice.nInitialBufferPos;
+			if ( voice.bResample ) {
+				for ( int i = 0; i < voice.nAvailFrames; ++i ) {
 
-				fVal_L = buffer_L[ nBufferPos ];
-				fVal_R = buffer_R[ nBufferPos ];
+					fVal_L = pBuffer_L[ nBufferPos ];
+					fVal_R = pBuffer_R[ nBufferPos ];
 
-				pBuf_L[ nBufferPos ] += fVal_L * fFXCost_L;
-				pBuf_R[ nBufferPos ] += fVal_R * fFXCost_R;
-				++nBufferPos;
+					pBuf_L[ nBufferPos ] += fVal_L * fFXCost_L;
+					pBuf_R[ nBufferPos ] += fVal_R * fFXCost_R;
+					++nBufferPos;
+				}
+			} else {
+				// The effects are fed with the plain sample.
+				visitVoiceData( voice, [&]( auto pSample_data_L, auto pSample_data_R ) {
+					int nSamplePos = voice.nInitialSamplePos;
+					for ( int i = 0; i < voice.nAvailFrames; ++i ) {
+						pBuf_L[ nBufferPos ] += pSample_data_L[ nSamplePos ] * fFXCost_L;
+						pBuf_R[ nBufferPos ] += pSample_data_R[ nSamplePos ] * fFXCost_R;
+						++nSamplePos;
+						++nBufferPos;
+					}
+				} );
 			}
 		}
 	}
+	// ~LADSPA
 #endif
-	return retValue;
 }
 
 
 void Sampler::stopPlayingNotes( std::shared_ptr<Instrument> pInstr )
 {
-	if ( pInstr ) { // stop all notes using this instrument
-		for ( unsigned i = 0; i < m_playingNotesQueue.size(); ) {
-			Note *pNote = m_playingNotesQueue[ i ];
-			assert( pNote );
-			if ( pNote->get_instrument() == pInstr ) {
-				delete pNote;
-				pInstr->dequeue();
-				m_playingNotesQueue.erase( m_playingNotesQueue.begin() + i );
-			}
-			++i;
-		}
-	} else { // stop all notes
-		// delete all copied notes in the playing notes queue
-		for ( unsigned i = 0; i < m_playingNotesQueue.size(); ++i ) {
-			Note *pNote = m_playingNotesQueue[i];
-			pNote->get_instrument()->dequeue();
-			delete pNote;
-		}
-		m_playingNotesQueue.clear();
+	// delete all copied notes in the playing notes queue using
+	// this instrument or all of them
+	if ( pInstr != nullptr && ! m_pVoiceAllocator->containsInstrument( pInstr.get() ) ) {
+		return;
 	}
+	m_pVoiceAllocator->removeIf( [&]( int, Note* pNote, bool ) {
+		assert( pNote );
+		if ( pInstr != nullptr && pNote->get_instrument() != pInstr ) {
+			return false;
+		}
+		pNote->get_instrument()->dequeue();
+		m_pNotePool->release( pNote );
+		return true;
+	} );
 }
 
 
@@ -1486,7 +1652,7 @@ void Sampler::preview_sample(std::shared_ptr<Sample> pSample, int length )
 
 		pLayer->set_sample( pSample );
 
-		Note *pPreviewNote = new Note( m_pPreviewInstrument, 0, 1.0, 0.f, length, 0 );
+		Note *pPreviewNote = m_pNotePool->acquire( m_pPreviewInstrument, 0, 1.0, 0.f, length, 0 );
 
 		stopPlayingNotes( m_pPreviewInstrument );
 		noteOn( pPreviewNote );
@@ -1509,7 +1675,7 @@ void Sampler::preview_instrument( std::shared_ptr<Instrument> pInstr )
 	m_pPreviewInstrument = pInstr;
 	pInstr->set_is_preview_instrument(true);
 
-	Note *pPreviewNote = new Note( m_pPreviewInstrument, 0, 1.0, 0.f, MAX_NOTES, 0 );
+	Note *pPreviewNote = m_pNotePool->acquire( m_pPreviewInstrument, 0, 1.0, 0.f, MAX_NOTES, 0 );
 
 	noteOn( pPreviewNote );	// exclusive note
 	Hydrogen::get_instance()->getAudioEngine()->unlock();
@@ -1608,12 +1774,8 @@ bool Sampler::isAnyInstrumentSoloed() const
 
 bool Sampler::isInstrumentPlaying( std::shared_ptr<Instrument> instrument )
 {
-	if ( instrument ) { // stop all notes using this instrument
-		for ( unsigned j = 0; j < m_playingNotesQueue.size(); j++ ) {
-			if ( instrument->get_name() == m_playingNotesQueue[ j ]->get_instrument()->get_name()){
-				return true;
-			}
-		}
+	if ( instrument ) {
+		return m_pVoiceAllocator->containsInstrument( instrument.get() );
 	}
 	return false;
 }
@@ -1634,5 +1796,38 @@ void Sampler::reinitializePlaybackTrack()
 	m_nPlayBackSamplePosition = 0;
 }
 
+void Sampler::enableStems( std::shared_ptr<Song> pSong )
+{
+	m_stems.clear();
+	InstrumentList* pInstrumentList = pSong->getInstrumentList();
+	for ( int nInstr = 0; nInstr < pInstrumentList->size(); ++nInstr ) {
+		m_stems[ pInstrumentList->get( nInstr )->get_id() ] =
+			std::vector<float>( 2 * MAX_BUFFER_SIZE, 0.f );
+	}
+}
+
+void Sampler::disableStems()
+{
+	m_stems.clear();
+}
+
+const float* Sampler::getStemOut_L( int nInstrumentId ) const
+{
+	auto it = m_stems.find( nInstrumentId );
+	if ( it == m_stems.end() ) {
+		return nullptr;
+	}
+	return it->second.data();
+}
+
+const float* Sampler::getStemOut_R( int nInstrumentId ) const
+{
+	auto it = m_stems.find( nInstrumentId );
+	if ( it == m_stems.end() ) {
+		return nullptr;
+	}
+	return it->second.data() + MAX_BUFFER_SIZE;
+}
+
 };
 
@@ -26,9 +26,11 @@
 
 #include <core/Object.h>
 #include <core/Globals.h>
+#include <core/Helpers/Random.h>
 #include <core/Sampler/Interpolation.h>
 
 #include <inttypes.h>
+#include <map>
 #include <vector>
 #include <memory>
 
@@ -43,6 +45,12 @@ class Instrument;
 struct SelectedLayerInfo;
 class InstrumentComponent;
 class AudioOutput;
+class NotePool;
+class WorkerPool;
+class DiskStreamer;
+class DiskStream;
+class LayerLoader;
+class VoiceAllocator;
 
 ///
 /// Waveform based sampler.
@@ -169,8 +177,11 @@ public:
 	 *
 	 * It is called by AudioEngine::AudioEngine() and stored in
 	 * AudioEngine::m_pSampler.
+	 *
+	 * \param pNotePool Pool used to destroy all notes handed over
+	 * to the Sampler. Owned by the AudioEngine.
 	 */
-	Sampler();
+	Sampler( NotePool* pNotePool );
 	~Sampler();
 
 	void process( uint32_t nFrames, std::shared_ptr<Song> pSong );
@@ -180,18 +191,20 @@ public:
 
 	/// Stop playing a note.
 	void noteOff( Note *pNote );
+	/** Releases all notes started by MIDI key @a key. Must only be
+	 * called by the audio thread (see AudioEngine::midiNoteOff()).*/
 	void midiKeyboardNoteOff( int key );
 
 	void stopPlayingNotes( std::shared_ptr<Instrument> pInstr = nullptr );
 
-	int getPlayingNotesNumber() {
-		return m_playingNotesQueue.size();
-	}
+	int getPlayingNotesNumber() const;
 
 	void preview_sample( std::shared_ptr<Sample> pSample, int length );
 	void preview_instrument( std::shared_ptr<Instrument> pInstr );
 
 	void setPlayingNotelength( std::shared_ptr<Instrument> pInstrument, unsigned long ticks, unsigned long noteOnTick );
+	/** Must only be called by the audio thread. The voices are
+	 * modified concurrently otherwise.*/
 	bool isInstrumentPlaying( std::shared_ptr<Instrument> pInstr );
 
 	void setInterpolateMode( Interpolation::InterpolateMode mode ){
@@ -217,10 +230,47 @@ public:
 	 * loaded with a nullptr instead.
 	 */
 	void reinitializePlaybackTrack();
+
+	/**
+	 * Adds an output for each instrument of @a pSong. process()
+	 * mixes the post-fader signal of each instrument into its output
+	 * in addition to the main out. Effect returns are not included.
+	 *
+	 * Used by the OfflineRenderer to export all tracks within a
+	 * single pass. Must not be called while the AudioEngine is
+	 * processing.
+	 */
+	void enableStems( std::shared_ptr<Song> pSong );
+	/** Drops all outputs created by enableStems().*/
+	void disableStems();
+	/** \return Output of the instrument with id @a nInstrumentId or
+	 * nullptr in case enableStems() was not called for it.
+	 * @{ */
+	const float* getStemOut_L( int nInstrumentId ) const;
+	const float* getStemOut_R( int nInstrumentId ) const;
+	/** @} */
+
+	/** \return #m_pDiskStreamer */
+	DiskStreamer* getDiskStreamer() const;
+	/** \return #m_pLayerLoader */
+	LayerLoader* getLayerLoader() const;
+	/** \return #m_pVoiceAllocator */
+	VoiceAllocator* getVoiceAllocator() const;
+	/** \return #m_random */
+	Random& getRandom();
 	
 private:
-	std::vector<Note*> m_playingNotesQueue;
+	/** Notes currently playing.*/
+	VoiceAllocator* m_pVoiceAllocator;
+	/** Notes done playing within the current period. Their MIDI
+	 * note-off is sent at the end of process(). Reserved to the
+	 * number of voices and never grown, see queueNoteOff().*/
 	std::vector<Note*> m_queuedNoteOffs;
+	/** Appends @a pNote to #m_queuedNoteOffs or, in case it is full,
+	 * passes it to sendNoteOff() right away.*/
+	void queueNoteOff( Note* pNote );
+	/** Sends the MIDI note-off of @a pNote and releases it.*/
+	void sendNoteOff( Note* pNote );
 	
 	/// Instrument used for the playback track feature.
 	std::shared_ptr<Instrument> m_pPlaybackTrackInstrument;
@@ -247,42 +297,159 @@ private:
 	
 	bool isAnyInstrumentSoloed() const;
 	
-	bool renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Song> pSong );
+	/**
+	 * A single component of a note to be rendered within the current
+	 * period.
+	 */
+	struct Voice {
+		Note* pNote;
+		std::shared_ptr<Sample> pSample;
+		SelectedLayerInfo* pSelectedLayerInfo;
+		std::shared_ptr<InstrumentComponent> pCompo;
+		DrumkitComponent* pDrumCompo;
+		int nInitialSilence;
+		float cost_L;
+		float cost_R;
+		float cost_track_L;
+		float cost_track_R;
+		float fLayerPitch;
+		bool bResample;
+		/** Position of the return value within #m_returnValues.*/
+		int nReturnValueIndex;
+		/** Offset of the rendered frames in #m_voiceBuffers.*/
+		size_t nBufferOffset;
+		/** Whether only the head of #pSample is kept in memory.*/
+		bool bStreamed;
+		/** Remainder of a streamed sample. nullptr if all streams
+		 * were in use.*/
+		DiskStream* pStream;
+		/** Set in case frames of #pStream were not read in time.*/
+		bool bStarved;
+
+		/** Set by renderNoteNoResample() and renderNoteResample().
+		 * @{ */
+		bool bEnded;
+		/** First and last + 1 frame written to the buffer.*/
+		int nInitialBufferPos;
+		int nTimes;
+		/** Number of frames covered by the sample.*/
+		int nAvailFrames;
+		int nInitialSamplePos;
+		/** @} */
+	};
+
+	/** All voices of a note within #m_voices.*/
+	struct NoteVoices {
+		int nFirstVoice;
+		int nVoices;
+		/** Offset of the return values within #m_returnValues.*/
+		int nFirstReturnValue;
+		int nReturnValues;
+	};
+
+	/**
+	 * Selects the layers of all components of @a pNote, computes
+	 * their gains, and appends the resulting Voice objects to
+	 * #m_voices.
+	 *
+	 * Involves random numbers and the round robin state of the song
+	 * and is therefore done in order of #m_pVoiceAllocator on the
+	 * audio thread.
+	 */
+	void prepareNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Song> pSong );
+	/** \return Index of the loaded layer of @a pComponent closest to
+	 * @a fVelocity or -1 if there is none.*/
+	int findNearestLoadedLayer( const std::shared_ptr<InstrumentComponent>& pComponent,
+								float fVelocity ) const;
+	/** Renders all voices of the @a nNote th note of
+	 * #m_pVoiceAllocator. Used as WorkerPool::Callback.*/
+	static void renderNoteVoices( void* pSampler, int nNote );
+	/** Renders @a voice into its buffer in #m_voiceBuffers.*/
+	void renderVoice( Voice& voice );
+	/** Mixes the rendered @a voice using mixVoice() and stores its
+	 * return value and the state of its stream.*/
+	void completeVoice( Voice& voice, std::shared_ptr<Song> pSong );
+	/** Adds a rendered voice to the outputs, the component, track,
+	 * and FX buffers.*/
+	void mixVoice( Voice& voice, std::shared_ptr<Song> pSong );
+	/**
+	 * Calls @a function with readers of both channels of the sample
+	 * of @a voice, just like Sample::visit_data(). Frames of
+	 * streamed samples beyond their head are read from
+	 * Voice::pStream.
+	 */
+	template <typename Function>
+	void visitVoiceData( Voice& voice, Function&& function );
 
 	Interpolation::InterpolateMode m_interpolateMode;
 
-	bool renderNoteNoResample(
-		std::shared_ptr<Sample> pSample,
-		Note *pNote,
-		SelectedLayerInfo *pSelectedLayerInfo,
-		std::shared_ptr<InstrumentComponent> pCompo,
-		DrumkitComponent *pDrumCompo,
-		int nBufferSize,
-		int nInitialSilence,
-		float cost_L,
-		float cost_R,
-		float cost_track_L,
-		float cost_track_R,
-		std::shared_ptr<Song> pSong
-	);
-
-	bool renderNoteResample(
-		std::shared_ptr<Sample> pSample,
-		Note *pNote,
-		SelectedLayerInfo *pSelectedLayerInfo,
-		std::shared_ptr<InstrumentComponent> pCompo,
-		DrumkitComponent *pDrumCompo,
-		int nBufferSize,
-		int nInitialSilence,
-		float cost_L,
-		float cost_R,
-		float cost_track_L,
-		float cost_track_R,
-		float fLayerPitch,
-		std::shared_ptr<Song> pSong
-	);
+	/** Destroys all notes once they are done playing.*/
+	NotePool* m_pNotePool;
+
+	/** Selects layers of instruments using Instrument::RANDOM.
+	 * Seeded by AudioEngine::seedRandom().*/
+	Random m_random;
+
+	/** Renders notes in parallel in case
+	 * Preferences::m_nSamplerWorkers is larger than 0.*/
+	WorkerPool* m_pWorkerPool;
+
+	/** Reads streamed samples from disk in case
+	 * Preferences::m_bDiskStreaming is set.*/
+	DiskStreamer* m_pDiskStreamer;
+
+	/** Decodes layers on first use in case
+	 * Preferences::m_bLazyLayerLoading is set.*/
+	LayerLoader* m_pLayerLoader;
+
+	/**
+	 * Voices of the current period.
+	 *
+	 * Each one is rendered into a buffer of its own. Mixing them is
+	 * done afterwards in the order of #m_pVoiceAllocator. This way
+	 * the output does not depend on the number of workers.
+	 *
+	 * All containers are reserved in the constructor.
+	 */
+	std::vector<Voice> m_voices;
+	std::vector<NoteVoices> m_noteVoices;
+	/** Whether the rendering of a component of a note is done.*/
+	std::vector<char> m_returnValues;
+	/** Number of voices rendered within a single period at most. Set
+	 * to the capacity of #m_pVoiceAllocator.*/
+	int m_nMaxVoices;
+	/** Two channels of #m_nVoiceBufferSize frames for each of the
+	 * #m_nMaxVoices voices in case there are workers. Otherwise a
+	 * single pair of channels shared by all voices.*/
+	std::unique_ptr<float[]> m_voiceBuffers;
+	/** Number of frames of the current period.*/
+	unsigned m_nVoiceBufferSize;
+	/** Song rendered within the current call to process().*/
+	std::shared_ptr<Song> m_pSong;
+
+	/** Outputs created by enableStems() indexed by instrument id.
+	 * Each holds #MAX_BUFFER_SIZE frames of the left followed by the
+	 * right channel.*/
+	std::map<int, std::vector<float>> m_stems;
+
+	bool renderNoteNoResample( Voice& voice, int nBufferSize );
+
+	bool renderNoteResample( Voice& voice, int nBufferSize, std::shared_ptr<Song> pSong );
 };
 
+inline DiskStreamer* Sampler::getDiskStreamer() const {
+	return m_pDiskStreamer;
+}
+inline LayerLoader* Sampler::getLayerLoader() const {
+	return m_pLayerLoader;
+}
+inline VoiceAllocator* Sampler::getVoiceAllocator() const {
+	return m_pVoiceAllocator;
+}
+inline Random& Sampler::getRandom() {
+	return m_random;
+}
+
 
 } // namespace
 
@@ -0,0 +1,108 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/Sampler/SincResampler.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <numeric>
+
+namespace H2Core
+{
+
+/** Modified Bessel function of the first kind of order zero.*/
+static double besselI0( double fX )
+{
+	double fSum = 1.0;
+	double fTerm = 1.0;
+	for ( int k = 1; k < 50; ++k ) {
+		fTerm *= ( fX / ( 2 * k ) ) * ( fX / ( 2 * k ) );
+		fSum += fTerm;
+		if ( fTerm < fSum * 1e-12 ) {
+			break;
+		}
+	}
+	return fSum;
+}
+
+SincResampler::SincResampler( int nSourceRate, int nTargetRate )
+{
+	assert( nSourceRate > 0 && nTargetRate > 0 );
+
+	const int nGcd = std::gcd( nSourceRate, nTargetRate );
+	m_nSourceRate = nSourceRate / nGcd;
+	m_nTargetRate = nTargetRate / nGcd;
+	m_fCutoff = fRolloff * std::min( 1.0, static_cast<double>( nTargetRate ) / nSourceRate );
+
+	// Two additional entries allow for interpolating at the very
+	// end without any check.
+	const int nSize = nZeroCrossings * nOversampling;
+	m_table.resize( nSize + 2, 0.0f );
+	const double fNorm = besselI0( fBeta );
+	m_table[ 0 ] = 1.0f;
+	for ( int ii = 1; ii < nSize; ++ii ) {
+		const double fX = static_cast<double>( ii ) / nOversampling;
+		const double fRatio = static_cast<double>( ii ) / nSize;
+		const double fWindow = besselI0( fBeta * std::sqrt( 1 - fRatio * fRatio ) ) / fNorm;
+		m_table[ ii ] = std::sin( M_PI * fX ) / ( M_PI * fX ) * fWindow;
+	}
+}
+
+int SincResampler::getOutputFrames( int nInputFrames ) const
+{
+	return static_cast<int>( static_cast<long long>( nInputFrames ) * m_nTargetRate /
+							 m_nSourceRate );
+}
+
+void SincResampler::process( const float* pIn, int nInputFrames, float* pOut,
+							 int nOutputFrames ) const
+{
+	// Kernel in units of input frames.
+	const double fHalfWidth = nZeroCrossings / m_fCutoff;
+	const double fTableStep = m_fCutoff * nOversampling;
+	const int nTableSize = nZeroCrossings * nOversampling;
+
+	for ( int nFrame = 0; nFrame < nOutputFrames; ++nFrame ) {
+		const long long nPosition = static_cast<long long>( nFrame ) * m_nSourceRate;
+		const double fPosition = nPosition / m_nTargetRate +
+			static_cast<double>( nPosition % m_nTargetRate ) / m_nTargetRate;
+
+		const int nFirst = std::max( 0, static_cast<int>( std::ceil( fPosition - fHalfWidth ) ) );
+		const int nLast = std::min( nInputFrames - 1,
+									static_cast<int>( std::floor( fPosition + fHalfWidth ) ) );
+		double fSum = 0.0;
+		for ( int ii = nFirst; ii <= nLast; ++ii ) {
+			const double fIndex = std::fabs( fPosition - ii ) * fTableStep;
+			const int nIndex = static_cast<int>( fIndex );
+			if ( nIndex >= nTableSize ) {
+				continue;
+			}
+			const float fMu = static_cast<float>( fIndex - nIndex );
+			fSum += pIn[ ii ] * ( m_table[ nIndex ] +
+								  fMu * ( m_table[ nIndex + 1 ] - m_table[ nIndex ] ) );
+		}
+		pOut[ nFrame ] = static_cast<float>( fSum * m_fCutoff );
+	}
+}
+
+};
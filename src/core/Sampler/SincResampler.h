@@ -0,0 +1,86 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2C_SINC_RESAMPLER_H
+#define H2C_SINC_RESAMPLER_H
+
+#include <vector>
+
+namespace H2Core
+{
+
+/**
+ * Band-limited sample rate conversion using a Kaiser-windowed sinc
+ * kernel.
+ *
+ * Far too expensive for the audio thread but of considerably higher
+ * quality than the interpolation used by the Sampler (see
+ * Interpolation). Used to convert samples to the rate of the audio
+ * driver while loading them (see Preferences::m_bResampleOnLoad).
+ *
+ * The kernel is tabulated once per instance. Positions in the input
+ * are computed exactly from the ratio of both rates, so there is no
+ * drift even for long samples.
+ *
+ * \ingroup docCore
+ */
+class SincResampler
+{
+public:
+	SincResampler( int nSourceRate, int nTargetRate );
+
+	/** \return Number of frames @a nInputFrames are converted to.*/
+	int getOutputFrames( int nInputFrames ) const;
+
+	/**
+	 * Converts a single channel. Frames outside of @a pIn are
+	 * considered silent.
+	 *
+	 * \param nOutputFrames Usually getOutputFrames( @a
+	 * nInputFrames ).
+	 */
+	void process( const float* pIn, int nInputFrames, float* pOut, int nOutputFrames ) const;
+
+	/** Half the length of the kernel in zero crossings.*/
+	static constexpr int nZeroCrossings = 32;
+	/** Number of table entries between two zero crossings.*/
+	static constexpr int nOversampling = 512;
+	/** Kaiser window parameter. Yields a stop band attenuation of
+	 * about 90 dB.*/
+	static constexpr double fBeta = 9.0;
+	/** Cutoff frequency relative to the Nyquist frequency of the
+	 * lower rate.*/
+	static constexpr double fRolloff = 0.95;
+
+private:
+	int m_nSourceRate;
+	int m_nTargetRate;
+	/** Cutoff frequency relative to the Nyquist frequency of the
+	 * source.*/
+	double m_fCutoff;
+	/** Right half of the windowed kernel.*/
+	std::vector<float> m_table;
+};
+
+};
+
+#endif // H2C_SINC_RESAMPLER_H
@@ -0,0 +1,351 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+
+#include <core/Sampler/VoiceAllocator.h>
+#include <core/Basics/Adsr.h>
+#include <core/Basics/Instrument.h>
+#include <core/Basics/Note.h>
+
+#include <algorithm>
+
+namespace H2Core
+{
+
+VoiceAllocator::VoiceAllocator( int nCapacity )
+	: m_nCapacity( std::max( 1, nCapacity ) )
+	, m_nFreeSlots( 0 )
+	, m_nVoices( 0 )
+	, m_nSounding( 0 )
+	, m_nBucketBits( 1 )
+	, m_nStolen( 0 )
+	, m_nDropped( 0 )
+{
+	m_slots = std::make_unique<Slot[]>( m_nCapacity );
+	m_freeSlots = std::make_unique<int[]>( m_nCapacity );
+	m_voices = std::make_unique<int[]>( m_nCapacity );
+	// The first slots are handed out first.
+	for ( int nSlot = m_nCapacity - 1; nSlot >= 0; --nSlot ) {
+		m_slots[ nSlot ].pNote = nullptr;
+		m_slots[ nSlot ].nFadeFrames = -1;
+		m_freeSlots[ m_nFreeSlots++ ] = nSlot;
+	}
+
+	while ( ( 1 << m_nBucketBits ) < 2 * m_nCapacity ) {
+		++m_nBucketBits;
+	}
+	for ( auto& pBuckets : m_buckets ) {
+		pBuckets = std::make_unique<Bucket[]>( 1 << m_nBucketBits );
+		for ( int nBucket = 0; nBucket < ( 1 << m_nBucketBits ); ++nBucket ) {
+			pBuckets[ nBucket ] = { nNoKey, -1, -1 };
+		}
+	}
+}
+
+Note* VoiceAllocator::add( Note* pNote, int nMaxVoices, Policy policy )
+{
+	const auto pInstrument = pNote->get_instrument();
+	const int nMaxInstrumentVoices = pInstrument != nullptr ? pInstrument->get_max_voices() : 0;
+	if ( nMaxInstrumentVoices > 0 ) {
+		int nInstrumentVoices = 0;
+		visitSlots( Group::instrument, getKey( pInstrument.get() ), [&]( int nSlot ) {
+			if ( m_slots[ nSlot ].nFadeFrames < 0 ) {
+				++nInstrumentVoices;
+			}
+		} );
+		// Notes of the same instrument are stolen oldest first unless
+		// the quietest ones were asked for.
+		const Policy instrumentPolicy = policy == Policy::quietest ? Policy::quietest : Policy::oldest;
+		for ( ; nInstrumentVoices >= nMaxInstrumentVoices; --nInstrumentVoices ) {
+			steal( findVictim( instrumentPolicy, pInstrument.get() ) );
+		}
+	}
+
+	nMaxVoices = std::clamp( nMaxVoices, 1, m_nCapacity );
+	while ( m_nSounding >= nMaxVoices ) {
+		int nVictim = -1;
+		if ( policy == Policy::sameInstrument ) {
+			nVictim = findVictim( Policy::oldest, pInstrument.get() );
+		}
+		if ( nVictim == -1 ) {
+			nVictim = findVictim( policy, nullptr );
+		}
+		steal( nVictim );
+	}
+
+	Note* pDropped = nullptr;
+	if ( m_nFreeSlots == 0 ) {
+		pDropped = drop();
+	}
+
+	const int nSlot = m_freeSlots[ --m_nFreeSlots ];
+	Slot& slot = m_slots[ nSlot ];
+	slot.pNote = pNote;
+	slot.nFadeFrames = -1;
+	for ( int nGroup = 0; nGroup < nGroups; ++nGroup ) {
+		slot.links[ nGroup ].nKey = getKey( static_cast<Group>( nGroup ), pNote );
+	}
+	link( nSlot );
+	m_voices[ m_nVoices++ ] = nSlot;
+	++m_nSounding;
+
+	return pDropped;
+}
+
+void VoiceAllocator::limit( int nMaxVoices, Policy policy )
+{
+	nMaxVoices = std::clamp( nMaxVoices, 1, m_nCapacity );
+	while ( m_nSounding > nMaxVoices ) {
+		steal( findVictim( policy == Policy::quietest ? Policy::quietest : Policy::oldest,
+						   nullptr ) );
+	}
+}
+
+void VoiceAllocator::advance( int nFrames )
+{
+	for ( int nVoice = 0; nVoice < m_nVoices; ++nVoice ) {
+		Slot& slot = m_slots[ m_voices[ nVoice ] ];
+		if ( slot.nFadeFrames > 0 ) {
+			slot.nFadeFrames = std::max( 0, slot.nFadeFrames - nFrames );
+		}
+	}
+}
+
+void VoiceAllocator::clear()
+{
+	removeIf( []( int, Note*, bool ) { return true; } );
+}
+
+int VoiceAllocator::findVictim( Policy policy, const Instrument* pInstrument ) const
+{
+	int nVictim = -1;
+	float fMinLevel = 0;
+	// Both all voices and the ones of an instrument are visited in
+	// the order they were started.
+	auto consider = [&]( int nSlot ) {
+		const Slot& slot = m_slots[ nSlot ];
+		if ( slot.nFadeFrames >= 0 ) {
+			return;
+		}
+		if ( policy != Policy::quietest ) {
+			if ( nVictim == -1 ) {
+				nVictim = nSlot;
+			}
+			return;
+		}
+		const float fLevel = slot.pNote->get_velocity() *
+			slot.pNote->get_adsr()->get_current_value();
+		if ( nVictim == -1 || fLevel < fMinLevel ) {
+			nVictim = nSlot;
+			fMinLevel = fLevel;
+		}
+	};
+
+	if ( pInstrument != nullptr ) {
+		visitSlots( Group::instrument, getKey( pInstrument ), consider );
+	} else {
+		for ( int nVoice = 0; nVoice < m_nVoices; ++nVoice ) {
+			consider( m_voices[ nVoice ] );
+			if ( nVictim != -1 && policy != Policy::quietest ) {
+				break;
+			}
+		}
+	}
+	return nVictim;
+}
+
+void VoiceAllocator::steal( int nSlot )
+{
+	if ( nSlot < 0 ) {
+		return;
+	}
+	Slot& slot = m_slots[ nSlot ];
+	slot.pNote->get_adsr()->fade_out( nFadeFrames );
+	slot.nFadeFrames = nFadeFrames;
+	--m_nSounding;
+	m_nStolen.fetch_add( 1, std::memory_order_relaxed );
+}
+
+Note* VoiceAllocator::drop()
+{
+	int nDropped = 0;
+	for ( int nVoice = 0; nVoice < m_nVoices; ++nVoice ) {
+		const int nFade = m_slots[ m_voices[ nVoice ] ].nFadeFrames;
+		const int nDroppedFade = m_slots[ m_voices[ nDropped ] ].nFadeFrames;
+		if ( nFade >= 0 && ( nDroppedFade < 0 || nFade < nDroppedFade ) ) {
+			nDropped = nVoice;
+		}
+	}
+
+	const int nSlot = m_voices[ nDropped ];
+	if ( m_slots[ nSlot ].nFadeFrames < 0 ) {
+		--m_nSounding;
+	}
+	std::copy( &m_voices[ nDropped + 1 ], &m_voices[ m_nVoices ], &m_voices[ nDropped ] );
+	--m_nVoices;
+	unlink( nSlot );
+	m_freeSlots[ m_nFreeSlots++ ] = nSlot;
+	m_nDropped.fetch_add( 1, std::memory_order_relaxed );
+
+	return m_slots[ nSlot ].pNote;
+}
+
+bool VoiceAllocator::containsInstrument( const Instrument* pInstrument ) const
+{
+	bool bContained = false;
+	visitSlots( Group::instrument, getKey( pInstrument ), [&]( int ) { bContained = true; } );
+	return bContained;
+}
+
+intptr_t VoiceAllocator::getKey( Group group, const Note* pNote )
+{
+	// Notes without a MIDI key and instruments without a mute group
+	// use -1, which matches #nNoKey.
+	const auto pInstrument = pNote->get_instrument();
+	switch ( group ) {
+	case Group::instrument:
+		return getKey( pInstrument.get() );
+	case Group::muteGroup:
+		return pInstrument != nullptr ? pInstrument->get_mute_group() : nNoKey;
+	case Group::midiKey:
+		return pNote->get_midi_msg();
+	}
+	return nNoKey;
+}
+
+intptr_t VoiceAllocator::getKey( const Instrument* pInstrument )
+{
+	return pInstrument != nullptr ? reinterpret_cast<intptr_t>( pInstrument ) : nNoKey;
+}
+
+int VoiceAllocator::getHome( intptr_t nKey ) const
+{
+	// Fibonacci hashing spreads both small integers and aligned
+	// pointers.
+	return static_cast<int>( ( static_cast<uint64_t>( nKey ) * 0x9e3779b97f4a7c15ULL ) >>
+							 ( 64 - m_nBucketBits ) );
+}
+
+int VoiceAllocator::findBucket( Group group, intptr_t nKey ) const
+{
+	const Bucket* pBuckets = m_buckets[ static_cast<int>( group ) ].get();
+	const int nMask = ( 1 << m_nBucketBits ) - 1;
+	int nBucket = getHome( nKey );
+	while ( pBuckets[ nBucket ].nFirst != -1 && pBuckets[ nBucket ].nKey != nKey ) {
+		nBucket = ( nBucket + 1 ) & nMask;
+	}
+	return nBucket;
+}
+
+void VoiceAllocator::eraseBucket( Group group, int nBucket )
+{
+	Bucket* pBuckets = m_buckets[ static_cast<int>( group ) ].get();
+	const int nMask = ( 1 << m_nBucketBits ) - 1;
+	int nHole = nBucket;
+	for ( int nNext = ( nHole + 1 ) & nMask; pBuckets[ nNext ].nFirst != -1;
+		  nNext = ( nNext + 1 ) & nMask ) {
+		// Entries may only move towards their home bucket.
+		const int nHome = getHome( pBuckets[ nNext ].nKey );
+		if ( ( ( nNext - nHome ) & nMask ) >= ( ( nNext - nHole ) & nMask ) ) {
+			pBuckets[ nHole ] = pBuckets[ nNext ];
+			nHole = nNext;
+		}
+	}
+	pBuckets[ nHole ] = { nNoKey, -1, -1 };
+}
+
+void VoiceAllocator::link( int nSlot )
+{
+	for ( int nGroup = 0; nGroup < nGroups; ++nGroup ) {
+		Link& link = m_slots[ nSlot ].links[ nGroup ];
+		link.nPrev = -1;
+		link.nNext = -1;
+		if ( link.nKey == nNoKey ) {
+			continue;
+		}
+		const Group group = static_cast<Group>( nGroup );
+		Bucket& bucket = m_buckets[ nGroup ][ findBucket( group, link.nKey ) ];
+		if ( bucket.nFirst == -1 ) {
+			bucket = { link.nKey, nSlot, nSlot };
+		} else {
+			link.nPrev = bucket.nLast;
+			m_slots[ bucket.nLast ].links[ nGroup ].nNext = nSlot;
+			bucket.nLast = nSlot;
+		}
+	}
+}
+
+void VoiceAllocator::unlink( int nSlot )
+{
+	for ( int nGroup = 0; nGroup < nGroups; ++nGroup ) {
+		const Link& link = m_slots[ nSlot ].links[ nGroup ];
+		if ( link.nKey == nNoKey ) {
+			continue;
+		}
+		const Group group = static_cast<Group>( nGroup );
+		const int nBucket = findBucket( group, link.nKey );
+		Bucket& bucket = m_buckets[ nGroup ][ nBucket ];
+		if ( link.nPrev != -1 ) {
+			m_slots[ link.nPrev ].links[ nGroup ].nNext = link.nNext;
+		} else {
+			bucket.nFirst = link.nNext;
+		}
+		if ( link.nNext != -1 ) {
+			m_slots[ link.nNext ].links[ nGroup ].nPrev = link.nPrev;
+		} else {
+			bucket.nLast = link.nPrev;
+		}
+		if ( bucket.nFirst == -1 ) {
+			eraseBucket( group, nBucket );
+		}
+	}
+}
+
+VoiceAllocator::Stats VoiceAllocator::getStats() const
+{
+	return { m_nStolen.load( std::memory_order_relaxed ),
+			 m_nDropped.load( std::memory_order_relaxed ) };
+}
+
+QString VoiceAllocator::toQString( const QString& sPrefix, bool bShort ) const {
+	const auto stats = getStats();
+	QString s = Base::sPrintIndention;
+	QString sOutput;
+	if ( ! bShort ) {
+		sOutput = QString( "%1[VoiceAllocator]\n" ).arg( sPrefix )
+			.append( QString( "%1%2capacity: %3\n" ).arg( sPrefix ).arg( s ).arg( m_nCapacity ) )
+			.append( QString( "%1%2voices: %3\n" ).arg( sPrefix ).arg( s ).arg( m_nVoices ) )
+			.append( QString( "%1%2sounding: %3\n" ).arg( sPrefix ).arg( s ).arg( m_nSounding ) )
+			.append( QString( "%1%2stolen: %3\n" ).arg( sPrefix ).arg( s ).arg( stats.nStolen ) )
+			.append( QString( "%1%2dropped: %3\n" ).arg( sPrefix ).arg( s ).arg( stats.nDropped ) );
+	} else {
+		sOutput = QString( "[VoiceAllocator]" )
+			.append( QString( " capacity: %1" ).arg( m_nCapacity ) )
+			.append( QString( ", voices: %1" ).arg( m_nVoices ) )
+			.append( QString( ", sounding: %1" ).arg( m_nSounding ) )
+			.append( QString( ", stolen: %1" ).arg( stats.nStolen ) )
+			.append( QString( ", dropped: %1" ).arg( stats.nDropped ) );
+	}
+	return sOutput;
+}
+
+};
@@ -0,0 +1,311 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+
+#ifndef H2C_VOICE_ALLOCATOR_H
+#define H2C_VOICE_ALLOCATOR_H
+
+#include <core/Object.h>
+#include <core/Preferences/Preferences.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace H2Core
+{
+
+class Instrument;
+class Note;
+
+/**
+ * Notes played by the Sampler.
+ *
+ * All voices are allocated on construction. add() takes a slot from
+ * a free list and appends it to the list of playing voices, which is
+ * kept in the order the notes were started. The Sampler prepares
+ * the notes in this order, which involves random numbers and the
+ * round robin state of the song, and therefore removes finished
+ * voices in a single pass per period using removeIf().
+ *
+ * Once more than Preferences::m_nMaxNotes notes or more than
+ * Instrument::get_max_voices() notes of an instrument would play at
+ * the same time, a voice is stolen according to
+ * Preferences::m_voiceStealing. Instead of being cut, its envelope
+ * fades out within #nFadeFrames frames (see ADSR::fade_out()) and it
+ * is removed afterwards. Stolen voices do not count towards either
+ * limit.
+ *
+ * Besides their order, voices are linked in lists of all voices
+ * sharing the same instrument, mute group, or MIDI key. The lists
+ * are found via hash tables allocated on construction as well. This
+ * way choking a mute group or releasing the notes of an instrument
+ * only touches the voices concerned.
+ *
+ * Only accessed by the audio thread, apart from getStats().
+ *
+ * \ingroup docCore docAudioEngine
+ */
+class VoiceAllocator : public H2Core::Object<VoiceAllocator>
+{
+	H2_OBJECT(VoiceAllocator)
+public:
+	using Policy = Preferences::VoiceStealing;
+
+	struct Stats {
+		/** Number of voices faded out to make room for new notes.*/
+		long long nStolen;
+		/** Number of voices cut since all of them were in use.*/
+		long long nDropped;
+	};
+
+	/**
+	 * \param nCapacity Maximum number of voices, including the ones
+	 * fading out.
+	 */
+	explicit VoiceAllocator( int nCapacity );
+
+	VoiceAllocator( const VoiceAllocator& ) = delete;
+	VoiceAllocator& operator=( const VoiceAllocator& ) = delete;
+
+	/**
+	 * Adds @a pNote as the newest voice. Voices are stolen in case
+	 * the instrument of @a pNote or all voices reached their limit.
+	 *
+	 * \param pNote Note to play.
+	 * \param nMaxVoices Maximum number of voices not fading out.
+	 * Bound by the capacity.
+	 * \param policy Selects the voices to steal.
+	 *
+	 * \return Note of a voice removed right away since all voices
+	 * were in use or nullptr. It has to be destroyed by the caller.
+	 */
+	Note* add( Note* pNote, int nMaxVoices, Policy policy );
+	/** Steals voices till no more than @a nMaxVoices are left which
+	 * do not fade out. Used after the limit was lowered.*/
+	void limit( int nMaxVoices, Policy policy );
+	/** Advances the fades of all stolen voices by @a nFrames.*/
+	void advance( int nFrames );
+	/**
+	 * Removes all voices for which @a predicate returns true while
+	 * keeping the order of the others.
+	 *
+	 * @a predicate is called once for each voice in order with its
+	 * index, its note, and whether it was stolen and completed its
+	 * fade.
+	 */
+	template <typename Function>
+	void removeIf( Function&& predicate );
+	/** Removes all voices without destroying their notes.*/
+	void clear();
+
+	/**
+	 * Calls @a function with the note of each voice of @a
+	 * pInstrument, including the ones fading out, in the order they
+	 * were started. @a function must neither add nor remove voices.
+	 */
+	template <typename Function>
+	void visitInstrument( const Instrument* pInstrument, Function&& function ) const;
+	/** Like visitInstrument() for all voices whose instrument was
+	 * part of mute group @a nMuteGroup at the time they were
+	 * added.*/
+	template <typename Function>
+	void visitMuteGroup( int nMuteGroup, Function&& function ) const;
+	/** Like visitInstrument() for all voices whose note carries the
+	 * MIDI key @a nKey (see Note::get_midi_msg()).*/
+	template <typename Function>
+	void visitMidiKey( int nKey, Function&& function ) const;
+	/** \return Whether any voice plays @a pInstrument.*/
+	bool containsInstrument( const Instrument* pInstrument ) const;
+
+	/** \return Number of voices, including the ones fading out.*/
+	int size() const;
+	/** \return Number of voices not fading out.*/
+	int getSounding() const;
+	int getCapacity() const;
+	/** \return Note of the @a nVoice th voice in the order they were
+	 * started.*/
+	Note* getNote( int nVoice ) const;
+	/** \return Whether the @a nVoice th voice is fading out.*/
+	bool isStolen( int nVoice ) const;
+
+	Stats getStats() const;
+
+	/** Number of voices used by the Sampler. Matches the largest
+	 * value of Preferences::m_nMaxNotes offered by the
+	 * PreferencesDialog.*/
+	static constexpr int nDefaultCapacity = 512;
+	/** Length of the fade applied to stolen voices. The shortest
+	 * release supported by the ADSR.*/
+	static constexpr int nFadeFrames = 256;
+
+	QString toQString( const QString& sPrefix, bool bShort = true ) const override;
+
+private:
+	/** Properties voices are grouped by.*/
+	enum class Group {
+		instrument = 0,
+		muteGroup = 1,
+		midiKey = 2
+	};
+	static constexpr int nGroups = 3;
+	/** Key of voices not being part of any list of a group.*/
+	static constexpr intptr_t nNoKey = -1;
+
+	/** Membership of a slot in the list of its key.*/
+	struct Link {
+		intptr_t nKey;
+		int nPrev;
+		int nNext;
+	};
+	struct Slot {
+		Note* pNote;
+		/** Frames left to fade out or -1 if the voice was not
+		 * stolen.*/
+		int nFadeFrames;
+		Link links[ nGroups ];
+	};
+	/** Entry of a hash table. Unused if nFirst is -1.*/
+	struct Bucket {
+		intptr_t nKey;
+		int nFirst;
+		int nLast;
+	};
+
+	/**
+	 * \param pInstrument Only consider voices of this instrument.
+	 * nullptr considers all voices.
+	 *
+	 * \return Slot of the voice to steal or -1 if all considered
+	 * voices are fading out already.
+	 */
+	int findVictim( Policy policy, const Instrument* pInstrument ) const;
+	void steal( int nSlot );
+	/** Removes the voice closest to finish its fade.
+	 * \return Its note.*/
+	Note* drop();
+
+	static intptr_t getKey( Group group, const Note* pNote );
+	static intptr_t getKey( const Instrument* pInstrument );
+	int getHome( intptr_t nKey ) const;
+	/** \return Bucket holding @a nKey or the unused one it would be
+	 * inserted in.*/
+	int findBucket( Group group, intptr_t nKey ) const;
+	/** Frees @a nBucket and moves following entries to keep all of
+	 * them reachable from their home bucket.*/
+	void eraseBucket( Group group, int nBucket );
+	/** Appends @a nSlot to the lists of the keys stored in its
+	 * links.*/
+	void link( int nSlot );
+	void unlink( int nSlot );
+	/** Calls @a function with each slot in the list of @a nKey.*/
+	template <typename Function>
+	void visitSlots( Group group, intptr_t nKey, Function&& function ) const;
+
+	std::unique_ptr<Slot[]> m_slots;
+	/** Stack of unused slot indices.*/
+	std::unique_ptr<int[]> m_freeSlots;
+	int m_nFreeSlots;
+	/** Slot indices of all voices in the order they were started.*/
+	std::unique_ptr<int[]> m_voices;
+	int m_nVoices;
+	int m_nCapacity;
+	int m_nSounding;
+	/** Hash table of each Group mapping keys to the first and last
+	 * slot of their list. Using linear probing and holding more than
+	 * twice the capacity, it is never full.*/
+	std::unique_ptr<Bucket[]> m_buckets[ nGroups ];
+	int m_nBucketBits;
+
+	std::atomic<long long> m_nStolen;
+	std::atomic<long long> m_nDropped;
+};
+
+template <typename Function>
+inline void VoiceAllocator::removeIf( Function&& predicate ) {
+	int nKept = 0;
+	for ( int nVoice = 0; nVoice < m_nVoices; ++nVoice ) {
+		const int nSlot = m_voices[ nVoice ];
+		const Slot& slot = m_slots[ nSlot ];
+		if ( predicate( nVoice, slot.pNote, slot.nFadeFrames == 0 ) ) {
+			if ( slot.nFadeFrames < 0 ) {
+				--m_nSounding;
+			}
+			unlink( nSlot );
+			m_freeSlots[ m_nFreeSlots++ ] = nSlot;
+		} else {
+			m_voices[ nKept++ ] = nSlot;
+		}
+	}
+	m_nVoices = nKept;
+}
+
+template <typename Function>
+inline void VoiceAllocator::visitSlots( Group group, intptr_t nKey, Function&& function ) const {
+	if ( nKey == nNoKey ) {
+		return;
+	}
+	const int nGroup = static_cast<int>( group );
+	const Bucket& bucket = m_buckets[ nGroup ][ findBucket( group, nKey ) ];
+	if ( bucket.nFirst == -1 ) {
+		return;
+	}
+	for ( int nSlot = bucket.nFirst; nSlot != -1; nSlot = m_slots[ nSlot ].links[ nGroup ].nNext ) {
+		function( nSlot );
+	}
+}
+
+template <typename Function>
+inline void VoiceAllocator::visitInstrument( const Instrument* pInstrument, Function&& function ) const {
+	visitSlots( Group::instrument, getKey( pInstrument ),
+				[&]( int nSlot ) { function( m_slots[ nSlot ].pNote ); } );
+}
+template <typename Function>
+inline void VoiceAllocator::visitMuteGroup( int nMuteGroup, Function&& function ) const {
+	visitSlots( Group::muteGroup, nMuteGroup,
+				[&]( int nSlot ) { function( m_slots[ nSlot ].pNote ); } );
+}
+template <typename Function>
+inline void VoiceAllocator::visitMidiKey( int nKey, Function&& function ) const {
+	visitSlots( Group::midiKey, nKey,
+				[&]( int nSlot ) { function( m_slots[ nSlot ].pNote ); } );
+}
+
+inline int VoiceAllocator::size() const {
+	return m_nVoices;
+}
+inline int VoiceAllocator::getSounding() const {
+	return m_nSounding;
+}
+inline int VoiceAllocator::getCapacity() const {
+	return m_nCapacity;
+}
+inline Note* VoiceAllocator::getNote( int nVoice ) const {
+	return m_slots[ m_voices[ nVoice ] ].pNote;
+}
+inline bool VoiceAllocator::isStolen( int nVoice ) const {
+	return m_slots[ m_voices[ nVoice ] ].nFadeFrames >= 0;
+}
+
+};
+
+#endif // H2C_VOICE_ALLOCATOR_H
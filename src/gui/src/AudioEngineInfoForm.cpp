@@ -34,6 +34,7 @@
 #include <core/Hydrogen.h>
 #include <core/IO/MidiInput.h>
 #include <core/IO/AudioOutput.h>
+#include <core/Sampler/DiskStreamer.h>
 #include <core/Sampler/Sampler.h>
 #include <core/AudioEngine/AudioEngine.h>
 using namespace H2Core;
@@ -47,6 +48,7 @@ AudioEngineInfoForm::AudioEngineInfoForm(QWidget* parent)
 	setFixedSize( width(), height() );	// not resizable
 
 	setWindowTitle( tr( "Audio Engine Info" ) );
+	m_pDspProfileLbl->setFont( QFontDatabase::systemFont( QFontDatabase::FixedFont ) );
 
 	updateInfo();
 
@@ -111,6 +113,9 @@ void AudioEngineInfoForm::updateInfo()
 	sprintf(tmp, "%#.2f / %#.2f  (%d%%)", pAudioEngine->getProcessTime(), pAudioEngine->getMaxProcessTime(), perc );
 	processTimeLbl->setText(tmp);
 
+	// Periods dropped because the audio engine was locked
+	skippedPeriodsLbl->setText( QString::number( pAudioEngine->getSkippedPeriods() ) );
+
 	// Song state
 	if (pSong == nullptr) {
 		songStateLbl->setText( "NULL song" );
@@ -200,10 +205,60 @@ void AudioEngineInfoForm::updateInfo()
 	// SAMPLER
 	Sampler *pSampler = pAudioEngine->getSampler();
 	sampler_playingNotesLbl->setText(QString( "%1 / %2" ).arg(pSampler->getPlayingNotesNumber()).arg(Preferences::get_instance()->m_nMaxNotes));
+	NotePool *pNotePool = pAudioEngine->getNotePool();
+	sampler_notePoolLbl->setText( QString( "%1 / %2 (%3 exhausted)" )
+								  .arg( pNotePool->getUsed() )
+								  .arg( pNotePool->getCapacity() )
+								  .arg( pNotePool->getExhaustedCount() ) );
+	DiskStreamer *pDiskStreamer = pSampler->getDiskStreamer();
+	if ( pDiskStreamer != nullptr ) {
+		const auto stats = pDiskStreamer->getStats();
+		sampler_diskStreamingLbl->setText( QString( "%1 / %2 (%3 starved)" )
+										   .arg( stats.nActiveStreams )
+										   .arg( stats.nStreams )
+										   .arg( stats.nStarvations ) );
+	} else {
+		sampler_diskStreamingLbl->setText( "off" );
+	}
 
 	// Synth
 	Synth *pSynth = pAudioEngine->getSynth();
 	synth_playingNotesLbl->setText( QString( "%1" ).arg( pSynth->getPlayingNotesNumber() ) );
+
+	// DSP profile
+	DspProfiler *pProfiler = pAudioEngine->getProfiler();
+	m_pDspProfileLbl->setText( pProfiler->toTable() +
+							   QString( "\nLost records: %1" ).arg( pProfiler->getLostRecords() ) );
+}
+
+void AudioEngineInfoForm::on_m_pDspProfileResetBtn_clicked()
+{
+	Hydrogen::get_instance()->getAudioEngine()->getProfiler()->reset();
+	updateInfo();
+}
+
+void AudioEngineInfoForm::on_m_pDspProfileTraceBtn_clicked()
+{
+	QFileDialog fd( this );
+	fd.setFileMode( QFileDialog::AnyFile );
+	fd.setNameFilter( tr( "Chrome trace (*.json)" ) );
+	fd.setDirectory( QDir::homePath() );
+	fd.setWindowTitle( tr( "Save DSP trace" ) );
+	fd.setAcceptMode( QFileDialog::AcceptSave );
+	fd.selectFile( "hydrogen-trace.json" );
+
+	if ( fd.exec() != QDialog::Accepted || fd.selectedFiles().isEmpty() ) {
+		return;
+	}
+
+	QString sFilename = fd.selectedFiles().first();
+	if ( ! sFilename.endsWith( ".json" ) ) {
+		sFilename += ".json";
+	}
+
+	if ( ! Hydrogen::get_instance()->getAudioEngine()->getProfiler()->dumpChromeTrace( sFilename ) ) {
+		QMessageBox::warning( this, "Hydrogen", tr( "Unable to write %1" ).arg( sFilename ) );
+	}
 }
 
 
@@ -59,6 +59,10 @@ class AudioEngineInfoForm :  public QWidget, public Ui_AudioEngineInfoForm_UI, p
 	public slots:
 		void updateInfo();
 
+	private slots:
+		void on_m_pDspProfileResetBtn_clicked();
+		void on_m_pDspProfileTraceBtn_clicked();
+
 	private:
 		void updateAudioEngineState();
 };
@@ -685,6 +685,8 @@ void HydrogenApp::onEventQueueTimer()
 
 	}
 
+	Hydrogen::get_instance()->releaseRetiredInstruments();
+
 	// midi notes
 	while( !pQueue->m_addMidiNoteVector.empty() ){
 		std::shared_ptr<Song> pSong = Hydrogen::get_instance()->getSong();
@@ -882,6 +884,11 @@ void HydrogenApp::updateSongEvent( int nValue ) {
 		// probably better to avoid displaying its path just to be
 		// sure.
 		QMessageBox::information( m_pMainForm, "Hydrogen", tr("Song is read-only.\nUse 'Save as' to enable autosave." ) );
+	} else if ( nValue == 3 ) {
+
+		// Samples were stretched to a new tempo by a thread of the
+		// SampleStretcher.
+		pHydrogen->setIsModified( true );
 	}
 }
 
@@ -280,9 +280,9 @@ void LayerPreview::mousePressEvent(QMouseEvent *ev)
 	if ( ev->y() < 20 ) {
 		float fVelocity = (float)ev->x() / (float)width();
 
-		Note * pNote = new Note( m_pInstrument, nPosition, fVelocity, fPan, nLength, fPitch );
+		Note * pNote = Hydrogen::get_instance()->getAudioEngine()->getNotePool()->acquire( m_pInstrument, nPosition, fVelocity, fPan, nLength, fPitch );
 		pNote->set_specific_compo_id( m_nSelectedComponent );
-		Hydrogen::get_instance()->getAudioEngine()->getSampler()->noteOn(pNote);
+		Hydrogen::get_instance()->getAudioEngine()->samplerNoteOn( pNote );
 		
 		for ( int i = 0; i < InstrumentComponent::getMaxLayers(); i++ ) {
 			auto pCompo = m_pInstrument->get_component(m_nSelectedComponent);
@@ -311,9 +311,9 @@ void LayerPreview::mousePressEvent(QMouseEvent *ev)
 		if(pCompo) {
 			auto pLayer = pCompo->get_layer( m_nSelectedLayer );
 			if ( pLayer ) {
-				Note *note = new Note( m_pInstrument , nPosition, m_pInstrument->get_component(m_nSelectedComponent)->get_layer( m_nSelectedLayer )->get_end_velocity() - 0.01, fPan, nLength, fPitch );
+				Note *note = Hydrogen::get_instance()->getAudioEngine()->getNotePool()->acquire( m_pInstrument , nPosition, m_pInstrument->get_component(m_nSelectedComponent)->get_layer( m_nSelectedLayer )->get_end_velocity() - 0.01, fPan, nLength, fPitch );
 				note->set_specific_compo_id( m_nSelectedComponent );
-				Hydrogen::get_instance()->getAudioEngine()->getSampler()->noteOn(note);
+				Hydrogen::get_instance()->getAudioEngine()->samplerNoteOn( note );
 				
 				int x1 = (int)( pLayer->get_start_velocity() * width() );
 				int x2 = (int)( pLayer->get_end_velocity() * width() );
@@ -305,8 +305,8 @@ void Mixer::noteOnClicked( MixerLine* ref )
 	auto pInstr = Hydrogen::get_instance()->getSong()->getInstrumentList()->get( nLine );
 	
 	const float fPitch = pInstr->get_pitch_offset();
-	Note *pNote = new Note( pInstr, 0, 1.0, 0.f, -1, fPitch );
-	pHydrogen->getAudioEngine()->getSampler()->noteOn(pNote);
+	Note *pNote = pHydrogen->getAudioEngine()->getNotePool()->acquire( pInstr, 0, 1.0, 0.f, -1, fPitch );
+	pHydrogen->getAudioEngine()->samplerNoteOn( pNote );
 }
 
 
@@ -323,8 +323,8 @@ void Mixer::noteOnClicked( MixerLine* ref )
 	auto pInstr = Hydrogen::get_instance()->getSong()->getInstrumentList()->get( nLine );
 
 	const float fPitch = 0.0f;
-	Note *pNote = new Note( pInstr, 0, 1.0, 0.f,-1, fPitch );
-	pHydrogen->getAudioEngine()->getSampler()->noteOff(pNote);
+	Note *pNote = pHydrogen->getAudioEngine()->getNotePool()->acquire( pInstr, 0, 1.0, 0.f,-1, fPitch );
+	pHydrogen->getAudioEngine()->samplerNoteOff( pNote );
 }
 
 
@@ -348,8 +348,8 @@ void DrumPatternEditor::addOrDeleteNoteAction(	int nColumn,
 		// hear note
 		if ( listen && !isNoteOff ) {
 			fPitch = pSelectedInstrument->get_pitch_offset();
-			Note *pNote2 = new Note( pSelectedInstrument, 0, fVelocity, fPan, nLength, fPitch);
-			m_pAudioEngine->getSampler()->noteOn(pNote2);
+			Note *pNote2 = m_pAudioEngine->getNotePool()->acquire( pSelectedInstrument, 0, fVelocity, fPan, nLength, fPitch);
+			m_pAudioEngine->samplerNoteOn( pNote2 );
 		}
 	}
 	pHydrogen->setIsModified( true );
@@ -230,8 +230,8 @@ void InstrumentLine::mousePressEvent(QMouseEvent *ev)
 		auto pInstr = pSong->getInstrumentList()->get( m_nInstrumentNumber );
 		const float fPitch = pInstr->get_pitch_offset();
 
-		Note *pNote = new Note( pInstr, 0, velocity, fPan, nLength, fPitch);
-		Hydrogen::get_instance()->getAudioEngine()->getSampler()->noteOn(pNote);
+		Note *pNote = Hydrogen::get_instance()->getAudioEngine()->getNotePool()->acquire( pInstr, 0, velocity, fPan, nLength, fPitch);
+		Hydrogen::get_instance()->getAudioEngine()->samplerNoteOn( pNote );
 	}
 	else if (ev->button() == Qt::RightButton ) {
 		m_pFunctionPopup->popup( QPoint( ev->globalX(), ev->globalY() ) );
@@ -406,9 +406,9 @@ void PianoRollEditor::addOrRemoveNote( int nColumn, int nRealColumn, int nLine,
 		Preferences *pref = Preferences::get_instance();
 		if ( pref->getHearNewNotes() ) {
 			const float fPitch = pSelectedInstrument->get_pitch_offset();
-			Note *pNote2 = new Note( pSelectedInstrument, 0, fVelocity, fPan, nLength, fPitch );
+			Note *pNote2 = m_pAudioEngine->getNotePool()->acquire( pSelectedInstrument, 0, fVelocity, fPan, nLength, fPitch );
 			pNote2->set_key_octave( notekey, octave );
-			m_pAudioEngine->getSampler()->noteOn( pNote2 );
+			m_pAudioEngine->samplerNoteOn( pNote2 );
 		}
 	}
 
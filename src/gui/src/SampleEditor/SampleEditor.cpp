@@ -566,9 +566,9 @@ void SampleEditor::on_PlayPushButton_clicked()
 	if ( pInstr == nullptr ) {
 		return;
 	}
-	Note *pNote = new Note( pInstr, 0, pInstr->get_component( m_nSelectedComponent )->get_layer( selectedLayer )->get_end_velocity() - 0.01, fPan, nLength, fPitch);
+	Note *pNote = pAudioEngine->getNotePool()->acquire( pInstr, 0, pInstr->get_component( m_nSelectedComponent )->get_layer( selectedLayer )->get_end_velocity() - 0.01, fPan, nLength, fPitch);
 	pNote->set_specific_compo_id( m_nSelectedComponent );
-	pHydrogen->getAudioEngine()->getSampler()->noteOn(pNote);
+	pHydrogen->getAudioEngine()->samplerNoteOn( pNote );
 
 	setSamplelengthFrames();
 	createPositionsRulerPath();
@@ -73,3 +73,31 @@ void ADSRTest::testRelease()
 	/* Idle */
 	CPPUNIT_ASSERT_DOUBLES_EQUAL( 0.0, m_adsr->get_value( 2.0 ), delta );
 }
+
+
+void ADSRTest::testGetValues()
+{
+	auto pReference = std::make_shared<ADSR>( 100, 300, 0.5, 1000 );
+	auto pBlock = std::make_shared<ADSR>( 100, 300, 0.5, 1000 );
+	pReference->attack();
+	pBlock->attack();
+
+	float values[ 64 ];
+	for ( int nPeriod = 0; nPeriod < 64; ++nPeriod ) {
+		if ( nPeriod == 20 ) {
+			/* Release during sustain */
+			CPPUNIT_ASSERT_DOUBLES_EQUAL( pReference->release(), pBlock->release(), delta );
+		}
+
+		/* Periods of varying size crossing the segment boundaries */
+		const int nFrames = 1 + ( nPeriod * 37 ) % 64;
+		pBlock->get_values( 1.0, values, nFrames );
+		for ( int ii = 0; ii < nFrames; ++ii ) {
+			CPPUNIT_ASSERT_DOUBLES_EQUAL( pReference->get_value( 1.0 ), values[ ii ], delta );
+		}
+	}
+
+	/* Idle */
+	CPPUNIT_ASSERT_DOUBLES_EQUAL( 0.0, pBlock->release(), delta );
+	CPPUNIT_ASSERT_DOUBLES_EQUAL( 0.0, values[ 0 ], delta );
+}
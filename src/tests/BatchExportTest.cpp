@@ -0,0 +1,118 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "TestHelper.h"
+
+#include <cli/BatchExport.h>
+#include <core/Basics/SampleCache.h>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+using namespace H2Core;
+
+class BatchExportTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( BatchExportTest );
+	CPPUNIT_TEST( testSummary );
+	CPPUNIT_TEST_SUITE_END();
+
+	QTemporaryDir m_tmpDir;
+
+	BatchExport::Options options() const
+	{
+		BatchExport::Options options;
+		options.sOutputDir = m_tmpDir.path();
+		options.sFormat = "wav";
+		options.nSampleRate = 44100;
+		options.nSampleDepth = 16;
+		options.bExportStems = false;
+		options.bDeterministic = true;
+		options.nJobs = 1;
+		return options;
+	}
+
+	/** Writes a batch list containing @a songs to @a sName and
+	 * exports it. \return number of files decoded in the process.*/
+	long long exportList( const QString& sName, const QStringList& songs )
+	{
+		const QString sList = m_tmpDir.filePath( sName + ".lst" );
+		QFile file( sList );
+		CPPUNIT_ASSERT( file.open( QIODevice::WriteOnly | QIODevice::Text ) );
+		QTextStream stream( &file );
+		for ( const auto& sSong : songs ) {
+			stream << H2TEST_FILE( sSong ) << '\n';
+		}
+		file.close();
+
+		SampleCache::get_instance()->clear();
+		BatchExport batchExport( options() );
+		CPPUNIT_ASSERT( batchExport.loadList( sList ) );
+		CPPUNIT_ASSERT_EQUAL( songs.size(), batchExport.size() );
+		const QJsonArray summary = batchExport.exportSongs( nullptr );
+		CPPUNIT_ASSERT( BatchExport::writeSummary(
+							summary, BatchExport::defaultSummaryPath( sList ) ) );
+		return SampleCache::get_instance()->getStats().nMisses;
+	}
+
+public:
+	void testSummary()
+	{
+		CPPUNIT_ASSERT( m_tmpDir.isValid() );
+
+		// Both songs use the GMRockKit.
+		const QStringList songs = { "functional/test.h2song",
+									"functional/velocityautomation.h2song" };
+		const long long nSingleMisses = exportList( "single", { songs[ 0 ] } );
+		const long long nBatchMisses = exportList( "batch", songs );
+
+		// The second song uses the samples decoded for the first one.
+		CPPUNIT_ASSERT_EQUAL( nSingleMisses, nBatchMisses );
+
+		QFile summaryFile( m_tmpDir.filePath( "batch.summary.json" ) );
+		CPPUNIT_ASSERT( summaryFile.open( QIODevice::ReadOnly ) );
+		const QJsonArray summary = QJsonDocument::fromJson( summaryFile.readAll() ).array();
+		CPPUNIT_ASSERT_EQUAL( 2, summary.size() );
+		CPPUNIT_ASSERT( BatchExport::allSucceeded( summary ) );
+
+		for ( int ii = 0; ii < summary.size(); ++ii ) {
+			const QJsonObject entry = summary[ ii ].toObject();
+			CPPUNIT_ASSERT( entry[ "song" ].toString() == H2TEST_FILE( songs[ ii ] ) );
+			CPPUNIT_ASSERT( entry[ "drumkit" ].toString() == "GMRockKit" );
+			CPPUNIT_ASSERT( entry[ "duration" ].toDouble() > 0 );
+			CPPUNIT_ASSERT( entry[ "peak" ].toDouble() > 0 );
+
+			const QFileInfo output( entry[ "output" ].toString() );
+			CPPUNIT_ASSERT( output.exists() );
+			CPPUNIT_ASSERT( output.size() > 0 );
+			CPPUNIT_ASSERT( output.fileName() ==
+							QFileInfo( songs[ ii ] ).completeBaseName() + ".wav" );
+		}
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( BatchExportTest );
@@ -0,0 +1,133 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "TestHelper.h"
+
+#include <core/Basics/Sample.h>
+#include <core/Basics/SampleCache.h>
+#include <core/Preferences/Preferences.h>
+#include <core/Sampler/DiskStreamer.h>
+
+using namespace H2Core;
+
+class DiskStreamerTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( DiskStreamerTest );
+	CPPUNIT_TEST( testStreamedSample );
+	CPPUNIT_TEST( testStreaming );
+	CPPUNIT_TEST_SUITE_END();
+
+	bool m_bDiskStreaming;
+	int m_nStreamingHeadFrames;
+
+public:
+	void setUp() override
+	{
+		auto pPref = Preferences::get_instance();
+		m_bDiskStreaming = pPref->m_bDiskStreaming;
+		m_nStreamingHeadFrames = pPref->m_nStreamingHeadFrames;
+		pPref->m_bDiskStreaming = true;
+		pPref->m_nStreamingHeadFrames = 1000;
+		SampleCache::get_instance()->clear();
+	}
+
+	void tearDown() override
+	{
+		auto pPref = Preferences::get_instance();
+		pPref->m_bDiskStreaming = m_bDiskStreaming;
+		pPref->m_nStreamingHeadFrames = m_nStreamingHeadFrames;
+		SampleCache::get_instance()->clear();
+	}
+
+	void testStreamedSample()
+	{
+		const QString sPath = H2TEST_FILE( "drumkits/baseKit/crash.wav" );
+		auto pStreamed = std::make_shared<Sample>( sPath );
+		CPPUNIT_ASSERT( pStreamed->load( true ) );
+		CPPUNIT_ASSERT( pStreamed->is_streamed() );
+		CPPUNIT_ASSERT_EQUAL( 1000, pStreamed->get_resident_frames() );
+
+		// Loading the sample without streaming does not reuse the
+		// incomplete buffer.
+		auto pResident = Sample::load( sPath );
+		CPPUNIT_ASSERT( ! pResident->is_streamed() );
+		CPPUNIT_ASSERT_EQUAL( pResident->get_frames(), pStreamed->get_frames() );
+		CPPUNIT_ASSERT_EQUAL( pResident->get_frames(), pResident->get_resident_frames() );
+
+		// Accessing the data outside of the audio thread yields the
+		// whole sample.
+		for ( int ii = 0; ii < pResident->get_frames(); ++ii ) {
+			CPPUNIT_ASSERT_EQUAL( pResident->get_data_l()[ ii ], pStreamed->get_data_l()[ ii ] );
+		}
+	}
+
+	void testStreaming()
+	{
+		const QString sPath = H2TEST_FILE( "drumkits/baseKit/crash.wav" );
+		auto pStreamed = std::make_shared<Sample>( sPath );
+		CPPUNIT_ASSERT( pStreamed->load( true ) );
+		auto pResident = Sample::load( sPath );
+		const float* pExpected_L = pResident->get_data_l();
+		const float* pExpected_R = pResident->get_data_r();
+		const int nFrames = pResident->get_frames();
+		const int nHeadFrames = pStreamed->get_resident_frames();
+
+		// The ring buffer wraps around several times.
+		DiskStreamer diskStreamer( 1, DiskStreamer::nChunkFrames );
+		auto pStream = diskStreamer.open( pStreamed, nHeadFrames );
+		CPPUNIT_ASSERT( pStream != nullptr );
+		CPPUNIT_ASSERT( diskStreamer.open( pStreamed, nHeadFrames ) == nullptr );
+		CPPUNIT_ASSERT_EQUAL( 1LL, diskStreamer.getStats().nUnavailable );
+
+		bool bStarved = false;
+		const int nPeriod = 1024;
+		for ( int nPosition = 0; nPosition < nFrames; nPosition += nPeriod ) {
+			diskStreamer.waitFor( pStream );
+			pStreamed->visit_data( [&]( auto head_L, auto head_R ) {
+				auto data_L = pStream->getReader( head_L, 0, nHeadFrames, &bStarved );
+				auto data_R = pStream->getReader( head_R, 1, nHeadFrames, &bStarved );
+				for ( int ii = nPosition; ii < std::min( nPosition + nPeriod, nFrames ); ++ii ) {
+					CPPUNIT_ASSERT_EQUAL( pExpected_L[ ii ], data_L[ ii ] );
+					CPPUNIT_ASSERT_EQUAL( pExpected_R[ ii ], data_R[ ii ] );
+				}
+			} );
+			pStream->setReadFrame( nPosition + nPeriod );
+		}
+		CPPUNIT_ASSERT( ! bStarved );
+		CPPUNIT_ASSERT( pStream->isComplete() );
+
+		// Frames not read yet result in silence.
+		pStream->close();
+		pStream = nullptr;
+		while ( pStream == nullptr ) {
+			pStream = diskStreamer.open( pStreamed, nHeadFrames );
+		}
+		pStreamed->visit_data( [&]( auto head_L, auto head_R ) {
+			auto data_L = pStream->getReader( head_L, 0, nHeadFrames, &bStarved );
+			CPPUNIT_ASSERT_EQUAL( 0.0f, data_L[ nFrames - 1 ] );
+		} );
+		CPPUNIT_ASSERT( bStarved );
+		pStream->close();
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( DiskStreamerTest );
@@ -0,0 +1,110 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <core/AudioEngine/DspProfiler.h>
+#include <core/Helpers/Filesystem.h>
+
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+using namespace H2Core;
+
+class DspProfilerTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( DspProfilerTest );
+	CPPUNIT_TEST( testPercentiles );
+	CPPUNIT_TEST( testOverwrite );
+	CPPUNIT_TEST( testChromeTrace );
+	CPPUNIT_TEST_SUITE_END();
+
+	void testPercentiles()
+	{
+		DspProfiler profiler;
+
+		// Durations of 1 to 1000 microseconds.
+		int64_t nTime = 0;
+		for ( int ii = 1; ii <= 1000; ++ii ) {
+			profiler.record( DspProfiler::Sampler, nTime, nTime + ii * 1000 );
+			nTime += ii * 1000;
+		}
+
+		const auto stats = profiler.getStats( DspProfiler::Sampler );
+		CPPUNIT_ASSERT_EQUAL( 1000LL, stats.nCount );
+		CPPUNIT_ASSERT_DOUBLES_EQUAL( 1000.0, stats.fMax, 1e-3 );
+		// Buckets have a relative width of 1/32.
+		CPPUNIT_ASSERT_DOUBLES_EQUAL( 500.0, stats.fP50, 500.0 / 32 );
+		CPPUNIT_ASSERT_DOUBLES_EQUAL( 990.0, stats.fP99, 990.0 / 32 );
+		CPPUNIT_ASSERT( stats.fP50 <= stats.fP99 );
+		CPPUNIT_ASSERT( stats.fP99 <= stats.fMax );
+
+		CPPUNIT_ASSERT_EQUAL( 0LL, profiler.getStats( DspProfiler::Synth ).nCount );
+
+		profiler.reset();
+		CPPUNIT_ASSERT_EQUAL( 0LL, profiler.getStats( DspProfiler::Sampler ).nCount );
+	}
+
+	void testOverwrite()
+	{
+		DspProfiler profiler;
+
+		const int nRecords = DspProfiler::nRingSize + 100;
+		for ( int ii = 0; ii < nRecords; ++ii ) {
+			profiler.record( DspProfiler::Total, ii, ii + ( ii < 100 ? 1000000 : 1000 ) );
+		}
+
+		// Only the most recent records are kept.
+		const auto stats = profiler.getStats( DspProfiler::Total );
+		CPPUNIT_ASSERT_EQUAL( static_cast<long long>( DspProfiler::nRingSize - 1 ), stats.nCount );
+		CPPUNIT_ASSERT_DOUBLES_EQUAL( 1.0, stats.fMax, 1e-3 );
+		CPPUNIT_ASSERT_EQUAL( 101LL, profiler.getLostRecords() );
+	}
+
+	void testChromeTrace()
+	{
+		DspProfiler profiler;
+		profiler.record( DspProfiler::NoteQueue, 1000, 3000 );
+		profiler.record( DspProfiler::Ladspa + 1, 3000, 4000 );
+		profiler.record( DspProfiler::Total, 0, 5000 );
+
+		const QString sPath = Filesystem::tmp_file_path( "trace.json" );
+		CPPUNIT_ASSERT( profiler.dumpChromeTrace( sPath ) );
+
+		QFile file( sPath );
+		CPPUNIT_ASSERT( file.open( QIODevice::ReadOnly ) );
+		const auto doc = QJsonDocument::fromJson( file.readAll() );
+		const auto events = doc.object()[ "traceEvents" ].toArray();
+		CPPUNIT_ASSERT_EQUAL( 3, events.size() );
+
+		const auto noteQueue = events[ 0 ].toObject();
+		CPPUNIT_ASSERT( noteQueue[ "name" ].toString() == "note queue" );
+		CPPUNIT_ASSERT_DOUBLES_EQUAL( 1.0, noteQueue[ "ts" ].toDouble(), 1e-6 );
+		CPPUNIT_ASSERT_DOUBLES_EQUAL( 2.0, noteQueue[ "dur" ].toDouble(), 1e-6 );
+		CPPUNIT_ASSERT( events[ 1 ].toObject()[ "name" ].toString() == "ladspa 1" );
+		CPPUNIT_ASSERT_DOUBLES_EQUAL( 0.0, events[ 2 ].toObject()[ "ts" ].toDouble(), 1e-6 );
+
+		file.remove();
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( DspProfilerTest );
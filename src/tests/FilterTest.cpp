@@ -0,0 +1,202 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <core/Basics/Instrument.h>
+#include <core/Basics/Note.h>
+#include <core/Sampler/Filter.h>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace H2Core;
+
+class FilterTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( FilterTest );
+	CPPUNIT_TEST( testConstant );
+	CPPUNIT_TEST( testRamp );
+	CPPUNIT_TEST( testNote );
+	CPPUNIT_TEST_SUITE_END();
+
+	std::vector<float> createBuffer( int nFrames, unsigned nSeed )
+	{
+		std::mt19937 rng( nSeed );
+		std::uniform_real_distribution<float> dist( -1.0f, 1.0f );
+		std::vector<float> buffer( nFrames );
+		for ( auto& fValue : buffer ) {
+			fValue = dist( rng );
+		}
+		return buffer;
+	}
+
+	/** Per-frame filter using the coefficients of frame @a ii
+	 * returned by @a coefficients. */
+	template <typename Coefficients>
+	void filterPerFrame( std::vector<float>& buffer_L, std::vector<float>& buffer_R,
+						 Filter::State& state, Coefficients coefficients )
+	{
+		for ( int ii = 0; ii < buffer_L.size(); ++ii ) {
+			float fCutoff, fResonance;
+			coefficients( ii, &fCutoff, &fResonance );
+			state.fBandPass[ 0 ] = fResonance * state.fBandPass[ 0 ] +
+				fCutoff * ( buffer_L[ ii ] - state.fLowPass[ 0 ] );
+			state.fLowPass[ 0 ] += fCutoff * state.fBandPass[ 0 ];
+			state.fBandPass[ 1 ] = fResonance * state.fBandPass[ 1 ] +
+				fCutoff * ( buffer_R[ ii ] - state.fLowPass[ 1 ] );
+			state.fLowPass[ 1 ] += fCutoff * state.fBandPass[ 1 ];
+			buffer_L[ ii ] = state.fLowPass[ 0 ];
+			buffer_R[ ii ] = state.fLowPass[ 1 ];
+		}
+	}
+
+	void testConstant()
+	{
+		for ( int nFrames : { 0, 1, 3, 64, 257 } ) {
+			auto expected_L = createBuffer( nFrames, 1 );
+			auto expected_R = createBuffer( nFrames, 2 );
+			auto buffer_L = expected_L;
+			auto buffer_R = expected_R;
+
+			Filter::State expectedState = { { 0.1f, -0.2f }, { 0.3f, 0.f } };
+			Filter::State state = expectedState;
+			filterPerFrame( expected_L, expected_R, expectedState,
+							[]( int, float* pCutoff, float* pResonance ) {
+								*pCutoff = 0.4f;
+								*pResonance = 0.8f;
+							} );
+			Filter::lowPass( buffer_L.data(), buffer_R.data(), nFrames, state,
+							 0.4f, 0.4f, 0.8f, 0.8f );
+
+			for ( int ii = 0; ii < nFrames; ++ii ) {
+				CPPUNIT_ASSERT_EQUAL( expected_L[ ii ], buffer_L[ ii ] );
+				CPPUNIT_ASSERT_EQUAL( expected_R[ ii ], buffer_R[ ii ] );
+			}
+			for ( int nChannel = 0; nChannel < 2; ++nChannel ) {
+				CPPUNIT_ASSERT_EQUAL( expectedState.fBandPass[ nChannel ],
+									  state.fBandPass[ nChannel ] );
+				CPPUNIT_ASSERT_EQUAL( expectedState.fLowPass[ nChannel ],
+									  state.fLowPass[ nChannel ] );
+			}
+		}
+	}
+
+	void testRamp()
+	{
+		const int nFrames = 256;
+		const float fCutoffFrom = 0.9f, fCutoffTo = 0.1f;
+		const float fResonanceFrom = 0.2f, fResonanceTo = 0.6f;
+		auto expected_L = createBuffer( nFrames, 3 );
+		auto expected_R = createBuffer( nFrames, 4 );
+		auto buffer_L = expected_L;
+		auto buffer_R = expected_R;
+		auto stepped_L = expected_L;
+		auto stepped_R = expected_R;
+
+		// The coefficients reach their target with the last frame.
+		Filter::State expectedState = { { 0.f, 0.f }, { 0.f, 0.f } };
+		filterPerFrame( expected_L, expected_R, expectedState,
+						[&]( int ii, float* pCutoff, float* pResonance ) {
+							const float fRatio = static_cast<float>( ii + 1 ) / nFrames;
+							*pCutoff = fCutoffFrom + ( fCutoffTo - fCutoffFrom ) * fRatio;
+							*pResonance = fResonanceFrom + ( fResonanceTo - fResonanceFrom ) * fRatio;
+						} );
+		Filter::State state = { { 0.f, 0.f }, { 0.f, 0.f } };
+		Filter::lowPass( buffer_L.data(), buffer_R.data(), nFrames, state,
+						 fCutoffFrom, fCutoffTo, fResonanceFrom, fResonanceTo );
+		for ( int ii = 0; ii < nFrames; ++ii ) {
+			CPPUNIT_ASSERT_DOUBLES_EQUAL( expected_L[ ii ], buffer_L[ ii ], 1e-4 );
+			CPPUNIT_ASSERT_DOUBLES_EQUAL( expected_R[ ii ], buffer_R[ ii ], 1e-4 );
+		}
+
+		// Switching the coefficients right away yields a different
+		// result in the first frames.
+		Filter::State steppedState = { { 0.f, 0.f }, { 0.f, 0.f } };
+		Filter::lowPass( stepped_L.data(), stepped_R.data(), nFrames, steppedState,
+						 fCutoffTo, fCutoffTo, fResonanceTo, fResonanceTo );
+		float fDifference = 0;
+		for ( int ii = 0; ii < 16; ++ii ) {
+			fDifference += std::abs( stepped_L[ ii ] - buffer_L[ ii ] );
+		}
+		CPPUNIT_ASSERT( fDifference > 0.1f );
+	}
+
+	void testNote()
+	{
+		const int nFrames = 128;
+		auto pInstrument = std::make_shared<Instrument>( 1, "Snare", nullptr );
+		pInstrument->set_filter_active( true );
+		pInstrument->set_filter_cutoff( 0.5f );
+		pInstrument->set_filter_resonance( 0.3f );
+		Note blockNote( pInstrument, 0, 1.0f, 0.f, -1, 0 );
+
+		// Without a change of the parameters the block filter matches
+		// the per-frame one.
+		auto buffer_L = createBuffer( nFrames, 5 );
+		auto buffer_R = createBuffer( nFrames, 6 );
+		auto expected_L = buffer_L;
+		auto expected_R = buffer_R;
+		Filter::State expectedState = { { 0.f, 0.f }, { 0.f, 0.f } };
+		filterPerFrame( expected_L, expected_R, expectedState,
+						[]( int, float* pCutoff, float* pResonance ) {
+							*pCutoff = 0.5f;
+							*pResonance = 0.3f;
+						} );
+		blockNote.apply_filter( buffer_L.data(), buffer_R.data(), nFrames );
+		for ( int ii = 0; ii < nFrames; ++ii ) {
+			CPPUNIT_ASSERT_EQUAL( expected_L[ ii ], buffer_L[ ii ] );
+			CPPUNIT_ASSERT_EQUAL( expected_R[ ii ], buffer_R[ ii ] );
+		}
+		CPPUNIT_ASSERT_EQUAL( 0.5f, blockNote.get_cut_off() );
+		CPPUNIT_ASSERT_EQUAL( 0.3f, blockNote.get_resonance() );
+
+		// A change, e.g. by MIDI CC, is ramped over the next block.
+		pInstrument->set_filter_cutoff( 0.1f );
+		Filter::State state = { { blockNote.get_bpfb_l(), blockNote.get_bpfb_r() },
+								{ blockNote.get_lpfb_l(), blockNote.get_lpfb_r() } };
+		auto ramped_L = createBuffer( nFrames, 7 );
+		auto ramped_R = createBuffer( nFrames, 8 );
+		buffer_L = ramped_L;
+		buffer_R = ramped_R;
+		Filter::lowPass( ramped_L.data(), ramped_R.data(), nFrames, state,
+						 0.5f, 0.1f, 0.3f, 0.3f );
+		blockNote.apply_filter( buffer_L.data(), buffer_R.data(), nFrames );
+		for ( int ii = 0; ii < nFrames; ++ii ) {
+			CPPUNIT_ASSERT_EQUAL( ramped_L[ ii ], buffer_L[ ii ] );
+			CPPUNIT_ASSERT_EQUAL( ramped_R[ ii ], buffer_R[ ii ] );
+		}
+		CPPUNIT_ASSERT_EQUAL( 0.1f, blockNote.get_cut_off() );
+		CPPUNIT_ASSERT_EQUAL( state.fLowPass[ 0 ], blockNote.get_lpfb_l() );
+		CPPUNIT_ASSERT_EQUAL( state.fBandPass[ 1 ], blockNote.get_bpfb_r() );
+
+		// Copies start without a ramp.
+		Note copy( &blockNote, nullptr );
+		pInstrument->set_filter_cutoff( 0.7f );
+		buffer_L = createBuffer( 1, 9 );
+		buffer_R = createBuffer( 1, 10 );
+		copy.apply_filter( buffer_L.data(), buffer_R.data(), 1 );
+		CPPUNIT_ASSERT_EQUAL( 0.7f, copy.get_cut_off() );
+	}
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( FilterTest );
@@ -41,12 +41,17 @@
 #include <core/Basics/Song.h>
 #include <core/Basics/Playlist.h>
 #include <core/Smf/SMF.h>
+#include <core/AudioEngine/OfflineRenderer.h>
 #include "TestHelper.h"
 #include "assertions/File.h"
 #include "assertions/AudioFile.h"
 
 #include <chrono>
+#include <cmath>
 #include <memory>
+#include <set>
+
+#include <sndfile.h>
 
 using namespace H2Core;
 
@@ -54,8 +59,11 @@ using namespace H2Core;
  * \brief Export Hydrogon song to audio file
  * \param songFile Path to Hydrogen file
  * \param fileName Output file name
+ * \param bExportStems Whether to write all tracks into separate files
+ * \param bDeterministic Whether to use the random seed of the song
  **/
-void exportSong( const QString &songFile, const QString &fileName )
+void exportSong( const QString &songFile, const QString &fileName, bool bExportStems = false,
+				 bool bDeterministic = false )
 {
 	auto t0 = std::chrono::high_resolution_clock::now();
 
@@ -77,7 +85,7 @@ void exportSong( const QString &songFile, const QString &fileName )
 	}
 
 	pHydrogen->startExportSession( 44100, 16 );
-	pHydrogen->startExportSong( fileName );
+	pHydrogen->startExportSong( fileName, bExportStems, bDeterministic );
 
 	bool done = false;
 	while ( ! done ) {
@@ -120,6 +128,8 @@ void exportMIDI( const QString &songFile, const QString &fileName, SMFWriter& wr
 class FunctionalTest : public CppUnit::TestCase {
 	CPPUNIT_TEST_SUITE( FunctionalTest );
 	CPPUNIT_TEST( testExportAudio );
+	CPPUNIT_TEST( testExportStems );
+	CPPUNIT_TEST( testExportDeterministic );
 	CPPUNIT_TEST( testExportMIDISMF0 );
 	CPPUNIT_TEST( testExportMIDISMF1Single );
 	CPPUNIT_TEST( testExportMIDISMF1Multi );
@@ -226,6 +236,93 @@ class FunctionalTest : public CppUnit::TestCase {
 		Filesystem::rm( outFile );
 	}
 
+	void testExportStems()
+	{
+		auto songFile = H2TEST_FILE("functional/test.h2song");
+		auto outFile = Filesystem::tmp_file_path("stems.wav");
+
+		exportSong( songFile, outFile, true );
+
+		auto readFile = []( const QString& sFilename ) {
+			SF_INFO info = {0};
+			SNDFILE* pFile = sf_open( sFilename.toLocal8Bit().data(), SFM_READ, &info );
+			CPPUNIT_ASSERT( pFile != nullptr );
+			std::vector<float> data( info.frames * info.channels );
+			CPPUNIT_ASSERT_EQUAL( info.frames, sf_readf_float( pFile, data.data(), info.frames ) );
+			sf_close( pFile );
+			return data;
+		};
+
+		// All instruments containing notes got a stem of their own.
+		auto pSong = Hydrogen::get_instance()->getSong();
+		std::set<int> usedInstruments;
+		auto pPatternList = pSong->getPatternList();
+		for ( int nPattern = 0; nPattern < pPatternList->size(); ++nPattern ) {
+			const Pattern::notes_t* pNotes = pPatternList->get( nPattern )->get_notes();
+			FOREACH_NOTE_CST_IT_BEGIN_END( pNotes, it ) {
+				usedInstruments.insert( it->second->get_instrument()->get_id() );
+			}
+		}
+		CPPUNIT_ASSERT( ! usedInstruments.empty() );
+
+		const auto master = readFile( outFile );
+		std::vector<float> sum( master.size(), 0.f );
+		auto pInstrumentList = pSong->getInstrumentList();
+		for ( int nInstr = 0; nInstr < pInstrumentList->size(); ++nInstr ) {
+			auto pInstrument = pInstrumentList->get( nInstr );
+			const QString sStemFile =
+				OfflineRenderer::getStemFilename( outFile, pInstrument, pSong );
+			if ( usedInstruments.count( pInstrument->get_id() ) == 0 ) {
+				CPPUNIT_ASSERT( ! Filesystem::file_exists( sStemFile, true ) );
+				continue;
+			}
+
+			const auto stem = readFile( sStemFile );
+			CPPUNIT_ASSERT_EQUAL( master.size(), stem.size() );
+			for ( size_t ii = 0; ii < stem.size(); ++ii ) {
+				sum[ ii ] += stem[ ii ];
+			}
+			Filesystem::rm( sStemFile );
+		}
+
+		// The song does not use any effects. Up to the quantization of
+		// each file the stems add up to the master.
+		const float fTolerance = ( usedInstruments.size() + 1 ) / 32768.0;
+		for ( size_t ii = 0; ii < master.size(); ++ii ) {
+			if ( std::fabs( master[ ii ] ) < 1 ) {
+				CPPUNIT_ASSERT_DOUBLES_EQUAL( master[ ii ], sum[ ii ], fTolerance );
+			}
+		}
+		Filesystem::rm( outFile );
+	}
+
+	void testExportDeterministic()
+	{
+		// Humanization and random pitch draw random numbers for each
+		// note.
+		auto pSong = Song::load( H2TEST_FILE("functional/test.h2song") );
+		CPPUNIT_ASSERT( pSong != nullptr );
+		pSong->setHumanizeTimeValue( 0.5 );
+		pSong->setHumanizeVelocityValue( 0.5 );
+		pSong->setRandomSeed( 1234 );
+		auto pInstrumentList = pSong->getInstrumentList();
+		for ( int ii = 0; ii < pInstrumentList->size(); ++ii ) {
+			pInstrumentList->get( ii )->set_random_pitch_factor( 0.5 );
+		}
+		auto songFile = Filesystem::tmp_file_path("deterministic.h2song");
+		CPPUNIT_ASSERT( pSong->save( songFile ) );
+
+		auto outFile1 = Filesystem::tmp_file_path("deterministic1.wav");
+		auto outFile2 = Filesystem::tmp_file_path("deterministic2.wav");
+		exportSong( songFile, outFile1, false, true );
+		exportSong( songFile, outFile2, false, true );
+		H2TEST_ASSERT_FILES_EQUAL( outFile1, outFile2 );
+
+		Filesystem::rm( outFile1 );
+		Filesystem::rm( outFile2 );
+		Filesystem::rm( songFile );
+	}
+
 	void testExportMIDISMF1Single()
 	{
 		auto songFile = H2TEST_FILE("functional/test.h2song");
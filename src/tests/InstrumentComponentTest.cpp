@@ -0,0 +1,192 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <core/Basics/InstrumentComponent.h>
+#include <core/Basics/InstrumentLayer.h>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace H2Core;
+
+class InstrumentComponentTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( InstrumentComponentTest );
+	CPPUNIT_TEST( testFindLayers );
+	CPPUNIT_TEST( testUpdate );
+	CPPUNIT_TEST( testNearestLayer );
+	CPPUNIT_TEST_SUITE_END();
+
+	int m_nMaxLayers;
+
+	/** Layers with random, possibly overlapping velocity ranges.
+	 * Every third slot is left empty. */
+	std::shared_ptr<InstrumentComponent> createComponent( int nLayers, unsigned nSeed )
+	{
+		std::mt19937 rng( nSeed );
+		std::uniform_real_distribution<float> dist( 0.0f, 1.0f );
+		auto pComponent = std::make_shared<InstrumentComponent>( 0 );
+		for ( int ii = 0; ii < nLayers; ++ii ) {
+			if ( ii % 3 == 2 ) {
+				continue;
+			}
+			auto pLayer = std::make_shared<InstrumentLayer>( nullptr );
+			const float fStart = dist( rng );
+			pLayer->set_start_velocity( fStart );
+			pLayer->set_end_velocity( std::min( 1.0f, fStart + dist( rng ) * 0.2f ) );
+			pComponent->set_layer( pLayer, ii );
+		}
+		return pComponent;
+	}
+
+	/** Selection as done by the Sampler prior to the velocity
+	 * tables. */
+	static int findLayersLinear( std::shared_ptr<InstrumentComponent> pComponent,
+								 float fVelocity, int* indices )
+	{
+		int nFound = 0;
+		for ( int nLayer = 0; nLayer < InstrumentComponent::getMaxLayers(); ++nLayer ) {
+			auto pLayer = pComponent->get_layer( nLayer );
+			if ( pLayer != nullptr &&
+				 fVelocity >= pLayer->get_start_velocity() &&
+				 fVelocity <= pLayer->get_end_velocity() ) {
+				indices[ nFound++ ] = nLayer;
+			}
+		}
+		return nFound;
+	}
+
+	void checkVelocity( std::shared_ptr<InstrumentComponent> pComponent, float fVelocity )
+	{
+		std::vector<int> expected( InstrumentComponent::getMaxLayers() );
+		std::vector<int> found( InstrumentComponent::getMaxLayers() );
+		const int nExpected = findLayersLinear( pComponent, fVelocity, expected.data() );
+		CPPUNIT_ASSERT_EQUAL( nExpected, pComponent->find_layers( fVelocity, found.data() ) );
+		for ( int ii = 0; ii < nExpected; ++ii ) {
+			CPPUNIT_ASSERT_EQUAL( expected[ ii ], found[ ii ] );
+		}
+		CPPUNIT_ASSERT_EQUAL( nExpected > 0 ? expected[ 0 ] : -1,
+							  pComponent->find_layer( fVelocity ) );
+	}
+
+public:
+	void setUp() override
+	{
+		m_nMaxLayers = InstrumentComponent::getMaxLayers();
+		InstrumentComponent::setMaxLayers( 32 );
+	}
+
+	void tearDown() override
+	{
+		InstrumentComponent::setMaxLayers( m_nMaxLayers );
+	}
+
+	void testFindLayers()
+	{
+		auto pComponent = createComponent( 32, 1 );
+
+		std::mt19937 rng( 2 );
+		std::uniform_real_distribution<float> dist( 0.0f, 1.0f );
+		for ( int ii = 0; ii < 10000; ++ii ) {
+			checkVelocity( pComponent, dist( rng ) );
+		}
+
+		// Boundaries of all layers and the buckets.
+		for ( int nLayer = 0; nLayer < InstrumentComponent::getMaxLayers(); ++nLayer ) {
+			auto pLayer = pComponent->get_layer( nLayer );
+			if ( pLayer != nullptr ) {
+				checkVelocity( pComponent, pLayer->get_start_velocity() );
+				checkVelocity( pComponent, pLayer->get_end_velocity() );
+			}
+		}
+		for ( int ii = 0; ii <= InstrumentComponent::nVelocityBuckets; ++ii ) {
+			checkVelocity( pComponent, static_cast<float>( ii ) / InstrumentComponent::nVelocityBuckets );
+		}
+		checkVelocity( pComponent, -0.1f );
+		checkVelocity( pComponent, 1.1f );
+	}
+
+	void testUpdate()
+	{
+		auto pComponent = std::make_shared<InstrumentComponent>( 0 );
+		CPPUNIT_ASSERT_EQUAL( -1, pComponent->find_layer( 0.5f ) );
+
+		auto pLow = std::make_shared<InstrumentLayer>( nullptr );
+		pLow->set_start_velocity( 0.0f );
+		pLow->set_end_velocity( 0.5f );
+		pComponent->set_layer( pLow, 3 );
+		CPPUNIT_ASSERT_EQUAL( 3, pComponent->find_layer( 0.5f ) );
+		CPPUNIT_ASSERT_EQUAL( -1, pComponent->find_layer( 0.501f ) );
+
+		// Editing the velocity range of a layer already added.
+		pLow->set_end_velocity( 0.25f );
+		CPPUNIT_ASSERT_EQUAL( -1, pComponent->find_layer( 0.5f ) );
+		CPPUNIT_ASSERT_EQUAL( 3, pComponent->find_layer( 0.25f ) );
+
+		auto pHigh = std::make_shared<InstrumentLayer>( nullptr );
+		pHigh->set_start_velocity( 0.2f );
+		pHigh->set_end_velocity( 1.0f );
+		pComponent->set_layer( pHigh, 1 );
+		CPPUNIT_ASSERT_EQUAL( 1, pComponent->find_layer( 0.25f ) );
+		CPPUNIT_ASSERT_EQUAL( 3, pComponent->find_layer( 0.1f ) );
+
+		pComponent->set_layer( nullptr, 1 );
+		CPPUNIT_ASSERT_EQUAL( 3, pComponent->find_layer( 0.25f ) );
+		CPPUNIT_ASSERT_EQUAL( -1, pComponent->find_layer( 0.75f ) );
+	}
+
+	void testNearestLayer()
+	{
+		auto pComponent = std::make_shared<InstrumentComponent>( 0 );
+		CPPUNIT_ASSERT_EQUAL( -1, pComponent->find_nearest_layer( 0.5f ) );
+
+		auto pLow = std::make_shared<InstrumentLayer>( nullptr );
+		pLow->set_start_velocity( 0.0f );
+		pLow->set_end_velocity( 0.2f );
+		pComponent->set_layer( pLow, 2 );
+		auto pHigh = std::make_shared<InstrumentLayer>( nullptr );
+		pHigh->set_start_velocity( 0.6f );
+		pHigh->set_end_velocity( 1.0f );
+		pComponent->set_layer( pHigh, 0 );
+
+		// Velocities covered by a layer.
+		CPPUNIT_ASSERT_EQUAL( 2, pComponent->find_nearest_layer( 0.1f ) );
+		CPPUNIT_ASSERT_EQUAL( 0, pComponent->find_nearest_layer( 0.8f ) );
+
+		// Velocities within the hole between both layers.
+		CPPUNIT_ASSERT_EQUAL( -1, pComponent->find_layer( 0.3f ) );
+		CPPUNIT_ASSERT_EQUAL( 2, pComponent->find_nearest_layer( 0.3f ) );
+		CPPUNIT_ASSERT_EQUAL( 0, pComponent->find_nearest_layer( 0.55f ) );
+
+		// Editing the velocity range of a layer already added.
+		pHigh->set_start_velocity( 0.35f );
+		CPPUNIT_ASSERT_EQUAL( 0, pComponent->find_nearest_layer( 0.3f ) );
+
+		pComponent->set_layer( nullptr, 0 );
+		CPPUNIT_ASSERT_EQUAL( 2, pComponent->find_nearest_layer( 0.9f ) );
+	}
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( InstrumentComponentTest );
@@ -0,0 +1,107 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <core/Sampler/Interpolation.h>
+
+#include <random>
+#include <vector>
+
+using namespace H2Core;
+using namespace H2Core::Interpolation;
+
+class InterpolationTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( InterpolationTest );
+	CPPUNIT_TEST( testResample );
+	CPPUNIT_TEST_SUITE_END();
+
+	/** Per-frame interpolation the kernels are compared against. */
+	float referenceValue( InterpolateMode mode, const std::vector<float>& data, double fPos )
+	{
+		const int nFrames = data.size();
+		const int nPos = static_cast<int>( fPos );
+		const double fMu = fPos - nPos;
+		if ( nPos - 1 >= nFrames ) {
+			return 0.0;
+		}
+		float y0, y1, y2, y3;
+		gatherFrames( data.data(), nFrames, nPos, y0, y1, y2, y3 );
+		switch ( mode ) {
+		case InterpolateMode::Linear:
+			return linear_Interpolate( y1, y2, fMu );
+		case InterpolateMode::Cosine:
+			return cosine_Interpolate( y1, y2, fMu );
+		case InterpolateMode::Third:
+			return third_Interpolate( y0, y1, y2, y3, fMu );
+		case InterpolateMode::Cubic:
+			return cubic_Interpolate( y0, y1, y2, y3, fMu );
+		case InterpolateMode::Hermite:
+		default:
+			return hermite_Interpolate( y0, y1, y2, y3, fMu );
+		}
+	}
+
+	/** Renders the whole sample in periods of varying size. */
+	template <InterpolateMode mode>
+	void checkResample( const std::vector<float>& data_L, const std::vector<float>& data_R, float fStep )
+	{
+		const int nFrames = data_L.size();
+		std::vector<float> out_L( 67 ), out_R( 67 );
+		double fPos = 0;
+		int nPeriod = 1;
+		while ( fPos < nFrames + 2 ) {
+			const double fStart = fPos;
+			fPos = resample<mode>( data_L.data(), data_R.data(), nFrames, fPos, fStep,
+								   out_L.data(), out_R.data(), nPeriod );
+
+			double fFramePos = fStart;
+			for ( int ii = 0; ii < nPeriod; ++ii ) {
+				CPPUNIT_ASSERT_DOUBLES_EQUAL( referenceValue( mode, data_L, fFramePos ), out_L[ ii ], 1e-5 );
+				CPPUNIT_ASSERT_DOUBLES_EQUAL( referenceValue( mode, data_R, fFramePos ), out_R[ ii ], 1e-5 );
+				fFramePos += fStep;
+			}
+			CPPUNIT_ASSERT_DOUBLES_EQUAL( fFramePos, fPos, 1e-9 );
+			nPeriod = nPeriod % 67 + 1;
+		}
+	}
+
+	void testResample()
+	{
+		std::mt19937 rng( 4 );
+		std::uniform_real_distribution<float> dist( -1.0, 1.0 );
+		std::vector<float> data_L( 5000 ), data_R( 5000 );
+		for ( int ii = 0; ii < 5000; ++ii ) {
+			data_L[ ii ] = dist( rng );
+			data_R[ ii ] = dist( rng );
+		}
+
+		for ( float fStep : { 0.5f, 1.0f, 1.0594631f, 2.7f } ) {
+			checkResample<InterpolateMode::Linear>( data_L, data_R, fStep );
+			checkResample<InterpolateMode::Cosine>( data_L, data_R, fStep );
+			checkResample<InterpolateMode::Third>( data_L, data_R, fStep );
+			checkResample<InterpolateMode::Cubic>( data_L, data_R, fStep );
+			checkResample<InterpolateMode::Hermite>( data_L, data_R, fStep );
+		}
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( InterpolationTest );
@@ -0,0 +1,173 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "TestHelper.h"
+
+#include <core/Hydrogen.h>
+#include <core/Basics/Drumkit.h>
+#include <core/Basics/Instrument.h>
+#include <core/Basics/InstrumentComponent.h>
+#include <core/Basics/InstrumentLayer.h>
+#include <core/Basics/InstrumentList.h>
+#include <core/Basics/Note.h>
+#include <core/Basics/Pattern.h>
+#include <core/Basics/PatternList.h>
+#include <core/Basics/Sample.h>
+#include <core/Preferences/Preferences.h>
+#include <core/Sampler/LayerLoader.h>
+
+#include <vector>
+
+using namespace H2Core;
+
+class LayerLoaderTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( LayerLoaderTest );
+	CPPUNIT_TEST( testRequest );
+	CPPUNIT_TEST( testLoadUsedLayers );
+	CPPUNIT_TEST_SUITE_END();
+
+	bool m_bLazyLayerLoading;
+
+	static std::vector<std::shared_ptr<InstrumentLayer>> getLayers( std::shared_ptr<Instrument> pInstrument )
+	{
+		std::vector<std::shared_ptr<InstrumentLayer>> layers;
+		for ( const auto& pComponent : *pInstrument->get_components() ) {
+			for ( int nLayer = 0; nLayer < InstrumentComponent::getMaxLayers(); ++nLayer ) {
+				auto pLayer = pComponent->get_layer( nLayer );
+				if ( pLayer != nullptr ) {
+					layers.push_back( pLayer );
+				}
+			}
+		}
+		return layers;
+	}
+
+public:
+	void setUp() override
+	{
+		m_bLazyLayerLoading = Preferences::get_instance()->m_bLazyLayerLoading;
+		Preferences::get_instance()->m_bLazyLayerLoading = true;
+	}
+
+	void tearDown() override
+	{
+		Preferences::get_instance()->m_bLazyLayerLoading = m_bLazyLayerLoading;
+	}
+
+	void testRequest()
+	{
+		auto pDrumkit = Drumkit::load( H2TEST_FILE( "drumkits/baseKit" ), true );
+		CPPUNIT_ASSERT( pDrumkit != nullptr );
+
+		// Nothing is decoded at load time.
+		std::vector<std::shared_ptr<InstrumentLayer>> layers;
+		auto pInstruments = pDrumkit->get_instruments();
+		for ( int ii = 0; ii < pInstruments->size(); ++ii ) {
+			for ( const auto& pLayer : getLayers( pInstruments->get( ii ) ) ) {
+				CPPUNIT_ASSERT( pLayer->is_deferred() );
+				CPPUNIT_ASSERT( pLayer->get_sample()->is_empty() );
+				layers.push_back( pLayer );
+			}
+		}
+		CPPUNIT_ASSERT( layers.size() > 1 );
+
+		// Requests beyond the available slots are dropped and the
+		// layer stays deferred.
+		LayerLoader layerLoader( 1 );
+		for ( const auto& pLayer : layers ) {
+			layerLoader.request( pLayer );
+		}
+		layerLoader.wait();
+
+		auto stats = layerLoader.getStats();
+		CPPUNIT_ASSERT_EQUAL( 0, stats.nPending );
+		CPPUNIT_ASSERT_EQUAL( 0LL, stats.nFailed );
+		CPPUNIT_ASSERT( stats.nLoaded >= 1 );
+		CPPUNIT_ASSERT_EQUAL( static_cast<long long>( layers.size() ),
+							  stats.nLoaded + stats.nUnavailable );
+
+		while ( layerLoader.getStats().nLoaded < static_cast<long long>( layers.size() ) ) {
+			for ( const auto& pLayer : layers ) {
+				layerLoader.request( pLayer );
+			}
+			layerLoader.wait();
+		}
+		for ( const auto& pLayer : layers ) {
+			CPPUNIT_ASSERT( ! pLayer->is_deferred() );
+			CPPUNIT_ASSERT( pLayer->get_sample()->get_frames() > 0 );
+		}
+
+		// Loaded layers are not requested again.
+		const auto nLoaded = layerLoader.getStats().nLoaded;
+		layerLoader.request( layers.front() );
+		layerLoader.wait();
+		CPPUNIT_ASSERT_EQUAL( nLoaded, layerLoader.getStats().nLoaded );
+		delete pDrumkit;
+	}
+
+	void testLoadUsedLayers()
+	{
+		auto pDrumkit = Drumkit::load( H2TEST_FILE( "drumkits/baseKit" ), true );
+		CPPUNIT_ASSERT( pDrumkit != nullptr );
+		auto pInstruments = pDrumkit->get_instruments();
+		CPPUNIT_ASSERT( pInstruments->size() > 1 );
+		auto pUsedInstrument = pInstruments->get( 0 );
+
+		PatternList patternList;
+		auto pPattern = new Pattern();
+		pPattern->insert_note( new Note( pUsedInstrument, 0, 0.8, 0.f, 1, 0 ) );
+		patternList.add( pPattern );
+
+		Hydrogen::get_instance()->loadDeferredLayers( pInstruments, &patternList );
+
+		// Only the layers hit by the note are loaded.
+		bool bLoaded = false;
+		for ( const auto& pLayer : getLayers( pUsedInstrument ) ) {
+			const bool bHit = pLayer->get_start_velocity() <= 0.8f &&
+				pLayer->get_end_velocity() >= 0.8f;
+			CPPUNIT_ASSERT( ! bHit || ! pLayer->is_deferred() );
+			if ( ! pLayer->is_deferred() ) {
+				CPPUNIT_ASSERT( pLayer->get_sample()->get_frames() > 0 );
+				bLoaded = true;
+			}
+		}
+		CPPUNIT_ASSERT( bLoaded );
+		for ( int ii = 1; ii < pInstruments->size(); ++ii ) {
+			for ( const auto& pLayer : getLayers( pInstruments->get( ii ) ) ) {
+				CPPUNIT_ASSERT( pLayer->is_deferred() );
+			}
+		}
+
+		// All remaining ones are loaded without a pattern list.
+		Hydrogen::get_instance()->loadDeferredLayers( pInstruments );
+		for ( int ii = 0; ii < pInstruments->size(); ++ii ) {
+			for ( const auto& pLayer : getLayers( pInstruments->get( ii ) ) ) {
+				CPPUNIT_ASSERT( ! pLayer->is_deferred() );
+			}
+		}
+		delete pDrumkit;
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( LayerLoaderTest );
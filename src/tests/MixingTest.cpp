@@ -0,0 +1,141 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <core/AudioEngine/Mixing.h>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace H2Core;
+
+class MixingTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( MixingTest );
+	CPPUNIT_TEST( testPeak );
+	CPPUNIT_TEST( testAdd );
+	CPPUNIT_TEST( testAddAndPeak );
+	CPPUNIT_TEST( testInterleave );
+	CPPUNIT_TEST_SUITE_END();
+
+	std::vector<float> createBuffer( unsigned nFrames, unsigned nSeed )
+	{
+		std::mt19937 rng( nSeed );
+		std::uniform_real_distribution<float> dist( -1.0f, 1.0f );
+		std::vector<float> buffer( nFrames );
+		for ( auto& fValue : buffer ) {
+			fValue = dist( rng );
+		}
+		return buffer;
+	}
+
+	float peakPerFrame( const std::vector<float>& buffer, unsigned nFrames, float fPeak )
+	{
+		for ( unsigned ii = 0; ii < nFrames; ++ii ) {
+			if ( buffer[ ii ] > fPeak ) {
+				fPeak = buffer[ ii ];
+			}
+		}
+		return fPeak;
+	}
+
+	void testPeak()
+	{
+		for ( unsigned nFrames : { 0, 1, 3, 4, 7, 64, 257 } ) {
+			auto buffer = createBuffer( nFrames, nFrames );
+			for ( float fPeak : { 0.f, -2.f, 0.5f } ) {
+				CPPUNIT_ASSERT_EQUAL( peakPerFrame( buffer, nFrames, fPeak ),
+									  Mixing::peak( buffer.data(), nFrames, fPeak ) );
+			}
+		}
+
+		// NaNs must not end up in the meters.
+		auto buffer = createBuffer( 16, 1 );
+		buffer[ 5 ] = NAN;
+		buffer[ 15 ] = NAN;
+		const float fPeak = Mixing::peak( buffer.data(), 16, 0.f );
+		CPPUNIT_ASSERT( ! std::isnan( fPeak ) );
+		CPPUNIT_ASSERT_EQUAL( peakPerFrame( buffer, 16, 0.f ), fPeak );
+	}
+
+	void testAdd()
+	{
+		for ( unsigned nFrames : { 1, 5, 64, 259 } ) {
+			auto dest = createBuffer( nFrames, 1 );
+			auto source1 = createBuffer( nFrames, 2 );
+			auto source2 = createBuffer( nFrames, 3 );
+			auto expected = dest;
+			for ( unsigned ii = 0; ii < nFrames; ++ii ) {
+				expected[ ii ] += source1[ ii ];
+			}
+			for ( unsigned ii = 0; ii < nFrames; ++ii ) {
+				expected[ ii ] += source2[ ii ];
+			}
+
+			Mixing::add( dest.data(), source1.data(), source2.data(), nFrames );
+			for ( unsigned ii = 0; ii < nFrames; ++ii ) {
+				CPPUNIT_ASSERT_EQUAL( expected[ ii ], dest[ ii ] );
+			}
+		}
+	}
+
+	void testAddAndPeak()
+	{
+		for ( unsigned nFrames : { 1, 5, 64, 259 } ) {
+			auto dest = createBuffer( nFrames, 4 );
+			auto source = createBuffer( nFrames, 5 );
+			auto expected = dest;
+			for ( unsigned ii = 0; ii < nFrames; ++ii ) {
+				expected[ ii ] += source[ ii ];
+			}
+
+			float fPeak = 0.1f;
+			Mixing::addAndPeak( dest.data(), source.data(), nFrames, fPeak );
+			CPPUNIT_ASSERT_EQUAL( peakPerFrame( source, nFrames, 0.1f ), fPeak );
+			for ( unsigned ii = 0; ii < nFrames; ++ii ) {
+				CPPUNIT_ASSERT_EQUAL( expected[ ii ], dest[ ii ] );
+			}
+		}
+	}
+
+	void testInterleave()
+	{
+		for ( unsigned nFrames : { 1, 5, 64, 259 } ) {
+			auto interleaved = createBuffer( 2 * nFrames, 6 );
+			std::vector<float> left( nFrames ), right( nFrames );
+			Mixing::deinterleave( interleaved.data(), left.data(), right.data(), nFrames );
+			for ( unsigned ii = 0; ii < nFrames; ++ii ) {
+				CPPUNIT_ASSERT_EQUAL( interleaved[ 2 * ii ], left[ ii ] );
+				CPPUNIT_ASSERT_EQUAL( interleaved[ 2 * ii + 1 ], right[ ii ] );
+			}
+
+			std::vector<float> result( 2 * nFrames );
+			Mixing::interleave( left.data(), right.data(), result.data(), nFrames );
+			for ( unsigned ii = 0; ii < 2 * nFrames; ++ii ) {
+				CPPUNIT_ASSERT_EQUAL( interleaved[ ii ], result[ ii ] );
+			}
+		}
+	}
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( MixingTest );
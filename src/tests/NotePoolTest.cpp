@@ -0,0 +1,90 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <core/AudioEngine/NotePool.h>
+#include <core/Basics/Note.h>
+#include <core/Basics/Instrument.h>
+
+#include <vector>
+
+using namespace H2Core;
+
+class NotePoolTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( NotePoolTest );
+	CPPUNIT_TEST( testAcquireRelease );
+	CPPUNIT_TEST( testExhaustion );
+	CPPUNIT_TEST_SUITE_END();
+
+	void testAcquireRelease()
+	{
+		NotePool pool( 8 );
+		auto pInstr = std::make_shared<Instrument>( 1, "Snare", nullptr );
+
+		Note* pNote = pool.acquire( pInstr, 12, 0.5f, 0.f, -1, 1.0f );
+		CPPUNIT_ASSERT( pool.contains( pNote ) );
+		CPPUNIT_ASSERT_EQUAL( 1, pool.getUsed() );
+		CPPUNIT_ASSERT_EQUAL( 12, pNote->get_position() );
+		CPPUNIT_ASSERT_EQUAL( 0.5f, pNote->get_velocity() );
+
+		Note* pCopy = pool.acquire( pNote );
+		CPPUNIT_ASSERT( pool.contains( pCopy ) );
+		CPPUNIT_ASSERT( pCopy != pNote );
+		CPPUNIT_ASSERT_EQUAL( 12, pCopy->get_position() );
+		CPPUNIT_ASSERT_EQUAL( 2, pool.getUsed() );
+
+		pool.release( pNote );
+		pool.release( pCopy );
+		CPPUNIT_ASSERT_EQUAL( 0, pool.getUsed() );
+
+		// Notes not created by the pool are deleted.
+		Note* pHeapNote = new Note( pInstr, 0, 1.0f, 0.f, -1, 0.f );
+		CPPUNIT_ASSERT( ! pool.contains( pHeapNote ) );
+		pool.release( pHeapNote );
+		CPPUNIT_ASSERT_EQUAL( 0, pool.getUsed() );
+		CPPUNIT_ASSERT_EQUAL( 0, pool.getExhaustedCount() );
+	}
+
+	void testExhaustion()
+	{
+		NotePool pool( 4 );
+		std::vector<Note*> notes;
+		for ( int ii = 0; ii < 6; ++ii ) {
+			notes.push_back( pool.acquire( nullptr, ii, 1.0f, 0.f, -1, 0.f ) );
+		}
+		CPPUNIT_ASSERT_EQUAL( 4, pool.getUsed() );
+		CPPUNIT_ASSERT_EQUAL( 2, pool.getExhaustedCount() );
+		CPPUNIT_ASSERT( ! pool.contains( notes[ 5 ] ) );
+
+		for ( auto pNote : notes ) {
+			pool.release( pNote );
+		}
+		CPPUNIT_ASSERT_EQUAL( 0, pool.getUsed() );
+
+		// Released slots are used again.
+		Note* pNote = pool.acquire( nullptr, 0, 1.0f, 0.f, -1, 0.f );
+		CPPUNIT_ASSERT( pool.contains( pNote ) );
+		pool.release( pNote );
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( NotePoolTest );
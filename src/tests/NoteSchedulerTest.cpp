@@ -0,0 +1,153 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <core/AudioEngine/NoteScheduler.h>
+#include <core/Basics/Note.h>
+
+#include <memory>
+#include <random>
+#include <set>
+#include <vector>
+
+using namespace H2Core;
+
+class NoteSchedulerTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( NoteSchedulerTest );
+	CPPUNIT_TEST( testOrder );
+	CPPUNIT_TEST( testLateAndDistantNotes );
+	CPPUNIT_TEST( testReschedule );
+	CPPUNIT_TEST( testPop );
+	CPPUNIT_TEST_SUITE_END();
+
+	/** The position of the notes is used as due frame. */
+	std::vector<std::unique_ptr<Note>> createNotes( int nNotes, int nSpan, unsigned nSeed )
+	{
+		std::mt19937 rng( nSeed );
+		std::uniform_int_distribution<int> dist( 0, nSpan - 1 );
+		std::vector<std::unique_ptr<Note>> notes;
+		for ( int ii = 0; ii < nNotes; ++ii ) {
+			notes.push_back( std::make_unique<Note>( nullptr, dist( rng ), 1.0f, 0.f, -1, 0.f ) );
+		}
+		return notes;
+	}
+
+	void testOrder()
+	{
+		NoteScheduler scheduler( 6 );
+		auto notes = createNotes( 1000, 4000, 1 );
+		for ( auto& pNote : notes ) {
+			scheduler.push( pNote.get(), pNote->get_position() );
+		}
+		CPPUNIT_ASSERT_EQUAL( 1000, scheduler.size() );
+
+		int nLastPosition = 0;
+		int nPopped = 0;
+		for ( long long nFrame = 0; nFrame < 4000; nFrame += 256 ) {
+			Note* pNote;
+			while ( ( pNote = scheduler.popDue( nFrame + 256 ) ) != nullptr ) {
+				CPPUNIT_ASSERT( pNote->get_position() >= nLastPosition );
+				CPPUNIT_ASSERT( pNote->get_position() < nFrame + 256 );
+				nLastPosition = pNote->get_position();
+				++nPopped;
+			}
+		}
+		CPPUNIT_ASSERT_EQUAL( 1000, nPopped );
+		CPPUNIT_ASSERT( scheduler.empty() );
+	}
+
+	void testLateAndDistantNotes()
+	{
+		// Wheel spanning 64 frames.
+		NoteScheduler scheduler( 6 );
+		Note late( nullptr, 0, 1.0f, 0.f, -1, 0.f );
+		Note soon( nullptr, 0, 1.0f, 0.f, -1, 0.f );
+		Note distant( nullptr, 0, 1.0f, 0.f, -1, 0.f );
+
+		scheduler.push( &soon, 1000 );
+		scheduler.push( &distant, 100000 );
+		CPPUNIT_ASSERT( scheduler.popDue( 1000 ) == nullptr );
+		CPPUNIT_ASSERT( scheduler.popDue( 1001 ) == &soon );
+
+		// Due before the cursor of the wheel.
+		scheduler.push( &late, 10 );
+		CPPUNIT_ASSERT( scheduler.popDue( 20 ) == &late );
+		CPPUNIT_ASSERT( scheduler.popDue( 100000 ) == nullptr );
+		CPPUNIT_ASSERT( scheduler.popDue( 100001 ) == &distant );
+		CPPUNIT_ASSERT( scheduler.empty() );
+	}
+
+	void testReschedule()
+	{
+		NoteScheduler scheduler( 6 );
+		auto notes = createNotes( 200, 2000, 2 );
+		for ( auto& pNote : notes ) {
+			scheduler.push( pNote.get(), pNote->get_position() );
+		}
+
+		// Doubling the tick size.
+		scheduler.reschedule( []( Note* pNote ) {
+				return static_cast<long long>( pNote->get_position() ) * 2; } );
+		CPPUNIT_ASSERT_EQUAL( 200, scheduler.size() );
+
+		Note* pNote;
+		while ( ( pNote = scheduler.popDue( 2000 ) ) != nullptr ) {
+			CPPUNIT_ASSERT( pNote->get_position() < 1000 );
+		}
+		while ( ( pNote = scheduler.popDue( 4000 ) ) != nullptr ) {
+			CPPUNIT_ASSERT( pNote->get_position() >= 1000 );
+		}
+		CPPUNIT_ASSERT( scheduler.empty() );
+	}
+
+	void testPop()
+	{
+		NoteScheduler scheduler( 6 );
+		auto notes = createNotes( 100, 200, 3 );
+		for ( auto& pNote : notes ) {
+			scheduler.push( pNote.get(), pNote->get_position() );
+		}
+
+		// Pushing notes in between draining must not hide them from
+		// the following calls.
+		std::vector<Note*> popped;
+		Note* pNote;
+		while ( popped.size() < 50 && ( pNote = scheduler.pop() ) != nullptr ) {
+			popped.push_back( pNote );
+		}
+		CPPUNIT_ASSERT_EQUAL( 50, scheduler.size() );
+		for ( auto pPopped : popped ) {
+			scheduler.push( pPopped, pPopped->get_position() );
+		}
+		CPPUNIT_ASSERT_EQUAL( 100, scheduler.size() );
+
+		std::set<Note*> remaining;
+		while ( ( pNote = scheduler.pop() ) != nullptr ) {
+			remaining.insert( pNote );
+		}
+		CPPUNIT_ASSERT_EQUAL( size_t( 100 ), remaining.size() );
+		CPPUNIT_ASSERT( scheduler.empty() );
+	}
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( NoteSchedulerTest );
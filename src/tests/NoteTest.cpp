@@ -23,6 +23,7 @@
 #include <cppunit/extensions/HelperMacros.h>
 #include <core/Basics/Note.h>
 #include <core/Basics/Instrument.h>
+#include <core/Basics/InstrumentComponent.h>
 #include <core/Basics/InstrumentList.h>
 #include <core/Helpers/Xml.h>
 #include <QDomDocument>
@@ -33,6 +34,8 @@ class NoteTest : public CppUnit::TestCase {
 	CPPUNIT_TEST_SUITE( NoteTest );
 	CPPUNIT_TEST( testProbability );
 	CPPUNIT_TEST( testSerializeProbability );
+	CPPUNIT_TEST( testCapturedComponents );
+	CPPUNIT_TEST( testLayersSelected );
 	CPPUNIT_TEST_SUITE_END();
 
 	void testProbability()
@@ -77,6 +80,59 @@ class NoteTest : public CppUnit::TestCase {
 		delete snare;
 		*/
 	}
+
+	void testCapturedComponents()
+	{
+		auto pInstr = std::make_shared<Instrument>( 1, "Kick", nullptr );
+		pInstr->get_components()->push_back( std::make_shared<InstrumentComponent>( 0 ) );
+		auto pOldComponent = pInstr->get_components()->front();
+
+		Note note( pInstr, 0, 1.0f, 0.f, 1, 1.0f );
+		note.capture_components();
+
+		// Exchanging the drumkit keeps the instrument itself.
+		auto pStaged = std::make_shared<Instrument>( 1, "Bass Drum", nullptr );
+		pStaged->get_components()->push_back( std::make_shared<InstrumentComponent>( 2 ) );
+		pInstr->take_over( pStaged );
+		CPPUNIT_ASSERT( pInstr->get_name() == "Bass Drum" );
+		CPPUNIT_ASSERT_EQUAL( 2, pInstr->get_components()->front()->get_drumkit_componentID() );
+		CPPUNIT_ASSERT( pStaged->get_components()->front() == pOldComponent );
+
+		// The playing note finishes with the previous components.
+		auto pPrevious = pStaged->share_components();
+		pStaged = nullptr;
+		CPPUNIT_ASSERT( note.get_components()->front() == pOldComponent );
+		CPPUNIT_ASSERT_EQUAL( 2L, pPrevious.use_count() );
+
+		Note other( pInstr, 0, 1.0f, 0.f, 1, 1.0f );
+		CPPUNIT_ASSERT( other.get_components() == pInstr->get_components() );
+	}
+
+	void testLayersSelected()
+	{
+		for ( int nComponents : { 2, Note::nEmbeddedLayers + 3 } ) {
+			auto pInstr = std::make_shared<Instrument>( 1, "Kick", nullptr );
+			pInstr->get_adsr()->set_attack( 123 );
+			for ( int ii = 0; ii < nComponents; ++ii ) {
+				pInstr->get_components()->push_back( std::make_shared<InstrumentComponent>( 10 + ii ) );
+			}
+
+			Note note( pInstr, 0, 1.0f, 0.f, 1, 1.0f );
+			Note copy( &note, nullptr );
+			for ( int ii = 0; ii < nComponents; ++ii ) {
+				auto pInfo = note.get_layer_selected( 10 + ii );
+				CPPUNIT_ASSERT( pInfo != nullptr );
+				CPPUNIT_ASSERT_EQUAL( -1, pInfo->SelectedLayer );
+				CPPUNIT_ASSERT( pInfo != copy.get_layer_selected( 10 + ii ) );
+			}
+			CPPUNIT_ASSERT( note.get_layer_selected( 0 ) == nullptr );
+
+			// Each note got an envelope of its own.
+			CPPUNIT_ASSERT_EQUAL( 123u, note.get_adsr()->get_attack() );
+			CPPUNIT_ASSERT( note.get_adsr() != copy.get_adsr() );
+			CPPUNIT_ASSERT( note.get_adsr() != pInstr->get_adsr().get() );
+		}
+	}
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION( NoteTest );
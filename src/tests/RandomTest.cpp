@@ -0,0 +1,85 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <core/Helpers/Random.h>
+
+#include <cmath>
+#include <vector>
+
+using namespace H2Core;
+
+class RandomTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( RandomTest );
+	CPPUNIT_TEST( testSequence );
+	CPPUNIT_TEST( testDistributions );
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void testSequence()
+	{
+		// Exported songs must not depend on the platform.
+		Random random( 1234 );
+		const std::vector<uint32_t> expected = { 2745262699u, 2527431456u,
+												 130831659u, 1562225585u };
+		for ( auto nExpected : expected ) {
+			CPPUNIT_ASSERT_EQUAL( nExpected, random.next() );
+		}
+		random.seed( 1234 );
+		CPPUNIT_ASSERT_EQUAL( 0.0590738058f, random.gaussian() );
+		CPPUNIT_ASSERT_EQUAL( 1.63976371f, random.gaussian() );
+
+		// Reseeding drops buffered Gaussian numbers.
+		Random other( 1 );
+		other.gaussian();
+		other.seed( 1234 );
+		CPPUNIT_ASSERT_EQUAL( 0.0590738058f, other.gaussian() );
+	}
+
+	void testDistributions()
+	{
+		Random random( 1 );
+		const int nCount = 100000;
+
+		double fSum = 0, fSumSquares = 0;
+		for ( int ii = 0; ii < nCount; ++ii ) {
+			const float fValue = random.gaussian( 2.0f );
+			fSum += fValue;
+			fSumSquares += fValue * fValue;
+		}
+		CPPUNIT_ASSERT_DOUBLES_EQUAL( 0.0, fSum / nCount, 0.05 );
+		CPPUNIT_ASSERT_DOUBLES_EQUAL( 2.0, std::sqrt( fSumSquares / nCount ), 0.05 );
+
+		std::vector<int> histogram( 10, 0 );
+		for ( int ii = 0; ii < nCount; ++ii ) {
+			const float fValue = random.uniform();
+			CPPUNIT_ASSERT( fValue >= 0 && fValue < 1 );
+			++histogram[ random.below( 10 ) ];
+		}
+		for ( int nBin : histogram ) {
+			CPPUNIT_ASSERT( std::abs( nBin - nCount / 10 ) < nCount / 100 );
+		}
+	}
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( RandomTest );
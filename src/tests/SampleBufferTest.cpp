@@ -0,0 +1,290 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "TestHelper.h"
+
+#include <core/Basics/Sample.h>
+#include <core/Basics/SampleBuffer.h>
+#include <core/Basics/SampleCache.h>
+#include <core/Helpers/Filesystem.h>
+#include <core/Sampler/SincResampler.h>
+
+#include <sndfile.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace H2Core;
+
+class SampleBufferTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( SampleBufferTest );
+	CPPUNIT_TEST( testMono );
+	CPPUNIT_TEST( testLossless );
+	CPPUNIT_TEST( testHalf );
+	CPPUNIT_TEST( testCompactSample );
+	CPPUNIT_TEST( testResample );
+	CPPUNIT_TEST( testChunkedDecode );
+	CPPUNIT_TEST( testWrite );
+	CPPUNIT_TEST_SUITE_END();
+
+	SampleBuffer::Format m_format;
+
+public:
+	void setUp() override
+	{
+		m_format = SampleCache::get_instance()->getFormat();
+	}
+
+	void tearDown() override
+	{
+		SampleCache::get_instance()->setFormat( m_format );
+		SampleCache::get_instance()->clear();
+	}
+
+	void testMono()
+	{
+		auto pBuffer = SampleBuffer::decode( H2TEST_FILE( "drumkits/baseKit/kick.wav" ),
+											 SampleBuffer::Format::Auto );
+		CPPUNIT_ASSERT( pBuffer != nullptr );
+		CPPUNIT_ASSERT_EQUAL( 1, pBuffer->getChannels() );
+		CPPUNIT_ASSERT( pBuffer->getFormat() == SampleBuffer::Format::Int16 );
+		CPPUNIT_ASSERT( pBuffer->getData( 0 ) == pBuffer->getData( 1 ) );
+		CPPUNIT_ASSERT_EQUAL( static_cast<size_t>( pBuffer->getFrames() ) * 2,
+							  pBuffer->getSize() );
+	}
+
+	void testLossless()
+	{
+		for ( const QString& sFile : { "kick.wav", "snare.wav", "hh.wav", "crash.wav" } ) {
+			const QString sPath = H2TEST_FILE( "drumkits/baseKit/" + sFile );
+			auto pFloat = SampleBuffer::decode( sPath, SampleBuffer::Format::Float );
+			auto pCompact = SampleBuffer::decode( sPath, SampleBuffer::Format::Auto );
+			CPPUNIT_ASSERT( pFloat != nullptr );
+			CPPUNIT_ASSERT( pCompact != nullptr );
+			CPPUNIT_ASSERT_EQUAL( pFloat->getFrames(), pCompact->getFrames() );
+			CPPUNIT_ASSERT( pCompact->getSize() * 2 <= pFloat->getSize() );
+
+			std::vector<float> compact( pCompact->getFrames() );
+			for ( int nChannel = 0; nChannel < 2; ++nChannel ) {
+				pCompact->toFloat( nChannel, compact.data() );
+				const float* pExpected = pFloat->getFloatData( nChannel );
+				for ( int ii = 0; ii < pFloat->getFrames(); ++ii ) {
+					CPPUNIT_ASSERT_EQUAL( pExpected[ ii ], compact[ ii ] );
+				}
+			}
+		}
+	}
+
+	void testHalf()
+	{
+		for ( uint32_t nHalf = 0; nHalf < 0x10000; ++nHalf ) {
+			const float fValue = SampleBuffer::halfToFloat( nHalf );
+			if ( std::isnan( fValue ) ) {
+				continue;
+			}
+			CPPUNIT_ASSERT_EQUAL( static_cast<uint16_t>( nHalf ),
+								  SampleBuffer::floatToHalf( fValue ) );
+		}
+
+		const QString sPath = H2TEST_FILE( "drumkits/baseKit/snare.wav" );
+		auto pFloat = SampleBuffer::decode( sPath, SampleBuffer::Format::Float );
+		auto pHalf = SampleBuffer::decode( sPath, SampleBuffer::Format::Half );
+		CPPUNIT_ASSERT_EQUAL( pFloat->getSize() / 2, pHalf->getSize() );
+
+		std::vector<float> half( pHalf->getFrames() );
+		pHalf->toFloat( 0, half.data() );
+		const float* pExpected = pFloat->getFloatData( 0 );
+		for ( int ii = 0; ii < pFloat->getFrames(); ++ii ) {
+			// 11 bits of precision
+			CPPUNIT_ASSERT_DOUBLES_EQUAL( pExpected[ ii ], half[ ii ],
+										  std::fabs( pExpected[ ii ] ) / 2048 + 1e-7 );
+		}
+	}
+
+	void testCompactSample()
+	{
+		const QString sPath = H2TEST_FILE( "drumkits/baseKit/snare.wav" );
+		auto pCache = SampleCache::get_instance();
+		pCache->clear();
+		pCache->setFormat( SampleBuffer::Format::Float );
+		auto pFloat = Sample::load( sPath );
+		pCache->clear();
+		pCache->setFormat( SampleBuffer::Format::Auto );
+		auto pCompact = Sample::load( sPath );
+
+		CPPUNIT_ASSERT_EQUAL( pFloat->get_frames(), pCompact->get_frames() );
+		CPPUNIT_ASSERT_EQUAL( pFloat->get_size() / 2, pCompact->get_size() );
+		CPPUNIT_ASSERT_EQUAL( 2, pCompact->get_channels() );
+
+		// Readers used by the Sampler
+		pCompact->visit_data( [&]( auto data_L, auto data_R ) {
+			for ( int ii = 0; ii < pFloat->get_frames(); ++ii ) {
+				CPPUNIT_ASSERT_EQUAL( pFloat->get_data_l()[ ii ], data_L[ ii ] );
+				CPPUNIT_ASSERT_EQUAL( pFloat->get_data_r()[ ii ], data_R[ ii ] );
+			}
+		} );
+
+		// Conversion on demand
+		for ( int ii = 0; ii < pFloat->get_frames(); ++ii ) {
+			CPPUNIT_ASSERT_EQUAL( pFloat->get_data_l()[ ii ], pCompact->get_data_l()[ ii ] );
+			CPPUNIT_ASSERT_EQUAL( pFloat->get_data_r()[ ii ], pCompact->get_data_r()[ ii ] );
+		}
+
+		// Modifications are applied to a float copy.
+		Sample::VelocityEnvelope velocity;
+		velocity.emplace_back( EnvelopePoint( 0, 45 ) );
+		velocity.emplace_back( EnvelopePoint( 841, 45 ) );
+		pCompact->apply_velocity( velocity );
+		pFloat->apply_velocity( velocity );
+		CPPUNIT_ASSERT_EQUAL( pFloat->get_size(), pCompact->get_size() );
+		for ( int ii = 0; ii < pFloat->get_frames(); ++ii ) {
+			CPPUNIT_ASSERT_EQUAL( pFloat->get_data_l()[ ii ], pCompact->get_data_l()[ ii ] );
+		}
+	}
+
+	void testResample()
+	{
+		// Sine of 1 kHz
+		const int nFrames = 44100;
+		std::vector<float> sine( nFrames );
+		for ( int ii = 0; ii < nFrames; ++ii ) {
+			sine[ ii ] = std::sin( 2 * M_PI * 1000 * ii / 44100.0 );
+		}
+		const SincResampler resampler( 44100, 48000 );
+		CPPUNIT_ASSERT_EQUAL( 48000, resampler.getOutputFrames( nFrames ) );
+		std::vector<float> resampled( 48000 );
+		resampler.process( sine.data(), nFrames, resampled.data(), resampled.size() );
+		// Apart from the edges the result matches the analytic sine.
+		for ( int ii = 100; ii < resampled.size() - 100; ++ii ) {
+			CPPUNIT_ASSERT_DOUBLES_EQUAL( std::sin( 2 * M_PI * 1000 * ii / 48000.0 ),
+										  resampled[ ii ], 1e-4 );
+		}
+
+		const QString sPath = H2TEST_FILE( "drumkits/baseKit/snare.wav" );
+		auto pCache = SampleCache::get_instance();
+		pCache->clear();
+		pCache->setFormat( SampleBuffer::Format::Auto );
+		auto pSample1 = Sample::load( sPath );
+		auto pSample2 = Sample::load( sPath );
+		const int nSampleRate = pSample1->get_sample_rate() == 48000 ? 44100 : 48000;
+		const int nExpectedFrames = static_cast<long long>( pSample1->get_frames() ) *
+			nSampleRate / pSample1->get_sample_rate();
+
+		// Unmodified samples share the resampled content.
+		CPPUNIT_ASSERT( pSample1->resample( nSampleRate ) );
+		CPPUNIT_ASSERT( pSample2->resample( nSampleRate ) );
+		CPPUNIT_ASSERT_EQUAL( nSampleRate, pSample1->get_sample_rate() );
+		CPPUNIT_ASSERT_EQUAL( nExpectedFrames, pSample1->get_frames() );
+		CPPUNIT_ASSERT_EQUAL( pSample1->get_size(), pSample2->get_size() );
+		CPPUNIT_ASSERT_EQUAL( 2, pCache->getStats().nEntries );
+		CPPUNIT_ASSERT( pSample1->get_data_l() != nullptr );
+
+		// Compact formats are kept.
+		pCache->clear();
+		pCache->setFormat( SampleBuffer::Format::Float );
+		auto pFloat = Sample::load( sPath );
+		CPPUNIT_ASSERT( pFloat->resample( nSampleRate ) );
+		CPPUNIT_ASSERT_EQUAL( pFloat->get_size() / 2, pSample1->get_size() );
+		for ( int ii = 0; ii < nExpectedFrames; ++ii ) {
+			if ( std::fabs( pFloat->get_data_l()[ ii ] ) >= 1.0f ) {
+				// Clipped
+				continue;
+			}
+			CPPUNIT_ASSERT_DOUBLES_EQUAL( pFloat->get_data_l()[ ii ],
+										  pSample1->get_data_l()[ ii ], 1.0 / 0x8000 );
+		}
+
+		// Modified samples convert their own content.
+		Sample::VelocityEnvelope velocity;
+		velocity.emplace_back( EnvelopePoint( 0, 45 ) );
+		velocity.emplace_back( EnvelopePoint( 841, 45 ) );
+		auto pModified = Sample::load( sPath );
+		pModified->apply_velocity( velocity );
+		CPPUNIT_ASSERT( pModified->resample( nSampleRate ) );
+		CPPUNIT_ASSERT_EQUAL( nSampleRate, pModified->get_sample_rate() );
+		CPPUNIT_ASSERT_EQUAL( nExpectedFrames, pModified->get_frames() );
+	}
+
+	/** Decoding in chunks yields the same content as reading the
+	 * whole file at once.*/
+	void testChunkedDecode()
+	{
+		for ( const QString& sFile : { "kick.wav", "snare.wav", "crash.wav" } ) {
+			const QString sPath = H2TEST_FILE( "drumkits/baseKit/" + sFile );
+			SF_INFO info = {0};
+			SNDFILE* pFile = sf_open( sPath.toLocal8Bit(), SFM_READ, &info );
+			CPPUNIT_ASSERT( pFile != nullptr );
+			std::vector<float> interleaved( info.frames * info.channels );
+			CPPUNIT_ASSERT_EQUAL( info.frames, sf_readf_float( pFile, interleaved.data(), info.frames ) );
+			sf_close( pFile );
+
+			auto pBuffer = SampleBuffer::decode( sPath, SampleBuffer::Format::Float );
+			CPPUNIT_ASSERT( pBuffer != nullptr );
+			CPPUNIT_ASSERT_EQUAL( static_cast<int>( info.frames ), pBuffer->getFrames() );
+			for ( int nChannel = 0; nChannel < info.channels; ++nChannel ) {
+				const float* pData = pBuffer->getFloatData( nChannel );
+				for ( int ii = 0; ii < pBuffer->getFrames(); ++ii ) {
+					CPPUNIT_ASSERT_EQUAL( interleaved[ ii * info.channels + nChannel ], pData[ ii ] );
+				}
+			}
+
+			// Partial decoding stops within a chunk.
+			const int nMaxFrames = SampleBuffer::nChunkFrames + 17;
+			if ( info.frames > nMaxFrames ) {
+				auto pHead = SampleBuffer::decode( sPath, SampleBuffer::Format::Float, nMaxFrames );
+				CPPUNIT_ASSERT_EQUAL( nMaxFrames, pHead->getFrames() );
+				CPPUNIT_ASSERT_EQUAL( static_cast<int>( info.frames ), pHead->getFileFrames() );
+				for ( int ii = 0; ii < nMaxFrames; ++ii ) {
+					CPPUNIT_ASSERT_EQUAL( pBuffer->getFloatData( 0 )[ ii ], pHead->getFloatData( 0 )[ ii ] );
+				}
+			}
+		}
+	}
+
+	void testWrite()
+	{
+		const QString sPath = H2TEST_FILE( "drumkits/baseKit/crash.wav" );
+		auto pCache = SampleCache::get_instance();
+		pCache->clear();
+		pCache->setFormat( SampleBuffer::Format::Float );
+		auto pSample = Sample::load( sPath );
+		CPPUNIT_ASSERT( pSample != nullptr );
+		CPPUNIT_ASSERT( pSample->get_frames() > SampleBuffer::nChunkFrames );
+
+		const QString sOutPath = Filesystem::tmp_dir().append( "sample-buffer-write.wav" );
+		CPPUNIT_ASSERT( pSample->write( sOutPath, SF_FORMAT_WAV | SF_FORMAT_FLOAT ) );
+		auto pWritten = SampleBuffer::decode( sOutPath, SampleBuffer::Format::Float );
+		CPPUNIT_ASSERT( pWritten != nullptr );
+		CPPUNIT_ASSERT_EQUAL( pSample->get_frames(), pWritten->getFrames() );
+		for ( int ii = 0; ii < pSample->get_frames(); ++ii ) {
+			CPPUNIT_ASSERT_EQUAL( std::clamp( pSample->get_data_l()[ ii ], -1.f, 1.f ),
+								  pWritten->getFloatData( 0 )[ ii ] );
+			CPPUNIT_ASSERT_EQUAL( std::clamp( pSample->get_data_r()[ ii ], -1.f, 1.f ),
+								  pWritten->getFloatData( 1 )[ ii ] );
+		}
+		Filesystem::rm( sOutPath );
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( SampleBufferTest );
@@ -0,0 +1,229 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "TestHelper.h"
+
+#include <core/Basics/Sample.h>
+#include <core/Basics/SampleCache.h>
+#include <core/Basics/SampleDiskCache.h>
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include <cstring>
+#include <vector>
+
+using namespace H2Core;
+
+class SampleCacheTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( SampleCacheTest );
+	CPPUNIT_TEST( testSharing );
+	CPPUNIT_TEST( testCopyOnWrite );
+	CPPUNIT_TEST( testEviction );
+	CPPUNIT_TEST( testModifiedFile );
+	CPPUNIT_TEST( testDiskCache );
+	CPPUNIT_TEST_SUITE_END();
+
+	size_t m_nBudget;
+	SampleBuffer::Format m_format;
+
+public:
+	void setUp() override
+	{
+		m_nBudget = SampleCache::get_instance()->getBudget();
+		m_format = SampleCache::get_instance()->getFormat();
+		// Data pointers of compact samples are not shared.
+		SampleCache::get_instance()->setFormat( SampleBuffer::Format::Float );
+		SampleCache::get_instance()->clear();
+	}
+
+	void tearDown() override
+	{
+		SampleCache::get_instance()->setBudget( m_nBudget );
+		SampleCache::get_instance()->setFormat( m_format );
+		SampleCache::get_instance()->setDiskCache( nullptr );
+		SampleCache::get_instance()->clear();
+	}
+
+	void testSharing()
+	{
+		auto pCache = SampleCache::get_instance();
+
+		auto pSample1 = Sample::load( H2TEST_FILE( "drumkits/baseKit/kick.wav" ) );
+		auto pSample2 = Sample::load( H2TEST_FILE( "drumkits/baseKit/kick.wav" ) );
+		CPPUNIT_ASSERT( pSample1 != nullptr );
+		CPPUNIT_ASSERT( pSample2 != nullptr );
+		CPPUNIT_ASSERT( pSample1->get_data_l() == pSample2->get_data_l() );
+		CPPUNIT_ASSERT( pSample1->get_data_r() == pSample2->get_data_r() );
+		CPPUNIT_ASSERT_EQUAL( pSample1->get_frames(), pSample2->get_frames() );
+
+		// Copies share the content too.
+		auto pCopy = std::make_shared<Sample>( pSample1 );
+		CPPUNIT_ASSERT( pCopy->get_data_l() == pSample1->get_data_l() );
+
+		auto stats = pCache->getStats();
+		CPPUNIT_ASSERT_EQUAL( 1LL, stats.nHits );
+		CPPUNIT_ASSERT_EQUAL( 1LL, stats.nMisses );
+		CPPUNIT_ASSERT_EQUAL( 1, stats.nEntries );
+		CPPUNIT_ASSERT_EQUAL( static_cast<size_t>( pSample1->get_size() ), stats.nBytes );
+		CPPUNIT_ASSERT_EQUAL( static_cast<size_t>( 0 ), stats.nUnusedBytes );
+
+		pSample1->unload();
+		CPPUNIT_ASSERT( pSample1->get_data_l() == nullptr );
+		CPPUNIT_ASSERT( pSample2->get_data_l() != nullptr );
+	}
+
+	void testCopyOnWrite()
+	{
+		auto pSample1 = Sample::load( H2TEST_FILE( "drumkits/baseKit/snare.wav" ) );
+		auto pSample2 = Sample::load( H2TEST_FILE( "drumkits/baseKit/snare.wav" ) );
+		CPPUNIT_ASSERT( pSample1 != nullptr );
+		CPPUNIT_ASSERT( pSample2 != nullptr );
+
+		const int nFrames = pSample2->get_frames();
+		std::vector<float> original( pSample2->get_data_l(),
+									 pSample2->get_data_l() + nFrames );
+
+		Sample::VelocityEnvelope velocity;
+		velocity.emplace_back( EnvelopePoint( 0, 45 ) );
+		velocity.emplace_back( EnvelopePoint( 841, 45 ) );
+		pSample1->apply_velocity( velocity );
+
+		CPPUNIT_ASSERT( pSample1->get_data_l() != pSample2->get_data_l() );
+		CPPUNIT_ASSERT( pSample1->get_data_r() != pSample2->get_data_r() );
+		for ( int ii = 0; ii < nFrames; ++ii ) {
+			CPPUNIT_ASSERT_EQUAL( original[ ii ], pSample2->get_data_l()[ ii ] );
+		}
+
+		// Loading the file once more still yields the unaltered
+		// content.
+		auto pSample3 = Sample::load( H2TEST_FILE( "drumkits/baseKit/snare.wav" ) );
+		CPPUNIT_ASSERT( pSample3->get_data_l() == pSample2->get_data_l() );
+	}
+
+	void testEviction()
+	{
+		auto pCache = SampleCache::get_instance();
+
+		auto pKick = Sample::load( H2TEST_FILE( "drumkits/baseKit/kick.wav" ) );
+		auto pSnare = Sample::load( H2TEST_FILE( "drumkits/baseKit/snare.wav" ) );
+		auto pHiHat = Sample::load( H2TEST_FILE( "drumkits/baseKit/hh.wav" ) );
+		const size_t nKickSize = pKick->get_size();
+		const size_t nSnareSize = pSnare->get_size();
+
+		// Samples in use are never evicted.
+		pCache->setBudget( 0 );
+		CPPUNIT_ASSERT_EQUAL( 3, pCache->getStats().nEntries );
+
+		// Kick is the least recently used one.
+		pCache->setBudget( nSnareSize );
+		pKick.reset();
+		pSnare.reset();
+		pCache->trim();
+
+		auto stats = pCache->getStats();
+		CPPUNIT_ASSERT_EQUAL( 2, stats.nEntries );
+		CPPUNIT_ASSERT_EQUAL( 1LL, stats.nEvictions );
+		CPPUNIT_ASSERT_EQUAL( nSnareSize, stats.nUnusedBytes );
+
+		pSnare = Sample::load( H2TEST_FILE( "drumkits/baseKit/snare.wav" ) );
+		pKick = Sample::load( H2TEST_FILE( "drumkits/baseKit/kick.wav" ) );
+		stats = pCache->getStats();
+		CPPUNIT_ASSERT_EQUAL( 1LL, stats.nHits );
+		CPPUNIT_ASSERT_EQUAL( 4LL, stats.nMisses );
+		CPPUNIT_ASSERT_EQUAL( nKickSize + nSnareSize + pHiHat->get_size(),
+							  stats.nBytes );
+	}
+
+	void testModifiedFile()
+	{
+		QTemporaryDir tmpDir;
+		CPPUNIT_ASSERT( tmpDir.isValid() );
+		const QString sPath = tmpDir.filePath( "sample.wav" );
+
+		CPPUNIT_ASSERT( QFile::copy( H2TEST_FILE( "drumkits/baseKit/kick.wav" ), sPath ) );
+		auto pKick = Sample::load( sPath );
+		CPPUNIT_ASSERT( pKick != nullptr );
+
+		CPPUNIT_ASSERT( QFile::remove( sPath ) );
+		CPPUNIT_ASSERT( QFile::copy( H2TEST_FILE( "drumkits/baseKit/hh.wav" ), sPath ) );
+		auto pHiHat = Sample::load( sPath );
+		CPPUNIT_ASSERT( pHiHat != nullptr );
+
+		auto pReference = Sample::load( H2TEST_FILE( "drumkits/baseKit/hh.wav" ) );
+		CPPUNIT_ASSERT_EQUAL( pReference->get_frames(), pHiHat->get_frames() );
+		CPPUNIT_ASSERT( pKick->get_frames() != pHiHat->get_frames() );
+		CPPUNIT_ASSERT_EQUAL( 0LL, SampleCache::get_instance()->getStats().nHits );
+	}
+
+	void testDiskCache()
+	{
+		auto pCache = SampleCache::get_instance();
+		QTemporaryDir tmpDir;
+		CPPUNIT_ASSERT( tmpDir.isValid() );
+		const QString sPath = tmpDir.filePath( "sample.wav" );
+		auto pDiskCache = std::make_shared<SampleDiskCache>( tmpDir.filePath( "cache" ) );
+		pCache->setDiskCache( pDiskCache );
+
+		CPPUNIT_ASSERT( QFile::copy( H2TEST_FILE( "drumkits/baseKit/kick.wav" ), sPath ) );
+		auto pDecoded = pCache->get( sPath );
+		CPPUNIT_ASSERT( pDecoded != nullptr );
+		CPPUNIT_ASSERT( ! pDecoded->isMapped() );
+		CPPUNIT_ASSERT_EQUAL( 0LL, pCache->getStats().nDiskHits );
+
+		// Once dropped from memory the content is restored from disk.
+		pCache->clear();
+		auto pMapped = pCache->get( sPath );
+		CPPUNIT_ASSERT( pMapped != nullptr );
+		CPPUNIT_ASSERT( pMapped->isMapped() );
+		CPPUNIT_ASSERT_EQUAL( 1LL, pCache->getStats().nDiskHits );
+		CPPUNIT_ASSERT_EQUAL( pDecoded->getFrames(), pMapped->getFrames() );
+		CPPUNIT_ASSERT_EQUAL( pDecoded->getSampleRate(), pMapped->getSampleRate() );
+		CPPUNIT_ASSERT_EQUAL( pDecoded->getChannels(), pMapped->getChannels() );
+		for ( int nChannel = 0; nChannel < 2; ++nChannel ) {
+			CPPUNIT_ASSERT( memcmp( pDecoded->getData( nChannel ), pMapped->getData( nChannel ),
+									pDecoded->getSize() / pDecoded->getChannels() ) == 0 );
+		}
+
+		// Samples loaded from the mapped content behave as usual.
+		auto pSample = Sample::load( sPath );
+		CPPUNIT_ASSERT( pSample != nullptr );
+		CPPUNIT_ASSERT_EQUAL( pDecoded->getFrames(), pSample->get_frames() );
+
+		// Cache files of altered files are not used.
+		pCache->clear();
+		CPPUNIT_ASSERT( QFile::remove( sPath ) );
+		CPPUNIT_ASSERT( QFile::copy( H2TEST_FILE( "drumkits/baseKit/hh.wav" ), sPath ) );
+		auto pHiHat = pCache->get( sPath );
+		CPPUNIT_ASSERT( ! pHiHat->isMapped() );
+		CPPUNIT_ASSERT_EQUAL( 0LL, pCache->getStats().nDiskHits );
+		auto pReference = Sample::load( H2TEST_FILE( "drumkits/baseKit/hh.wav" ) );
+		CPPUNIT_ASSERT_EQUAL( pReference->get_frames(), pHiHat->getFrames() );
+
+		pDiskCache->clear();
+		CPPUNIT_ASSERT( QDir( pDiskCache->getDirectory() ).isEmpty() );
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( SampleCacheTest );
@@ -0,0 +1,137 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "TestHelper.h"
+
+#include <core/Basics/Drumkit.h>
+#include <core/Basics/Instrument.h>
+#include <core/Basics/InstrumentComponent.h>
+#include <core/Basics/InstrumentLayer.h>
+#include <core/Basics/InstrumentList.h>
+#include <core/Basics/Sample.h>
+#include <core/Basics/SampleLoader.h>
+#include <core/Preferences/Preferences.h>
+
+#include <vector>
+
+using namespace H2Core;
+
+class SampleLoaderTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( SampleLoaderTest );
+	CPPUNIT_TEST( testOrder );
+	CPPUNIT_TEST( testDrumkit );
+	CPPUNIT_TEST( testThreadReuse );
+	CPPUNIT_TEST_SUITE_END();
+
+	int m_nSampleLoadingThreads;
+
+public:
+	void setUp() override
+	{
+		m_nSampleLoadingThreads = Preferences::get_instance()->m_nSampleLoadingThreads;
+		Preferences::get_instance()->m_nSampleLoadingThreads = 4;
+	}
+
+	void tearDown() override
+	{
+		Preferences::get_instance()->m_nSampleLoadingThreads = m_nSampleLoadingThreads;
+	}
+
+	void testOrder()
+	{
+		const std::vector<QString> files = { "kick.wav", "snare.wav", "missing.wav",
+											 "hh.wav", "crash.wav" };
+		SampleLoader loader;
+		std::vector<std::shared_ptr<Sample>> samples;
+		for ( const auto& sFile : files ) {
+			const QString sPath = H2TEST_FILE( "drumkits/baseKit/" + sFile );
+			loader.add( [sPath]() { return Sample::load( sPath ); },
+						[&]( std::shared_ptr<Sample> pSample ) {
+							samples.push_back( pSample );
+						} );
+		}
+		CPPUNIT_ASSERT_EQUAL( 5, loader.size() );
+		loader.run();
+		CPPUNIT_ASSERT_EQUAL( 0, loader.size() );
+
+		// Results are handed over in the order the jobs were added.
+		CPPUNIT_ASSERT_EQUAL( files.size(), samples.size() );
+		for ( int ii = 0; ii < files.size(); ++ii ) {
+			if ( files[ ii ] == "missing.wav" ) {
+				CPPUNIT_ASSERT( samples[ ii ] == nullptr );
+			} else {
+				CPPUNIT_ASSERT( samples[ ii ] != nullptr );
+				CPPUNIT_ASSERT( samples[ ii ]->get_filename() == files[ ii ] );
+			}
+		}
+	}
+
+	void testDrumkit()
+	{
+		auto pDrumkit = Drumkit::load( H2TEST_FILE( "drumkits/baseKit" ), true );
+		CPPUNIT_ASSERT( pDrumkit != nullptr );
+
+		auto pInstruments = pDrumkit->get_instruments();
+		for ( int ii = 0; ii < pInstruments->size(); ++ii ) {
+			for ( const auto& pComponent : *pInstruments->get( ii )->get_components() ) {
+				for ( int nLayer = 0; nLayer < InstrumentComponent::getMaxLayers(); ++nLayer ) {
+					auto pLayer = pComponent->get_layer( nLayer );
+					if ( pLayer != nullptr ) {
+						CPPUNIT_ASSERT( pLayer->get_sample()->get_frames() > 0 );
+					}
+				}
+			}
+		}
+		delete pDrumkit;
+	}
+
+	void testThreadReuse()
+	{
+		const QString sPath = H2TEST_FILE( "drumkits/baseKit/snare.wav" );
+		int nPooledThreads = -1;
+		for ( int nRound = 0; nRound < 5; ++nRound ) {
+			SampleLoader loader;
+			int nLoaded = 0;
+			for ( int ii = 0; ii < 8; ++ii ) {
+				loader.add( [sPath]() { return Sample::load( sPath ); },
+							[&]( std::shared_ptr<Sample> pSample ) {
+								if ( pSample != nullptr ) {
+									++nLoaded;
+								}
+							} );
+			}
+			loader.run();
+			CPPUNIT_ASSERT_EQUAL( 8, nLoaded );
+
+			// Subsequent loaders use the threads of the first one.
+			CPPUNIT_ASSERT( SampleLoader::getPooledThreadCount() >=
+							SampleLoader::getThreadCount() - 1 );
+			if ( nPooledThreads != -1 ) {
+				CPPUNIT_ASSERT_EQUAL( nPooledThreads, SampleLoader::getPooledThreadCount() );
+			}
+			nPooledThreads = SampleLoader::getPooledThreadCount();
+		}
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( SampleLoaderTest );
@@ -0,0 +1,118 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "TestHelper.h"
+
+#include <core/Basics/InstrumentLayer.h>
+#include <core/Basics/Sample.h>
+#include <core/Basics/SampleStretcher.h>
+
+using namespace H2Core;
+
+class SampleStretcherTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( SampleStretcherTest );
+	CPPUNIT_TEST( testWithoutRubberband );
+	CPPUNIT_TEST( testRequestTempo );
+#ifdef H2CORE_HAVE_RUBBERBAND
+	CPPUNIT_TEST( testStretch );
+#endif
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void testWithoutRubberband()
+	{
+		auto pSample = Sample::load( H2TEST_FILE( "drumkits/baseKit/snare.wav" ) );
+		CPPUNIT_ASSERT( pSample != nullptr );
+		auto pLayer = std::make_shared<InstrumentLayer>( pSample );
+
+		SampleStretcher stretcher( 2, 0 );
+		stretcher.request( pLayer, pSample, 120 );
+		stretcher.wait();
+
+		// Samples not using Rubber Band are kept as they are.
+		CPPUNIT_ASSERT( pLayer->get_sample() == pSample );
+		const auto stats = stretcher.getStats();
+		CPPUNIT_ASSERT_EQUAL( 0, stats.nEntries );
+		CPPUNIT_ASSERT_EQUAL( 0, stats.nPending );
+	}
+
+	void testRequestTempo()
+	{
+		// Posted tempi are picked up by a worker thread.
+		SampleStretcher stretcher( 1, 0 );
+		stretcher.requestTempo( 100 );
+		stretcher.requestTempo( 110 );
+		stretcher.wait();
+		CPPUNIT_ASSERT_EQUAL( 0, stretcher.getStats().nPending );
+	}
+
+#ifdef H2CORE_HAVE_RUBBERBAND
+	void testStretch()
+	{
+		auto pSource = Sample::load( H2TEST_FILE( "drumkits/baseKit/snare.wav" ) );
+		CPPUNIT_ASSERT( pSource != nullptr );
+		Sample::Rubberband rb;
+		rb.use = true;
+		rb.divider = 1.0;
+		rb.pitch = 0.0;
+		pSource->set_rubberband( rb );
+		auto pLayer = std::make_shared<InstrumentLayer>( pSource );
+
+		SampleStretcher stretcher( 1, 100 * 1024 * 1024 );
+		stretcher.request( pLayer, pSource, 120 );
+		stretcher.wait();
+		auto pStretched120 = pLayer->get_sample();
+		CPPUNIT_ASSERT( pStretched120 != pSource );
+		CPPUNIT_ASSERT( pStretched120->get_unstretched() == pSource );
+
+		// The stretched sample is stretched from its source again.
+		stretcher.request( pLayer, pStretched120, 60 );
+		stretcher.wait();
+		auto pStretched60 = pLayer->get_sample();
+		CPPUNIT_ASSERT( pStretched60->get_unstretched() == pSource );
+		CPPUNIT_ASSERT( pStretched60->get_frames() > pStretched120->get_frames() );
+
+		// Switching back is served by the cache.
+		stretcher.request( pLayer, pStretched60, 120 );
+		stretcher.wait();
+		CPPUNIT_ASSERT( pLayer->get_sample() == pStretched120 );
+
+		// So is reloading the same file.
+		auto pReloaded = Sample::load( H2TEST_FILE( "drumkits/baseKit/snare.wav" ) );
+		CPPUNIT_ASSERT( pReloaded != nullptr );
+		pReloaded->set_rubberband( rb );
+		auto pReloadedLayer = std::make_shared<InstrumentLayer>( pReloaded );
+		stretcher.request( pReloadedLayer, pReloaded, 60 );
+		stretcher.wait();
+		CPPUNIT_ASSERT( pReloadedLayer->get_sample() == pStretched60 );
+
+		const auto stats = stretcher.getStats();
+		CPPUNIT_ASSERT_EQUAL( 2LL, stats.nHits );
+		CPPUNIT_ASSERT_EQUAL( 2LL, stats.nMisses );
+		CPPUNIT_ASSERT_EQUAL( 2, stats.nEntries );
+	}
+#endif
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( SampleStretcherTest );
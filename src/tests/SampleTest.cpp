@@ -24,10 +24,17 @@
 #include "TestHelper.h"
 
 #include <core/Basics/Sample.h>
+#include <core/Preferences/Preferences.h>
+
+#include <QFile>
+#include <QTemporaryDir>
 
 class SampleTest : public CppUnit::TestCase {
 	CPPUNIT_TEST_SUITE( SampleTest );
 	CPPUNIT_TEST( testLoadInvalidSample );
+#ifndef WIN32
+	CPPUNIT_TEST( testResampleModified );
+#endif
 
 	CPPUNIT_TEST_SUITE_END();
 
@@ -45,6 +52,55 @@ class SampleTest : public CppUnit::TestCase {
 		pSample = H2Core::Sample::load( H2TEST_FILE("drumkits/baseKit/drumkit.xml") );
 		CPPUNIT_ASSERT(pSample == nullptr);
 	}
+
+#ifndef WIN32
+	void testResampleModified()
+	{
+		// Fake Rubber Band CLI replacing the sample with another
+		// file of a different length.
+		QTemporaryDir tmpDir;
+		CPPUNIT_ASSERT( tmpDir.isValid() );
+		const QString sStretched = H2TEST_FILE( "drumkits/baseKit/hh.wav" );
+		const QString sProgram = tmpDir.filePath( "rubberband" );
+		QFile program( sProgram );
+		CPPUNIT_ASSERT( program.open( QIODevice::WriteOnly ) );
+		program.write( QString( "#!/bin/sh\nfor last; do :; done\ncp '%1' \"$last\"\n" )
+					   .arg( sStretched ).toUtf8() );
+		program.close();
+		program.setPermissions( QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner );
+
+		auto pPref = H2Core::Preferences::get_instance();
+		const QString sFormerProgram = pPref->m_rubberBandCLIexecutable;
+		pPref->m_rubberBandCLIexecutable = sProgram;
+
+		auto pSample = H2Core::Sample::load( H2TEST_FILE( "drumkits/baseKit/snare.wav" ) );
+		CPPUNIT_ASSERT( pSample != nullptr );
+		H2Core::Sample::Rubberband rb;
+		rb.use = true;
+		rb.divider = 1.0;
+		const bool bStretched = pSample->exec_rubberband_cli( rb, 120 );
+		pPref->m_rubberBandCLIexecutable = sFormerProgram;
+		CPPUNIT_ASSERT( bStretched );
+		CPPUNIT_ASSERT( pSample->get_is_modified() );
+
+		// The stretched content has to be resampled instead of the
+		// file the sample was loaded from.
+		auto pExpected = H2Core::Sample::load( sStretched );
+		CPPUNIT_ASSERT( pExpected != nullptr );
+		const int nSampleRate = 2 * pExpected->get_sample_rate();
+		CPPUNIT_ASSERT( pExpected->resample( nSampleRate ) );
+		CPPUNIT_ASSERT( pSample->resample( nSampleRate ) );
+		CPPUNIT_ASSERT_EQUAL( nSampleRate, pSample->get_sample_rate() );
+		CPPUNIT_ASSERT_EQUAL( pExpected->get_frames(), pSample->get_frames() );
+		// The cache might store the file in a compact format.
+		for ( int ii = 0; ii < pSample->get_frames(); ii += 97 ) {
+			CPPUNIT_ASSERT_DOUBLES_EQUAL( pExpected->get_data_l()[ ii ],
+										  pSample->get_data_l()[ ii ], 1e-4 );
+			CPPUNIT_ASSERT_DOUBLES_EQUAL( pExpected->get_data_r()[ ii ],
+										  pSample->get_data_r()[ ii ], 1e-4 );
+		}
+	}
+#endif
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION( SampleTest );
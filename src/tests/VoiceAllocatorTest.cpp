@@ -0,0 +1,345 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <core/Basics/Adsr.h>
+#include <core/Basics/Instrument.h>
+#include <core/Basics/Note.h>
+#include <core/Sampler/VoiceAllocator.h>
+
+#include <random>
+#include <vector>
+
+using namespace H2Core;
+
+class VoiceAllocatorTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( VoiceAllocatorTest );
+	CPPUNIT_TEST( testOrder );
+	CPPUNIT_TEST( testStealOldest );
+	CPPUNIT_TEST( testStealQuietest );
+	CPPUNIT_TEST( testInstrumentLimit );
+	CPPUNIT_TEST( testDrop );
+	CPPUNIT_TEST( testChoke );
+	CPPUNIT_TEST( testGroups );
+	CPPUNIT_TEST_SUITE_END();
+
+	using Policy = VoiceAllocator::Policy;
+
+	std::shared_ptr<Instrument> m_pKick;
+	std::shared_ptr<Instrument> m_pHihat;
+	std::vector<Note*> m_notes;
+
+	/** Creates a note which is already playing.*/
+	Note* createNote( std::shared_ptr<Instrument> pInstrument, float fVelocity = 1.0f )
+	{
+		Note* pNote = new Note( pInstrument, 0, fVelocity, 0.f, -1, 0.f );
+		pNote->get_adsr()->attack();
+		pNote->get_adsr()->get_value( 1 );
+		m_notes.push_back( pNote );
+		return pNote;
+	}
+
+	/** \return Notes of all voices in order.*/
+	std::vector<Note*> getNotes( const VoiceAllocator& voiceAllocator ) const
+	{
+		std::vector<Note*> notes;
+		for ( int nVoice = 0; nVoice < voiceAllocator.size(); ++nVoice ) {
+			notes.push_back( voiceAllocator.getNote( nVoice ) );
+		}
+		return notes;
+	}
+
+	/** \return Notes visited by @a visit in order.*/
+	template <typename Visit>
+	static std::vector<Note*> collect( Visit&& visit )
+	{
+		std::vector<Note*> notes;
+		visit( [&]( Note* pNote ) { notes.push_back( pNote ); } );
+		return notes;
+	}
+
+	/** \return Notes of all voices in order for which @a
+	 * predicate holds. Formerly used by the Sampler to find the
+	 * voices to release.*/
+	template <typename Predicate>
+	std::vector<Note*> scan( const VoiceAllocator& voiceAllocator, Predicate&& predicate ) const
+	{
+		std::vector<Note*> notes;
+		for ( auto pNote : getNotes( voiceAllocator ) ) {
+			if ( predicate( pNote ) ) {
+				notes.push_back( pNote );
+			}
+		}
+		return notes;
+	}
+
+	/** Removes all voices which completed their fade.*/
+	void removeFadedOut( VoiceAllocator& voiceAllocator ) const
+	{
+		voiceAllocator.advance( VoiceAllocator::nFadeFrames );
+		voiceAllocator.removeIf( []( int, Note*, bool bFadedOut ) { return bFadedOut; } );
+	}
+
+public:
+	void setUp() override
+	{
+		m_pKick = std::make_shared<Instrument>( 1, "Kick" );
+		m_pHihat = std::make_shared<Instrument>( 2, "Hihat" );
+	}
+
+	void tearDown() override
+	{
+		for ( auto pNote : m_notes ) {
+			delete pNote;
+		}
+		m_notes.clear();
+	}
+
+	void testOrder()
+	{
+		VoiceAllocator voiceAllocator( 8 );
+		std::vector<Note*> notes;
+		for ( int ii = 0; ii < 6; ++ii ) {
+			Note* pNote = createNote( m_pKick );
+			CPPUNIT_ASSERT( voiceAllocator.add( pNote, 8, Policy::oldest ) == nullptr );
+			notes.push_back( pNote );
+		}
+		CPPUNIT_ASSERT_EQUAL( 6, voiceAllocator.size() );
+		CPPUNIT_ASSERT_EQUAL( 6, voiceAllocator.getSounding() );
+
+		// Finished voices are removed without altering the order of
+		// the others.
+		voiceAllocator.removeIf( [&]( int nVoice, Note* pNote, bool bFadedOut ) {
+			CPPUNIT_ASSERT( ! bFadedOut );
+			CPPUNIT_ASSERT( pNote == notes[ nVoice ] );
+			return nVoice % 2 == 0;
+		} );
+		const std::vector<Note*> expected = { notes[ 1 ], notes[ 3 ], notes[ 5 ] };
+		CPPUNIT_ASSERT( getNotes( voiceAllocator ) == expected );
+		CPPUNIT_ASSERT_EQUAL( 3, voiceAllocator.getSounding() );
+
+		// Freed slots are used again.
+		for ( int ii = 0; ii < 5; ++ii ) {
+			CPPUNIT_ASSERT( voiceAllocator.add( createNote( m_pKick ), 8, Policy::oldest ) == nullptr );
+		}
+		CPPUNIT_ASSERT_EQUAL( 8, voiceAllocator.size() );
+		CPPUNIT_ASSERT_EQUAL( 0LL, voiceAllocator.getStats().nStolen );
+
+		voiceAllocator.clear();
+		CPPUNIT_ASSERT_EQUAL( 0, voiceAllocator.size() );
+		CPPUNIT_ASSERT_EQUAL( 0, voiceAllocator.getSounding() );
+	}
+
+	void testStealOldest()
+	{
+		VoiceAllocator voiceAllocator( 8 );
+		std::vector<Note*> notes;
+		for ( int ii = 0; ii < 4; ++ii ) {
+			notes.push_back( createNote( m_pKick ) );
+			voiceAllocator.add( notes.back(), 3, Policy::oldest );
+		}
+
+		// The oldest note fades out instead of being cut.
+		CPPUNIT_ASSERT_EQUAL( 4, voiceAllocator.size() );
+		CPPUNIT_ASSERT_EQUAL( 3, voiceAllocator.getSounding() );
+		CPPUNIT_ASSERT( voiceAllocator.isStolen( 0 ) );
+		CPPUNIT_ASSERT( ! voiceAllocator.isStolen( 1 ) );
+		CPPUNIT_ASSERT_EQUAL( 1LL, voiceAllocator.getStats().nStolen );
+		CPPUNIT_ASSERT( notes[ 0 ]->get_adsr()->get_value( 1 ) > 0.9f );
+		float fValues[ VoiceAllocator::nFadeFrames ];
+		notes[ 0 ]->get_adsr()->get_values( 1, fValues, VoiceAllocator::nFadeFrames );
+		CPPUNIT_ASSERT( fValues[ VoiceAllocator::nFadeFrames / 2 ] < 0.5f );
+		CPPUNIT_ASSERT_EQUAL( 0.0f, notes[ 0 ]->get_adsr()->get_value( 1 ) );
+
+		voiceAllocator.advance( VoiceAllocator::nFadeFrames - 1 );
+		voiceAllocator.removeIf( []( int, Note*, bool bFadedOut ) { return bFadedOut; } );
+		CPPUNIT_ASSERT_EQUAL( 4, voiceAllocator.size() );
+		removeFadedOut( voiceAllocator );
+		const std::vector<Note*> expected = { notes[ 1 ], notes[ 2 ], notes[ 3 ] };
+		CPPUNIT_ASSERT( getNotes( voiceAllocator ) == expected );
+
+		// Lowering the limit steals the oldest notes as well.
+		voiceAllocator.limit( 1, Policy::oldest );
+		CPPUNIT_ASSERT( voiceAllocator.isStolen( 0 ) );
+		CPPUNIT_ASSERT( voiceAllocator.isStolen( 1 ) );
+		CPPUNIT_ASSERT( ! voiceAllocator.isStolen( 2 ) );
+		CPPUNIT_ASSERT_EQUAL( 1, voiceAllocator.getSounding() );
+	}
+
+	void testStealQuietest()
+	{
+		VoiceAllocator voiceAllocator( 8 );
+		Note* pLoud = createNote( m_pKick, 1.0f );
+		Note* pQuiet = createNote( m_pKick, 0.2f );
+		Note* pMedium = createNote( m_pHihat, 0.5f );
+		voiceAllocator.add( pLoud, 3, Policy::quietest );
+		voiceAllocator.add( pQuiet, 3, Policy::quietest );
+		voiceAllocator.add( pMedium, 3, Policy::quietest );
+
+		voiceAllocator.add( createNote( m_pKick, 0.8f ), 3, Policy::quietest );
+		CPPUNIT_ASSERT( voiceAllocator.isStolen( 1 ) );
+		removeFadedOut( voiceAllocator );
+		voiceAllocator.add( createNote( m_pKick, 0.8f ), 3, Policy::quietest );
+		CPPUNIT_ASSERT( voiceAllocator.getNote( 1 ) == pMedium );
+		CPPUNIT_ASSERT( voiceAllocator.isStolen( 1 ) );
+
+		// Prefers notes of the same instrument.
+		removeFadedOut( voiceAllocator );
+		CPPUNIT_ASSERT( voiceAllocator.getNote( 0 ) == pLoud );
+		Note* pHihat = createNote( m_pHihat, 0.1f );
+		voiceAllocator.add( pHihat, 3, Policy::sameInstrument );
+		CPPUNIT_ASSERT( voiceAllocator.isStolen( 0 ) );
+		voiceAllocator.add( createNote( m_pHihat ), 3, Policy::sameInstrument );
+		CPPUNIT_ASSERT( voiceAllocator.getNote( 3 ) == pHihat );
+		CPPUNIT_ASSERT( voiceAllocator.isStolen( 3 ) );
+	}
+
+	void testInstrumentLimit()
+	{
+		m_pHihat->set_max_voices( 2 );
+		VoiceAllocator voiceAllocator( 8 );
+		std::vector<Note*> hihats;
+		for ( int ii = 0; ii < 3; ++ii ) {
+			voiceAllocator.add( createNote( m_pKick ), 8, Policy::oldest );
+			hihats.push_back( createNote( m_pHihat ) );
+			voiceAllocator.add( hihats.back(), 8, Policy::oldest );
+		}
+
+		// Only the first hihat was stolen although the kicks are
+		// older.
+		CPPUNIT_ASSERT_EQUAL( 6, voiceAllocator.size() );
+		CPPUNIT_ASSERT_EQUAL( 5, voiceAllocator.getSounding() );
+		for ( int nVoice = 0; nVoice < voiceAllocator.size(); ++nVoice ) {
+			CPPUNIT_ASSERT_EQUAL( voiceAllocator.getNote( nVoice ) == hihats[ 0 ],
+								  voiceAllocator.isStolen( nVoice ) );
+		}
+		m_pHihat->set_max_voices( 0 );
+	}
+
+	void testDrop()
+	{
+		VoiceAllocator voiceAllocator( 2 );
+		Note* pFirst = createNote( m_pKick );
+		Note* pSecond = createNote( m_pKick );
+		CPPUNIT_ASSERT( voiceAllocator.add( pFirst, 1, Policy::oldest ) == nullptr );
+		CPPUNIT_ASSERT( voiceAllocator.add( pSecond, 1, Policy::oldest ) == nullptr );
+		voiceAllocator.advance( 10 );
+
+		// All slots are in use. The voice closest to finish its fade
+		// is removed right away.
+		Note* pThird = createNote( m_pKick );
+		CPPUNIT_ASSERT( voiceAllocator.add( pThird, 1, Policy::oldest ) == pFirst );
+		const std::vector<Note*> expected = { pSecond, pThird };
+		CPPUNIT_ASSERT( getNotes( voiceAllocator ) == expected );
+		CPPUNIT_ASSERT_EQUAL( 1LL, voiceAllocator.getStats().nDropped );
+		CPPUNIT_ASSERT_EQUAL( 1, voiceAllocator.getSounding() );
+	}
+
+	void testChoke()
+	{
+		auto pOpenHihat = std::make_shared<Instrument>( 3, "Open Hihat" );
+		m_pHihat->set_mute_group( 1 );
+		pOpenHihat->set_mute_group( 1 );
+		VoiceAllocator voiceAllocator( 8 );
+		Note* pKick = createNote( m_pKick );
+		Note* pOpen1 = createNote( pOpenHihat );
+		Note* pOpen2 = createNote( pOpenHihat );
+		Note* pClosed = createNote( m_pHihat );
+		for ( auto pNote : { pKick, pOpen1, pOpen2, pClosed } ) {
+			voiceAllocator.add( pNote, 8, Policy::oldest );
+		}
+
+		// The closed hihat chokes the open ones but neither itself
+		// nor the kick.
+		const std::vector<Note*> muteGroup = { pOpen1, pOpen2, pClosed };
+		CPPUNIT_ASSERT( collect( [&]( auto f ) { voiceAllocator.visitMuteGroup( 1, f ); } ) ==
+						muteGroup );
+		CPPUNIT_ASSERT( collect( [&]( auto f ) { voiceAllocator.visitMuteGroup( 0, f ); } ).empty() );
+		const std::vector<Note*> openHihats = { pOpen1, pOpen2 };
+		CPPUNIT_ASSERT( collect( [&]( auto f ) {
+					voiceAllocator.visitInstrument( pOpenHihat.get(), f ); } ) == openHihats );
+		CPPUNIT_ASSERT( voiceAllocator.containsInstrument( m_pKick.get() ) );
+
+		voiceAllocator.removeIf( [&]( int, Note* pNote, bool ) { return pNote == pOpen1 ||
+																		  pNote == pKick; } );
+		const std::vector<Note*> remaining = { pOpen2, pClosed };
+		CPPUNIT_ASSERT( collect( [&]( auto f ) { voiceAllocator.visitMuteGroup( 1, f ); } ) ==
+						remaining );
+		CPPUNIT_ASSERT( ! voiceAllocator.containsInstrument( m_pKick.get() ) );
+
+		m_pHihat->set_mute_group( -1 );
+	}
+
+	void testGroups()
+	{
+		// Voices found via the lists match the ones of a linear scan
+		// across all operations changing the voices.
+		const int nInstruments = 12;
+		std::vector<std::shared_ptr<Instrument>> instruments;
+		for ( int ii = 0; ii < nInstruments; ++ii ) {
+			instruments.push_back( std::make_shared<Instrument>( ii, "Instrument" ) );
+			instruments.back()->set_mute_group( ii % 4 - 1 );
+		}
+		instruments[ 0 ]->set_max_voices( 3 );
+
+		std::mt19937 rng( 1 );
+		VoiceAllocator voiceAllocator( 32 );
+		for ( int nStep = 0; nStep < 5000; ++nStep ) {
+			const int nAction = rng() % 10;
+			if ( nAction < 6 ) {
+				Note* pNote = createNote( instruments[ rng() % nInstruments ] );
+				pNote->set_midi_info( Note::C, Note::P8, rng() % 4 - 1 );
+				voiceAllocator.add( pNote, 24, static_cast<Policy>( rng() % 3 ) );
+			} else if ( nAction < 9 ) {
+				voiceAllocator.advance( VoiceAllocator::nFadeFrames / 2 );
+				voiceAllocator.removeIf( [&]( int, Note*, bool bFadedOut ) {
+					return bFadedOut || rng() % 4 == 0; } );
+			} else {
+				voiceAllocator.limit( rng() % 24, Policy::quietest );
+			}
+
+			for ( const auto& pInstrument : instruments ) {
+				const auto expected = scan( voiceAllocator, [&]( Note* pNote ) {
+					return pNote->get_instrument() == pInstrument; } );
+				CPPUNIT_ASSERT( collect( [&]( auto f ) {
+							voiceAllocator.visitInstrument( pInstrument.get(), f ); } ) == expected );
+				CPPUNIT_ASSERT_EQUAL( ! expected.empty(),
+									  voiceAllocator.containsInstrument( pInstrument.get() ) );
+			}
+			for ( int nGroup = 0; nGroup < 3; ++nGroup ) {
+				const auto expected = scan( voiceAllocator, [&]( Note* pNote ) {
+					return pNote->get_instrument()->get_mute_group() == nGroup; } );
+				CPPUNIT_ASSERT( collect( [&]( auto f ) {
+							voiceAllocator.visitMuteGroup( nGroup, f ); } ) == expected );
+			}
+			for ( int nKey = 0; nKey < 3; ++nKey ) {
+				const auto expected = scan( voiceAllocator, [&]( Note* pNote ) {
+					return pNote->get_midi_msg() == nKey; } );
+				CPPUNIT_ASSERT( collect( [&]( auto f ) {
+							voiceAllocator.visitMidiKey( nKey, f ); } ) == expected );
+			}
+		}
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( VoiceAllocatorTest );
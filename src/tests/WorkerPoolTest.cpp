@@ -0,0 +1,161 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <core/AudioEngine/WorkerPool.h>
+
+#include <atomic>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace H2Core;
+
+class WorkerPoolTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( WorkerPoolTest );
+	CPPUNIT_TEST( testRun );
+#ifdef __linux__
+	CPPUNIT_TEST( testAdoptAffinity );
+	CPPUNIT_TEST( testPinWorkers );
+#endif
+	CPPUNIT_TEST_SUITE_END();
+
+	struct Context {
+		std::vector<int> results;
+		std::atomic<int> nCalls;
+		int nRound;
+	};
+
+	static void job( void* pContext, int nJob )
+	{
+		auto pJobContext = static_cast<Context*>( pContext );
+		pJobContext->results[ nJob ] = nJob + pJobContext->nRound;
+		++pJobContext->nCalls;
+	}
+
+	void testRun()
+	{
+		WorkerPool pool( 3 );
+		Context context;
+
+		// Each job has to be done exactly once in each round.
+		for ( int nRound = 0; nRound < 500; ++nRound ) {
+			const int nJobs = nRound % 70;
+			context.results.assign( nJobs, -1 );
+			context.nCalls = 0;
+			context.nRound = nRound;
+
+			pool.run( nJobs, &WorkerPoolTest::job, &context );
+
+			CPPUNIT_ASSERT_EQUAL( nJobs, context.nCalls.load() );
+			for ( int ii = 0; ii < nJobs; ++ii ) {
+				CPPUNIT_ASSERT_EQUAL( ii + nRound, context.results[ ii ] );
+			}
+		}
+	}
+
+#ifdef __linux__
+	static void checkAffinity( void* pContext, int )
+	{
+		auto pExpected = static_cast<cpu_set_t*>( pContext );
+		cpu_set_t cpuSet;
+		CPU_ZERO( &cpuSet );
+		sched_getaffinity( 0, sizeof( cpuSet ), &cpuSet );
+		CPPUNIT_ASSERT( CPU_EQUAL( pExpected, &cpuSet ) );
+	}
+
+	void testAdoptAffinity()
+	{
+		cpu_set_t original;
+		CPPUNIT_ASSERT_EQUAL( 0, sched_getaffinity( 0, sizeof( original ), &original ) );
+
+		// Pin the calling thread to the last CPU it may use.
+		int nCPU = CPU_SETSIZE - 1;
+		while ( nCPU > 0 && ! CPU_ISSET( nCPU, &original ) ) {
+			--nCPU;
+		}
+		cpu_set_t pinned;
+		CPU_ZERO( &pinned );
+		CPU_SET( nCPU, &pinned );
+		CPPUNIT_ASSERT_EQUAL( 0, sched_setaffinity( 0, sizeof( pinned ), &pinned ) );
+
+		{
+			WorkerPool pool( 3 );
+			for ( int nRound = 0; nRound < 50; ++nRound ) {
+				pool.run( 16, &WorkerPoolTest::checkAffinity, &pinned );
+			}
+		}
+
+		sched_setaffinity( 0, sizeof( original ), &original );
+	}
+
+	struct PinContext {
+		pthread_t caller;
+		cpu_set_t callerSet;
+		int nFirstCPU;
+	};
+
+	static void checkPinned( void* pContext, int )
+	{
+		auto pPinContext = static_cast<PinContext*>( pContext );
+		if ( pthread_equal( pthread_self(), pPinContext->caller ) ) {
+			return;
+		}
+		cpu_set_t cpuSet;
+		CPU_ZERO( &cpuSet );
+		sched_getaffinity( 0, sizeof( cpuSet ), &cpuSet );
+		CPPUNIT_ASSERT_EQUAL( 1, CPU_COUNT( &cpuSet ) );
+		for ( int nCPU = 0; nCPU < CPU_SETSIZE; ++nCPU ) {
+			if ( CPU_ISSET( nCPU, &cpuSet ) ) {
+				CPPUNIT_ASSERT( CPU_ISSET( nCPU, &pPinContext->callerSet ) );
+				CPPUNIT_ASSERT( nCPU != pPinContext->nFirstCPU );
+			}
+		}
+	}
+
+	void testPinWorkers()
+	{
+		PinContext context;
+		context.caller = pthread_self();
+		CPPUNIT_ASSERT_EQUAL( 0, sched_getaffinity( 0, sizeof( context.callerSet ),
+													&context.callerSet ) );
+		if ( CPU_COUNT( &context.callerSet ) < 2 ) {
+			// Nothing to distribute the workers across.
+			return;
+		}
+		context.nFirstCPU = 0;
+		while ( ! CPU_ISSET( context.nFirstCPU, &context.callerSet ) ) {
+			++context.nFirstCPU;
+		}
+
+		WorkerPool pool( 3 );
+		for ( int nRound = 0; nRound < 50; ++nRound ) {
+			pool.run( 16, &WorkerPoolTest::checkPinned, &context );
+		}
+	}
+#endif
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( WorkerPoolTest );
@@ -0,0 +1,82 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QDebug>
+#include <QString>
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+/**
+ * Helpers shared by the microbenchmarks. Each of them compares a
+ * former implementation with its replacement.
+ */
+namespace Benchmark {
+
+/**
+ * Calls @a function with the index of the round for @a nRounds
+ * rounds.
+ *
+ * \return Average duration of a round in nanoseconds.
+ */
+template <typename Function>
+inline double measure( int nRounds, Function&& function )
+{
+	const auto start = std::chrono::steady_clock::now();
+	for ( int nRound = 0; nRound < nRounds; ++nRound ) {
+		function( nRound );
+	}
+	const auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - start );
+	return static_cast<double>( duration.count() ) / nRounds;
+}
+
+/** Prints the average duration of a round of the former and the
+ * new implementation. */
+inline void report( const QString& sSubject, const QString& sFormer, double fFormerNs,
+					const QString& sNew, double fNewNs )
+{
+	qDebug().noquote() << QString( "%1 - %2: %3 us, %4: %5 us, speedup: %6" )
+		.arg( sSubject ).arg( sFormer ).arg( fFormerNs / 1000, 0, 'f', 3 )
+		.arg( sNew ).arg( fNewNs / 1000, 0, 'f', 3 )
+		.arg( fNewNs > 0 ? fFormerNs / fNewNs : 0, 0, 'f', 2 );
+}
+
+/** \return @a nFrames random values uniformly distributed in [-1, 1). */
+inline std::vector<float> createBuffer( int nFrames, unsigned nSeed )
+{
+	std::mt19937 rng( nSeed );
+	std::uniform_real_distribution<float> dist( -1.0f, 1.0f );
+	std::vector<float> buffer( nFrames );
+	for ( auto& fValue : buffer ) {
+		fValue = dist( rng );
+	}
+	return buffer;
+}
+
+};
+
+#endif // BENCHMARK_H
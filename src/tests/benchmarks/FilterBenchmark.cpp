@@ -0,0 +1,95 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <core/Basics/Instrument.h>
+#include <core/Basics/Note.h>
+#include <core/Sampler/Filter.h>
+
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <memory>
+
+using namespace H2Core;
+
+/**
+ * Compares filtering a voice frame by frame, the way the Sampler
+ * used to, with Note::apply_filter().
+ */
+class FilterBenchmark : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( FilterBenchmark );
+	CPPUNIT_TEST( testApplyFilter );
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void testApplyFilter()
+	{
+		const int nFrames = 1024;
+		const int nRounds = 2000;
+		auto pInstrument = std::make_shared<Instrument>( 1, "Snare", nullptr );
+		pInstrument->set_filter_active( true );
+		pInstrument->set_filter_cutoff( 0.5f );
+		pInstrument->set_filter_resonance( 0.3f );
+		Note blockNote( pInstrument, 0, 1.0f, 0.f, -1, 0 );
+		const float fCutoff = pInstrument->get_filter_cutoff();
+		const float fResonance = pInstrument->get_filter_resonance();
+		Filter::State state = { { 0.f, 0.f }, { 0.f, 0.f } };
+
+		const auto source_L = Benchmark::createBuffer( nFrames, 11 );
+		const auto source_R = Benchmark::createBuffer( nFrames, 12 );
+		auto buffer_L = source_L;
+		auto buffer_R = source_R;
+
+		float fPerFrameSum = 0;
+		const double fPerFrameTime = Benchmark::measure( nRounds, [&]( int ) {
+			std::copy( source_L.begin(), source_L.end(), buffer_L.begin() );
+			std::copy( source_R.begin(), source_R.end(), buffer_R.begin() );
+			for ( int ii = 0; ii < nFrames; ++ii ) {
+				state.fBandPass[ 0 ] = fResonance * state.fBandPass[ 0 ] +
+					fCutoff * ( buffer_L[ ii ] - state.fLowPass[ 0 ] );
+				state.fLowPass[ 0 ] += fCutoff * state.fBandPass[ 0 ];
+				state.fBandPass[ 1 ] = fResonance * state.fBandPass[ 1 ] +
+					fCutoff * ( buffer_R[ ii ] - state.fLowPass[ 1 ] );
+				state.fLowPass[ 1 ] += fCutoff * state.fBandPass[ 1 ];
+				buffer_L[ ii ] = state.fLowPass[ 0 ];
+				buffer_R[ ii ] = state.fLowPass[ 1 ];
+			}
+			fPerFrameSum += buffer_L[ nFrames - 1 ] + buffer_R[ nFrames - 1 ];
+		} );
+
+		float fBlockSum = 0;
+		const double fBlockTime = Benchmark::measure( nRounds, [&]( int ) {
+			std::copy( source_L.begin(), source_L.end(), buffer_L.begin() );
+			std::copy( source_R.begin(), source_R.end(), buffer_R.begin() );
+			blockNote.apply_filter( buffer_L.data(), buffer_R.data(), nFrames );
+			fBlockSum += buffer_L[ nFrames - 1 ] + buffer_R[ nFrames - 1 ];
+		} );
+
+		CPPUNIT_ASSERT_EQUAL( fPerFrameSum, fBlockSum );
+
+		Benchmark::report( QString( "Filter, %1 frames" ).arg( nFrames ),
+						   "per frame", fPerFrameTime, "block-wise", fBlockTime );
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( FilterBenchmark );
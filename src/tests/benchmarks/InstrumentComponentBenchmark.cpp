@@ -0,0 +1,129 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <core/Basics/InstrumentComponent.h>
+#include <core/Basics/InstrumentLayer.h>
+
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <memory>
+
+using namespace H2Core;
+
+/**
+ * Compares the linear scan over all layers formerly done by the
+ * Sampler with the velocity table of InstrumentComponent.
+ */
+class InstrumentComponentBenchmark : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( InstrumentComponentBenchmark );
+	CPPUNIT_TEST( testFindLayers );
+	CPPUNIT_TEST_SUITE_END();
+
+	int m_nMaxLayers;
+
+	/** Layers with random, possibly overlapping velocity ranges.
+	 * Every third slot is left empty. */
+	std::shared_ptr<InstrumentComponent> createComponent( int nLayers, unsigned nSeed )
+	{
+		std::mt19937 rng( nSeed );
+		std::uniform_real_distribution<float> dist( 0.0f, 1.0f );
+		auto pComponent = std::make_shared<InstrumentComponent>( 0 );
+		for ( int ii = 0; ii < nLayers; ++ii ) {
+			if ( ii % 3 == 2 ) {
+				continue;
+			}
+			auto pLayer = std::make_shared<InstrumentLayer>( nullptr );
+			const float fStart = dist( rng );
+			pLayer->set_start_velocity( fStart );
+			pLayer->set_end_velocity( std::min( 1.0f, fStart + dist( rng ) * 0.2f ) );
+			pComponent->set_layer( pLayer, ii );
+		}
+		return pComponent;
+	}
+
+	static int findLayersLinear( std::shared_ptr<InstrumentComponent> pComponent,
+								 float fVelocity, int* indices )
+	{
+		int nFound = 0;
+		for ( int nLayer = 0; nLayer < InstrumentComponent::getMaxLayers(); ++nLayer ) {
+			auto pLayer = pComponent->get_layer( nLayer );
+			if ( pLayer != nullptr &&
+				 fVelocity >= pLayer->get_start_velocity() &&
+				 fVelocity <= pLayer->get_end_velocity() ) {
+				indices[ nFound++ ] = nLayer;
+			}
+		}
+		return nFound;
+	}
+
+public:
+	void setUp() override
+	{
+		m_nMaxLayers = InstrumentComponent::getMaxLayers();
+		InstrumentComponent::setMaxLayers( 32 );
+	}
+
+	void tearDown() override
+	{
+		InstrumentComponent::setMaxLayers( m_nMaxLayers );
+	}
+
+	void testFindLayers()
+	{
+		const int nLookups = 1000000;
+		std::mt19937 rng( 3 );
+		std::uniform_real_distribution<float> dist( 0.0f, 1.0f );
+		std::vector<float> velocities( nLookups );
+		for ( auto& fVelocity : velocities ) {
+			fVelocity = dist( rng );
+		}
+		std::vector<int> indices( InstrumentComponent::getMaxLayers() );
+
+		for ( int nLayers : { 16, 24, 32 } ) {
+			auto pComponent = createComponent( nLayers, 4 );
+
+			long long nFoundLinear = 0;
+			const double fLinearTime = Benchmark::measure( 1, [&]( int ) {
+				for ( float fVelocity : velocities ) {
+					nFoundLinear += findLayersLinear( pComponent, fVelocity, indices.data() );
+				}
+			} );
+
+			long long nFoundTable = 0;
+			const double fTableTime = Benchmark::measure( 1, [&]( int ) {
+				for ( float fVelocity : velocities ) {
+					nFoundTable += pComponent->find_layers( fVelocity, indices.data() );
+				}
+			} );
+
+			CPPUNIT_ASSERT_EQUAL( nFoundLinear, nFoundTable );
+
+			Benchmark::report( QString( "InstrumentComponent, %1 layers, %2 lookups" )
+							   .arg( nLayers ).arg( nLookups ),
+							   "linear scan", fLinearTime, "velocity table", fTableTime );
+		}
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( InstrumentComponentBenchmark );
@@ -0,0 +1,130 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <core/AudioEngine/Mixing.h>
+
+#include "Benchmark.h"
+
+#include <algorithm>
+
+using namespace H2Core;
+
+/**
+ * Compares the former per-frame passes of
+ * AudioEngine::audioEngine_process() - summing sampler and synth,
+ * adding an effect return, and computing the master and all
+ * component peaks within the same frame loop - with the block-wise
+ * ones.
+ */
+class MixingBenchmark : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( MixingBenchmark );
+	CPPUNIT_TEST( testProcess );
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void testProcess()
+	{
+		const unsigned nFrames = 1024;
+		const int nComponents = 4;
+		const int nRounds = 2000;
+
+		auto sampler_L = Benchmark::createBuffer( nFrames, 1 );
+		auto sampler_R = Benchmark::createBuffer( nFrames, 2 );
+		auto synth_L = Benchmark::createBuffer( nFrames, 3 );
+		auto synth_R = Benchmark::createBuffer( nFrames, 4 );
+		auto fx_L = Benchmark::createBuffer( nFrames, 5 );
+		auto fx_R = Benchmark::createBuffer( nFrames, 6 );
+		std::vector<std::vector<float>> components;
+		for ( int ii = 0; ii < 2 * nComponents; ++ii ) {
+			components.push_back( Benchmark::createBuffer( nFrames, 7 + ii ) );
+		}
+		std::vector<float> out_L( nFrames ), out_R( nFrames );
+
+		float fPerFrameSum = 0;
+		const double fPerFrameTime = Benchmark::measure( nRounds, [&]( int ) {
+			float fMasterPeak_L = 0, fMasterPeak_R = 0, fFXPeak_L = 0, fFXPeak_R = 0;
+			std::vector<float> componentPeaks( 2 * nComponents, 0.f );
+			std::fill( out_L.begin(), out_L.end(), 0.f );
+			std::fill( out_R.begin(), out_R.end(), 0.f );
+			for ( unsigned i = 0; i < nFrames; ++i ) {
+				out_L[ i ] += sampler_L[ i ];
+				out_R[ i ] += sampler_R[ i ];
+			}
+			for ( unsigned i = 0; i < nFrames; ++i ) {
+				out_L[ i ] += synth_L[ i ];
+				out_R[ i ] += synth_R[ i ];
+			}
+			for ( unsigned i = 0; i < nFrames; ++i ) {
+				out_L[ i ] += fx_L[ i ];
+				out_R[ i ] += fx_R[ i ];
+				if ( fx_L[ i ] > fFXPeak_L ) {
+					fFXPeak_L = fx_L[ i ];
+				}
+				if ( fx_R[ i ] > fFXPeak_R ) {
+					fFXPeak_R = fx_R[ i ];
+				}
+			}
+			for ( unsigned i = 0; i < nFrames; ++i ) {
+				if ( out_L[ i ] > fMasterPeak_L ) {
+					fMasterPeak_L = out_L[ i ];
+				}
+				if ( out_R[ i ] > fMasterPeak_R ) {
+					fMasterPeak_R = out_R[ i ];
+				}
+				for ( int nCompo = 0; nCompo < 2 * nComponents; ++nCompo ) {
+					if ( components[ nCompo ][ i ] > componentPeaks[ nCompo ] ) {
+						componentPeaks[ nCompo ] = components[ nCompo ][ i ];
+					}
+				}
+			}
+			fPerFrameSum += fMasterPeak_L + fMasterPeak_R + fFXPeak_L + fFXPeak_R;
+			for ( auto fPeak : componentPeaks ) {
+				fPerFrameSum += fPeak;
+			}
+		} );
+
+		float fBlockSum = 0;
+		const double fBlockTime = Benchmark::measure( nRounds, [&]( int ) {
+			float fMasterPeak_L = 0, fMasterPeak_R = 0, fFXPeak_L = 0, fFXPeak_R = 0;
+			std::fill( out_L.begin(), out_L.end(), 0.f );
+			std::fill( out_R.begin(), out_R.end(), 0.f );
+			Mixing::add( out_L.data(), sampler_L.data(), synth_L.data(), nFrames );
+			Mixing::add( out_R.data(), sampler_R.data(), synth_R.data(), nFrames );
+			Mixing::addAndPeak( out_L.data(), fx_L.data(), nFrames, fFXPeak_L );
+			Mixing::addAndPeak( out_R.data(), fx_R.data(), nFrames, fFXPeak_R );
+			fMasterPeak_L = Mixing::peak( out_L.data(), nFrames, fMasterPeak_L );
+			fMasterPeak_R = Mixing::peak( out_R.data(), nFrames, fMasterPeak_R );
+			fBlockSum += fMasterPeak_L + fMasterPeak_R + fFXPeak_L + fFXPeak_R;
+			for ( const auto& component : components ) {
+				fBlockSum += Mixing::peak( component.data(), nFrames, 0.f );
+			}
+		} );
+
+		CPPUNIT_ASSERT_EQUAL( fPerFrameSum, fBlockSum );
+
+		Benchmark::report( QString( "Mixing, %1 frames, %2 components" ).arg( nFrames ).arg( nComponents ),
+						   "per frame", fPerFrameTime, "block-wise", fBlockTime );
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( MixingBenchmark );
@@ -0,0 +1,110 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <core/AudioEngine/NoteScheduler.h>
+#include <core/Basics/Note.h>
+
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <queue>
+
+using namespace H2Core;
+
+/**
+ * Compares the timing wheel with the priority queue used by the
+ * AudioEngine previously. All notes are queued within a lookahead
+ * window and drained in periods of 1024 frames. Just like in
+ * AudioEngine::updateNoteQueue() they are enqueued in the order of
+ * their ticks.
+ */
+class NoteSchedulerBenchmark : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( NoteSchedulerBenchmark );
+	CPPUNIT_TEST( testQueue );
+	CPPUNIT_TEST_SUITE_END();
+
+	struct ComparePositions {
+		bool operator()( Note* pNote1, Note* pNote2 ) {
+			return pNote1->get_position() > pNote2->get_position();
+		}
+	};
+
+public:
+	void testQueue()
+	{
+		const int nSpan = 16384;
+		const int nPeriod = 1024;
+		const int nRounds = 10;
+
+		for ( int nNotes : { 1000, 10000, 100000 } ) {
+			std::mt19937 rng( 3 );
+			std::uniform_int_distribution<int> dist( 0, nSpan - 1 );
+			std::vector<std::unique_ptr<Note>> notes;
+			for ( int ii = 0; ii < nNotes; ++ii ) {
+				notes.push_back( std::make_unique<Note>( nullptr, dist( rng ), 1.0f, 0.f, -1, 0.f ) );
+			}
+			std::stable_sort( notes.begin(), notes.end(),
+							  []( const std::unique_ptr<Note>& pNote1,
+								  const std::unique_ptr<Note>& pNote2 ) {
+								  return pNote1->get_position() < pNote2->get_position(); } );
+
+			int nPoppedQueue = 0;
+			const double fQueueTime = Benchmark::measure( nRounds, [&]( int ) {
+				std::priority_queue<Note*, std::deque<Note*>, ComparePositions> queue;
+				for ( auto& pNote : notes ) {
+					queue.push( pNote.get() );
+				}
+				for ( int nFrame = 0; nFrame < nSpan; nFrame += nPeriod ) {
+					while ( ! queue.empty() &&
+							queue.top()->get_position() < nFrame + nPeriod ) {
+						queue.pop();
+						++nPoppedQueue;
+					}
+				}
+			} );
+
+			int nPoppedWheel = 0;
+			NoteScheduler scheduler;
+			const double fWheelTime = Benchmark::measure( nRounds, [&]( int ) {
+				for ( auto& pNote : notes ) {
+					scheduler.push( pNote.get(), pNote->get_position() );
+				}
+				for ( int nFrame = 0; nFrame < nSpan; nFrame += nPeriod ) {
+					while ( scheduler.popDue( nFrame + nPeriod ) != nullptr ) {
+						++nPoppedWheel;
+					}
+				}
+			} );
+
+			CPPUNIT_ASSERT_EQUAL( nNotes * nRounds, nPoppedQueue );
+			CPPUNIT_ASSERT_EQUAL( nNotes * nRounds, nPoppedWheel );
+
+			Benchmark::report( QString( "NoteScheduler, %1 notes" ).arg( nNotes ),
+							   "priority queue", fQueueTime, "timing wheel", fWheelTime );
+		}
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( NoteSchedulerBenchmark );
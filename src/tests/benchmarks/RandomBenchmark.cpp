@@ -0,0 +1,74 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <core/Helpers/Random.h>
+
+#include "Benchmark.h"
+
+#include <cmath>
+#include <cstdlib>
+
+using namespace H2Core;
+
+/** Compares the polar method formerly used by the AudioEngine with
+ * Random::gaussian(). */
+class RandomBenchmark : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( RandomBenchmark );
+	CPPUNIT_TEST( testGaussian );
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void testGaussian()
+	{
+		const int nCount = 10000000;
+		const float fRandMax = static_cast<float>( RAND_MAX );
+
+		float fSumRand = 0;
+		const double fRandTime = Benchmark::measure( 1, [&]( int ) {
+			for ( int ii = 0; ii < nCount; ++ii ) {
+				float x1, x2, w;
+				do {
+					x1 = 2.0f * static_cast<float>( rand() ) / fRandMax - 1.0f;
+					x2 = 2.0f * static_cast<float>( rand() ) / fRandMax - 1.0f;
+					w = x1 * x1 + x2 * x2;
+				} while ( w >= 1.0f || w == 0.0f );
+				fSumRand += x1 * sqrtf( -2.0f * logf( w ) / w );
+			}
+		} );
+
+		Random random( 1 );
+		float fSumRandom = 0;
+		const double fRandomTime = Benchmark::measure( 1, [&]( int ) {
+			for ( int ii = 0; ii < nCount; ++ii ) {
+				fSumRandom += random.gaussian();
+			}
+		} );
+
+		CPPUNIT_ASSERT( std::isfinite( fSumRand ) && std::isfinite( fSumRandom ) );
+
+		Benchmark::report( QString( "Random, %1 Gaussian numbers" ).arg( nCount ),
+						   "rand()", fRandTime, "Random", fRandomTime );
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( RandomBenchmark );
@@ -0,0 +1,57 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+
+#include <core/Object.h>
+#include <core/Logger.h>
+
+#include <QCoreApplication>
+
+/**
+ * Runs all microbenchmarks or the ones given by name on the command
+ * line, e.g. "MixingBenchmark". The results are printed to
+ * stderr.
+ */
+int main( int argc, char **argv )
+{
+	QCoreApplication app( argc, argv );
+
+	H2Core::Logger* pLogger = H2Core::Logger::bootstrap( H2Core::Logger::Error );
+	H2Core::Base::bootstrap( pLogger, false );
+
+	CppUnit::TextUi::TestRunner runner;
+	runner.addTest( CppUnit::TestFactoryRegistry::getRegistry().makeTest() );
+
+	bool bSuccessful = true;
+	if ( argc < 2 ) {
+		bSuccessful = runner.run( "", false );
+	} else {
+		for ( int ii = 1; ii < argc; ++ii ) {
+			bSuccessful = runner.run( argv[ ii ], false ) && bSuccessful;
+		}
+	}
+
+	delete pLogger;
+	return bSuccessful ? 0 : 1;
+}